@@ -22,6 +22,9 @@
 #include "camera_engine.h"
 #include "utils/native_debug.h"
 
+// Log preview conversion stats every so many frames
+static const uint64_t kPreviewStatsInterval = 300;
+
 /**
  * constructor and destructor for main application class
  * @param app native_app_glue environment
@@ -154,19 +157,33 @@ void CameraEngine::OnCameraParameterChanged(int32_t code, int64_t val) {
  */
 void CameraEngine::DrawFrame(void) {
   if (!cameraReady_ || !yuvReader_) return;
-  AImage* image = yuvReader_->GetNextImage();
-  if (!image) {
+  // latest frame wins: frames older than it are dropped, not queued
+  FrameHandle frame = yuvReader_->GetLatestFrame();
+  if (frame == kInvalidFrame) {
     return;
   }
 
   ANativeWindow_acquire(app_->window);
   ANativeWindow_Buffer buf;
   if (ANativeWindow_lock(app_->window, &buf, nullptr) < 0) {
-    yuvReader_->DeleteImage(image);
+    yuvReader_->GetFramePool()->Release(frame);
+    ANativeWindow_release(app_->window);
     return;
   }
 
-  yuvReader_->DisplayImage(&buf, image);
+  yuvReader_->DisplayFrame(&buf, frame);
   ANativeWindow_unlockAndPost(app_->window);
   ANativeWindow_release(app_->window);
+  yuvReader_->GetFramePool()->Release(frame);
+
+  ConversionStats stats;
+  yuvReader_->GetPreviewStats(&stats);
+  if (stats.frames && stats.frames % kPreviewStatsInterval == 0) {
+    LOGI("Preview: %llu frames, %llu dropped, conversion avg %llu us, "
+         "max %llu us",
+         static_cast<unsigned long long>(stats.frames),
+         static_cast<unsigned long long>(stats.droppedFrames),
+         static_cast<unsigned long long>(stats.totalLatency / stats.frames),
+         static_cast<unsigned long long>(stats.maxLatency));
+  }
 }
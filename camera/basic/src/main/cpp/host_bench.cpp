@@ -0,0 +1,499 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check and benchmarks of the camera helpers in common/utils that don't
+ * depend on the camera or window APIs, built when CMakeLists.txt is
+ * configured for the host rather than Android:
+ *   camera_host_bench check    YuvConverter against the per-pixel YUV2RGB()
+ *                              the sample used before, and FileWriter in a
+ *                              burst of captures; exit 1 on a mismatch
+ *   camera_host_bench convert  vector converter against the per-pixel loop
+ *   camera_host_bench rotate   blocked rotation against per-pixel rotation
+ * With no argument, runs all of them.
+ */
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/file_writer.h"
+#include "utils/yuv_converter.h"
+
+namespace {
+
+double NowMs() {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+ * YUV2RGB(): the per-pixel conversion of image_reader.cpp before
+ * YuvConverter, unchanged; it packs 0xAARRGGBB.
+ */
+const int kMaxChannelValue = 262143;
+
+inline uint32_t YUV2RGB(int nY, int nU, int nV) {
+  nY -= 16;
+  nU -= 128;
+  nV -= 128;
+  if (nY < 0) nY = 0;
+
+  int nR = (int)(1192 * nY + 1634 * nV);
+  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
+  int nB = (int)(1192 * nY + 2066 * nU);
+
+  nR = std::min(kMaxChannelValue, std::max(0, nR));
+  nG = std::min(kMaxChannelValue, std::max(0, nG));
+  nB = std::min(kMaxChannelValue, std::max(0, nB));
+
+  nR = (nR >> 10) & 0xff;
+  nG = (nG >> 10) & 0xff;
+  nB = (nB >> 10) & 0xff;
+
+  return 0xff000000 | (nR << 16) | (nG << 8) | nB;
+}
+
+// YUV2RGB() in the RGBA byte order of YuvConverter: R and B swapped
+inline uint32_t ReferencePixel(int y, int u, int v) {
+  uint32_t p = YUV2RGB(y, u, v);
+  return (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+}
+
+/*
+ * A picture with random samples, in one of the chroma layouts of
+ * YUV_420_888, with padding at the end of each row
+ */
+enum class ChromaLayout { I420, NV12, NV21 };
+
+struct TestPicture {
+  std::vector<uint8_t> y, u, v;
+  YuvPlanes planes;
+
+  TestPicture(int32_t width, int32_t height, ChromaLayout layout,
+              int32_t padding) {
+    int32_t pixelStride = layout == ChromaLayout::I420 ? 1 : 2;
+    int32_t uvStride = (width + 1) / 2 * pixelStride + padding;
+    int32_t uvRows = (height + 1) / 2;
+    y.resize((width + padding) * height);
+    u.resize(uvStride * uvRows + 1);
+    v.resize(layout == ChromaLayout::I420 ? u.size() : 0);
+    for (auto& s : y) s = static_cast<uint8_t>(rand());
+    for (auto& s : u) s = static_cast<uint8_t>(rand());
+    for (auto& s : v) s = static_cast<uint8_t>(rand());
+    planes.y = y.data();
+    planes.yStride = width + padding;
+    planes.uvStride = uvStride;
+    planes.uvPixelStride = pixelStride;
+    switch (layout) {
+      case ChromaLayout::I420:
+        planes.u = u.data();
+        planes.v = v.data();
+        break;
+      case ChromaLayout::NV12:
+        planes.u = u.data();
+        planes.v = u.data() + 1;
+        break;
+      case ChromaLayout::NV21:
+        planes.v = u.data();
+        planes.u = u.data() + 1;
+        break;
+    }
+  }
+
+  // chroma sample of pixel x of a row starting at left, as image_reader.cpp
+  // addressed it
+  int32_t UvOffset(int32_t left, int32_t row, int32_t x) const {
+    return planes.uvStride * (row >> 1) +
+           ((left >> 1) + (x >> 1)) * planes.uvPixelStride;
+  }
+};
+
+const char* kLayoutNames[] = {"I420", "NV12", "NV21"};
+
+/*
+ * Every Y/U/V triple through ConvertPixel() against YUV2RGB(), then pictures
+ * of odd sizes and padded strides in each chroma layout through Convert():
+ * against YUV2RGB() for BT.601 limited range, against ConvertPixel() for the
+ * other coefficient sets (the scalar path the vector code must match).
+ */
+bool CheckConverter() {
+  bool ok = true;
+  YuvConverter bt601;
+  uint32_t mismatches = 0;
+  for (int y = 0; y < 256; y++) {
+    for (int u = 0; u < 256; u++) {
+      for (int v = 0; v < 256; v++) {
+        mismatches += bt601.ConvertPixel(y, u, v) != ReferencePixel(y, u, v);
+      }
+    }
+  }
+  printf("ConvertPixel, all 2^24 samples: %u mismatches\n", mismatches);
+  ok = ok && !mismatches;
+
+  const int32_t kSizes[][2] = {{1, 1},  {2, 2},  {15, 7},
+                               {17, 9}, {33, 5}, {1923, 37}};
+  const YuvColorSpace kSpaces[] = {YuvColorSpace::BT601, YuvColorSpace::BT709};
+  const YuvRange kRanges[] = {YuvRange::LIMITED, YuvRange::FULL};
+  for (int32_t layout = 0; layout < 3; layout++) {
+    mismatches = 0;
+    for (auto& size : kSizes) {
+      TestPicture pic(size[0], size[1], static_cast<ChromaLayout>(layout), 13);
+      // whole picture, and a region from an even left / odd top corner
+      const int32_t kRegions[][4] = {
+          {0, 0, size[0], size[1]},
+          {std::min(2, size[0] - 1), std::min(1, size[1] - 1),
+           std::max(1, size[0] - 3), std::max(1, size[1] - 2)}};
+      for (auto& region : kRegions) {
+        int32_t left = region[0], top = region[1];
+        int32_t width = region[2], height = region[3];
+        int32_t outStride = width + 7;
+        std::vector<uint32_t> out(outStride * height);
+        for (auto space : kSpaces) {
+          for (auto range : kRanges) {
+            YuvConverter conv(space, range);
+            bool reference =
+                space == YuvColorSpace::BT601 && range == YuvRange::LIMITED;
+            conv.Convert(pic.planes, left, top, width, height, out.data(),
+                         outStride);
+            for (int32_t r = 0; r < height; r++) {
+              const uint8_t* y = pic.planes.y + pic.planes.yStride * (top + r);
+              for (int32_t x = 0; x < width; x++) {
+                int32_t uv = pic.UvOffset(left, top + r, x);
+                int32_t Y = y[left + x], U = pic.planes.u[uv],
+                        V = pic.planes.v[uv];
+                uint32_t expect = reference ? ReferencePixel(Y, U, V)
+                                            : conv.ConvertPixel(Y, U, V);
+                mismatches += out[r * outStride + x] != expect;
+              }
+            }
+          }
+        }
+      }
+    }
+    printf("Convert, %s, odd sizes and strides: %u mismatches\n",
+           kLayoutNames[layout], mismatches);
+    ok = ok && !mismatches;
+  }
+  return ok;
+}
+
+/*
+ * RotatePixel(): per-pixel rotated conversion, one YUV2RGB() per source
+ * pixel written to its rotated place, as the old PresentImage90/180/270()
+ * did
+ */
+void RotatePixel(const TestPicture& pic, int32_t left, int32_t top,
+                 int32_t width, int32_t height, int32_t rotation,
+                 uint32_t* out, int32_t outStride) {
+  for (int32_t r = 0; r < height; r++) {
+    const uint8_t* y = pic.planes.y + pic.planes.yStride * (top + r);
+    for (int32_t x = 0; x < width; x++) {
+      int32_t uv = pic.UvOffset(left, top + r, x);
+      uint32_t pixel =
+          ReferencePixel(y[left + x], pic.planes.u[uv], pic.planes.v[uv]);
+      switch (rotation) {
+        case 90:
+          out[x * outStride + height - 1 - r] = pixel;
+          break;
+        case 180:
+          out[(height - 1 - r) * outStride + width - 1 - x] = pixel;
+          break;
+        default:
+          out[(width - 1 - x) * outStride + r] = pixel;
+          break;
+      }
+    }
+  }
+}
+
+// ConvertRotated() against RotatePixel(), on sizes that leave partial blocks
+bool CheckRotation() {
+  const int32_t kSizes[][2] = {{1, 1}, {31, 33}, {65, 47}, {333, 97}};
+  bool ok = true;
+  YuvConverter conv;
+  for (int32_t layout = 0; layout < 3; layout++) {
+    uint32_t mismatches = 0;
+    for (auto& size : kSizes) {
+      TestPicture pic(size[0], size[1], static_cast<ChromaLayout>(layout), 5);
+      int32_t left = size[0] > 2 ? 2 : 0, top = size[1] > 1 ? 1 : 0;
+      int32_t width = size[0] - left, height = size[1] - top;
+      for (int32_t rotation = 90; rotation <= 270; rotation += 90) {
+        int32_t rows = rotation == 180 ? height : width;
+        int32_t outStride = (rotation == 180 ? width : height) + 3;
+        std::vector<uint32_t> blocked(rows * outStride, 0),
+            pixel(rows * outStride, 0);
+        conv.ConvertRotated(pic.planes, left, top, width, height, rotation,
+                            blocked.data(), outStride);
+        RotatePixel(pic, left, top, width, height, rotation, pixel.data(),
+                    outStride);
+        for (size_t i = 0; i < blocked.size(); i++) {
+          mismatches += blocked[i] != pixel[i];
+        }
+      }
+    }
+    printf("ConvertRotated, %s, 90/180/270: %u mismatches\n",
+           kLayoutNames[layout], mismatches);
+    ok = ok && !mismatches;
+  }
+  return ok;
+}
+
+/*
+ * A burst of 30 captures through FileWriter, set up as ImageReader does:
+ * MAX_BUF_COUNT (4) reader buffers and a queue of MAX_BUF_COUNT - 2. The
+ * "camera" acquires a free buffer for each capture as fast as it can, like
+ * AImageReader_acquireNextImage(), which must never find all buffers held by
+ * the writer; each buffer goes back when its release callback runs.
+ * Checks the queue depth and stalls, that every file is written with its
+ * capture's data, that captures within one second get distinct -<n> names,
+ * and that every capture is released and reported once, also when the
+ * files can't be written.
+ */
+bool CheckFileWriterBurst() {
+  const int kBuffers = 4, kCaptures = 30;
+  const uint32_t kQueueDepth = kBuffers - 2;
+  const size_t kCaptureSize = 3 * 1024 * 1024;
+  bool ok = true;
+
+  const char* tmp = getenv("TMPDIR");
+  std::string dir = std::string(tmp ? tmp : "/tmp") + "/camera_burst_XXXXXX";
+  if (!mkdtemp(&dir[0])) {
+    fprintf(stderr, "FileWriter: unable to create %s\n", dir.c_str());
+    return false;
+  }
+
+  std::vector<std::vector<uint8_t>> buffers(kBuffers,
+                                            std::vector<uint8_t>(kCaptureSize));
+  std::vector<bool> held(kBuffers, false);
+  std::mutex lock;
+  int exhausted = 0, releases = 0, dones = 0;
+  std::vector<std::string> names(kCaptures);
+  FileWriterStats stats;
+  auto start = NowMs();
+  {
+    FileWriter writer((dir + "/DCIM").c_str(), "capture", ".jpg", kQueueDepth);
+    for (int capture = 0; capture < kCaptures; capture++) {
+      int buffer = 0;
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        while (buffer < kBuffers && held[buffer]) buffer++;
+        if (buffer == kBuffers) {
+          // AImageReader would fail with AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED
+          exhausted++;
+          continue;
+        }
+        held[buffer] = true;
+      }
+      memset(buffers[buffer].data(), capture, kCaptureSize);
+      writer.Enqueue(
+          buffers[buffer].data(), kCaptureSize,
+          [&, buffer]() {
+            std::lock_guard<std::mutex> guard(lock);
+            held[buffer] = false;
+            releases++;
+          },
+          [&, capture](const char* fileName) {
+            std::lock_guard<std::mutex> guard(lock);
+            names[capture] = fileName ? fileName : "";
+            dones++;
+          });
+    }
+    writer.GetStats(&stats);
+  }
+  double ms = NowMs() - start;
+
+  if (exhausted || releases != kCaptures || dones != kCaptures) {
+    fprintf(stderr,
+            "FileWriter: %d captures found no buffer, %d released, %d done\n",
+            exhausted, releases, dones);
+    ok = false;
+  }
+  // queued entries plus the one being written
+  if (stats.maxQueueDepth > kQueueDepth + 1 || !stats.stalls) {
+    fprintf(stderr, "FileWriter: max queue depth %u, %u stalls\n",
+            stats.maxQueueDepth, stats.stalls);
+    ok = false;
+  }
+
+  // <prefix><date-time>[-<n>]<suffix>: per date-time, n counts 1, 2, ...
+  std::map<std::string, std::vector<int>> seconds;
+  for (int capture = 0; capture < kCaptures; capture++) {
+    const std::string& name = names[capture];
+    struct stat st;
+    std::vector<uint8_t> data(kCaptureSize);
+    FILE* file = name.empty() ? nullptr : fopen(name.c_str(), "rb");
+    bool same = file && stat(name.c_str(), &st) == 0 &&
+                static_cast<size_t>(st.st_size) == kCaptureSize &&
+                fread(data.data(), 1, kCaptureSize, file) == kCaptureSize &&
+                std::count(data.begin(), data.end(),
+                           static_cast<uint8_t>(capture)) ==
+                    static_cast<long>(kCaptureSize);
+    if (file) fclose(file);
+    if (!same) {
+      fprintf(stderr, "FileWriter: capture %d not in '%s'\n", capture,
+              name.c_str());
+      ok = false;
+      continue;
+    }
+    std::string base = name.substr(name.rfind('/') + 1);
+    base.resize(base.size() - strlen(".jpg"));
+    size_t dash = base.rfind('-');
+    size_t timeDash = base.find('-');
+    int n = 0;
+    if (dash != timeDash) {
+      n = atoi(base.c_str() + dash + 1);
+      base.resize(dash);
+    }
+    seconds[base].push_back(n);
+    unlink(name.c_str());
+  }
+  for (auto& second : seconds) {
+    for (size_t i = 0; i < second.second.size(); i++) {
+      if (second.second[i] != static_cast<int>(i)) {
+        fprintf(stderr, "FileWriter: capture %zu of %s is numbered %d\n", i,
+                second.first.c_str(), second.second[i]);
+        ok = false;
+      }
+    }
+  }
+  rmdir((dir + "/DCIM").c_str());
+
+  // a directory that can't be created: failures, still released and reported
+  std::string blocker = dir + "/file";
+  FILE* file = fopen(blocker.c_str(), "w");
+  if (file) fclose(file);
+  int failedReleases = 0, failedDones = 0;
+  {
+    FileWriter writer((blocker + "/DCIM").c_str(), "capture", ".jpg",
+                      kQueueDepth);
+    for (int capture = 0; capture < 3; capture++) {
+      writer.Enqueue(buffers[0].data(), kCaptureSize,
+                     [&]() { failedReleases++; },
+                     [&](const char* fileName) {
+                       failedDones += fileName == nullptr;
+                     });
+    }
+  }
+  if (failedReleases != 3 || failedDones != 3) {
+    fprintf(stderr, "FileWriter: unwritable directory, %d released, %d failed\n",
+            failedReleases, failedDones);
+    ok = false;
+  }
+  unlink(blocker.c_str());
+  rmdir(dir.c_str());
+
+  printf("FileWriter, burst of %d x %zu MB: %.1f ms, %zu seconds, "
+         "%u stalls: %s\n",
+         kCaptures, kCaptureSize >> 20, ms, seconds.size(), stats.stalls,
+         ok ? "ok" : "FAILED");
+  return ok;
+}
+
+void BenchConvert() {
+  const int32_t kSizes[][2] = {{1920, 1080}, {3840, 2160}};
+  const int kRuns = 10;
+  YuvConverter conv;
+  for (auto& size : kSizes) {
+    int32_t width = size[0], height = size[1];
+    std::vector<uint32_t> out(width * height);
+    for (int32_t layout = 0; layout < 2; layout++) {
+      TestPicture pic(width, height, static_cast<ChromaLayout>(layout), 0);
+      double start = NowMs();
+      for (int i = 0; i < kRuns; i++) {
+        conv.Convert(pic.planes, 0, 0, width, height, out.data(), width);
+      }
+      double vectorMs = (NowMs() - start) / kRuns;
+
+      // the loop of the old PresentImage()
+      start = NowMs();
+      for (int i = 0; i < kRuns; i++) {
+        for (int32_t r = 0; r < height; r++) {
+          const uint8_t* y = pic.planes.y + pic.planes.yStride * r;
+          uint32_t* dst = out.data() + width * r;
+          for (int32_t x = 0; x < width; x++) {
+            int32_t uv = pic.UvOffset(0, r, x);
+            dst[x] = ReferencePixel(y[x], pic.planes.u[uv], pic.planes.v[uv]);
+          }
+        }
+      }
+      double pixelMs = (NowMs() - start) / kRuns;
+      printf("%4dx%-4d %s: converter %6.2f ms, per pixel %6.2f ms (x%.1f)\n",
+             width, height, kLayoutNames[layout], vectorMs, pixelMs,
+             pixelMs / vectorMs);
+    }
+  }
+}
+
+void BenchRotate() {
+  const int32_t kSizes[][2] = {{1920, 1080}, {3840, 2160}};
+  const int kRuns = 5;
+  YuvConverter conv;
+  for (auto& size : kSizes) {
+    int32_t width = size[0], height = size[1];
+    TestPicture pic(width, height, ChromaLayout::NV21, 0);
+    std::vector<uint32_t> out(width * height);
+    for (int32_t rotation : {90, 270}) {
+      double start = NowMs();
+      for (int i = 0; i < kRuns; i++) {
+        conv.ConvertRotated(pic.planes, 0, 0, width, height, rotation,
+                            out.data(), height);
+      }
+      double blockedMs = (NowMs() - start) / kRuns;
+      start = NowMs();
+      for (int i = 0; i < kRuns; i++) {
+        RotatePixel(pic, 0, 0, width, height, rotation, out.data(), height);
+      }
+      double pixelMs = (NowMs() - start) / kRuns;
+      printf("%4dx%-4d %3d: 32x32 blocks %6.2f ms, per pixel %6.2f ms (x%.1f)\n",
+             width, height, rotation, blockedMs, pixelMs, pixelMs / blockedMs);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : nullptr;
+  if (mode && strcmp(mode, "check") && strcmp(mode, "convert") &&
+      strcmp(mode, "rotate")) {
+    fprintf(stderr, "usage: %s [check|convert|rotate]\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = true;
+  if (!mode || !strcmp(mode, "check")) {
+    ok = CheckConverter() && ok;
+    ok = CheckRotation() && ok;
+    ok = CheckFileWriterBurst() && ok;
+    printf("check: %s\n", ok ? "ok" : "FAILED");
+  }
+  if (!mode || !strcmp(mode, "convert")) {
+    BenchConvert();
+  }
+  if (!mode || !strcmp(mode, "rotate")) {
+    BenchRotate();
+  }
+  return ok ? 0 : 1;
+}
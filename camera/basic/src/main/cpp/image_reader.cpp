@@ -15,9 +15,8 @@
  */
 #include <string>
 #include <functional>
-#include <thread>
 #include <cstdlib>
-#include <dirent.h>
+#include <cstring>
 #include <ctime>
 #include "image_reader.h"
 #include "utils/native_debug.h"
@@ -25,8 +24,8 @@
 /*
  * For JPEG capture, captured files are saved under
  *     DirName
- * File names are incrementally appended an index number as
- *     capture0.jpg, capture1.jpg, capture2.jpg
+ * File names are the capture time, appended an index number for captures
+ * within the same second (see FileWriter)
  */
 static const char *kDirName = "/sdcard/DCIM/Camera/";
 static const char *kFileName = "capture";
@@ -55,14 +54,31 @@ void OnImageCallback(void *ctx, AImageReader *reader) {
  * Constructor
  */
 ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
-    : reader_(nullptr), presentRotation_(0) {
+    : reader_(nullptr),
+      presentRotation_(0),
+      scheduler_(nullptr),
+      writer_(nullptr),
+      framePool_(nullptr) {
   callback_ = nullptr;
   callbackCtx_ = nullptr;
+  pendingImages_ = 0;
+  droppedCaptures_ = 0;
+  if (format == AIMAGE_FORMAT_YUV_420_888) {
+    scheduler_ = new ConversionScheduler(&yuvConverter_);
+    framePool_ = new FramePool(MAX_BUF_COUNT);
+  }
 
   media_status_t status = AImageReader_new(res->width, res->height, format,
                                            MAX_BUF_COUNT, &reader_);
   ASSERT(reader_ && status == AMEDIA_OK, "Failed to create AImageReader");
 
+  if (format == AIMAGE_FORMAT_JPEG) {
+    // every request holds an image of reader_: the queued ones, the one being
+    // written and the one blocked in Enqueue() must stay within
+    // MAX_BUF_COUNT, or acquiring the next capture fails
+    writer_ = new FileWriter(kDirName, kFileName, ".jpg", MAX_BUF_COUNT - 2);
+  }
+
   AImageReader_ImageListener listener{
       .context = this, .onImageAvailable = OnImageCallback,
   };
@@ -71,7 +87,18 @@ ImageReader::ImageReader(ImageFormat *res, enum AIMAGE_FORMATS format)
 
 ImageReader::~ImageReader() {
   ASSERT(reader_, "NULL Pointer to %s", __FUNCTION__);
+  // finish pending files first: they hold images of reader_
+  delete writer_;
+  // and give back the pool frames consumers did not release
+  if (framePool_) {
+    uint32_t released = framePool_->ReleaseAll();
+    if (released) {
+      LOGW("%u frames still referenced when deleting ImageReader", released);
+    }
+  }
   AImageReader_delete(reader_);
+  delete scheduler_;
+  delete framePool_;
 }
 
 void ImageReader::RegisterCallback(void* ctx,
@@ -87,11 +114,32 @@ void ImageReader::ImageCallback(AImageReader *reader) {
   if (format == AIMAGE_FORMAT_JPEG) {
     AImage *image = nullptr;
     media_status_t status = AImageReader_acquireNextImage(reader, &image);
-    ASSERT(status == AMEDIA_OK && image, "Image is not available");
+    if (status != AMEDIA_OK || !image) {
+      // e.g. AMEDIA_IMGREADER_MAX_IMAGES_ACQUIRED: drop the capture
+      LOGW("Capture dropped, acquireNextImage() status = %d", status);
+      if (image) {
+        AImage_delete(image);
+      }
+      droppedCaptures_++;
+      return;
+    }
 
-    // Create a thread and write out the jpeg files
-    std::thread writeFileHandler(&ImageReader::WriteFile, this, image);
-    writeFileHandler.detach();
+    int32_t planeCount = 0;
+    status = AImage_getNumberOfPlanes(image, &planeCount);
+    ASSERT(status == AMEDIA_OK && planeCount == 1,
+           "Error: getNumberOfPlanes() planeCount = %d", planeCount);
+    uint8_t *data = nullptr;
+    int len = 0;
+    AImage_getPlaneData(image, 0, &data, &len);
+
+    // queued to the writer thread: blocks while the writer is behind, and
+    // the image is kept until its file is written
+    writer_->Enqueue(data, static_cast<size_t>(len),
+                     [image]() { AImage_delete(image); },
+                     [this](const char *fileName) { OnFileWritten(fileName); });
+  } else {
+    // counted so GetLatestImage() knows how many frames it skips
+    pendingImages_++;
   }
 }
 
@@ -115,13 +163,16 @@ AImage *ImageReader::GetNextImage(void) {
   if (status != AMEDIA_OK) {
     return nullptr;
   }
+  if (pendingImages_ > 0) pendingImages_--;
   return image;
 }
 
 /**
  * GetLatestImage()
  *   Retrieve the last image in ImageReader's bufferQueue, deleting images in
- * in front of it on the queue. Recommended for real-time processing.
+ * in front of it on the queue. Recommended for real-time processing: a slow
+ * consumer drops stale frames instead of falling behind; the skipped frames
+ * are counted in the preview stats.
  */
 AImage *ImageReader::GetLatestImage(void) {
     AImage *image;
@@ -129,6 +180,10 @@ AImage *ImageReader::GetLatestImage(void) {
     if (status != AMEDIA_OK) {
         return nullptr;
     }
+    uint32_t pending = pendingImages_.exchange(0);
+    if (pending > 1 && scheduler_) {
+        scheduler_->AddDroppedFrames(pending - 1);
+    }
     return image;
 }
 
@@ -140,12 +195,6 @@ void ImageReader::DeleteImage(AImage *image) {
   if (image) AImage_delete(image);
 }
 
-/**
- * Helper function for YUV_420 to RGB conversion. Courtesy of Tensorflow
- * ImageClassifier Sample:
- * https://github.com/tensorflow/tensorflow/blob/master/tensorflow/examples/android/jni/yuv2rgb.cc
- * The difference is that here we have to swap UV plane when calling it.
- */
 #ifndef MAX
 #define MAX(a, b)           \
   ({                        \
@@ -161,38 +210,74 @@ void ImageReader::DeleteImage(AImage *image) {
   })
 #endif
 
-// This value is 2 ^ 18 - 1, and is used to clamp the RGB values before their
-// ranges
-// are normalized to eight bits.
-static const int kMaxChannelValue = 262143;
-
-static inline uint32_t YUV2RGB(int nY, int nU, int nV) {
-  nY -= 16;
-  nU -= 128;
-  nV -= 128;
-  if (nY < 0) nY = 0;
-
-  // This is the floating point equivalent. We do the conversion in integer
-  // because some Android devices do not have floating point in hardware.
-  // nR = (int)(1.164 * nY + 1.596 * nV);
-  // nG = (int)(1.164 * nY - 0.813 * nV - 0.391 * nU);
-  // nB = (int)(1.164 * nY + 2.018 * nU);
-
-  int nR = (int)(1192 * nY + 1634 * nV);
-  int nG = (int)(1192 * nY - 833 * nV - 400 * nU);
-  int nB = (int)(1192 * nY + 2066 * nU);
+/**
+ * DescribeImage()
+ *   Fill frame descriptor with geometry and plane layout of image, pointing
+ *   at image's own buffers
+ */
+static void DescribeImage(AImage *image, FrameDesc *desc) {
+  memset(desc, 0, sizeof(*desc));
+  AImage_getWidth(image, &desc->width);
+  AImage_getHeight(image, &desc->height);
+  AImage_getFormat(image, &desc->format);
+  AImage_getTimestamp(image, &desc->timestamp);
+  AImageCropRect crop;
+  AImage_getCropRect(image, &crop);
+  desc->cropLeft = crop.left, desc->cropTop = crop.top;
+  desc->cropRight = crop.right, desc->cropBottom = crop.bottom;
+
+  AImage_getNumberOfPlanes(image, &desc->planeCount);
+  desc->planeCount = MIN(desc->planeCount, FrameDesc::kMaxPlanes);
+  for (int32_t i = 0; i < desc->planeCount; i++) {
+    PlaneDesc &plane = desc->planes[i];
+    AImage_getPlaneData(image, i, &plane.data, &plane.len);
+    AImage_getPlaneRowStride(image, i, &plane.rowStride);
+    AImage_getPlanePixelStride(image, i, &plane.pixelStride);
+  }
+}
 
-  nR = MIN(kMaxChannelValue, MAX(0, nR));
-  nG = MIN(kMaxChannelValue, MAX(0, nG));
-  nB = MIN(kMaxChannelValue, MAX(0, nB));
+/**
+ * GetYuvPlanes()
+ *   Collect plane pointers and strides of a YUV_420_888 frame: plane 1 is
+ *   Cb (U), plane 2 is Cr (V)
+ */
+static void GetYuvPlanes(const FrameDesc &desc, YuvPlanes *planes) {
+  planes->y = desc.planes[0].data;
+  planes->u = desc.planes[1].data;
+  planes->v = desc.planes[2].data;
+  planes->yStride = desc.planes[0].rowStride;
+  planes->uvStride = desc.planes[1].rowStride;
+  planes->uvPixelStride = desc.planes[1].pixelStride;
+}
 
-  nR = (nR >> 10) & 0xff;
-  nG = (nG >> 10) & 0xff;
-  nB = (nB >> 10) & 0xff;
+static void ReleaseImage(void *ctx) {
+  AImage_delete(reinterpret_cast<AImage *>(ctx));
+}
 
-  return 0xff000000 | (nR << 16) | (nG << 8) | nB;
+/**
+ * GetLatestFrame()
+ *   GetLatestImage() wrapped into a frame of the reader's pool: consumers
+ *   share it through its handle, the image is deleted when the last
+ *   reference is released.
+ * @return frame handle holding one reference, kInvalidFrame if there is no
+ *         new image or every pool frame is still referenced
+ */
+FrameHandle ImageReader::GetLatestFrame(void) {
+  if (!framePool_) return kInvalidFrame;
+  AImage *image = GetLatestImage();
+  if (!image) return kInvalidFrame;
+
+  FrameDesc desc;
+  DescribeImage(image, &desc);
+  FrameHandle frame = framePool_->Publish(desc, ReleaseImage, image);
+  if (frame == kInvalidFrame) {
+    AImage_delete(image);
+  }
+  return frame;
 }
 
+FramePool *ImageReader::GetFramePool(void) { return framePool_; }
+
 /**
  * Convert yuv image inside AImage into ANativeWindow_Buffer
  * ANativeWindow_Buffer format is guaranteed to be
@@ -208,250 +293,112 @@ bool ImageReader::DisplayImage(ANativeWindow_Buffer *buf, AImage *image) {
              buf->format == WINDOW_FORMAT_RGBA_8888,
          "Not supported buffer format");
 
-  int32_t srcFormat = -1;
-  AImage_getFormat(image, &srcFormat);
-  ASSERT(AIMAGE_FORMAT_YUV_420_888 == srcFormat, "Failed to get format");
-  int32_t srcPlanes = 0;
-  AImage_getNumberOfPlanes(image, &srcPlanes);
-  ASSERT(srcPlanes == 3, "Is not 3 planes");
-
-  switch (presentRotation_) {
-    case 0:
-      PresentImage(buf, image);
-      break;
-    case 90:
-      PresentImage90(buf, image);
-      break;
-    case 180:
-      PresentImage180(buf, image);
-      break;
-    case 270:
-      PresentImage270(buf, image);
-      break;
-    default:
-      ASSERT(0, "NOT recognized display rotation: %d", presentRotation_);
-  }
+  FrameDesc desc;
+  DescribeImage(image, &desc);
+  PresentImage(buf, desc);
 
   AImage_delete(image);
 
   return true;
 }
 
-/*
- * PresentImage()
- *   Converting yuv to RGB
- *   No rotation: (x,y) --> (x, y)
- *   Refer to:
- * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
+/**
+ * Convert a frame of the pool into ANativeWindow_Buffer, same as
+ * DisplayImage(); the caller keeps its reference to the frame
  */
-void ImageReader::PresentImage(ANativeWindow_Buffer *buf, AImage *image) {  
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += buf->stride;
+bool ImageReader::DisplayFrame(ANativeWindow_Buffer *buf, FrameHandle frame) {
+  ASSERT(buf->format == WINDOW_FORMAT_RGBX_8888 ||
+             buf->format == WINDOW_FORMAT_RGBA_8888,
+         "Not supported buffer format");
+  const FrameDesc *desc = framePool_ ? framePool_->GetFrame(frame) : nullptr;
+  if (!desc) {
+    return false;
   }
+  PresentImage(buf, *desc);
+  return true;
 }
 
 /*
- * PresentImage90()
- *   Converting YUV to RGB
- *   Rotation image anti-clockwise 90 degree -- (x, y) --> (-y, x)
+ * PresentImage()
+ *   Converting yuv to RGB, rotated by presentRotation_:
+ *     0:   (x, y) --> (x, y)
+ *     90:  anti-clockwise -- (x, y) --> (-y, x)
+ *     180: (x, y) --> (-x, -y)
+ *     270: counter-clockwise 270 degree -- (x, y) --> (y, x)
+ *   Refer to:
+ * https://mathbits.com/MathBits/TISection/Geometry/Transformations2.htm
+ *   Conversion is split into bands across scheduler_ threads.
  */
-void ImageReader::PresentImage90(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += height - 1;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // [x, y]--> [-y, x]
-      out[x * buf->stride] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= 1;  // move to the next column
-  }
+void ImageReader::PresentImage(ANativeWindow_Buffer *buf,
+                               const FrameDesc &frame) {
+  ASSERT(AIMAGE_FORMAT_YUV_420_888 == frame.format, "Failed to get format");
+  ASSERT(frame.planeCount == 3, "Is not 3 planes");
+  ASSERT(presentRotation_ == 0 || presentRotation_ == 90 ||
+             presentRotation_ == 180 || presentRotation_ == 270,
+         "NOT recognized display rotation: %d", presentRotation_);
+  YuvPlanes planes;
+  GetYuvPlanes(frame, &planes);
+
+  bool transposed = (presentRotation_ == 90 || presentRotation_ == 270);
+  int32_t height = MIN(transposed ? buf->width : buf->height,
+                       (frame.cropBottom - frame.cropTop));
+  int32_t width = MIN(transposed ? buf->height : buf->width,
+                      (frame.cropRight - frame.cropLeft));
+
+  scheduler_->Convert(planes, frame.cropLeft, frame.cropTop, width, height,
+                      presentRotation_, static_cast<uint32_t *>(buf->bits),
+                      buf->stride);
 }
 
 /*
- * PresentImage180()
- *   Converting yuv to RGB
- *   Rotate image 180 degree: (x, y) --> (-x, -y)
+ * GetPreviewStats()
+ *   Conversion latency and dropped frames of the preview
  */
-void ImageReader::PresentImage180(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->height, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->width, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  out += (height - 1) * buf->stride;
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      // mirror image since we are using front camera
-      out[width - 1 - x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-      // out[x] = YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out -= buf->stride;
+void ImageReader::GetPreviewStats(ConversionStats *stats) {
+  if (!scheduler_) {
+    memset(stats, 0, sizeof(*stats));
+    return;
   }
+  scheduler_->GetStats(stats);
 }
 
-/*
- * PresentImage270()
- *   Converting image from YUV to RGB
- *   Rotate Image counter-clockwise 270 degree: (x, y) --> (y, x)
- */
-void ImageReader::PresentImage270(ANativeWindow_Buffer *buf, AImage *image) {
-  AImageCropRect srcRect;
-  AImage_getCropRect(image, &srcRect);
-
-  int32_t yStride, uvStride;
-  uint8_t *yPixel, *uPixel, *vPixel;
-  int32_t yLen, uLen, vLen;
-  AImage_getPlaneRowStride(image, 0, &yStride);
-  AImage_getPlaneRowStride(image, 1, &uvStride);
-  AImage_getPlaneData(image, 0, &yPixel, &yLen);
-  AImage_getPlaneData(image, 1, &vPixel, &vLen);
-  AImage_getPlaneData(image, 2, &uPixel, &uLen);
-  int32_t uvPixelStride;
-  AImage_getPlanePixelStride(image, 1, &uvPixelStride);
-
-  int32_t height = MIN(buf->width, (srcRect.bottom - srcRect.top));
-  int32_t width = MIN(buf->height, (srcRect.right - srcRect.left));
-
-  uint32_t *out = static_cast<uint32_t *>(buf->bits);
-  for (int32_t y = 0; y < height; y++) {
-    const uint8_t *pY = yPixel + yStride * (y + srcRect.top) + srcRect.left;
-
-    int32_t uv_row_start = uvStride * ((y + srcRect.top) >> 1);
-    const uint8_t *pU = uPixel + uv_row_start + (srcRect.left >> 1);
-    const uint8_t *pV = vPixel + uv_row_start + (srcRect.left >> 1);
-
-    for (int32_t x = 0; x < width; x++) {
-      const int32_t uv_offset = (x >> 1) * uvPixelStride;
-      out[(width - 1 - x) * buf->stride] =
-          YUV2RGB(pY[x], pU[uv_offset], pV[uv_offset]);
-    }
-    out += 1;  // move to the next column
-  }
-}
 void ImageReader::SetPresentRotation(int32_t angle) {
   presentRotation_ = angle;
 }
 
 /**
- * Write out jpeg files to kDirName directory
- * @param image point capture jpg image
+ * Called on the writer thread once a jpeg file is written out
+ * @param fileName written file, nullptr if writing failed
  */
-void ImageReader::WriteFile(AImage* image) {
-
-  int planeCount;
-  media_status_t status = AImage_getNumberOfPlanes(image, &planeCount);
-  ASSERT(status == AMEDIA_OK && planeCount == 1,
-         "Error: getNumberOfPlanes() planeCount = %d", planeCount);
-  uint8_t *data = nullptr;
-  int len = 0;
-  AImage_getPlaneData(image, 0, &data, &len);
-
-  DIR *dir = opendir(kDirName);
-  if (dir) {
-    closedir(dir);
-  } else {
-    std::string cmd = "mkdir -p ";
-    cmd += kDirName;
-    system(cmd.c_str());
+void ImageReader::OnFileWritten(const char *fileName) {
+  if (!fileName) {
+    LOGW("Failed to write out captured image");
+    return;
   }
+  FileWriterStats stats;
+  writer_->GetStats(&stats);
+  LOGI("Saved %s: %llu files, queue depth max %u, %u stalls, %.1f MB/s",
+       fileName, static_cast<unsigned long long>(stats.files),
+       stats.maxQueueDepth, stats.stalls,
+       stats.writeTime ? static_cast<double>(stats.bytes) / stats.writeTime
+                       : 0.0);
+
+  if (callback_) {
+    callback_(callbackCtx_, fileName);
+  }
+}
 
-  struct timespec ts {
-      0, 0
-  };
-  clock_gettime(CLOCK_REALTIME, &ts);
-  struct tm localTime;
-  localtime_r(&ts.tv_sec, &localTime);
-
-  std::string fileName = kDirName;
-  std::string dash("-");
-  fileName += kFileName + std::to_string(localTime.tm_mon) +
-              std::to_string(localTime.tm_mday) + dash +
-              std::to_string(localTime.tm_hour) +
-              std::to_string(localTime.tm_min) +
-              std::to_string(localTime.tm_sec) + ".jpg";
-  FILE *file = fopen(fileName.c_str(), "wb");
-  if (file && data && len) {
-    fwrite(data, 1, len, file);
-    fclose(file);
-
-    if (callback_) {
-      callback_(callbackCtx_, fileName.c_str());
-    }
-  } else {
-    if (file)
-      fclose(file);
+/**
+ * JPEG file writer queue depth and throughput
+ */
+void ImageReader::GetWriterStats(FileWriterStats *stats) {
+  if (!writer_) {
+    memset(stats, 0, sizeof(*stats));
+    return;
   }
-  AImage_delete(image);
-}
\ No newline at end of file
+  writer_->GetStats(stats);
+}
+
+uint32_t ImageReader::GetDroppedCaptures(void) {
+  return droppedCaptures_;
+}
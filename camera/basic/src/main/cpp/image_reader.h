@@ -17,7 +17,12 @@
 #ifndef CAMERA_IMAGE_READER_H
 #define CAMERA_IMAGE_READER_H
 #include <media/NdkImageReader.h>
+#include <atomic>
 #include <functional>
+#include "utils/conversion_scheduler.h"
+#include "utils/file_writer.h"
+#include "utils/frame_pool.h"
+#include "utils/yuv_converter.h"
 /*
  * ImageFormat:
  *     A Data Structure to communicate resolution between camera and ImageReader
@@ -55,6 +60,14 @@ class ImageReader {
   */
   AImage* GetLatestImage(void);
 
+  /**
+   * Retrieve the latest image as a frame of GetFramePool(), dropping older
+   * images. Release the returned handle to the pool when done; other
+   * consumers may Acquire() it meanwhile, nothing is copied.
+   */
+  FrameHandle GetLatestFrame(void);
+  FramePool* GetFramePool(void);
+
   /**
    * Delete Image
    * @param image {@link AImage} instance to be deleted
@@ -81,6 +94,12 @@ class ImageReader {
    *   @return true on success, false on failure
    */
   bool DisplayImage(ANativeWindow_Buffer* buf, AImage* image);
+  /**
+   * DisplayFrame()
+   *   Same as DisplayImage() for a frame from GetLatestFrame(); the frame
+   *   reference stays with the caller.
+   */
+  bool DisplayFrame(ANativeWindow_Buffer* buf, FrameHandle frame);
   /**
    * Configure the rotation angle necessary to apply to
    * Camera image when presenting: all rotations should be accumulated:
@@ -96,6 +115,21 @@ class ImageReader {
    * @param callback is the actual callback function
    */
   void RegisterCallback(void* ctx, std::function<void(void* ctx, const char* fileName)>);
+
+  /**
+   * Preview conversion latency and frames dropped by GetLatestImage()
+   */
+  void GetPreviewStats(ConversionStats* stats);
+
+  /**
+   * JPEG writer queue depth and throughput
+   */
+  void GetWriterStats(FileWriterStats* stats);
+
+  /**
+   * JPEG captures that could not be acquired from the reader
+   */
+  uint32_t GetDroppedCaptures(void);
  private:
   int32_t presentRotation_;
   AImageReader* reader_;
@@ -103,12 +137,16 @@ class ImageReader {
   std::function<void(void *ctx, const char* fileName)> callback_;
   void *callbackCtx_;
 
-  void PresentImage(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage90(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage180(ANativeWindow_Buffer* buf, AImage* image);
-  void PresentImage270(ANativeWindow_Buffer* buf, AImage* image);
+  YuvConverter yuvConverter_;
+  ConversionScheduler* scheduler_;  // YUV readers only
+  std::atomic<uint32_t> pendingImages_;
+  FileWriter* writer_;  // JPEG readers only
+  std::atomic<uint32_t> droppedCaptures_;
+  FramePool* framePool_;  // YUV readers only
+
+  void PresentImage(ANativeWindow_Buffer* buf, const FrameDesc& frame);
 
-  void WriteFile(AImage* image);
+  void OnFileWritten(const char* fileName);
 };
 
 #endif  // CAMERA_IMAGE_READER_H
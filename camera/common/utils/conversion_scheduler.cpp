@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "conversion_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Band heights are kept a multiple of the rotation block (and even, so
+// bands never split a chroma row)
+static const int32_t kBandAlign = 32;
+
+const int32_t ConversionScheduler::kMaxThreads;
+
+ConversionScheduler::ConversionScheduler(const YuvConverter* converter,
+                                         int32_t threadCount)
+    : converter_(converter),
+      jobId_(0),
+      nextBand_(0),
+      bandCount_(0),
+      doneBands_(0),
+      exit_(false) {
+  memset(&job_, 0, sizeof(job_));
+  memset(&stats_, 0, sizeof(stats_));
+  if (threadCount <= 0) {
+    threadCount = static_cast<int32_t>(std::thread::hardware_concurrency());
+  }
+  threadCount = std::max(1, std::min(threadCount, kMaxThreads));
+  for (int32_t i = 1; i < threadCount; i++) {
+    workers_.push_back(std::thread(&ConversionScheduler::WorkerLoop, this));
+  }
+}
+
+ConversionScheduler::~ConversionScheduler() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    exit_ = true;
+  }
+  jobCond_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+bool ConversionScheduler::Convert(const YuvPlanes& src, int32_t left,
+                                  int32_t top, int32_t width, int32_t height,
+                                  int32_t rotation, uint32_t* out,
+                                  int32_t outStride) {
+  if (rotation != 0 && rotation != 90 && rotation != 180 && rotation != 270) {
+    return false;
+  }
+  if (width <= 0 || height <= 0) {
+    return true;
+  }
+  auto start = std::chrono::steady_clock::now();
+
+  int32_t threads = static_cast<int32_t>(workers_.size()) + 1;
+  int32_t bandRows = (height + threads - 1) / threads;
+  bandRows = (bandRows + kBandAlign - 1) / kBandAlign * kBandAlign;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    job_.src = src;
+    job_.left = left, job_.top = top;
+    job_.width = width, job_.height = height;
+    job_.rotation = rotation;
+    job_.out = out, job_.outStride = outStride;
+    job_.bandRows = bandRows;
+    nextBand_ = 0;
+    doneBands_ = 0;
+    bandCount_ = (height + bandRows - 1) / bandRows;
+    jobId_++;
+  }
+  if (bandCount_ > 1) {
+    jobCond_.notify_all();
+  }
+
+  RunBands();
+  {
+    std::unique_lock<std::mutex> guard(lock_);
+    doneCond_.wait(guard, [this] { return doneBands_ == bandCount_; });
+
+    uint64_t latency = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+    stats_.frames++;
+    stats_.lastLatency = latency;
+    stats_.maxLatency = std::max(stats_.maxLatency, latency);
+    stats_.totalLatency += latency;
+  }
+  return true;
+}
+
+void ConversionScheduler::AddDroppedFrames(uint32_t count) {
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.droppedFrames += count;
+}
+
+void ConversionScheduler::GetStats(ConversionStats* stats) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *stats = stats_;
+}
+
+void ConversionScheduler::WorkerLoop(void) {
+  uint64_t lastJob = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      jobCond_.wait(guard, [this, lastJob] {
+        return exit_ || (jobId_ != lastJob && nextBand_ < bandCount_);
+      });
+      if (exit_) {
+        return;
+      }
+      lastJob = jobId_;
+    }
+    RunBands();
+  }
+}
+
+/*
+ * RunBands(): take bands of the current job until none is left
+ */
+void ConversionScheduler::RunBands(void) {
+  while (true) {
+    int32_t band;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      if (nextBand_ >= bandCount_) {
+        return;
+      }
+      band = nextBand_++;
+    }
+    ConvertBand(band);
+
+    std::lock_guard<std::mutex> guard(lock_);
+    if (++doneBands_ == bandCount_) {
+      doneCond_.notify_all();
+    }
+  }
+}
+
+/*
+ * ConvertBand(): convert source rows [y0, y0 + rows) of the job, to where
+ *                the rotation puts them
+ */
+void ConversionScheduler::ConvertBand(int32_t band) {
+  const Job& job = job_;
+  int32_t y0 = band * job.bandRows;
+  int32_t rows = std::min(job.bandRows, job.height - y0);
+  uint32_t* out = job.out;
+  switch (job.rotation) {
+    case 0:
+      converter_->Convert(job.src, job.left, job.top + y0, job.width, rows,
+                          out + y0 * job.outStride, job.outStride);
+      return;
+    case 90:
+      out += job.height - y0 - rows;
+      break;
+    case 180:
+      out += (job.height - y0 - rows) * job.outStride;
+      break;
+    case 270:
+      out += y0;
+      break;
+  }
+  converter_->ConvertRotated(job.src, job.left, job.top + y0, job.width, rows,
+                             job.rotation, out, job.outStride);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CAMERA_CONVERSION_SCHEDULER_H__
+#define __CAMERA_CONVERSION_SCHEDULER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "yuv_converter.h"
+
+/*
+ * Preview conversion statistics, latency in micro-seconds
+ *   droppedFrames: stale frames skipped by the consumer, reported through
+ *                  AddDroppedFrames()
+ */
+struct ConversionStats {
+  uint64_t frames;
+  uint64_t droppedFrames;
+  uint64_t lastLatency;
+  uint64_t maxLatency;
+  uint64_t totalLatency;
+};
+
+/*
+ * ConversionScheduler:
+ *   Converts (and rotates) one frame at a time with a YuvConverter, split
+ *   into horizontal bands of source rows. Bands are taken by a small pool
+ *   of persistent worker threads and by the calling thread itself;
+ *   Convert() returns when the whole frame is written.
+ *   It works on plain YuvPlanes, so it runs the same on synthetic planes as
+ *   on AImage planes.
+ */
+class ConversionScheduler {
+ public:
+  static const int32_t kMaxThreads = 4;
+
+  // threadCount includes the calling thread; 0 picks one per core, up to
+  // kMaxThreads
+  explicit ConversionScheduler(const YuvConverter* converter,
+                               int32_t threadCount = 0);
+  ~ConversionScheduler();
+
+  /*
+   * Convert width x height pixels at (left, top) of src into out with
+   * rotation 0, 90, 180 or 270 (see YuvConverter::ConvertRotated()).
+   * Returns false for other rotations.
+   */
+  bool Convert(const YuvPlanes& src, int32_t left, int32_t top, int32_t width,
+               int32_t height, int32_t rotation, uint32_t* out,
+               int32_t outStride);
+
+  void AddDroppedFrames(uint32_t count);
+  void GetStats(ConversionStats* stats);
+
+ private:
+  struct Job {
+    YuvPlanes src;
+    int32_t left, top, width, height, rotation;
+    uint32_t* out;
+    int32_t outStride;
+    int32_t bandRows;
+  };
+
+  void WorkerLoop(void);
+  void RunBands(void);
+  void ConvertBand(int32_t band);
+
+  const YuvConverter* converter_;
+  std::vector<std::thread> workers_;
+  std::mutex lock_;
+  std::condition_variable jobCond_;
+  std::condition_variable doneCond_;
+  Job job_;
+  uint64_t jobId_;
+  int32_t nextBand_, bandCount_, doneBands_;
+  bool exit_;
+  ConversionStats stats_;
+};
+
+#endif  // __CAMERA_CONVERSION_SCHEDULER_H__
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "file_writer.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "native_debug.h"
+
+const size_t FileWriter::kWriteChunk;
+
+/*
+ * MakeDirs(): mkdir -p
+ */
+static bool MakeDirs(const std::string& path) {
+  for (size_t pos = 1; pos <= path.size(); pos++) {
+    if (pos != path.size() && path[pos] != '/') continue;
+    std::string dir = path.substr(0, pos);
+    if (mkdir(dir.c_str(), 0775) && errno != EEXIST) {
+      LOGE("Unable to create %s: %s", dir.c_str(), strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint64_t ElapsedUs(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+FileWriter::FileWriter(const char* dirName, const char* prefix,
+                       const char* suffix, uint32_t queueDepth,
+                       uint32_t syncInterval)
+    : dirName_(dirName),
+      prefix_(prefix),
+      suffix_(suffix),
+      queueDepth_(std::max(queueDepth, 1U)),
+      syncInterval_(syncInterval),
+      exit_(false),
+      writing_(false),
+      lastSecond_(0),
+      sameSecondCount_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+  if (!dirName_.empty() && dirName_.back() != '/') {
+    dirName_ += '/';
+  }
+  // created once here, files are written straight into it afterwards
+  dirReady_ = MakeDirs(dirName_);
+  writer_ = std::thread(&FileWriter::WriterLoop, this);
+}
+
+FileWriter::~FileWriter() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    exit_ = true;
+  }
+  notEmpty_.notify_all();
+  writer_.join();
+}
+
+void FileWriter::Enqueue(const uint8_t* data, size_t len,
+                         ReleaseCallback release, DoneCallback done) {
+  std::unique_lock<std::mutex> guard(lock_);
+  if (queue_.size() >= queueDepth_) {
+    stats_.stalls++;
+    notFull_.wait(guard, [this] { return queue_.size() < queueDepth_; });
+  }
+  queue_.push_back({data, len, release, done});
+  stats_.queueDepth = static_cast<uint32_t>(queue_.size()) + (writing_ ? 1 : 0);
+  stats_.maxQueueDepth = std::max(stats_.maxQueueDepth, stats_.queueDepth);
+  notEmpty_.notify_one();
+}
+
+void FileWriter::GetStats(FileWriterStats* stats) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *stats = stats_;
+}
+
+void FileWriter::WriterLoop(void) {
+  while (true) {
+    Request req;
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      notEmpty_.wait(guard, [this] { return exit_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        break;  // exit_ is set and everything is written
+      }
+      req = queue_.front();
+      queue_.pop_front();
+      writing_ = true;
+    }
+    notFull_.notify_one();
+
+    std::string fileName;
+    auto start = std::chrono::steady_clock::now();
+    bool written = WriteRequest(req, &fileName);
+    uint64_t writeTime = ElapsedUs(start);
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      writing_ = false;
+      stats_.queueDepth = static_cast<uint32_t>(queue_.size());
+      stats_.writeTime += writeTime;
+      if (written) {
+        stats_.files++;
+        stats_.bytes += req.len;
+      } else {
+        stats_.failures++;
+      }
+    }
+    if (req.release) {
+      req.release();
+    }
+    if (req.done) {
+      req.done(written ? fileName.c_str() : nullptr);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  SyncPending();
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.writeTime += ElapsedUs(start);
+}
+
+bool FileWriter::WriteRequest(const Request& req, std::string* fileName) {
+  if (!dirReady_ || !req.data || !req.len) {
+    return false;
+  }
+  *fileName = NextFileName();
+  int fd = open(fileName->c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0664);
+  if (fd < 0) {
+    LOGE("Unable to open %s: %s", fileName->c_str(), strerror(errno));
+    return false;
+  }
+
+  size_t offset = 0;
+  while (offset < req.len) {
+    size_t size = std::min(kWriteChunk, req.len - offset);
+    ssize_t count = write(fd, req.data + offset, size);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      LOGE("Failed to write %s: %s", fileName->c_str(), strerror(errno));
+      close(fd);
+      unlink(fileName->c_str());
+      return false;
+    }
+    offset += static_cast<size_t>(count);
+  }
+
+  if (!syncInterval_) {
+    close(fd);
+    return true;
+  }
+  unsynced_.push_back(fd);
+  if (unsynced_.size() >= syncInterval_) {
+    SyncPending();
+  }
+  return true;
+}
+
+/*
+ * SyncPending(): flush files written since the last batch to storage
+ */
+void FileWriter::SyncPending(void) {
+  for (int fd : unsynced_) {
+    fsync(fd);
+    close(fd);
+  }
+  unsynced_.clear();
+}
+
+std::string FileWriter::NextFileName(void) {
+  struct timespec ts {
+      0, 0
+  };
+  clock_gettime(CLOCK_REALTIME, &ts);
+  struct tm localTime;
+  localtime_r(&ts.tv_sec, &localTime);
+
+  // same second bursts get a sequence number instead of overwriting
+  if (ts.tv_sec == lastSecond_) {
+    sameSecondCount_++;
+  } else {
+    lastSecond_ = ts.tv_sec;
+    sameSecondCount_ = 0;
+  }
+
+  char name[64];
+  int len = snprintf(name, sizeof(name), "%d%d-%d%d%d", localTime.tm_mon,
+                     localTime.tm_mday, localTime.tm_hour, localTime.tm_min,
+                     localTime.tm_sec);
+  if (sameSecondCount_) {
+    snprintf(name + len, sizeof(name) - len, "-%u", sameSecondCount_);
+  }
+  return dirName_ + prefix_ + name + suffix_;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CAMERA_FILE_WRITER_H__
+#define __CAMERA_FILE_WRITER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Writer statistics, time in micro-seconds
+ *   queueDepth: requests waiting or being written
+ *   stalls:     Enqueue() calls that blocked on a full queue
+ */
+struct FileWriterStats {
+  uint32_t queueDepth, maxQueueDepth;
+  uint32_t stalls;
+  uint64_t files, failures;
+  uint64_t bytes;
+  uint64_t writeTime;  // spent inside write()/fsync()
+};
+
+/*
+ * FileWriter:
+ *   One persistent thread writes buffers out as files in dirName, in
+ *   request order. The request queue holds at most queueDepth entries:
+ *   Enqueue() blocks while it is full, so a burst slows down the producer
+ *   instead of piling up threads or memory. Up to queueDepth + 2 buffers are
+ *   held at once (queued, being written, blocked in Enqueue()): size
+ *   queueDepth to the producer's buffer count.
+ *   Files are named <prefix><month><day>-<hour><min><sec>[-<n>]<suffix>,
+ *   n counting files started in the same second.
+ *   Data is written straight from the caller's buffer with write() in
+ *   kWriteChunk pieces (no stdio copy); with syncInterval > 0, written
+ *   files are fsync()ed in batches of that many files.
+ */
+class FileWriter {
+ public:
+  static const uint32_t kDefaultQueueDepth = 4;
+  static const size_t kWriteChunk = 1024 * 1024;
+
+  // called with the file name when the file is written, nullptr on failure
+  typedef std::function<void(const char* fileName)> DoneCallback;
+  // called when the writer no longer needs the data
+  typedef std::function<void(void)> ReleaseCallback;
+
+  explicit FileWriter(const char* dirName, const char* prefix,
+                      const char* suffix,
+                      uint32_t queueDepth = kDefaultQueueDepth,
+                      uint32_t syncInterval = 0);
+  // finishes all queued requests
+  ~FileWriter();
+
+  void Enqueue(const uint8_t* data, size_t len, ReleaseCallback release,
+               DoneCallback done);
+  void GetStats(FileWriterStats* stats);
+
+ private:
+  struct Request {
+    const uint8_t* data;
+    size_t len;
+    ReleaseCallback release;
+    DoneCallback done;
+  };
+
+  void WriterLoop(void);
+  bool WriteRequest(const Request& req, std::string* fileName);
+  std::string NextFileName(void);
+  void SyncPending(void);
+
+  std::string dirName_, prefix_, suffix_;
+  uint32_t queueDepth_, syncInterval_;
+  bool dirReady_;
+
+  std::deque<Request> queue_;
+  std::mutex lock_;
+  std::condition_variable notEmpty_, notFull_;
+  bool exit_;
+  bool writing_;
+  std::thread writer_;
+
+  // writer thread only
+  time_t lastSecond_;
+  uint32_t sameSecondCount_;
+  std::deque<int> unsynced_;
+
+  FileWriterStats stats_;
+};
+
+#endif  // __CAMERA_FILE_WRITER_H__
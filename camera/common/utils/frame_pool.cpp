@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frame_pool.h"
+#include <cstring>
+#include "native_debug.h"
+
+static inline uint64_t SlotState(uint32_t generation, uint32_t refCount) {
+  return (static_cast<uint64_t>(generation) << 32) | refCount;
+}
+static inline uint32_t StateGeneration(uint64_t state) {
+  return static_cast<uint32_t>(state >> 32);
+}
+static inline uint32_t StateRefCount(uint64_t state) {
+  return static_cast<uint32_t>(state);
+}
+
+FramePool::FramePool(uint32_t capacity) : slots_(capacity) {
+  ASSERT(capacity > 0 && capacity <= (1U << kSlotBits),
+         "Unsupported frame pool capacity %u", capacity);
+  memset(&stats_, 0, sizeof(stats_));
+  // hand out slot 0 first
+  for (uint32_t i = capacity; i > 0; i--) {
+    Slot& slot = slots_[i - 1];
+    memset(&slot.desc, 0, sizeof(slot.desc));
+    slot.release = nullptr;
+    slot.ctx = nullptr;
+    slot.state = SlotState(1, 0);
+    freeSlots_.push_back(i - 1);
+  }
+}
+
+FramePool::~FramePool() {
+  if (stats_.inUse) {
+    LOGW("FramePool destroyed with %u frames still referenced", stats_.inUse);
+  }
+}
+
+FrameHandle FramePool::Publish(const FrameDesc& desc, ReleaseFunc release,
+                               void* ctx) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (freeSlots_.empty()) {
+    stats_.exhausted++;
+    return kInvalidFrame;
+  }
+  uint32_t index = freeSlots_.back();
+  freeSlots_.pop_back();
+
+  Slot& slot = slots_[index];
+  slot.desc = desc;
+  slot.release = release;
+  slot.ctx = ctx;
+  uint32_t generation = StateGeneration(slot.state);
+  slot.state = SlotState(generation, 1);
+
+  stats_.published++;
+  stats_.inUse++;
+  if (stats_.inUse > stats_.maxInUse) stats_.maxInUse = stats_.inUse;
+  return (generation << kSlotBits) | index;
+}
+
+FramePool::Slot* FramePool::GetSlot(FrameHandle handle) const {
+  uint32_t index = handle & ((1U << kSlotBits) - 1);
+  if (handle == kInvalidFrame || index >= slots_.size()) {
+    return nullptr;
+  }
+  const Slot& slot = slots_[index];
+  uint64_t state = slot.state;
+  if (StateGeneration(state) != (handle >> kSlotBits) ||
+      StateRefCount(state) == 0) {
+    return nullptr;
+  }
+  return const_cast<Slot*>(&slot);
+}
+
+/*
+ * AddReference(): add delta (+1 or -1) to the reference count of the frame,
+ * only if the slot still holds the handle's generation with a count above
+ * 0: a frame whose last reference is dropped is never revived, and a stale
+ * handle never touches the frame published after it. Recycle the frame
+ * when the last reference is dropped. False if the handle is stale.
+ */
+bool FramePool::AddReference(FrameHandle handle, int32_t delta) {
+  uint32_t index = handle & ((1U << kSlotBits) - 1);
+  if (handle == kInvalidFrame || index >= slots_.size()) {
+    return false;
+  }
+  Slot& slot = slots_[index];
+  uint32_t generation = handle >> kSlotBits;
+  uint64_t state = slot.state.load();
+  uint32_t count;
+  do {
+    count = StateRefCount(state);
+    if (StateGeneration(state) != generation || count == 0) {
+      return false;
+    }
+  } while (!slot.state.compare_exchange_weak(
+      state, SlotState(generation, count + delta)));
+
+  if (count + delta == 0) {
+    Recycle(index, generation);
+  }
+  return true;
+}
+
+bool FramePool::Acquire(FrameHandle handle) {
+  if (AddReference(handle, 1)) {
+    return true;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  stats_.stale++;
+  return false;
+}
+
+void FramePool::Release(FrameHandle handle) {
+  if (!AddReference(handle, -1)) {
+    std::lock_guard<std::mutex> guard(lock_);
+    stats_.stale++;
+  }
+}
+
+uint32_t FramePool::ReleaseAll(void) {
+  uint32_t released = 0;
+  for (uint32_t index = 0; index < slots_.size(); index++) {
+    Slot& slot = slots_[index];
+    uint64_t state = slot.state.load();
+    while (StateRefCount(state) > 0 &&
+           !slot.state.compare_exchange_weak(
+               state, SlotState(StateGeneration(state), 0))) {
+    }
+    if (StateRefCount(state) > 0) {
+      Recycle(index, StateGeneration(state));
+      released++;
+    }
+  }
+  return released;
+}
+
+const FrameDesc* FramePool::GetFrame(FrameHandle handle) const {
+  Slot* slot = GetSlot(handle);
+  return slot ? &slot->desc : nullptr;
+}
+
+/*
+ * Recycle(): last reference is gone, give the frame back to its producer.
+ * The count is already 0, so the slot can't be acquired until published again
+ */
+void FramePool::Recycle(uint32_t index, uint32_t generation) {
+  Slot& slot = slots_[index];
+  if (slot.release) {
+    slot.release(slot.ctx);
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  slot.release = nullptr;
+  slot.ctx = nullptr;
+  // never produce generation 0, so no handle equals kInvalidFrame
+  generation++;
+  slot.state = SlotState(
+      (generation < (1U << (32 - kSlotBits))) ? generation : 1, 0);
+  freeSlots_.push_back(index);
+  stats_.recycled++;
+  stats_.inUse--;
+}
+
+void FramePool::GetStats(FramePoolStats* stats) {
+  std::lock_guard<std::mutex> guard(lock_);
+  *stats = stats_;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CAMERA_FRAME_POOL_H__
+#define __CAMERA_FRAME_POOL_H__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+ * Plane and frame descriptors: where the producer's pixels are, nothing is
+ * copied. For YUV_420_888, planes are Y, Cb (U), Cr (V).
+ */
+struct PlaneDesc {
+  uint8_t* data;
+  int32_t len;
+  int32_t rowStride;
+  int32_t pixelStride;
+};
+
+struct FrameDesc {
+  static const int32_t kMaxPlanes = 3;
+  int32_t width, height;
+  int32_t format;
+  int32_t cropLeft, cropTop, cropRight, cropBottom;
+  int64_t timestamp;
+  int32_t planeCount;
+  PlaneDesc planes[kMaxPlanes];
+};
+
+// Frame handle: slot index in the low bits, slot generation above
+typedef uint32_t FrameHandle;
+static const FrameHandle kInvalidFrame = 0;
+
+/*
+ * Pool statistics
+ *   exhausted: Publish() calls refused because every slot was in use
+ *   stale:     Acquire()/Release() with a handle of a recycled frame
+ */
+struct FramePoolStats {
+  uint64_t published, recycled;
+  uint32_t inUse, maxInUse;
+  uint32_t exhausted, stale;
+};
+
+/*
+ * FramePool:
+ *   Shares producer owned frames (e.g. AImage) between several consumers
+ *   (preview, analysis, encoder) without copying. Publish() wraps the
+ *   producer's planes in a pool slot holding one reference; consumers add
+ *   references with Acquire() and drop them with Release(). When the last
+ *   reference is dropped, the producer's release function gives the frame
+ *   back (AImage_delete() for camera frames) and the slot is reused.
+ *   Slots are allocated once; a handle names a slot and its generation so a
+ *   late Release() of a recycled frame is detected instead of corrupting
+ *   the new one. A slot's generation and reference count are one atomic
+ *   word, so a reference is only ever taken or dropped on the generation
+ *   the handle names.
+ */
+class FramePool {
+ public:
+  typedef void (*ReleaseFunc)(void* ctx);
+
+  explicit FramePool(uint32_t capacity);
+  ~FramePool();
+
+  // returns kInvalidFrame (release() is not called) if the pool is full
+  FrameHandle Publish(const FrameDesc& desc, ReleaseFunc release, void* ctx);
+
+  // add one more reference, false if handle is stale
+  bool Acquire(FrameHandle handle);
+  void Release(FrameHandle handle);
+
+  // valid while the caller holds a reference
+  const FrameDesc* GetFrame(FrameHandle handle) const;
+  // drop every outstanding reference, giving all frames back to their
+  // producer (e.g. before the producer is destroyed). Consumers must no
+  // longer use their frames; their late Release() calls are counted as
+  // stale. Returns the number of frames that were still referenced.
+  uint32_t ReleaseAll(void);
+
+  void GetStats(FramePoolStats* stats);
+
+ private:
+  static const uint32_t kSlotBits = 8;
+  struct Slot {
+    FrameDesc desc;
+    ReleaseFunc release;
+    void* ctx;
+    // generation in the high 32 bits, reference count in the low 32 bits
+    std::atomic<uint64_t> state;
+  };
+
+  Slot* GetSlot(FrameHandle handle) const;
+  bool AddReference(FrameHandle handle, int32_t delta);
+  void Recycle(uint32_t index, uint32_t generation);
+
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> freeSlots_;
+  std::mutex lock_;
+  FramePoolStats stats_;
+};
+
+#endif  // __CAMERA_FRAME_POOL_H__
@@ -1,3 +1,4 @@
+#ifdef __ANDROID__
 #include <android/log.h>
 
 #define LOG_TAG "CAMERA-SAMPLE"
@@ -8,3 +9,20 @@
   if (!(cond)) {                                              \
     __android_log_assert(#cond, LOG_TAG, fmt, ##__VA_ARGS__); \
   }
+#else
+// host build (basic/src/main/cpp/CMakeLists.txt): log to stderr
+#include <cstdio>
+#include <cstdlib>
+
+#define LOG_TAG "CAMERA-SAMPLE"
+#define LOG_STDERR(...) \
+  (fprintf(stderr, LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#define LOGI(...) LOG_STDERR(__VA_ARGS__)
+#define LOGW(...) LOG_STDERR(__VA_ARGS__)
+#define LOGE(...) LOG_STDERR(__VA_ARGS__)
+#define ASSERT(cond, fmt, ...)       \
+  if (!(cond)) {                     \
+    LOG_STDERR(fmt, ##__VA_ARGS__);  \
+    abort();                         \
+  }
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "yuv_converter.h"
+#include <algorithm>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define YUV_CONVERTER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define YUV_CONVERTER_SSE2
+#endif
+
+// Pixels converted by one iteration of the vector loop
+static const int32_t kVectorPixels = 16;
+
+// Block size of rotated conversion: 32 x 32 pixels, 4KB of scratch
+static const int32_t kRotateTile = 32;
+
+// 2 ^ 18 - 1: clamp of the Q10 results before they are normalized to 8 bits
+static const int32_t kMaxChannelValue = 262143;
+
+/*
+ * Q10 coefficients: Y scale, Cr->R, Cb->G, Cr->G, Cb->B
+ *   limited range: Y in [16, 235], scaled by 255/219
+ *   full range:    Y in [0, 255]
+ */
+static const int32_t kCoefficients[2][2][5] = {
+    // BT.601
+    {{1192, 1634, 400, 833, 2066},   // limited
+     {1024, 1436, 352, 731, 1815}},  // full
+    // BT.709
+    {{1192, 1836, 218, 546, 2163},   // limited
+     {1024, 1613, 192, 479, 1900}},  // full
+};
+
+YuvConverter::YuvConverter(YuvColorSpace colorSpace, YuvRange range) {
+  const int32_t* coef =
+      kCoefficients[colorSpace == YuvColorSpace::BT709 ? 1 : 0]
+                   [range == YuvRange::FULL ? 1 : 0];
+  yOffset_ = (range == YuvRange::FULL) ? 0 : 16;
+  yCoef_ = coef[0];
+  vToR_ = coef[1];
+  uToG_ = coef[2];
+  vToG_ = coef[3];
+  uToB_ = coef[4];
+}
+
+static inline int32_t Clamp(int32_t value) {
+  if (value < 0) return 0;
+  if (value > kMaxChannelValue) return kMaxChannelValue;
+  return value;
+}
+
+uint32_t YuvConverter::ConvertPixel(int32_t y, int32_t u, int32_t v) const {
+  y -= yOffset_;
+  u -= 128;
+  v -= 128;
+  if (y < 0) y = 0;
+
+  int32_t r = Clamp(yCoef_ * y + vToR_ * v) >> 10;
+  int32_t g = Clamp(yCoef_ * y - vToG_ * v - uToG_ * u) >> 10;
+  int32_t b = Clamp(yCoef_ * y + uToB_ * u) >> 10;
+
+  return 0xff000000 | (b << 16) | (g << 8) | r;
+}
+
+/*
+ * The vector code gets the same results as Clamp(x) >> 10 with an arithmetic
+ * shift followed by saturating narrowing: negative values saturate to 0 and
+ * values above kMaxChannelValue to 255.
+ */
+#if defined(YUV_CONVERTER_NEON)
+static inline void ConvertVector(const int32_t* coef, int16x8_t y,
+                                 int16x8_t u, int16x8_t v, uint8x8_t* r,
+                                 uint8x8_t* g, uint8x8_t* b) {
+  int16x4_t halfY[2] = {vget_low_s16(y), vget_high_s16(y)};
+  int16x4_t halfU[2] = {vget_low_s16(u), vget_high_s16(u)};
+  int16x4_t halfV[2] = {vget_low_s16(v), vget_high_s16(v)};
+  int16x4_t outR[2], outG[2], outB[2];
+  for (int i = 0; i < 2; i++) {
+    int32x4_t base = vmull_n_s16(halfY[i], coef[0]);
+    int32x4_t valR = vmlal_n_s16(base, halfV[i], coef[1]);
+    int32x4_t valG = vmlsl_n_s16(base, halfU[i], coef[2]);
+    valG = vmlsl_n_s16(valG, halfV[i], coef[3]);
+    int32x4_t valB = vmlal_n_s16(base, halfU[i], coef[4]);
+    outR[i] = vqmovn_s32(vshrq_n_s32(valR, 10));
+    outG[i] = vqmovn_s32(vshrq_n_s32(valG, 10));
+    outB[i] = vqmovn_s32(vshrq_n_s32(valB, 10));
+  }
+  *r = vqmovun_s16(vcombine_s16(outR[0], outR[1]));
+  *g = vqmovun_s16(vcombine_s16(outG[0], outG[1]));
+  *b = vqmovun_s16(vcombine_s16(outB[0], outB[1]));
+}
+#elif defined(YUV_CONVERTER_SSE2)
+/*
+ * _mm_madd_epi16() on interleaved (a, b) pairs computes a * ca + b * cb in
+ * 32 bits for 4 pixels
+ */
+static inline __m128i ConvertChannel(__m128i a, __m128i b, int32_t ca,
+                                     int32_t cb, bool high) {
+  __m128i pairs = high ? _mm_unpackhi_epi16(a, b) : _mm_unpacklo_epi16(a, b);
+  __m128i coef = _mm_set1_epi32(static_cast<int32_t>(
+      (static_cast<uint32_t>(cb) << 16) | (static_cast<uint32_t>(ca) & 0xffff)));
+  return _mm_madd_epi16(pairs, coef);
+}
+
+static inline void ConvertVector(const int32_t* coef, __m128i y, __m128i u,
+                                 __m128i v, __m128i* r, __m128i* g,
+                                 __m128i* b) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i outR[2], outG[2], outB[2];
+  for (int i = 0; i < 2; i++) {
+    bool high = (i != 0);
+    __m128i valR = ConvertChannel(y, v, coef[0], coef[1], high);
+    __m128i valG = _mm_add_epi32(ConvertChannel(y, u, coef[0], -coef[2], high),
+                                 ConvertChannel(v, zero, -coef[3], 0, high));
+    __m128i valB = ConvertChannel(y, u, coef[0], coef[4], high);
+    outR[i] = _mm_srai_epi32(valR, 10);
+    outG[i] = _mm_srai_epi32(valG, 10);
+    outB[i] = _mm_srai_epi32(valB, 10);
+  }
+  // 8 pixels per channel, in the low 8 bytes
+  *r = _mm_packus_epi16(_mm_packs_epi32(outR[0], outR[1]), zero);
+  *g = _mm_packus_epi16(_mm_packs_epi32(outG[0], outG[1]), zero);
+  *b = _mm_packus_epi16(_mm_packs_epi32(outB[0], outB[1]), zero);
+}
+#endif
+
+void YuvConverter::ConvertRow(const uint8_t* y, const uint8_t* u,
+                              const uint8_t* v, int32_t uvPixelStride,
+                              int32_t width, uint32_t* out) const {
+  ConvertSpan(y, u, v, uvPixelStride, width, width, out);
+}
+
+/*
+ * ConvertSpan(): ConvertRow() for a part of a row, rowWidth pixels are
+ *                readable from y (and the matching chroma), so the vector
+ *                loop may run up to the span end
+ */
+void YuvConverter::ConvertSpan(const uint8_t* y, const uint8_t* u,
+                               const uint8_t* v, int32_t uvPixelStride,
+                               int32_t width, int32_t rowWidth,
+                               uint32_t* out) const {
+  int32_t x = 0;
+#if defined(YUV_CONVERTER_NEON) || defined(YUV_CONVERTER_SSE2)
+  const int32_t coef[5] = {yCoef_, vToR_, uToG_, vToG_, uToB_};
+  // semi-planar loads read one byte past the last chroma sample used
+  int32_t vectorEnd = rowWidth - kVectorPixels - (uvPixelStride == 2 ? 1 : 0);
+  if (vectorEnd > width - kVectorPixels) {
+    vectorEnd = width - kVectorPixels;
+  }
+  if (uvPixelStride != 1 && uvPixelStride != 2) {
+    vectorEnd = -1;
+  }
+#endif
+
+#if defined(YUV_CONVERTER_NEON)
+  const int16x8_t yOffset = vdupq_n_s16(static_cast<int16_t>(yOffset_));
+  const int16x8_t uvOffset = vdupq_n_s16(128);
+  for (; x <= vectorEnd; x += kVectorPixels) {
+    uint8x16_t srcY = vld1q_u8(y + x);
+    uint8x8_t srcU, srcV;
+    if (uvPixelStride == 1) {
+      srcU = vld1_u8(u + (x >> 1));
+      srcV = vld1_u8(v + (x >> 1));
+    } else {
+      srcU = vld2_u8(u + x).val[0];
+      srcV = vld2_u8(v + x).val[0];
+    }
+    int16x8_t chromaU =
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(srcU)), uvOffset);
+    int16x8_t chromaV =
+        vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(srcV)), uvOffset);
+    // every chroma sample covers 2 pixels
+    int16x8x2_t pixelU = vzipq_s16(chromaU, chromaU);
+    int16x8x2_t pixelV = vzipq_s16(chromaV, chromaV);
+
+    uint8x16x4_t rgba;
+    rgba.val[3] = vdupq_n_u8(0xff);
+    uint8x8_t r[2], g[2], b[2];
+    for (int i = 0; i < 2; i++) {
+      uint8x8_t half = i ? vget_high_u8(srcY) : vget_low_u8(srcY);
+      int16x8_t luma = vmaxq_s16(
+          vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(half)), yOffset),
+          vdupq_n_s16(0));
+      ConvertVector(coef, luma, pixelU.val[i], pixelV.val[i], &r[i], &g[i],
+                    &b[i]);
+    }
+    rgba.val[0] = vcombine_u8(r[0], r[1]);
+    rgba.val[1] = vcombine_u8(g[0], g[1]);
+    rgba.val[2] = vcombine_u8(b[0], b[1]);
+    vst4q_u8(reinterpret_cast<uint8_t*>(out + x), rgba);
+  }
+#elif defined(YUV_CONVERTER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i yOffset = _mm_set1_epi16(static_cast<int16_t>(yOffset_));
+  const __m128i uvOffset = _mm_set1_epi16(128);
+  const __m128i evenBytes = _mm_set1_epi16(0x00ff);
+  const __m128i alpha = _mm_set1_epi8(static_cast<char>(0xff));
+  for (; x <= vectorEnd; x += kVectorPixels) {
+    __m128i srcY = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x));
+    __m128i chromaU, chromaV;
+    if (uvPixelStride == 1) {
+      chromaU = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + (x >> 1))),
+          zero);
+      chromaV = _mm_unpacklo_epi8(
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + (x >> 1))),
+          zero);
+    } else {
+      chromaU = _mm_and_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x)), evenBytes);
+      chromaV = _mm_and_si128(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x)), evenBytes);
+    }
+    chromaU = _mm_sub_epi16(chromaU, uvOffset);
+    chromaV = _mm_sub_epi16(chromaV, uvOffset);
+
+    __m128i* dst = reinterpret_cast<__m128i*>(out + x);
+    for (int i = 0; i < 2; i++) {
+      // every chroma sample covers 2 pixels
+      __m128i pixelU = i ? _mm_unpackhi_epi16(chromaU, chromaU)
+                         : _mm_unpacklo_epi16(chromaU, chromaU);
+      __m128i pixelV = i ? _mm_unpackhi_epi16(chromaV, chromaV)
+                         : _mm_unpacklo_epi16(chromaV, chromaV);
+      __m128i luma = i ? _mm_unpackhi_epi8(srcY, zero)
+                       : _mm_unpacklo_epi8(srcY, zero);
+      luma = _mm_max_epi16(_mm_sub_epi16(luma, yOffset), zero);
+
+      __m128i r, g, b;
+      ConvertVector(coef, luma, pixelU, pixelV, &r, &g, &b);
+      __m128i rg = _mm_unpacklo_epi8(r, g);
+      __m128i ba = _mm_unpacklo_epi8(b, alpha);
+      _mm_storeu_si128(dst + 2 * i, _mm_unpacklo_epi16(rg, ba));
+      _mm_storeu_si128(dst + 2 * i + 1, _mm_unpackhi_epi16(rg, ba));
+    }
+  }
+#endif
+
+  for (; x < width; x++) {
+    const int32_t uvOffset = (x >> 1) * uvPixelStride;
+    out[x] = ConvertPixel(y[x], u[uvOffset], v[uvOffset]);
+  }
+}
+
+void YuvConverter::Convert(const YuvPlanes& src, int32_t left, int32_t top,
+                           int32_t width, int32_t height, uint32_t* out,
+                           int32_t outStride) const {
+  for (int32_t row = top; row < top + height; row++) {
+    int32_t uvRowStart =
+        src.uvStride * (row >> 1) + (left >> 1) * src.uvPixelStride;
+    ConvertRow(src.y + src.yStride * row + left, src.u + uvRowStart,
+               src.v + uvRowStart, src.uvPixelStride, width, out);
+    out += outStride;
+  }
+}
+
+/*
+ * ConvertRotated():
+ *   Converting and rotating 90/270 degree in kRotateTile x kRotateTile
+ *   blocks: a block is converted row by row into an L1 sized scratch, then
+ *   written out transposed, so each output row receives kRotateTile
+ *   consecutive pixels instead of one pixel per output row touched.
+ *     90:  (x, y) --> (height - 1 - y, x)
+ *     180: (x, y) --> (width - 1 - x, height - 1 - y)
+ *     270: (x, y) --> (y, width - 1 - x)
+ */
+bool YuvConverter::ConvertRotated(const YuvPlanes& src, int32_t left,
+                                  int32_t top, int32_t width, int32_t height,
+                                  int32_t rotation, uint32_t* out,
+                                  int32_t outStride) const {
+  if (rotation != 90 && rotation != 180 && rotation != 270) {
+    return false;
+  }
+  uint32_t tile[kRotateTile * kRotateTile];
+  if (rotation == 180) {
+    // rows stay rows: convert scratch sized pieces, copy them reversed
+    const int32_t kPiece = kRotateTile * kRotateTile;
+    for (int32_t y = 0; y < height; y++) {
+      int32_t row = top + y;
+      uint32_t* dst = out + (height - 1 - y) * outStride + width;
+      for (int32_t x0 = 0; x0 < width; x0 += kPiece) {
+        int32_t cols = std::min(kPiece, width - x0);
+        int32_t uvStart = src.uvStride * (row >> 1) +
+                          ((left >> 1) + (x0 >> 1)) * src.uvPixelStride;
+        ConvertSpan(src.y + src.yStride * row + left + x0, src.u + uvStart,
+                    src.v + uvStart, src.uvPixelStride, cols, width - x0,
+                    tile);
+        std::reverse_copy(tile, tile + cols, dst - x0 - cols);
+      }
+    }
+    return true;
+  }
+  for (int32_t y0 = 0; y0 < height; y0 += kRotateTile) {
+    int32_t rows = std::min(kRotateTile, height - y0);
+    for (int32_t x0 = 0; x0 < width; x0 += kRotateTile) {
+      int32_t cols = std::min(kRotateTile, width - x0);
+      for (int32_t r = 0; r < rows; r++) {
+        int32_t row = top + y0 + r;
+        int32_t uvStart = src.uvStride * (row >> 1) +
+                          ((left >> 1) + (x0 >> 1)) * src.uvPixelStride;
+        ConvertSpan(src.y + src.yStride * row + left + x0, src.u + uvStart,
+                    src.v + uvStart, src.uvPixelStride, cols, width - x0,
+                    &tile[r * kRotateTile]);
+      }
+
+      for (int32_t c = 0; c < cols; c++) {
+        if (rotation == 90) {
+          uint32_t* dst = out + (x0 + c) * outStride + (height - y0 - rows);
+          for (int32_t r = rows - 1; r >= 0; r--) {
+            *dst++ = tile[r * kRotateTile + c];
+          }
+        } else {
+          uint32_t* dst = out + (width - 1 - x0 - c) * outStride + y0;
+          for (int32_t r = 0; r < rows; r++) {
+            *dst++ = tile[r * kRotateTile + c];
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
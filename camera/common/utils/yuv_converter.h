@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CAMERA_YUV_CONVERTER_H__
+#define __CAMERA_YUV_CONVERTER_H__
+
+#include <cstdint>
+
+enum class YuvColorSpace { BT601, BT709 };
+enum class YuvRange { LIMITED, FULL };
+
+/*
+ * One YUV_420_888 picture, as reported by AImage:
+ *   u is the Cb plane (plane 1), v is the Cr plane (plane 2); both share
+ *   uvStride and uvPixelStride: 1 for planar (I420), 2 for semi-planar
+ *   (NV12/NV21) chroma
+ */
+struct YuvPlanes {
+  const uint8_t* y;
+  const uint8_t* u;
+  const uint8_t* v;
+  int32_t yStride;
+  int32_t uvStride;
+  int32_t uvPixelStride;
+};
+
+/*
+ * YUV_420_888 to RGBA_8888 converter:
+ *   Output pixels are in RGBA byte order, alpha set to 0xFF, suitable for
+ *   WINDOW_FORMAT_RGBA_8888/RGBX_8888 buffers.
+ *   Arithmetic is in Q10 fixed point; with BT.601 limited range it produces
+ *   exactly the values of the Tensorflow sample's YUV2RGB() this sample used
+ *   to call per pixel.
+ *   Rows are converted 16 pixels per iteration with NEON (arm) or SSE2
+ *   (x86), remaining pixels and other uvPixelStride go through the scalar
+ *   code. Rotated output is produced in cache sized blocks.
+ *   The converter holds no state besides coefficients: one object can be
+ *   used by several threads at once.
+ */
+class YuvConverter {
+ public:
+  explicit YuvConverter(YuvColorSpace colorSpace = YuvColorSpace::BT601,
+                        YuvRange range = YuvRange::LIMITED);
+
+  /*
+   * Convert width pixels of one row: pixel x uses chroma sample (x >> 1)
+   * of u and v, samples are uvPixelStride bytes apart.
+   */
+  void ConvertRow(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                  int32_t uvPixelStride, int32_t width, uint32_t* out) const;
+
+  /*
+   * Convert a width x height region starting at (left, top) of the picture
+   * into out, outStride is in pixels
+   */
+  void Convert(const YuvPlanes& src, int32_t left, int32_t top, int32_t width,
+               int32_t height, uint32_t* out, int32_t outStride) const;
+
+  /*
+   * Same as Convert(), rotating the picture by 90, 180 or 270 degree as
+   * the preview does: for 90 and 270, out receives height columns of width
+   * pixels. Returns false for other rotations.
+   */
+  bool ConvertRotated(const YuvPlanes& src, int32_t left, int32_t top,
+                      int32_t width, int32_t height, int32_t rotation,
+                      uint32_t* out, int32_t outStride) const;
+
+  // Scalar conversion of one pixel
+  uint32_t ConvertPixel(int32_t y, int32_t u, int32_t v) const;
+
+ private:
+  void ConvertSpan(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                   int32_t uvPixelStride, int32_t width, int32_t rowWidth,
+                   uint32_t* out) const;
+
+  int32_t yOffset_;
+  // Q10 coefficients, applied to (y - yOffset_), (u - 128), (v - 128)
+  int32_t yCoef_, vToR_, uToG_, vToG_, uToB_;
+};
+
+#endif  // __CAMERA_YUV_CONVERTER_H__
@@ -72,6 +72,8 @@ GLuint AssetTexture::SRGBATexId() {
  *     texture is created from:
  *       original image --> sRGB color Space --> display_ color space
  *     during the process, colors outside sRGB are clamped.
+ *     Images tagged with another color space are first transformed into the
+ *     display_ color space for the first texture too.
  */
 bool AssetTexture::CreateGLTextures(AAssetManager *mgr) {
   ASSERT(mgr, "Asset Manager is not valid");
@@ -96,14 +98,23 @@ bool AssetTexture::CreateGLTextures(AAssetManager *mgr) {
       reinterpret_cast<int*>(&imgHeight), reinterpret_cast<int*>(&n), 4);
   uint8_t* imgBits = imageData;
   std::vector<uint8_t> staging;
+
+  /*
+   * Source color space: from embedded ICC profile / sRGB / cHRM chunks;
+   * images without any of them are assumed to be P3.
+   */
+  PNGHeader header(name_, fileData.data(), fileData.size());
+  const mathfu::mat3* srcNPM = header.HasNPM() ?
+                               header.NPM() : GetTransformNPM(NPM_TYPE::P3_D65);
   if (dispColorSpace_ == DISPLAY_COLORSPACE::SRGB) {
     staging.resize(imgWidth * imgHeight * 4 * sizeof(uint8_t));
     IMAGE_FORMAT src {
         .buf_ = imageData,
         .width_ = imgWidth,
         .height_ = imgHeight,
-        .gamma_ = DEFAULT_P3_IMAGE_GAMMA,
-        .npm_ = GetTransformNPM(NPM_TYPE::P3_D65),
+        .gamma_ = header.GetGamma(),
+        .npm_ = srcNPM,
+        .decodeTable_ = header.DecodeTable(),
     };
 
     IMAGE_FORMAT dst {
@@ -115,6 +126,27 @@ bool AssetTexture::CreateGLTextures(AAssetManager *mgr) {
     };
     TransformColorSpace(dst, src);
     imgBits = staging.data();
+  } else if (header.HasNPM()) {
+    // tagged (sRGB, ICC, cHRM) image on P3 display: bring it into P3 as well
+    staging.resize(imgWidth * imgHeight * 4 * sizeof(uint8_t));
+    IMAGE_FORMAT src {
+        .buf_ = imageData,
+        .width_ = imgWidth,
+        .height_ = imgHeight,
+        .gamma_ = header.GetGamma(),
+        .npm_ = srcNPM,
+        .decodeTable_ = header.DecodeTable(),
+    };
+
+    IMAGE_FORMAT dst {
+        .buf_ = staging.data(),
+        .width_ = imgWidth,
+        .height_ = imgHeight,
+        .gamma_ = DEFAULT_DISPLAY_GAMMA,
+        .npm_ = GetTransformNPM(NPM_TYPE::P3_D65_INV),
+    };
+    TransformColorSpace(dst, src);
+    imgBits = staging.data();
   }
   glTexImage2D(GL_TEXTURE_2D, 0,  // mip level
                GL_RGBA,
@@ -135,8 +167,9 @@ bool AssetTexture::CreateGLTextures(AAssetManager *mgr) {
         .buf_ = imageData,
         .width_ = imgWidth,
         .height_ = imgHeight,
-        .gamma_ = DEFAULT_P3_IMAGE_GAMMA,
-        .npm_ = GetTransformNPM(NPM_TYPE::P3_D65),
+        .gamma_ = header.GetGamma(),
+        .npm_ = srcNPM,
+        .decodeTable_ = header.DecodeTable(),
     };
     std::vector<uint8_t> srgbImg(imgWidth * imgHeight * 4 * sizeof(uint8_t));
     IMAGE_FORMAT dst{
@@ -79,7 +79,7 @@ static void CreateGammaDecodeTable(float gamma, std::vector<uint8_t>&table) {
  *    Perform gamma lookup for RGBA8888 format
  */
 static bool ApplyGamma(void* dst, void* src, uint32_t w, uint32_t h,
-                std::vector<uint8_t>& gammaTable) {
+                const std::vector<uint8_t>& gammaTable) {
   if(!src || !dst || gammaTable.empty()) {
     LOGE("Invalid Input to %s, dst(%p),src(%p)",
          __FUNCTION__, dst, src);
@@ -122,6 +122,10 @@ static bool GammaDecode(IMAGE_FORMAT &dst, IMAGE_FORMAT &src) {
     LOGE("No gamma value to source gamma");
     return true;
   }
+  if (src.decodeTable_ && src.decodeTable_->size() == 256) {
+    return ApplyGamma(dst.buf_, src.buf_, src.width_, src.height_,
+                      *src.decodeTable_);
+  }
   std::vector<uint8_t> gammaTable;
   CreateGammaDecodeTable(1.0f/src.gamma_, gammaTable);
 
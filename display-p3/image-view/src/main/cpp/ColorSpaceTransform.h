@@ -19,6 +19,7 @@
 #define __COLOR_TRANSFORM_H__
 
 #include <cstdint>
+#include <vector>
 #include <mathfu/glsl_mappings.h>
 
 struct IMAGE_FORMAT {
@@ -26,6 +27,8 @@ struct IMAGE_FORMAT {
   uint32_t    width_, height_;
   float       gamma_;
   const mathfu::mat3* npm_;
+  // optional exact decode curve(from ICC profile), overrides gamma_ decoding
+  const std::vector<uint8_t>* decodeTable_;
 };
 
 #define DEFAULT_DISPLAY_GAMMA (1.0f/2.2f)
@@ -0,0 +1,367 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <zlib.h>
+#include "android_debug.h"
+#include "IccProfile.h"
+
+// ICC signatures, big endian
+#define ICC_SIG(c1, c2, c3, c4)  \
+  ((static_cast<uint32_t>(c1) << 24) | (static_cast<uint32_t>(c2) << 16) | \
+   (static_cast<uint32_t>(c3) << 8) | static_cast<uint32_t>(c4))
+
+#define ICC_HEADER_SIZE     128
+#define ICC_TAG_ENTRY_SIZE  12
+#define ICC_MAX_PROFILE_SIZE (16 * 1024 * 1024)
+#define ICC_CURVE_SAMPLES   256
+
+static inline uint32_t ReadU32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) |
+         static_cast<uint32_t>(p[3]);
+}
+static inline uint16_t ReadU16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+static inline float ReadS15Fixed16(const uint8_t* p) {
+  return static_cast<int32_t>(ReadU32(p)) / 65536.0f;
+}
+
+/*
+ * Bradford chromatic adaptation D50 --> D65, used to bring colorants of
+ * profiles without 'chad' tag back to D65 (our NPMs are all D65 based)
+ */
+static const mathfu::mat3 kBradfordD50ToD65(
+    0.9555766f, -0.0282895f, 0.0122982f,
+    -0.0230393f, 1.0099416f, -0.0204830f,
+    0.0631636f, 0.0210077f, 1.3299098f);
+
+IccProfile::IccProfile(const std::vector<uint8_t>& profile) :
+    data_(profile.data()), length_(static_cast<uint32_t>(profile.size())),
+    gamma_(1.0f), valid_(false) {
+  NPM_ = mathfu::mat3::Identity();
+
+  if (length_ < ICC_HEADER_SIZE + 4 || ReadU32(data_) > length_) {
+    LOGE("====ICC profile truncated (%d bytes)", length_);
+    return;
+  }
+  length_ = ReadU32(data_);
+  if (length_ < ICC_HEADER_SIZE + 4) {
+    LOGE("====ICC profile size %d is too small", length_);
+    return;
+  }
+  if (ReadU32(&data_[16]) != ICC_SIG('R', 'G', 'B', ' ') ||
+      ReadU32(&data_[20]) != ICC_SIG('X', 'Y', 'Z', ' ')) {
+    LOGW("====ICC profile is not RGB/XYZ based, ignored");
+    return;
+  }
+  LOGV("====ICC profile version %d.%d", data_[8], data_[9] >> 4);
+
+  uint32_t tagCount = ReadU32(&data_[ICC_HEADER_SIZE]);
+  if (tagCount > (length_ - ICC_HEADER_SIZE - 4) / ICC_TAG_ENTRY_SIZE) {
+    LOGE("====ICC tag table corrupted");
+    return;
+  }
+
+  mathfu::vec3 colorants[3];
+  std::vector<float> trc[3];
+  mathfu::mat3 chad;
+  bool hasChad = false;
+  uint32_t found = 0;
+  const uint8_t* entry = &data_[ICC_HEADER_SIZE + 4];
+  for (uint32_t idx = 0; idx < tagCount; idx++, entry += ICC_TAG_ENTRY_SIZE) {
+    uint32_t sig = ReadU32(entry);
+    uint32_t offset = ReadU32(entry + 4);
+    uint32_t size = ReadU32(entry + 8);
+    if (offset > length_ || size > length_ - offset) {
+      LOGE("====ICC tag %08x out of bounds", sig);
+      return;
+    }
+    bool ok = true;
+    switch (sig) {
+      case ICC_SIG('r', 'X', 'Y', 'Z'):
+        ok = ParseXYZ(offset, size, colorants[0]), found |= 0x01;
+        break;
+      case ICC_SIG('g', 'X', 'Y', 'Z'):
+        ok = ParseXYZ(offset, size, colorants[1]), found |= 0x02;
+        break;
+      case ICC_SIG('b', 'X', 'Y', 'Z'):
+        ok = ParseXYZ(offset, size, colorants[2]), found |= 0x04;
+        break;
+      case ICC_SIG('r', 'T', 'R', 'C'):
+        ok = ParseTRC(offset, size, trc[0]), found |= 0x08;
+        break;
+      case ICC_SIG('g', 'T', 'R', 'C'):
+        ok = ParseTRC(offset, size, trc[1]), found |= 0x10;
+        break;
+      case ICC_SIG('b', 'T', 'R', 'C'):
+        ok = ParseTRC(offset, size, trc[2]), found |= 0x20;
+        break;
+      case ICC_SIG('c', 'h', 'a', 'd'):
+        ok = hasChad = ParseChad(offset, size, chad);
+        break;
+      default:
+        break;
+    }
+    if (!ok) {
+      LOGE("====ICC tag %08x corrupted", sig);
+      return;
+    }
+  }
+  if (found != 0x3F) {
+    LOGW("====ICC profile is not matrix/TRC based, ignored");
+    return;
+  }
+
+  /*
+   * Colorants are adapted to PCS white (D50); undo the adaptation so the
+   * matrix could be combined with our D65 NPMs.
+   */
+  mathfu::mat3 npm(colorants[0][0], colorants[0][1], colorants[0][2],
+                   colorants[1][0], colorants[1][1], colorants[1][2],
+                   colorants[2][0], colorants[2][1], colorants[2][2]);
+  NPM_ = (hasChad ? chad.Inverse() : kBradfordD50ToD65) * npm;
+
+  /*
+   * TransformColorSpace() applies one curve to all channels: average the
+   * three TRCs, and fit a power function for users of gamma value only.
+   */
+  curve_.resize(ICC_CURVE_SAMPLES);
+  double sumExp = 0.0;
+  uint32_t expCount = 0;
+  for (uint32_t idx = 0; idx < ICC_CURVE_SAMPLES; idx++) {
+    float y = (trc[0][idx] + trc[1][idx] + trc[2][idx]) / 3.0f;
+    y = std::min(std::max(y, 0.0f), 1.0f);
+    curve_[idx] = static_cast<uint8_t>(y * 255.0f + 0.5f);
+
+    float x = idx / static_cast<float>(ICC_CURVE_SAMPLES - 1);
+    if (x > 0.05f && x < 0.95f && y > 0.0f) {
+      sumExp += std::log(y) / std::log(x);
+      expCount++;
+    }
+  }
+  if (expCount) {
+    float exponent = static_cast<float>(sumExp / expCount);
+    // IMAGE_FORMAT keeps the encoding gamma, i.e. 1/2.2 for 2.2 curves
+    gamma_ = (exponent > 0.0f) ? 1.0f / exponent : 1.0f;
+  }
+
+  data_ = nullptr;
+  valid_ = true;
+}
+
+bool IccProfile::ParseXYZ(uint32_t tagOffset, uint32_t tagSize,
+                          mathfu::vec3& xyz) {
+  const uint8_t* tag = &data_[tagOffset];
+  if (tagSize < 20 || ReadU32(tag) != ICC_SIG('X', 'Y', 'Z', ' ')) {
+    return false;
+  }
+  xyz = mathfu::vec3(ReadS15Fixed16(tag + 8), ReadS15Fixed16(tag + 12),
+                     ReadS15Fixed16(tag + 16));
+  return true;
+}
+
+bool IccProfile::ParseChad(uint32_t tagOffset, uint32_t tagSize,
+                           mathfu::mat3& chad) {
+  const uint8_t* tag = &data_[tagOffset];
+  if (tagSize < 44 || ReadU32(tag) != ICC_SIG('s', 'f', '3', '2')) {
+    return false;
+  }
+  float m[9];
+  for (int32_t idx = 0; idx < 9; idx++) {
+    m[idx] = ReadS15Fixed16(tag + 8 + idx * 4);
+  }
+  // stored in row major order, mathfu takes column major
+  chad = mathfu::mat3(m[0], m[3], m[6], m[1], m[4], m[7], m[2], m[5], m[8]);
+  return true;
+}
+
+/*
+ * ParseTRC(): sample 'curv' or 'para' tone curve into ICC_CURVE_SAMPLES
+ *             linear values in [0, 1]
+ */
+bool IccProfile::ParseTRC(uint32_t tagOffset, uint32_t tagSize,
+                          std::vector<float>& curve) {
+  const uint8_t* tag = &data_[tagOffset];
+  if (tagSize < 12) {
+    return false;
+  }
+  curve.resize(ICC_CURVE_SAMPLES);
+  uint32_t type = ReadU32(tag);
+  if (type == ICC_SIG('c', 'u', 'r', 'v')) {
+    uint32_t count = ReadU32(tag + 8);
+    if (count > (tagSize - 12) / 2) {
+      return false;
+    }
+    float gamma = 1.0f;
+    if (count == 1) {
+      gamma = ReadU16(tag + 12) / 256.0f;
+    }
+    for (uint32_t idx = 0; idx < ICC_CURVE_SAMPLES; idx++) {
+      float x = idx / static_cast<float>(ICC_CURVE_SAMPLES - 1);
+      if (count <= 1) {
+        curve[idx] = std::pow(x, gamma);
+        continue;
+      }
+      // table curve: linear interpolation between entries
+      float pos = x * (count - 1);
+      uint32_t i0 = static_cast<uint32_t>(pos);
+      uint32_t i1 = std::min(i0 + 1, count - 1);
+      float frac = pos - i0;
+      float y0 = ReadU16(tag + 12 + i0 * 2) / 65535.0f;
+      float y1 = ReadU16(tag + 12 + i1 * 2) / 65535.0f;
+      curve[idx] = y0 + (y1 - y0) * frac;
+    }
+    return true;
+  }
+
+  if (type == ICC_SIG('p', 'a', 'r', 'a')) {
+    static const uint32_t paramCount[] = {1, 3, 4, 5, 7};
+    uint16_t function = ReadU16(tag + 8);
+    if (function >= sizeof(paramCount) / sizeof(paramCount[0]) ||
+        tagSize < 12 + paramCount[function] * 4) {
+      return false;
+    }
+    // g, a, b, c, d, e, f
+    float p[7] = {1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    for (uint32_t idx = 0; idx < paramCount[function]; idx++) {
+      p[idx] = ReadS15Fixed16(tag + 12 + idx * 4);
+    }
+    for (uint32_t idx = 0; idx < ICC_CURVE_SAMPLES; idx++) {
+      float x = idx / static_cast<float>(ICC_CURVE_SAMPLES - 1);
+      float y;
+      switch (function) {
+        case 0:
+          y = std::pow(x, p[0]);
+          break;
+        case 1:
+          y = (x >= -p[2] / p[1]) ? std::pow(p[1] * x + p[2], p[0]) : 0.0f;
+          break;
+        case 2:
+          y = (x >= -p[2] / p[1]) ?
+              std::pow(p[1] * x + p[2], p[0]) + p[3] : p[3];
+          break;
+        case 3:
+          y = (x >= p[4]) ? std::pow(p[1] * x + p[2], p[0]) : p[3] * x;
+          break;
+        default:
+          y = (x >= p[4]) ?
+              std::pow(p[1] * x + p[2], p[0]) + p[5] : p[3] * x + p[6];
+          break;
+      }
+      curve[idx] = y;
+    }
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Inflate iCCP payload (zlib stream)
+ */
+static bool InflateProfile(const uint8_t* data, uint32_t len,
+                           std::vector<uint8_t>& profile) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK) {
+    return false;
+  }
+  stream.next_in = const_cast<Bytef*>(data);
+  stream.avail_in = len;
+
+  profile.resize(0);
+  int ret = Z_OK;
+  while (ret == Z_OK) {
+    size_t produced = profile.size();
+    if (produced >= ICC_MAX_PROFILE_SIZE) {
+      break;
+    }
+    profile.resize(produced + 16 * 1024);
+    stream.next_out = profile.data() + produced;
+    stream.avail_out = static_cast<uInt>(profile.size() - produced);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    profile.resize(profile.size() - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  return (ret == Z_STREAM_END);
+}
+
+/*
+ * FNV-1a hash of the compressed profile, key of the profile cache
+ */
+static uint64_t HashProfile(const uint8_t* data, uint32_t len) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (uint32_t idx = 0; idx < len; idx++) {
+    hash ^= data[idx];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash ^ len;
+}
+
+/*
+ * A cached profile, with the compressed data it came from: a hash match
+ * is only a hit when the data is the same too.
+ */
+struct ProfileCacheEntry {
+  std::vector<uint8_t> compressed;
+  std::shared_ptr<const IccProfile> profile;
+};
+
+static std::mutex cacheLock;
+static std::unordered_map<uint64_t, ProfileCacheEntry> profileCache;
+
+std::shared_ptr<const IccProfile> IccProfile::CreateFromCompressed(
+    const uint8_t* data, uint32_t len) {
+  uint64_t key = HashProfile(data, len);
+  {
+    std::lock_guard<std::mutex> lock(cacheLock);
+    auto it = profileCache.find(key);
+    if (it != profileCache.end() && it->second.compressed.size() == len &&
+        std::equal(data, data + len, it->second.compressed.begin())) {
+      return it->second.profile;
+    }
+  }
+
+  std::shared_ptr<const IccProfile> profile;
+  std::vector<uint8_t> raw;
+  if (InflateProfile(data, len, raw)) {
+    auto parsed = std::make_shared<IccProfile>(raw);
+    if (parsed->IsValid()) {
+      profile = parsed;
+    }
+  } else {
+    LOGE("====Failed to inflate iCCP profile");
+  }
+
+  // unusable profiles are cached too, so they are not parsed again. On a
+  // hash collision, the newer profile replaces the older one.
+  std::lock_guard<std::mutex> lock(cacheLock);
+  ProfileCacheEntry& entry = profileCache[key];
+  entry.compressed.assign(data, data + len);
+  entry.profile = profile;
+  return profile;
+}
+
+void IccProfile::ClearCache(void) {
+  std::lock_guard<std::mutex> lock(cacheLock);
+  profileCache.clear();
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef  __ICC_PROFILE_H__
+#define  __ICC_PROFILE_H__
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <mathfu/glsl_mappings.h>
+
+/*
+ * IccProfile: matrix/TRC RGB ICC profile (v2 and v4), refer to
+ *    http://www.color.org/specification/ICC1v43_2010-12.pdf
+ * Only the parts needed to feed TransformColorSpace() are extracted:
+ *    NPM:    RGB --> XYZ matrix, adapted back to D65 white
+ *    gamma:  best-fit power of the tone curves, in IMAGE_FORMAT convention
+ *    curve:  8 bit decode table (encoded --> linear) of the exact tone curve
+ * LUT based profiles (A2B0 etc) are not supported.
+ */
+class IccProfile {
+public:
+  /*
+   * Create a profile from the zlib compressed payload of PNG iCCP chunk.
+   * Profiles are cached by the compressed data (looked up by its hash): an
+   * identical profile embedded in another file is not inflated/parsed again.
+   * Return nullptr if the profile could not be used.
+   */
+  static std::shared_ptr<const IccProfile> CreateFromCompressed(
+      const uint8_t* data, uint32_t len);
+  static void ClearCache(void);
+
+  explicit IccProfile(const std::vector<uint8_t>& profile);
+
+  bool IsValid(void) const { return valid_; }
+  float GetGamma(void) const { return gamma_; }
+  const mathfu::mat3* NPM(void) const { return &NPM_; }
+  const std::vector<uint8_t>* DecodeTable(void) const { return &curve_; }
+
+private:
+  bool ParseXYZ(uint32_t tagOffset, uint32_t tagSize, mathfu::vec3& xyz);
+  bool ParseChad(uint32_t tagOffset, uint32_t tagSize, mathfu::mat3& chad);
+  bool ParseTRC(uint32_t tagOffset, uint32_t tagSize,
+                std::vector<float>& curve);
+
+  const uint8_t* data_;
+  uint32_t length_;
+
+  float gamma_;
+  mathfu::mat3 NPM_;
+  std::vector<uint8_t> curve_;
+  bool valid_;
+};
+
+#endif // __ICC_PROFILE_H__
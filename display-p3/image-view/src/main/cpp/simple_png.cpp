@@ -14,7 +14,9 @@
  * limitations under the License.
  *
  */
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include "common.h"
 #include "simple_png.h"
 
@@ -120,10 +122,7 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
         break;
       }
       case PNG_CHUNCK('i', 'C', 'C', 'P'):
-        LOGI("====iCCP: %s, compression Method %d",
-             &buf_[offset_],
-             buf_[offset_ +
-                 strlen(reinterpret_cast<const char*>(&buf_[offset_])) + 1]);
+        ParseICCP(len.value);
         has_iCCP = true;
         offset_ += sizeof(uint32_t) + len.value;
         break;
@@ -142,7 +141,30 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
     }
   }
 
-  if(has_sRGB) {
+  /*
+   * iCCP and sRGB override gAMA and cHRM (PNG spec 11.3.3.1);
+   * a file should not carry both of them.
+   */
+  if (iccProfile_) {
+    gamma_ = iccProfile_->GetGamma();
+    NPM_ = *iccProfile_->NPM();
+
+    // derive chromaticities from the profile, so IsP3Image() works as usual
+    float white[3] = {0.0f, 0.0f, 0.0f};
+    for (int idx = REF_RED_IDX; idx <= REF_BLUE_IDX; idx++) {
+      int col = idx - REF_RED_IDX;
+      float sum = NPM_(0, col) + NPM_(1, col) + NPM_(2, col);
+      chrm_[idx].x = NPM_(0, col) / sum;
+      chrm_[idx].y = NPM_(1, col) / sum;
+      for (int row = 0; row < 3; row++) {
+        white[row] += NPM_(row, col);
+      }
+    }
+    float sum = white[0] + white[1] + white[2];
+    chrm_[REF_WHITE_IDX].x = white[0] / sum;
+    chrm_[REF_WHITE_IDX].y = white[1] / sum;
+    hasChrm_ = true;
+  } else if(has_sRGB) {
     CIE_POINT defaultsRGBValues[] = {
         {.31270f, .32900f },
         {.640000f, .33f   },
@@ -152,19 +174,39 @@ PNGHeader::PNGHeader(std::string& name, uint8_t *buf, uint64_t len) :
     memcpy(chrm_, defaultsRGBValues, sizeof(defaultsRGBValues));
     gamma_ = .45455f;
     hasChrm_ = true;
-  }
-
-  if(hasChrm_) {
+    UpdateNPM();
+  } else if (has_iCCP) {
+    /*
+     * shortcut: profile we could not use (LUT based etc), assume to be P3
+     */
+    hasChrm_ = false;
+  } else if(hasChrm_) {
     UpdateNPM();
   }
+  valid_ = true;
+}
 
-  /*
-   * shortcut: if SRGB / iCCP present, assume to be P3 iamge
-   */
-  if (has_sRGB || has_iCCP) {
-    hasChrm_ = false;   // When no cHRM present, assume to be P3 colorspace
+/*
+ * iCCP chunk:
+ *    profile name:   1-79 bytes, null terminated
+ *    compression:    1 byte, 0 for zlib
+ *    profile:        compressed ICC profile to the end of chunk
+ */
+void PNGHeader::ParseICCP(uint32_t len) {
+  const uint8_t* chunk = &buf_[offset_];
+  const uint8_t* nameEnd = static_cast<const uint8_t*>(
+      memchr(chunk, 0, std::min<uint32_t>(len, 80)));
+  if (!nameEnd || static_cast<uint32_t>(nameEnd - chunk) + 2 > len) {
+    LOGE("====iCCP chunk corrupted in %s", name_.c_str());
+    return;
   }
-  valid_ = true;
+  uint32_t headerSize = static_cast<uint32_t>(nameEnd - chunk) + 2;
+  LOGI("====iCCP: %s, compression Method %d", chunk, nameEnd[1]);
+  if (nameEnd[1] != 0) {
+    return;
+  }
+  iccProfile_ = IccProfile::CreateFromCompressed(chunk + headerSize,
+                                                 len - headerSize);
 }
 
 float PNGHeader::GetGamma() const{
@@ -241,3 +283,7 @@ const mathfu::mat3* PNGHeader::NPM(void) {
   ASSERT(hasChrm_, "File does not have NPM info");
   return &NPM_;
 }
+
+const std::vector<uint8_t>* PNGHeader::DecodeTable(void) const {
+  return iccProfile_ ? iccProfile_->DecodeTable() : nullptr;
+}
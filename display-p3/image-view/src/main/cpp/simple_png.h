@@ -19,8 +19,11 @@
 #define  __SIMPLE_PNG_H__
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include "android_debug.h"
+#include "IccProfile.h"
 #include <mathfu/glsl_mappings.h>
 
 #pragma pack(push, 1 )
@@ -51,9 +54,12 @@ public:
   bool  IsP3Image(void) const;
   bool  HasNPM(void) const;
   const mathfu::mat3* NPM(void);
+  // Exact decode curve from embedded ICC profile, nullptr if not available
+  const std::vector<uint8_t>* DecodeTable(void) const;
 
 private:
   void UpdateNPM(void);
+  void ParseICCP(uint32_t len);
 
   std::string name_;
   uint8_t* buf_;
@@ -67,6 +73,7 @@ private:
   CIE_POINT  chrm_[4];
   bool hasChrm_;
   mathfu::mat3 NPM_;
+  std::shared_ptr<const IccProfile> iccProfile_;
   bool  valid_;
 };
 
@@ -18,7 +18,14 @@
 #define GEOM_DEBUG LOGD
 //#define GEOM_DEBUG
 
-SimpleGeom* AsciiArtToGeom(const char *art, float scale) {
+// geometry we already baked (see BakeAsciiArt)
+static BakedAsciiArt *_baked_list = NULL;
+
+// alignment of the baked vertex and index arrays
+#define BAKE_ALIGN 64
+
+static void _parse_ascii_art(const char *art, float scale, GLfloat **outVertices,
+        int *outVertexCount, GLushort **outIndices, int *outIndexCount) {
     // figure out width and height
     LOGD("Creating geometry from ASCII art.");
     GEOM_DEBUG("Ascii art source:\n%s", art);
@@ -94,9 +101,7 @@ SimpleGeom* AsciiArtToGeom(const char *art, float scale) {
     GEOM_DEBUG("Total vertices: %d, total indices %d", vertices, indices);
 
     // allocate arrays for the vertices and lines
-    const int VERTICES_STRIDE = sizeof(GLfloat) * 7;
-    const int VERTICES_COLOR_OFFSET = sizeof(GLfloat) * 3;
-    GLfloat *verticesArray = new GLfloat[vertices * VERTICES_STRIDE];
+    GLfloat *verticesArray = new GLfloat[vertices * ASCII_ART_VERTEX_FLOATS];
     GLushort *indicesArray = new GLushort[indices];
     vertices = indices = 0; // current count of vertices and lines
 
@@ -209,22 +214,69 @@ SimpleGeom* AsciiArtToGeom(const char *art, float scale) {
         }
     }
 
-    // create the buffers
-    GEOM_DEBUG("Creating output VBO (%d vertices) and IBO (%d indices).", vertices, indices);
-    SimpleGeom* out = new SimpleGeom(new VertexBuf(verticesArray, vertices * sizeof(GLfloat) *
-            VERTICES_STRIDE, VERTICES_STRIDE), new IndexBuf(indicesArray, indices *
-            sizeof(GLushort)));
-    out->vbuf->SetPrimitive(GL_LINES);  // draw as lines
-    out->vbuf->SetColorsOffset(VERTICES_COLOR_OFFSET);
+    LOGD("Created geometry from ascii art: %d vertices, %d indices", vertices, indices);
+
+    *outVertices = verticesArray;
+    *outVertexCount = vertices;
+    *outIndices = indicesArray;
+    *outIndexCount = indices;
+}
+
+static int _align_up(int n) {
+    return (n + BAKE_ALIGN - 1) & ~(BAKE_ALIGN - 1);
+}
+
+const BakedAsciiArt* BakeAsciiArt(const char *art, float scale) {
+    BakedAsciiArt *b;
+    for (b = _baked_list; b; b = b->next) {
+        if (b->scale == scale && !strcmp(b->art, art)) {
+            return b;
+        }
+    }
+
+    GLfloat *verticesArray;
+    GLushort *indicesArray;
+    int vertices, indices;
+    _parse_ascii_art(art, scale, &verticesArray, &vertices, &indicesArray, &indices);
+
+    // Everything goes in one block: the header, then the vertices and the indices, each
+    // starting on a cache line, then the copy of the art.
+    int vertOffset = _align_up(sizeof(BakedAsciiArt));
+    int indexOffset = vertOffset + _align_up(vertices * ASCII_ART_VERTEX_STRIDE);
+    int artOffset = indexOffset + _align_up(indices * sizeof(GLushort));
+    int size = artOffset + strlen(art) + 1;
+    char *block = new char[size + BAKE_ALIGN];  // never freed, see header
+    char *base = block + (BAKE_ALIGN - (intptr_t)block % BAKE_ALIGN) % BAKE_ALIGN;
+
+    b = (BakedAsciiArt*)base;
+    memcpy(base + vertOffset, verticesArray, vertices * ASCII_ART_VERTEX_STRIDE);
+    memcpy(base + indexOffset, indicesArray, indices * sizeof(GLushort));
+    strcpy(base + artOffset, art);
+    b->art = base + artOffset;
+    b->scale = scale;
+    b->vertexCount = vertices;
+    b->indexCount = indices;
+    b->vertices = (const GLfloat*)(base + vertOffset);
+    b->indices = (const GLushort*)(base + indexOffset);
+    b->next = _baked_list;
+    _baked_list = b;
 
-    // clean up our work buffers
     delete [] verticesArray;
-    verticesArray = NULL;
     delete [] indicesArray;
-    indicesArray = NULL;
+    return b;
+}
 
-    LOGD("Created geometry from ascii art: %d vertices, %d indices", vertices, indices);
+SimpleGeom* AsciiArtToGeom(const char *art, float scale) {
+    const BakedAsciiArt *b = BakeAsciiArt(art, scale);
 
+    // create the buffers
+    GEOM_DEBUG("Creating output VBO (%d vertices) and IBO (%d indices).", b->vertexCount,
+            b->indexCount);
+    SimpleGeom* out = new SimpleGeom(new VertexBuf(b->vertices, b->vertexCount *
+            ASCII_ART_VERTEX_STRIDE, ASCII_ART_VERTEX_STRIDE), new IndexBuf(b->indices,
+            b->indexCount * sizeof(GLushort)));
+    out->vbuf->SetPrimitive(GL_LINES);  // draw as lines
+    out->vbuf->SetColorsOffset(ASCII_ART_VERTEX_COLOR_OFFSET);
     return out;
 }
 
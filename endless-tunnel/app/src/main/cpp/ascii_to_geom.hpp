@@ -38,5 +38,27 @@
  */
 SimpleGeom* AsciiArtToGeom(const char *art, float scale);
 
+// Layout of the vertices generated from ASCII art: x, y, z, r, g, b, a.
+#define ASCII_ART_VERTEX_FLOATS 7
+#define ASCII_ART_VERTEX_STRIDE (ASCII_ART_VERTEX_FLOATS * sizeof(GLfloat))
+#define ASCII_ART_VERTEX_COLOR_OFFSET (3 * sizeof(GLfloat))
+
+/* ASCII art converted to vertices (in the layout above) and GL_LINES indices. */
+struct BakedAsciiArt {
+    const char *art;  // copy of the source art
+    float scale;
+    int vertexCount;
+    int indexCount;
+    const GLfloat *vertices;
+    const GLushort *indices;
+    BakedAsciiArt *next;
+};
+
+/* Returns the geometry for the given ASCII art and scale. The art is only parsed the
+ * first time; the result is kept for the life of the process, so recreating the
+ * graphics context (which happens every time the app is paused and resumed) only needs
+ * to upload it again. AsciiArtToGeom uses this. */
+const BakedAsciiArt* BakeAsciiArt(const char *art, float scale);
+
 #endif
 
@@ -60,5 +60,44 @@
            "   gl_FragColor = mix(v_Color * u_Tint * texture2D(u_Sampler, v_TexCoord) + u_PointLightColor * att, vec4(0), v_FogFactor);\n" \
            "}";
 
-#endif
+// Variant of the shader above for instanced rendering: the model matrix and the tint come
+// from per-instance attributes (3 rows of the model matrix and an RGBA tint) and u_MVP is
+// just projection * view. There is no point light.
+#define OUR_INSTANCED_VERTEX_SHADER_SOURCE \
+           "uniform mat4 u_MVP;            \n" \
+           "attribute vec4 a_Position;     \n" \
+           "attribute vec4 a_Color;        \n" \
+           "attribute vec2 a_TexCoord;     \n" \
+           "attribute vec4 a_ModelRow0;    \n" \
+           "attribute vec4 a_ModelRow1;    \n" \
+           "attribute vec4 a_ModelRow2;    \n" \
+           "attribute vec4 a_Tint;         \n" \
+           "varying vec4 v_Color;          \n" \
+           "varying float v_FogFactor;     \n" \
+           "varying vec2 v_TexCoord;      \n" \
+           "float FOG_START = 100.0;        \n" \
+           "float FOG_END = 200.0;         \n" \
+           "void main()                    \n" \
+           "{                              \n" \
+           "   vec4 world = vec4(dot(a_ModelRow0, a_Position), \n" \
+           "                     dot(a_ModelRow1, a_Position), \n" \
+           "                     dot(a_ModelRow2, a_Position), 1.0); \n" \
+           "   vec4 pos = u_MVP * world;   \n" \
+           "   v_Color = a_Color * a_Tint; \n" \
+           "   gl_Position = pos;          \n" \
+           "   v_TexCoord = a_TexCoord;    \n" \
+           "   v_FogFactor = clamp((pos.z - FOG_START) / (FOG_END - FOG_START), 0.0, 1.0); \n" \
+           "}                              \n";
+
+#define OUR_INSTANCED_FRAG_SHADER_SOURCE \
+           "precision mediump float;       \n" \
+           "varying vec4 v_Color;          \n" \
+           "varying vec2 v_TexCoord;      \n" \
+           "varying float v_FogFactor;     \n" \
+           "uniform sampler2D u_Sampler;   \n" \
+           "void main()                    \n" \
+           "{                              \n" \
+           "   gl_FragColor = mix(v_Color * texture2D(u_Sampler, v_TexCoord), vec4(0), v_FogFactor);\n" \
+           "}";
 
+#endif
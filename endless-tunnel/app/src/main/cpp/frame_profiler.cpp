@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <cstdio>
+
+#include "common.hpp"
+#include "frame_profiler.hpp"
+#include "util.hpp"
+
+static const char* PHASE_NAMES[FrameProfiler::PHASE_COUNT] = {
+    "update", "obstacle_gen", "collision", "render_submit"
+};
+
+FrameProfiler::FrameProfiler(int maxFrames) {
+    mFrames = NULL;
+    Reset(maxFrames);
+}
+
+FrameProfiler::~FrameProfiler() {
+    delete[] mFrames;
+}
+
+void FrameProfiler::Reset(int maxFrames) {
+    MY_ASSERT(maxFrames > 0);
+    if (!mFrames || maxFrames != mMaxFrames) {
+        delete[] mFrames;
+        mFrames = new FrameRecord[maxFrames];
+        mMaxFrames = maxFrames;
+    }
+    mFirstFrame = 0;
+    mFrameCount = 0;
+    mCurrent = NULL;
+    mBaseTime = PreciseClock();
+}
+
+void FrameProfiler::BeginFrame() {
+    // once the buffer is full, we overwrite the oldest frame
+    int slot = (mFrameCount < mMaxFrames) ? (mFirstFrame + mFrameCount) % mMaxFrames :
+            mFirstFrame;
+    mCurrent = &mFrames[slot];
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        mCurrent->phaseStart[i] = 0.0;
+        mCurrent->phaseDuration[i] = -1.0;
+    }
+    mCurrent->duration = 0.0;
+    mCurrent->start = PreciseClock();
+}
+
+void FrameProfiler::EndFrame() {
+    if (!mCurrent) {
+        return;
+    }
+    mCurrent->duration = PreciseClock() - mCurrent->start;
+    mCurrent = NULL;
+    if (mFrameCount < mMaxFrames) {
+        mFrameCount++;
+    } else {
+        mFirstFrame = (mFirstFrame + 1) % mMaxFrames;
+    }
+}
+
+void FrameProfiler::BeginPhase(int phase) {
+    if (mCurrent) {
+        mCurrent->phaseStart[phase] = PreciseClock();
+    }
+}
+
+void FrameProfiler::EndPhase(int phase) {
+    if (mCurrent) {
+        mCurrent->phaseDuration[phase] = PreciseClock() - mCurrent->phaseStart[phase];
+    }
+}
+
+float FrameProfiler::GetAverageFrameMs() {
+    double total = 0.0;
+    for (int i = 0; i < mFrameCount; i++) {
+        total += mFrames[(mFirstFrame + i) % mMaxFrames].duration;
+    }
+    return mFrameCount ? (float)(1000.0 * total / mFrameCount) : 0.0f;
+}
+
+float FrameProfiler::GetAveragePhaseMs(int phase) {
+    double total = 0.0;
+    for (int i = 0; i < mFrameCount; i++) {
+        FrameRecord *f = &mFrames[(mFirstFrame + i) % mMaxFrames];
+        if (f->phaseDuration[phase] >= 0.0) {
+            total += f->phaseDuration[phase];
+        }
+    }
+    return mFrameCount ? (float)(1000.0 * total / mFrameCount) : 0.0f;
+}
+
+const char* FrameProfiler::GetPhaseName(int phase) {
+    MY_ASSERT(phase >= 0 && phase < PHASE_COUNT);
+    return PHASE_NAMES[phase];
+}
+
+bool FrameProfiler::WriteTrace(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        LOGE("FrameProfiler: can't write trace to %s", path);
+        return false;
+    }
+
+    // one complete ("X") event per frame and per phase, timestamps in microseconds
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (int i = 0; i < mFrameCount; i++) {
+        FrameRecord *r = &mFrames[(mFirstFrame + i) % mMaxFrames];
+        fprintf(f, "%s{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"index\":%d}}",
+                first ? "" : ",\n", 1e6 * (r->start - mBaseTime), 1e6 * r->duration, i);
+        first = false;
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            if (r->phaseDuration[p] < 0.0) {
+                continue;
+            }
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                    "\"ts\":%.3f,\"dur\":%.3f}", PHASE_NAMES[p],
+                    1e6 * (r->phaseStart[p] - mBaseTime), 1e6 * r->phaseDuration[p]);
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    bool ok = !ferror(f);
+    if (0 != fclose(f) || !ok) {
+        LOGE("FrameProfiler: error writing trace to %s", path);
+        return false;
+    }
+    LOGD("FrameProfiler: wrote %d frames to %s", mFrameCount, path);
+    return true;
+}
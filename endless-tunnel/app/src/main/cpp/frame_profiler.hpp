@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef endlesstunnel_frame_profiler_hpp
+#define endlesstunnel_frame_profiler_hpp
+
+/* Times the phases of each frame (update, obstacle generation, collision detection and
+ * render submission) and keeps the timings of the last few frames, which can be written
+ * out as a trace. Phases may nest: the obstacle generation and collision phases run
+ * inside the update phase. */
+class FrameProfiler {
+    public:
+        static const int PHASE_UPDATE = 0;
+        static const int PHASE_OBSTACLE_GEN = 1;
+        static const int PHASE_COLLISION = 2;
+        static const int PHASE_RENDER_SUBMIT = 3;
+        static const int PHASE_COUNT = 4;
+
+        // keeps the timings of the last maxFrames frames
+        FrameProfiler(int maxFrames);
+        ~FrameProfiler();
+
+        // discards the recorded frames and keeps the last maxFrames from now on
+        void Reset(int maxFrames);
+
+        void BeginFrame();
+        void EndFrame();
+        void BeginPhase(int phase);
+        void EndPhase(int phase);
+
+        // number of frames recorded (at most maxFrames)
+        int GetFrameCount() { return mFrameCount; }
+
+        // average time, in milliseconds, of whole frames or of the given phase over
+        // the recorded frames
+        float GetAverageFrameMs();
+        float GetAveragePhaseMs(int phase);
+
+        static const char* GetPhaseName(int phase);
+
+        // Writes the recorded frames to the given file in the Chrome trace event format
+        // (it can be opened with chrome://tracing or Perfetto). Returns false on error.
+        bool WriteTrace(const char *path);
+
+    private:
+        struct FrameRecord {
+            double start, duration;
+            // phaseDuration is negative if the phase didn't run in this frame
+            double phaseStart[PHASE_COUNT];
+            double phaseDuration[PHASE_COUNT];
+        };
+
+        // circular buffer of frames (mFrames[mFirstFrame...])
+        FrameRecord *mFrames;
+        int mMaxFrames;
+        int mFirstFrame;
+        int mFrameCount;
+
+        // frame being recorded (NULL if none)
+        FrameRecord *mCurrent;
+
+        // time of the last Reset(); trace timestamps are relative to this
+        double mBaseTime;
+};
+
+#endif
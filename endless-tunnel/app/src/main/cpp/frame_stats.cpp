@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "common.hpp"
+#include "frame_stats.hpp"
+#include "shader.hpp"
+#include "util.hpp"
+
+// how often to report, in seconds
+#define FRAME_STATS_PERIOD 5.0
+
+FrameStats::FrameStats(const char *name, const char *unitName) {
+    mName = name;
+    mUnitName = unitName;
+    mFrameStart = 0.0;
+    mFrameStartDrawCalls = 0;
+    mPeriodStart = PreciseClock();
+    mFrames = 0;
+    mDrawCalls = 0;
+    mCpuTime = 0.0;
+    mDrawCallsPerFrame = 0.0f;
+    mCpuMsPerFrame = 0.0f;
+}
+
+void FrameStats::BeginFrame() {
+    mFrameStart = PreciseClock();
+    mFrameStartDrawCalls = Shader::GetDrawCallCount();
+}
+
+void FrameStats::EndFrame() {
+    double now = PreciseClock();
+    mCpuTime += now - mFrameStart;
+    mDrawCalls += Shader::GetDrawCallCount() - mFrameStartDrawCalls;
+    mFrames++;
+
+    if (now - mPeriodStart >= FRAME_STATS_PERIOD) {
+        mDrawCallsPerFrame = (float)mDrawCalls / mFrames;
+        mCpuMsPerFrame = (float)(1000.0 * mCpuTime / mFrames);
+        LOGD("%s: %.1f draw calls, %.3f ms CPU per %s (%d samples)", mName,
+                mDrawCallsPerFrame, mCpuMsPerFrame, mUnitName, mFrames);
+        mPeriodStart = now;
+        mFrames = mDrawCalls = 0;
+        mCpuTime = 0.0;
+    }
+}
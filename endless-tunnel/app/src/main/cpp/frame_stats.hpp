@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef endlesstunnel_frame_stats_hpp
+#define endlesstunnel_frame_stats_hpp
+
+/* Measures how many draw calls and how much CPU time each frame takes. Call BeginFrame()
+ * at the start of the frame and EndFrame() at the end. The averages are logged every
+ * few seconds. A "frame" can also be some smaller unit of work, given by unitName
+ * (the TextRenderer measures each string it renders, for example). */
+class FrameStats {
+    public:
+        FrameStats(const char *name, const char *unitName = "frame");
+
+        void BeginFrame();
+        void EndFrame();
+
+        // averages over the last reporting period
+        float GetDrawCallsPerFrame() { return mDrawCallsPerFrame; }
+        float GetCpuMsPerFrame() { return mCpuMsPerFrame; }
+
+    private:
+        const char *mName;
+        const char *mUnitName;
+
+        // state of the current frame
+        double mFrameStart;
+        int mFrameStartDrawCalls;
+
+        // totals for the current reporting period
+        double mPeriodStart;
+        int mFrames;
+        int mDrawCalls;
+        double mCpuTime;
+
+        // results of the last reporting period
+        float mDrawCallsPerFrame;
+        float mCpuMsPerFrame;
+};
+
+#endif
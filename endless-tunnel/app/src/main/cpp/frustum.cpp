@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "frustum.hpp"
+
+Frustum::Frustum() {
+    // until updated, everything is visible
+    for (int i = 0; i < PLANE_COUNT; i++) {
+        mPlanes[i] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+void Frustum::Update(const glm::mat4& m) {
+    // A point is inside the frustum if -w <= x, y, z <= w in clip coordinates, so each
+    // plane is the last row of the matrix plus or minus one of the others.
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    mPlanes[0] = row3 + row0; // left
+    mPlanes[1] = row3 - row0; // right
+    mPlanes[2] = row3 + row1; // bottom
+    mPlanes[3] = row3 - row1; // top
+    mPlanes[4] = row3 + row2; // near
+    mPlanes[5] = row3 - row2; // far
+}
+
+bool Frustum::IsBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    for (int i = 0; i < PLANE_COUNT; i++) {
+        const glm::vec4& p = mPlanes[i];
+
+        // the corner of the box that is furthest along the plane's normal; if even
+        // that one is outside, the whole box is
+        float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+        float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+        float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
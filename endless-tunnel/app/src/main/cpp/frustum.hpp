@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef endlesstunnel_frustum_hpp
+#define endlesstunnel_frustum_hpp
+
+#include "common.hpp"
+
+/* The view frustum, as six planes extracted from a projection * view matrix. Used to
+ * skip drawing things that are behind the camera or outside of the field of view. */
+class Frustum {
+    public:
+        Frustum();
+
+        // Recomputes the planes from the given projection * view matrix.
+        void Update(const glm::mat4& viewProjMat);
+
+        // Returns whether any part of the given axis-aligned box (in world coordinates)
+        // may be visible. This is conservative: a box that's near a corner of the
+        // frustum may be reported as visible even if it isn't.
+        bool IsBoxVisible(const glm::vec3& boxMin, const glm::vec3& boxMax);
+
+    private:
+        // planes as (a, b, c, d), where a point p is inside if a*x + b*y + c*z + d >= 0
+        static const int PLANE_COUNT = 6;
+        glm::vec4 mPlanes[PLANE_COUNT];
+};
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "common.hpp"
+#include "headless_sim.hpp"
+
+// FNV-1a
+#define HASH_BASIS 2166136261u
+#define HASH_PRIME 16777619u
+
+static unsigned _hash(unsigned h, const void *data, int size) {
+    const unsigned char *p = (const unsigned char*)data;
+    for (int i = 0; i < size; i++) {
+        h = (h ^ p[i]) * HASH_PRIME;
+    }
+    return h;
+}
+
+HeadlessSim* HeadlessSim::Create(unsigned seed, float timestep) {
+    UseManualClock(0.0f);
+    SeedRandom(seed);
+    return new HeadlessSim(timestep);
+}
+
+HeadlessSim::HeadlessSim(float timestep) : PlayScene(true) {
+    mTimestep = timestep;
+}
+
+int HeadlessSim::Run(int frameCount) {
+    int frames;
+    mProfiler.Reset(frameCount > 0 ? frameCount : 1);
+    double startTime = PreciseClock();
+
+    for (frames = 0; frames < frameCount && !IsGameExpired(); frames++) {
+        mProfiler.BeginFrame();
+        Autopilot();
+        UpdateGame(mTimestep);
+        AdvanceClock(mTimestep);
+        mProfiler.EndFrame();
+    }
+
+    double elapsed = PreciseClock() - startTime;
+    LOGD("HeadlessSim: %d frames (%.1f s of game time) in %.3f s, %.0f frames/s.", frames,
+            frames * mTimestep, elapsed, elapsed > 0.0 ? frames / elapsed : 0.0);
+    LOGD("HeadlessSim: score %d, level %d, lives %d, state hash %08x.", GetScore(),
+            mDifficulty, mLives, GetStateHash());
+    for (int i = 0; i < FrameProfiler::PHASE_COUNT; i++) {
+        LOGD("HeadlessSim:   %-14s %.4f ms/frame", FrameProfiler::GetPhaseName(i),
+                mProfiler.GetAveragePhaseMs(i));
+    }
+    return frames;
+}
+
+void HeadlessSim::Autopilot() {
+    if (mLives <= 0) {
+        return;
+    }
+
+    // find the first obstacle that the player hasn't gone past yet
+    Obstacle *o = NULL;
+    for (int i = 0; i < mObstacleCount; i++) {
+        float posY = (mFirstSection + i) * TUNNEL_SECTION_LENGTH;
+        if (mPlayerPos.y < posY - OBS_BOX_SIZE) {
+            o = GetObstacleAt(i);
+            break;
+        }
+    }
+    if (!o || o->style == Obstacle::STYLE_NULL) {
+        return;
+    }
+
+    int col = -1, row = -1;
+    if (o->HasBonus()) {
+        col = o->bonusCol;
+        row = o->bonusRow;
+    } else {
+        float bestDist = 0.0f;
+        for (int c = 0; c < OBS_GRID_SIZE; c++) {
+            for (int r = 0; r < OBS_GRID_SIZE; r++) {
+                if (o->grid[c][r]) {
+                    continue;
+                }
+                glm::vec3 center = o->GetBoxCenter(c, r, 0.0f);
+                float dx = center.x - mPlayerPos.x, dz = center.z - mPlayerPos.z;
+                float dist = dx * dx + dz * dz;
+                if (col < 0 || dist < bestDist) {
+                    col = c;
+                    row = r;
+                    bestDist = dist;
+                }
+            }
+        }
+        if (col < 0) {
+            // no way through
+            return;
+        }
+    }
+
+    glm::vec3 target = o->GetBoxCenter(col, row, 0.0f);
+    mSteering = STEERING_TOUCH;
+    mShipSteerX = target.x;
+    mShipSteerZ = target.z;
+}
+
+unsigned HeadlessSim::GetStateHash() {
+    unsigned h = HASH_BASIS;
+    int score = GetScore();
+    h = _hash(h, &mPlayerPos, sizeof(mPlayerPos));
+    h = _hash(h, &mPlayerSpeed, sizeof(mPlayerSpeed));
+    h = _hash(h, &mRollAngle, sizeof(mRollAngle));
+    h = _hash(h, &score, sizeof(score));
+    h = _hash(h, &mLives, sizeof(mLives));
+    h = _hash(h, &mDifficulty, sizeof(mDifficulty));
+    h = _hash(h, &mFirstSection, sizeof(mFirstSection));
+    for (int i = 0; i < mObstacleCount; i++) {
+        Obstacle *o = GetObstacleAt(i);
+        h = _hash(h, o->grid, sizeof(o->grid));
+        h = _hash(h, &o->style, sizeof(o->style));
+        h = _hash(h, &o->bonusRow, sizeof(o->bonusRow));
+        h = _hash(h, &o->bonusCol, sizeof(o->bonusCol));
+    }
+    return h;
+}
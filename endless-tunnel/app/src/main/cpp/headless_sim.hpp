@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef endlesstunnel_headless_sim_hpp
+#define endlesstunnel_headless_sim_hpp
+
+#include "play_scene.hpp"
+
+/* Plays the game without a GL context or sound, at a fixed timestep and with a seeded
+ * random number generator, so the same seed always plays out the same game. The ship is
+ * steered by a simple autopilot. This lets us measure the cost of the game logic and
+ * check it for regressions (by comparing GetStateHash() across builds) on a desktop,
+ * at thousands of frames per second. The per-phase timings are in GetProfiler().
+ *
+ * Note that this takes over Clock() (see UseManualClock()), so it can't run alongside
+ * the real game. */
+class HeadlessSim : public PlayScene {
+    public:
+        // Sets up the manual clock and seeds the random number generator, then creates
+        // a simulation that advances timestep seconds per frame.
+        static HeadlessSim* Create(unsigned seed, float timestep);
+
+        // Simulates up to frameCount frames, stopping early if the game is over.
+        // Returns the number of frames simulated. The profiler keeps all of them.
+        int Run(int frameCount);
+
+        // hash of the game state (player, score, level, obstacles)
+        unsigned GetStateHash();
+
+        FrameProfiler* GetProfiler() { return &mProfiler; }
+
+    private:
+        HeadlessSim(float timestep);
+
+        // steers the ship towards the bonus of the next obstacle, or towards its nearest
+        // free cell if it has no bonus
+        void Autopilot();
+
+        float mTimestep;
+};
+
+#endif
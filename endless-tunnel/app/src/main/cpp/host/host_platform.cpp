@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-ins for the parts of the platform that the game logic links
+ * against: logging goes to stderr and SfxMan is silent. A headless PlayScene
+ * never plays a tone, but the rest of PlayScene still refers to SfxMan. */
+#include <cstdarg>
+#include <cstdio>
+
+#include "sfxman.hpp"
+
+extern "C" int __android_log_print(int prio, const char *tag, const char *fmt, ...) {
+    static const char LEVELS[] = "??VDIWE";
+    char level = (prio >= 0 && prio < (int)sizeof(LEVELS) - 1) ? LEVELS[prio] : '?';
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%c/%s: ", level, tag);
+    int n = vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return n;
+}
+
+SfxMan::SfxMan() {
+    mInitOk = false;
+    mPlayerBufferQueue = NULL;
+}
+
+SfxMan* SfxMan::GetInstance() {
+    static SfxMan instance;
+    return &instance;
+}
+
+void SfxMan::PlayTone(const char *tone) {
+}
+
+bool SfxMan::IsIdle() {
+    return true;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the Android extensions of OpenSL ES, see OpenSLES.h. */
+#ifndef endlesstunnel_host_OpenSLES_Android_h
+#define endlesstunnel_host_OpenSLES_Android_h
+
+#include <SLES/OpenSLES.h>
+
+typedef const struct SLAndroidSimpleBufferQueueItf_ * const *
+        SLAndroidSimpleBufferQueueItf;
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the NDK's jni.h: just the types the game's headers name.
+ * Nothing on the host calls into Java. */
+#ifndef endlesstunnel_host_jni_h
+#define endlesstunnel_host_jni_h
+
+#include <stdint.h>
+
+typedef int32_t jint;
+typedef void* jobject;
+typedef void* jclass;
+typedef void* jstring;
+typedef void* jmethodID;
+typedef struct _JNIEnv JNIEnv;
+typedef struct _JavaVM JavaVM;
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host runner of the headless game simulation (see headless_sim.hpp), built when
+ * CMakeLists.txt is configured for the host rather than Android:
+ *   endless_tunnel_host_bench check
+ *       plays the same seeded game twice and checks that it plays out the same,
+ *       and that another seed plays out differently; exit 1 if not
+ *   endless_tunnel_host_bench sim [frames] [seed] [trace.json]
+ *       plays frames frames (default 60000, 1000 s of game time) and prints the
+ *       frame rate, the state hash and the time of each phase. With a trace
+ *       file, also writes the frames' phases to it in the Chrome trace event
+ *       format, for chrome://tracing or Perfetto.
+ * With no argument, runs check. */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "headless_sim.hpp"
+#include "util.hpp"
+
+#define TIMESTEP (1.0f / 60.0f)
+
+struct SimResult {
+    int frames;
+    unsigned hash;
+};
+
+static SimResult _play(unsigned seed, int frameCount) {
+    HeadlessSim *sim = HeadlessSim::Create(seed, TIMESTEP);
+    SimResult result;
+    result.frames = sim->Run(frameCount);
+    result.hash = sim->GetStateHash();
+    delete sim;
+    return result;
+}
+
+static bool _check() {
+    const int frameCount = 20000;
+    bool ok = true;
+
+    SimResult a = _play(1, frameCount);
+    SimResult b = _play(1, frameCount);
+    SimResult c = _play(2, frameCount);
+    printf("check: seed 1: %d frames, hash %08x; again: %d frames, hash %08x\n",
+            a.frames, a.hash, b.frames, b.hash);
+    printf("check: seed 2: %d frames, hash %08x\n", c.frames, c.hash);
+    if (a.frames != b.frames || a.hash != b.hash) {
+        printf("check: the same seed played out differently\n");
+        ok = false;
+    }
+    if (a.hash == c.hash) {
+        printf("check: different seeds played out the same\n");
+        ok = false;
+    }
+    if (a.frames < 1000) {
+        printf("check: the game ended after %d frames\n", a.frames);
+        ok = false;
+    }
+
+    // the trace has one frame event per recorded frame
+    HeadlessSim *sim = HeadlessSim::Create(1, TIMESTEP);
+    sim->Run(100);
+    std::string path = std::string(getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp") +
+            "/endless_tunnel_check_trace.json";
+    FrameProfiler *profiler = sim->GetProfiler();
+    int events = 0;
+    if (profiler->WriteTrace(path.c_str())) {
+        FILE *f = fopen(path.c_str(), "r");
+        char line[256];
+        while (f && fgets(line, sizeof(line), f)) {
+            if (strstr(line, "\"name\":\"frame\"")) {
+                events++;
+            }
+        }
+        if (f) {
+            fclose(f);
+        }
+        remove(path.c_str());
+    }
+    if (events != profiler->GetFrameCount() || events != 100) {
+        printf("check: trace has %d frames, expected %d\n", events,
+                profiler->GetFrameCount());
+        ok = false;
+    }
+    delete sim;
+
+    printf("check: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static void _sim(int frameCount, unsigned seed, const char *tracePath) {
+    HeadlessSim *sim = HeadlessSim::Create(seed, TIMESTEP);
+    double start = PreciseClock();
+    int frames = sim->Run(frameCount);
+    double elapsed = PreciseClock() - start;
+
+    FrameProfiler *profiler = sim->GetProfiler();
+    printf("sim: seed %u, %d frames (%.0f s of game time) in %.3f s, %.0f frames/s, "
+            "state hash %08x\n", seed, frames, frames * TIMESTEP, elapsed,
+            elapsed > 0.0 ? frames / elapsed : 0.0, sim->GetStateHash());
+    printf("sim:   %-14s %.4f ms\n", "frame", profiler->GetAverageFrameMs());
+    for (int i = 0; i < FrameProfiler::PHASE_COUNT; i++) {
+        printf("sim:   %-14s %.4f ms\n", FrameProfiler::GetPhaseName(i),
+                profiler->GetAveragePhaseMs(i));
+    }
+    if (tracePath && profiler->WriteTrace(tracePath)) {
+        printf("sim: wrote %d frames to %s\n", profiler->GetFrameCount(), tracePath);
+    }
+    delete sim;
+}
+
+int main(int argc, char **argv) {
+    const char *mode = argc > 1 ? argv[1] : "check";
+    if (!strcmp(mode, "check")) {
+        return _check() ? 0 : 1;
+    }
+    if (!strcmp(mode, "sim")) {
+        int frames = argc > 2 ? atoi(argv[2]) : 60000;
+        unsigned seed = argc > 3 ? (unsigned)strtoul(argv[3], NULL, 0) : 1;
+        _sim(frames > 0 ? frames : 1, seed, argc > 4 ? argv[4] : NULL);
+        return 0;
+    }
+    fprintf(stderr, "usage: %s [check|sim [frames] [seed] [trace.json]]\n", argv[0]);
+    return 2;
+}
@@ -15,7 +15,7 @@
  */
 #include "indexbuf.hpp"
 
-IndexBuf::IndexBuf(GLushort *data, int dataSizeBytes) {
+IndexBuf::IndexBuf(const GLushort *data, int dataSizeBytes) {
     mCount = dataSizeBytes / sizeof(GLushort);
 
     glGenBuffers(1, &mIbo);
@@ -29,6 +29,13 @@ IndexBuf::~IndexBuf() {
     mIbo = 0;
 }
 
+void IndexBuf::Update(const GLushort *data, int dataSizeBytes) {
+    mCount = dataSizeBytes / sizeof(GLushort);
+    BindBuffer();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, dataSizeBytes, data, GL_STREAM_DRAW);
+    UnbindBuffer();
+}
+
 void IndexBuf::BindBuffer() {
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo);
 }
@@ -21,13 +21,16 @@
 /* Represents an index buffer (IBO). */
 class IndexBuf {
     public:
-        IndexBuf(GLushort *data, int dataSizeBytes);
+        IndexBuf(const GLushort *data, int dataSizeBytes);
         ~IndexBuf();
 
         void BindBuffer();
         void UnbindBuffer();
         int GetCount() { return mCount; }
 
+        // Replaces the buffer's contents, for geometry that is rebuilt at runtime.
+        void Update(const GLushort *data, int dataSizeBytes);
+
     private:
         GLuint mIbo;
         int mCount;
@@ -18,6 +18,24 @@
 
 #define BONUS_PROBABILITY 0.7f
 
+// obstacle colors
+static const float OBS_COLORS[] = {
+        0.0f, 0.0f, 0.0f, // style 0 (not used)
+        0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f,
+        0.0f, 1.0f, 1.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 0.0f
+};
+
+void Obstacle::GetColor(float *r, float *g, float *b) {
+    int s = Clamp(style, 1, 6);
+    *r = OBS_COLORS[s * 3];
+    *g = OBS_COLORS[s * 3 + 1];
+    *b = OBS_COLORS[s * 3 + 2];
+}
+
 void Obstacle::PutRandomBonus() {
     if (Random(100) * 0.01f > BONUS_PROBABILITY) {
         return;
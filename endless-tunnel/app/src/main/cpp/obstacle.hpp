@@ -65,6 +65,9 @@ class Obstacle {
 
         void PutRandomBonus();
 
+        // color of the obstacle's boxes, given by its style
+        void GetColor(float *r, float *g, float *b);
+
         void DeleteBonus() {
             bonusCol = bonusRow = -1;
         }
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "obstacle_batch.hpp"
+
+ObstacleBatch::ObstacleBatch(int maxInstances) {
+    mMaxInstances = maxInstances;
+    mCount = 0;
+    mTransforms = new GLfloat[maxInstances * TRANSFORM_FLOATS];
+    mTints = new GLfloat[maxInstances * TINT_FLOATS];
+    mMergedVerts = NULL;
+    mMergedCapacity = 0;
+}
+
+ObstacleBatch::~ObstacleBatch() {
+    delete[] mTransforms;
+    delete[] mTints;
+    delete[] mMergedVerts;
+}
+
+void ObstacleBatch::AddBox(const glm::vec3& center, float size, float angle, float r,
+        float g, float b) {
+    MY_ASSERT(mCount < mMaxInstances);
+
+    // translate(center) * scale(size) * rotate(angle, Z)
+    float cosine = 1.0f, sine = 0.0f;
+    if (angle != 0.0f) {
+        cosine = cosf(angle);
+        sine = sinf(angle);
+    }
+    GLfloat *t = mTransforms + mCount * TRANSFORM_FLOATS;
+    t[0] = size * cosine; t[1] = -size * sine; t[2] = 0.0f;  t[3] = center.x;
+    t[4] = size * sine;   t[5] = size * cosine; t[6] = 0.0f; t[7] = center.y;
+    t[8] = 0.0f;          t[9] = 0.0f;          t[10] = size; t[11] = center.z;
+
+    GLfloat *tint = mTints + mCount * TINT_FLOATS;
+    tint[0] = r;
+    tint[1] = g;
+    tint[2] = b;
+    tint[3] = 1.0f;
+    ++mCount;
+}
+
+void ObstacleBatch::AddObstacle(Obstacle *o, float posY, float bonusAngle,
+        float bonusTint) {
+    int r, c;
+
+    if (o->style == Obstacle::STYLE_NULL) {
+        // don't render null obstacles
+        return;
+    }
+
+    float red, green, blue;
+    o->GetColor(&red, &green, &blue);
+    for (r = 0; r < OBS_GRID_SIZE; r++) {
+        for (c = 0; c < OBS_GRID_SIZE; c++) {
+            if (o->grid[c][r]) {
+                AddBox(o->GetBoxCenter(c, r, posY), OBS_BOX_SIZE, 0.0f, red, green, blue);
+            } else if (r == o->bonusRow && c == o->bonusCol) {
+                AddBox(o->GetBoxCenter(c, r, posY), OBS_BONUS_SIZE, bonusAngle, bonusTint,
+                        bonusTint, bonusTint);
+            }
+        }
+    }
+}
+
+const GLfloat* ObstacleBatch::BuildMergedVertices(const GLfloat *geom, int vertexCount,
+        int stride, int colorOffset) {
+    int floatStride = stride / sizeof(GLfloat);
+    int colorIndex = colorOffset / sizeof(GLfloat);
+    int needed = mCount * vertexCount * floatStride;
+    if (needed > mMergedCapacity) {
+        // sized for a full batch, so this only happens once
+        delete[] mMergedVerts;
+        mMergedCapacity = mMaxInstances * vertexCount * floatStride;
+        mMergedVerts = new GLfloat[mMergedCapacity];
+    }
+
+    GLfloat *out = mMergedVerts;
+    for (int i = 0; i < mCount; i++) {
+        const GLfloat *t = mTransforms + i * TRANSFORM_FLOATS;
+        const GLfloat *tint = mTints + i * TINT_FLOATS;
+        const GLfloat *in = geom;
+        for (int v = 0; v < vertexCount; v++, in += floatStride, out += floatStride) {
+            memcpy(out, in, stride);
+            out[0] = t[0] * in[0] + t[1] * in[1] + t[2] * in[2] + t[3];
+            out[1] = t[4] * in[0] + t[5] * in[1] + t[6] * in[2] + t[7];
+            out[2] = t[8] * in[0] + t[9] * in[1] + t[10] * in[2] + t[11];
+            out[colorIndex] = in[colorIndex] * tint[0];
+            out[colorIndex + 1] = in[colorIndex + 1] * tint[1];
+            out[colorIndex + 2] = in[colorIndex + 2] * tint[2];
+        }
+    }
+    return mMergedVerts;
+}
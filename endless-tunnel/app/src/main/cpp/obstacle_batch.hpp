@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef endlesstunnel_obstacle_batch_hpp
+#define endlesstunnel_obstacle_batch_hpp
+
+#include "obstacle.hpp"
+
+/* Builds the per-frame instance data for the obstacle boxes, so they can all be drawn
+ * with a single draw call. The data is kept as structure of arrays: one array with the
+ * model transform of each box and one with its tint color. This is the layout that
+ * OurInstancedShader::RenderInstances() expects. When instancing isn't available,
+ * BuildMergedVertices() expands the batch into one world space vertex array instead. */
+class ObstacleBatch {
+    public:
+        // floats per instance: the model transform is given as the 3 rows of its
+        // 3x4 affine part, the tint as RGBA
+        static const int TRANSFORM_FLOATS = 12;
+        static const int TINT_FLOATS = 4;
+
+        ObstacleBatch(int maxInstances);
+        ~ObstacleBatch();
+
+        void Clear() { mCount = 0; }
+
+        // Adds a box of the given size, centered at center and rotated by angle around the
+        // Z axis. angle is in radians, whereas glm::rotate() in the bundled glm (built
+        // without GLM_FORCE_RADIANS) takes degrees.
+        void AddBox(const glm::vec3& center, float size, float angle, float r, float g,
+                float b);
+
+        // Adds the boxes and the bonus of an obstacle at the given Y position. The bonus
+        // is drawn rotated by bonusAngle (radians), in a gray of intensity bonusTint.
+        void AddObstacle(Obstacle *o, float posY, float bonusAngle, float bonusTint);
+
+        int GetCount() { return mCount; }
+        const GLfloat* GetTransforms() { return mTransforms; }
+        const GLfloat* GetTints() { return mTints; }
+
+        // Returns a copy of the given geometry for each instance, transformed to world
+        // space and with its colors multiplied by the tint. stride and colorOffset are in
+        // bytes, as in VertexBuf. The array holds GetCount() * vertexCount vertices and is
+        // valid until the next call.
+        const GLfloat* BuildMergedVertices(const GLfloat *geom, int vertexCount, int stride,
+                int colorOffset);
+
+    private:
+        int mMaxInstances;
+        int mCount;
+        GLfloat *mTransforms;
+        GLfloat *mTints;
+
+        // storage for BuildMergedVertices
+        GLfloat *mMergedVerts;
+        int mMergedCapacity;
+};
+
+#endif
@@ -17,6 +17,9 @@
 #include "our_shader.hpp"
 #include "data/our_shader.inl"
 
+#include <GLES2/gl2ext.h>
+#include <string.h>
+
 OurShader::OurShader() : Shader() {
     mColorLoc = (GLint) -1;
     mTintLoc = -1;
@@ -130,3 +133,175 @@ const char* OurShader::GetShaderName() {
     return "OurShader";
 }
 
+
+
+// instancing entry points, looked up at runtime since we link against GLESv2 only
+static PFNGLVERTEXATTRIBDIVISOREXTPROC sVertexAttribDivisor = NULL;
+static PFNGLDRAWARRAYSINSTANCEDEXTPROC sDrawArraysInstanced = NULL;
+
+// per-instance data layout (see ObstacleBatch)
+static const int INSTANCE_TRANSFORM_FLOATS = 12;
+static const int INSTANCE_TINT_FLOATS = 4;
+
+OurInstancedShader::OurInstancedShader() : Shader() {
+    mColorLoc = (GLint) -1;
+    mTexCoordLoc = (GLint) -1;
+    mModelRowLoc[0] = mModelRowLoc[1] = mModelRowLoc[2] = (GLint) -1;
+    mTintLoc = (GLint) -1;
+    mSamplerLoc = -1;
+    mInstanceVbo = 0;
+}
+
+OurInstancedShader::~OurInstancedShader() {
+    if (mInstanceVbo) {
+        glDeleteBuffers(1, &mInstanceVbo);
+        mInstanceVbo = 0;
+    }
+}
+
+bool OurInstancedShader::IsSupported() {
+    const char *version = (const char*) glGetString(GL_VERSION);
+    const char *extensions = (const char*) glGetString(GL_EXTENSIONS);
+
+    // even with an ES 2 context, most devices give us an ES 3 implementation, which has
+    // instancing in core
+    if (version && !strncmp(version, "OpenGL ES 3", 11)) {
+        sVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)
+                eglGetProcAddress("glVertexAttribDivisor");
+        sDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)
+                eglGetProcAddress("glDrawArraysInstanced");
+    } else if (extensions && strstr(extensions, "GL_EXT_instanced_arrays")) {
+        sVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)
+                eglGetProcAddress("glVertexAttribDivisorEXT");
+        sDrawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)
+                eglGetProcAddress("glDrawArraysInstancedEXT");
+    } else {
+        sVertexAttribDivisor = NULL;
+        sDrawArraysInstanced = NULL;
+    }
+    return sVertexAttribDivisor != NULL && sDrawArraysInstanced != NULL;
+}
+
+void OurInstancedShader::Compile() {
+    static const char *rowNames[] = { "a_ModelRow0", "a_ModelRow1", "a_ModelRow2" };
+
+    // let base class handle compilation
+    Shader::Compile();
+
+    BindShader();
+    mColorLoc = glGetAttribLocation(mProgramH, "a_Color");
+    if (mColorLoc < 0) {
+        LOGE("*** Couldn't get color attrib location from shader (OurInstancedShader).");
+        ABORT_GAME;
+    }
+    mTexCoordLoc = glGetAttribLocation(mProgramH, "a_TexCoord");
+    if (mTexCoordLoc < 0) {
+        LOGE("*** Couldn't get tex coord attribute location from shader (OurInstancedShader).");
+        ABORT_GAME;
+    }
+    for (int i = 0; i < 3; i++) {
+        mModelRowLoc[i] = glGetAttribLocation(mProgramH, rowNames[i]);
+        if (mModelRowLoc[i] < 0) {
+            LOGE("*** Couldn't get %s attrib location from shader (OurInstancedShader).",
+                    rowNames[i]);
+            ABORT_GAME;
+        }
+    }
+    mTintLoc = glGetAttribLocation(mProgramH, "a_Tint");
+    if (mTintLoc < 0) {
+        LOGE("*** Couldn't get tint attrib location from shader (OurInstancedShader).");
+        ABORT_GAME;
+    }
+    mSamplerLoc = glGetUniformLocation(mProgramH, "u_Sampler");
+    if (mSamplerLoc < 0) {
+        LOGE("*** Couldn't get sampler location from shader (OurInstancedShader).");
+        ABORT_GAME;
+    }
+    UnbindShader();
+
+    // buffer for the per-instance data, refilled every frame
+    glGenBuffers(1, &mInstanceVbo);
+}
+
+void OurInstancedShader::SetTexture(Texture *t) {
+    MY_ASSERT(mPreparedVertexBuf != NULL);
+    t->Bind(GL_TEXTURE0);
+    glUniform1i(mSamplerLoc, 0);
+}
+
+void OurInstancedShader::BeginRender(VertexBuf *geom) {
+    // let superclass begin the render
+    Shader::BeginRender(geom);
+
+    // Confirm that geometry has color and texture data
+    MY_ASSERT(geom->HasColors());
+    MY_ASSERT(mColorLoc >= 0);
+    MY_ASSERT(geom->HasTexCoords());
+    MY_ASSERT(mTexCoordLoc >= 0);
+
+    // push color data
+    glVertexAttribPointer(mColorLoc, 3, GL_FLOAT, GL_FALSE, geom->GetStride(),
+                          BUFFER_OFFSET(geom->GetColorsOffset()));
+    glEnableVertexAttribArray(mColorLoc);
+
+    // push texture coordinates
+    glVertexAttribPointer(mTexCoordLoc, 2, GL_FLOAT, GL_FALSE, geom->GetStride(),
+                          BUFFER_OFFSET(geom->GetTexCoordsOffset()));
+    glEnableVertexAttribArray(mTexCoordLoc);
+}
+
+void OurInstancedShader::RenderInstances(glm::mat4 *viewProjMat, const GLfloat *transforms,
+        const GLfloat *tints, int count) {
+    int i;
+    int transformStride = INSTANCE_TRANSFORM_FLOATS * sizeof(GLfloat);
+    int transformsSize = count * transformStride;
+    int tintsSize = count * INSTANCE_TINT_FLOATS * sizeof(GLfloat);
+
+    MY_ASSERT(mPreparedVertexBuf != NULL);
+    MY_ASSERT(sVertexAttribDivisor != NULL && sDrawArraysInstanced != NULL);
+
+    PushMVPMatrix(viewProjMat);
+
+    // upload instance data; reallocating the store first means we don't have to wait
+    // for the GPU to finish with last frame's data
+    glBindBuffer(GL_ARRAY_BUFFER, mInstanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, transformsSize + tintsSize, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, transformsSize, transforms);
+    glBufferSubData(GL_ARRAY_BUFFER, transformsSize, tintsSize, tints);
+
+    for (i = 0; i < 3; i++) {
+        glVertexAttribPointer(mModelRowLoc[i], 4, GL_FLOAT, GL_FALSE, transformStride,
+                BUFFER_OFFSET(i * 4 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(mModelRowLoc[i]);
+        sVertexAttribDivisor(mModelRowLoc[i], 1);
+    }
+    glVertexAttribPointer(mTintLoc, 4, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(transformsSize));
+    glEnableVertexAttribArray(mTintLoc);
+    sVertexAttribDivisor(mTintLoc, 1);
+
+    sDrawArraysInstanced(mPreparedVertexBuf->GetPrimitive(), 0,
+            mPreparedVertexBuf->GetCount(), count);
+    ++sDrawCallCount;
+
+    // attribute state is shared by all programs, so leave it the way the other shaders
+    // expect it
+    for (i = 0; i < 3; i++) {
+        sVertexAttribDivisor(mModelRowLoc[i], 0);
+        glDisableVertexAttribArray(mModelRowLoc[i]);
+    }
+    sVertexAttribDivisor(mTintLoc, 0);
+    glDisableVertexAttribArray(mTintLoc);
+    mPreparedVertexBuf->BindBuffer();
+}
+
+const char* OurInstancedShader::GetVertShaderSource() {
+    return OUR_INSTANCED_VERTEX_SHADER_SOURCE;
+}
+
+const char* OurInstancedShader::GetFragShaderSource() {
+    return OUR_INSTANCED_FRAG_SHADER_SOURCE;
+}
+
+const char* OurInstancedShader::GetShaderName() {
+    return "OurInstancedShader";
+}
@@ -43,5 +43,35 @@ class OurShader : public Shader {
        virtual const char *GetShaderName();
 };
 
+// Instanced variant of OurShader, used to draw all the obstacles in one call. It needs
+// OpenGL ES 3.0 or the GL_EXT_instanced_arrays extension; check IsSupported() after the
+// GL context is created.
+class OurInstancedShader : public Shader {
+    protected:
+       GLint mColorLoc;
+       GLint mTexCoordLoc;
+       GLint mModelRowLoc[3];
+       GLint mTintLoc;
+       int mSamplerLoc;
+       GLuint mInstanceVbo;
+    public:
+       OurInstancedShader();
+       virtual ~OurInstancedShader();
+       static bool IsSupported();
+       virtual void Compile();
+       void SetTexture(Texture *t);
+       virtual void BeginRender(VertexBuf *geom);
+
+       // Draws count instances of the geometry. transforms holds 12 floats per instance
+       // (3 rows of the model matrix) and tints 4 floats per instance (RGBA), as built
+       // by ObstacleBatch.
+       void RenderInstances(glm::mat4 *viewProjMat, const GLfloat *transforms,
+               const GLfloat *tints, int count);
+   protected:
+       virtual const char *GetVertShaderSource();
+       virtual const char *GetFragShaderSource();
+       virtual const char *GetShaderName();
+};
+
 #endif
 
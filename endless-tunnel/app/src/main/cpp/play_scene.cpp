@@ -34,17 +34,6 @@
 static const float MENUITEM_SEL_COLOR[] = { 1.0f, 1.0f, 0.0f };
 static const float MENUITEM_COLOR[] = { 1.0f, 1.0f, 1.0f };
 
-// obstacle colors
-static const float OBS_COLORS[] = {
-        0.0f, 0.0f, 0.0f, // style 0 (not used)
-        0.0f, 0.0f, 1.0f,
-        0.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f,
-        1.0f, 0.0f, 0.0f,
-        1.0f, 0.0f, 1.0f,
-        1.0f, 1.0f, 0.0f
-};
-
 static const char* TONE_BONUS[] = {
     "d70 f150. f250. f350. f450.",
     "d70 f200. f300. f400. f500.",
@@ -57,9 +46,18 @@ static const char* TONE_BONUS[] = {
     "d70 f550. f650. f750. f850."
 };
 
-PlayScene::PlayScene() : Scene() {
+// how many frames of phase timings PlayScene keeps
+#define PROFILER_FRAMES 300
+
+PlayScene::PlayScene() : PlayScene(false) {
+}
+
+PlayScene::PlayScene(bool headless) : Scene(), mFrameStats("PlayScene"),
+        mProfiler(PROFILER_FRAMES) {
+    mHeadless = headless;
     mOurShader = NULL;
     mTrivialShader = NULL;
+    mInstancedShader = NULL;
     mTextRenderer = NULL;
     mShapeRenderer = NULL;
     mShipSteerX = mShipSteerZ = 0.0f;
@@ -70,11 +68,16 @@ PlayScene::PlayScene() : Scene() {
     mUseCloudSave = false;
 
     mCubeGeom = NULL;
+    mObstacleBatch = NULL;
+    mObstacleMergedBuf = NULL;
     mTunnelGeom = NULL;
 
     mObstacleCount = 0;
     mFirstObstacle = 0;
     mFirstSection = 0;
+    for (int i = 0; i < SECTION_RING_SIZE; i++) {
+        UpdateSectionTransform(i);
+    }
     mSteering = STEERING_NONE;
     mPointerId = -1;
     mPointerAnchorX = mPointerAnchorY = 0.0f;
@@ -140,6 +143,11 @@ PlayScene::PlayScene() : Scene() {
 void PlayScene::LoadProgress() {
     // try to load save file
     mSavedCheckpoint = 0;
+    if (mHeadless) {
+        LOGD("Headless: not loading progress.");
+        mUseCloudSave = false;
+        return;
+    }
 
     LOGD("Attempting to load: %s", mSaveFileName);
     FILE *f = fopen(mSaveFileName, "r");
@@ -181,6 +189,10 @@ void PlayScene::LoadProgress() {
 }
 
 void PlayScene::WriteSaveFile(int level) {
+    if (mHeadless) {
+        LOGD("Headless: not saving progress (level %d).", level);
+        return;
+    }
     LOGD("Saving progress (level %d) to file: %s", level, mSaveFileName);
     FILE *f = fopen(mSaveFileName, "w");
     if (!f) {
@@ -255,6 +267,20 @@ void PlayScene::OnStartGraphics() {
     mCubeGeom->vbuf->SetColorsOffset(CUBE_GEOM_COLOR_OFFSET);
     mCubeGeom->vbuf->SetTexCoordsOffset(CUBE_GEOM_TEXCOORD_OFFSET);
 
+    // obstacles are drawn in one batch: instanced if we can, otherwise as one big
+    // vertex buffer that we rebuild every frame
+    mObstacleBatch = new ObstacleBatch(MAX_OBS * OBS_GRID_SIZE * OBS_GRID_SIZE);
+    if (OurInstancedShader::IsSupported()) {
+        LOGD("Using instanced rendering for obstacles.");
+        mInstancedShader = new OurInstancedShader();
+        mInstancedShader->Compile();
+    } else {
+        LOGD("Instancing not supported, using merged vertex buffer for obstacles.");
+        mObstacleMergedBuf = new VertexBuf(NULL, 0, CUBE_GEOM_STRIDE);
+        mObstacleMergedBuf->SetColorsOffset(CUBE_GEOM_COLOR_OFFSET);
+        mObstacleMergedBuf->SetTexCoordsOffset(CUBE_GEOM_TEXCOORD_OFFSET);
+    }
+
     // make the wall texture
     mWallTexture = new Texture();
     mWallTexture->InitFromRawRGB(WALL_TEXTURE_SIZE, WALL_TEXTURE_SIZE, false,
@@ -276,15 +302,20 @@ void PlayScene::OnKillGraphics() {
     CleanUp(&mShapeRenderer);
     CleanUp(&mOurShader);
     CleanUp(&mTrivialShader);
+    CleanUp(&mInstancedShader);
     CleanUp(&mTunnelGeom);
     CleanUp(&mCubeGeom);
+    CleanUp(&mObstacleBatch);
+    CleanUp(&mObstacleMergedBuf);
     CleanUp(&mWallTexture);
     CleanUp(&mLifeGeom);
 }
 
 void PlayScene::DoFrame() {
+    mFrameStats.BeginFrame();
+    mProfiler.BeginFrame();
+
     float deltaT = mFrameClock.ReadDelta();
-    float previousY = mPlayerPos.y;
 
     // clear screen
     glClearColor(0.0, 0.0, 0.0, 1.0);
@@ -296,8 +327,10 @@ void PlayScene::DoFrame() {
 
     // set up view matrix according to player's ship position and direction
     mViewMat = glm::lookAt(mPlayerPos, mPlayerPos + mPlayerDir, upVec);
+    mFrustum.Update(mProjMat * mViewMat);
 
     // render tunnel walls
+    mProfiler.BeginPhase(FrameProfiler::PHASE_RENDER_SUBMIT);
     RenderTunnel();
 
     // render obstacles
@@ -305,13 +338,33 @@ void PlayScene::DoFrame() {
 
     if (mMenu) {
         RenderMenu();
+        mProfiler.EndPhase(FrameProfiler::PHASE_RENDER_SUBMIT);
         // nothing more to do
+        mProfiler.EndFrame();
+        mFrameStats.EndFrame();
         return;
     }
 
     // render HUD (lives, score, etc)
     RenderHUD();
 
+    mProfiler.EndPhase(FrameProfiler::PHASE_RENDER_SUBMIT);
+
+    UpdateGame(deltaT);
+
+    // did the game expire?
+    if (IsGameExpired()) {
+        SceneManager::GetInstance()->RequestNewScene(new WelcomeScene());
+    }
+
+    mProfiler.EndFrame();
+    mFrameStats.EndFrame();
+}
+
+void PlayScene::UpdateGame(float deltaT) {
+    mProfiler.BeginPhase(FrameProfiler::PHASE_UPDATE);
+    float previousY = mPlayerPos.y;
+
     // deduct from the time remaining to remove a sign from the screen
     if (mSignText && mSignExpires) {
         mSignTimeLeft -= deltaT;
@@ -371,14 +424,16 @@ void PlayScene::DoFrame() {
     mPlayerPos.x = Clamp(mPlayerPos.x, PLAYER_MIN_X, PLAYER_MAX_X);
     mPlayerPos.z = Clamp(mPlayerPos.z, PLAYER_MIN_Z, PLAYER_MAX_Z);
 
-    // shift sections if needed
+    // shift sections if needed and generate more obstacles!
+    mProfiler.BeginPhase(FrameProfiler::PHASE_OBSTACLE_GEN);
     ShiftIfNeeded();
-
-    // generate more obstacles!
     GenObstacles();
+    mProfiler.EndPhase(FrameProfiler::PHASE_OBSTACLE_GEN);
 
     // detect collisions
+    mProfiler.BeginPhase(FrameProfiler::PHASE_COLLISION);
     DetectCollisions(previousY);
+    mProfiler.EndPhase(FrameProfiler::PHASE_COLLISION);
 
     // update ship's roll speed according to level
     static float roll_speeds[] = ROLL_SPEEDS;
@@ -392,18 +447,14 @@ void PlayScene::DoFrame() {
         mRollAngle -= 2 * M_PI;
     }
 
-    // did the game expire?
-    if (mLives <= 0 && Clock() > mGameOverExpire) {
-        SceneManager::GetInstance()->RequestNewScene(new WelcomeScene());
-
-    }
-
     // produce the ambient sound
     int soundPoint = (int)floor(mPlayerPos.y / (TUNNEL_SECTION_LENGTH/3));
     if (soundPoint % 3 != 0 && soundPoint > mLastAmbientBeepEmitted) {
         mLastAmbientBeepEmitted = soundPoint;
-        SfxMan::GetInstance()->PlayTone(soundPoint % 2 ? TONE_AMBIENT_0 : TONE_AMBIENT_1);
+        PlayTone(soundPoint % 2 ? TONE_AMBIENT_0 : TONE_AMBIENT_1);
     }
+
+    mProfiler.EndPhase(FrameProfiler::PHASE_UPDATE);
 }
 
 static float GetSectionCenterY(int i) {
@@ -414,24 +465,27 @@ static float GetSectionEndY(int i) {
     return GetSectionCenterY(i) + 0.5f * TUNNEL_SECTION_LENGTH;
 }
 
-static void _get_obs_color(int style, float *r, float *g, float *b) {
-    style = Clamp(style, 1, 6);
-    *r = OBS_COLORS[style * 3];
-    *g = OBS_COLORS[style * 3 + 1];
-    *b = OBS_COLORS[style * 3 + 2];
+void PlayScene::UpdateSectionTransform(int section) {
+    mSectionModelMat[section % SECTION_RING_SIZE] = glm::translate(glm::mat4(1.0),
+            glm::vec3(0.0, GetSectionCenterY(section), 0.0));
 }
 
 void PlayScene::RenderTunnel() {
-    glm::mat4 modelMat;
+    glm::mat4 viewProjMat = mProjMat * mViewMat;
     glm::mat4 mvpMat;
     int i, oi;
 
     mOurShader->BeginRender(mTunnelGeom->vbuf);
     mOurShader->SetTexture(mWallTexture);
     for (i = mFirstSection, oi = 0; i <= mFirstSection + RENDER_TUNNEL_SECTION_COUNT; ++i, ++oi) {
-        float segCenterY = GetSectionCenterY(i);
-        modelMat = glm::translate(glm::mat4(1.0), glm::vec3(0.0, segCenterY, 0.0));
-        mvpMat = mProjMat * mViewMat * modelMat;
+        // skip sections that are behind us or beyond the far plane
+        float segEndY = GetSectionEndY(i);
+        float segStartY = segEndY - TUNNEL_SECTION_LENGTH;
+        if (!mFrustum.IsBoxVisible(glm::vec3(-TUNNEL_HALF_W, segStartY, -TUNNEL_HALF_H),
+                glm::vec3(TUNNEL_HALF_W, segEndY, TUNNEL_HALF_H))) {
+            continue;
+        }
+        mvpMat = viewProjMat * mSectionModelMat[i % SECTION_RING_SIZE];
 
         Obstacle *o = oi >= mObstacleCount ? NULL : GetObstacleAt(oi);
 
@@ -439,7 +493,7 @@ void PlayScene::RenderTunnel() {
         // tunnel section)
         if (o) {
             float red, green, blue;
-            _get_obs_color(o->style, &red, &green, &blue);
+            o->GetColor(&red, &green, &blue);
             mOurShader->EnablePointLight(glm::vec3(0.0, 0.0f, 0.0f), red, green, blue);
         } else {
             mOurShader->DisablePointLight();
@@ -453,53 +507,46 @@ void PlayScene::RenderTunnel() {
 
 void PlayScene::RenderObstacles() {
     int i;
-    int r, c;
-    float red, green, blue;
-    glm::mat4 modelMat;
-    glm::mat4 mvpMat;
-
-    mOurShader->BeginRender(mCubeGeom->vbuf);
-    mOurShader->SetTexture(mWallTexture);
+    glm::mat4 viewProjMat = mProjMat * mViewMat;
+    // 90 degrees per second; AddBox takes radians, unlike this glm's rotate()
+    float bonusAngle = glm::radians(Clock() * 90.0f);
+    float bonusTint = SineWave(0.8f, 1.0f, 0.5f, 0.0f); // shimmering color
 
+    // gather the boxes of all obstacles
+    mObstacleBatch->Clear();
     for (i = 0; i < mObstacleCount; i++) {
-        Obstacle *o = GetObstacleAt(i);
         float posY = GetSectionCenterY(mFirstSection + i);
 
-        if (o->style == Obstacle::STYLE_NULL) {
-            // don't render null obstacles
+        // all boxes (and the spinning bonus) fit within half a cell of posY
+        if (!mFrustum.IsBoxVisible(
+                glm::vec3(-TUNNEL_HALF_W, posY - 0.5f * OBS_CELL_SIZE, -TUNNEL_HALF_H),
+                glm::vec3(TUNNEL_HALF_W, posY + 0.5f * OBS_CELL_SIZE, TUNNEL_HALF_H))) {
             continue;
         }
+        mObstacleBatch->AddObstacle(GetObstacleAt(i), posY, bonusAngle, bonusTint);
+    }
+    if (mObstacleBatch->GetCount() == 0) {
+        return;
+    }
 
-        for (r = 0; r < OBS_GRID_SIZE; r++) {
-            for (c = 0; c < OBS_GRID_SIZE; c++) {
-                bool isBonus = r == o->bonusRow && c == o->bonusCol;
-                if (o->grid[c][r]) {
-                    // set up matrices
-                    modelMat = glm::translate(glm::mat4(1.0f), o->GetBoxCenter(c, r, posY));
-                    modelMat = glm::scale(modelMat, o->GetBoxSize(c, r));
-                    mvpMat = mProjMat * mViewMat * modelMat;
-
-                    // set up color
-                    _get_obs_color(o->style, &red, &green, &blue);
-                    mOurShader->SetTintColor(red, green, blue);
-
-                    // render box
-                    mOurShader->Render(&mvpMat);
-                } else if (isBonus) {
-                    modelMat = glm::translate(glm::mat4(1.0f), o->GetBoxCenter(c, r, posY));
-                    modelMat = glm::scale(modelMat, glm::vec3(OBS_BONUS_SIZE, OBS_BONUS_SIZE,
-                            OBS_BONUS_SIZE));
-                    modelMat = glm::rotate(modelMat, Clock() * 90.0f, glm::vec3(0.0f, 0.0f, 1.0f));
-                    mvpMat = mProjMat * mViewMat * modelMat;
-                    mOurShader->SetTintColor(SineWave(0.8f, 1.0f, 0.5f, 0.0f),
-                            SineWave(0.8f, 1.0f, 0.5f, 0.0f),
-                            SineWave(0.8f, 1.0f, 0.5f, 0.0f)); // shimmering color
-                    mOurShader->Render(&mvpMat); // render
-                }
-            }
-        }
+    if (mInstancedShader) {
+        mInstancedShader->BeginRender(mCubeGeom->vbuf);
+        mInstancedShader->SetTexture(mWallTexture);
+        mInstancedShader->RenderInstances(&viewProjMat, mObstacleBatch->GetTransforms(),
+                mObstacleBatch->GetTints(), mObstacleBatch->GetCount());
+        mInstancedShader->EndRender();
+    } else {
+        // the merged vertices are already in world space and tinted
+        int vertexCount = sizeof(CUBE_GEOM) / CUBE_GEOM_STRIDE;
+        const GLfloat *verts = mObstacleBatch->BuildMergedVertices(CUBE_GEOM, vertexCount,
+                CUBE_GEOM_STRIDE, CUBE_GEOM_COLOR_OFFSET);
+        mObstacleMergedBuf->Update(verts,
+                mObstacleBatch->GetCount() * vertexCount * CUBE_GEOM_STRIDE);
+        mOurShader->BeginRender(mObstacleMergedBuf);
+        mOurShader->SetTexture(mWallTexture);
+        mOurShader->Render(&viewProjMat);
+        mOurShader->EndRender();
     }
-    mOurShader->EndRender();
 }
 
 void PlayScene::GenObstacles() {
@@ -526,6 +573,9 @@ void PlayScene::ShiftIfNeeded() {
         // shift to the next turnnel section
         mFirstSection++;
 
+        // the section that just came into view takes the ring slot of the one we dropped
+        UpdateSectionTransform(mFirstSection + RENDER_TUNNEL_SECTION_COUNT);
+
         // discard obstacle corresponding to the deleted section
         if (mObstacleCount > 0) {
             // discarding first object (shifting) is easy because it's a circular buffer!
@@ -686,11 +736,11 @@ void PlayScene::DetectCollisions(float previousY) {
         mLives--;
         if (mLives > 0) {
             ShowSign(S_OUCH, SIGN_DURATION);
-            SfxMan::GetInstance()->PlayTone(TONE_CRASHED);
+            PlayTone(TONE_CRASHED);
         } else {
             // say "Game Over"
             ShowSign(S_GAME_OVER, SIGN_DURATION_GAME_OVER);
-            SfxMan::GetInstance()->PlayTone(TONE_GAME_OVER);
+            PlayTone(TONE_GAME_OVER);
             mGameOverExpire = Clock() + GAME_OVER_EXPIRE;
         }
         mPlayerPos.y = obsMin - PLAYER_RECEDE_AFTER_COLLISION;
@@ -716,7 +766,7 @@ void PlayScene::DetectCollisions(float previousY) {
             mDifficulty = score / SCORE_PER_LEVEL;
             ShowLevelSign();
             mObstacleGen.SetDifficulty(mDifficulty);
-            SfxMan::GetInstance()->PlayTone(TONE_LEVEL_UP);
+            PlayTone(TONE_LEVEL_UP);
 
             // save progress, if needed
             SaveProgress();
@@ -725,7 +775,7 @@ void PlayScene::DetectCollisions(float previousY) {
             tone = tone < 0 ? 0 :
                    tone >= static_cast<int>(sizeof(TONE_BONUS)/sizeof(char*)) ?
                    static_cast<int>(sizeof(TONE_BONUS)/sizeof(char*) - 1) : tone;
-            SfxMan::GetInstance()->PlayTone(TONE_BONUS[tone]);
+            PlayTone(TONE_BONUS[tone]);
         }
 
     } else if (o->HasBonus()) {
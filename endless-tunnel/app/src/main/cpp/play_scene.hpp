@@ -17,6 +17,10 @@
 #define endlesstunnel_play_scene_h
 
 #include "engine.hpp"
+#include "frame_profiler.hpp"
+#include "frame_stats.hpp"
+#include "frustum.hpp"
+#include "obstacle_batch.hpp"
 #include "obstacle_generator.hpp"
 #include "obstacle.hpp"
 #include "sfxman.hpp"
@@ -25,6 +29,7 @@
 #include "util.hpp"
 
 class OurShader;
+class OurInstancedShader;
 
 /* This is the gameplay scene -- the scene that shows the player flying down
  * the infinite tunnel, dodging obstacles, collecting bonuses and being awesome. */
@@ -44,10 +49,20 @@ class PlayScene : public Scene {
         virtual void OnPause();
 
     protected:
+        // A headless scene never renders and plays no sound, and it doesn't load or write the
+        // save file. It's only driven through UpdateGame() (see HeadlessSim).
+        PlayScene(bool headless);
+
+        // is this a headless scene?
+        bool mHeadless;
+
         // shaders
         OurShader *mOurShader;
         TrivialShader *mTrivialShader;
 
+        // shader to draw all obstacles in one call (NULL if instancing isn't supported)
+        OurInstancedShader *mInstancedShader;
+
         // the wall texture
         Texture *mWallTexture;
 
@@ -89,6 +104,16 @@ class PlayScene : public Scene {
         // what is the first tunnel section that we are rendering
         int mFirstSection;
 
+        // model matrices of the tunnel sections we render (mFirstSection to
+        // mFirstSection + RENDER_TUNNEL_SECTION_COUNT), in a ring buffer indexed by section
+        // number. Each one is computed once, when the section comes into view.
+        static const int SECTION_RING_SIZE = RENDER_TUNNEL_SECTION_COUNT + 1;
+        glm::mat4 mSectionModelMat[SECTION_RING_SIZE];
+
+        // view frustum for the current frame, to skip sections and obstacles that
+        // are not visible
+        Frustum mFrustum;
+
         // circular buffer of obstacles (mObstacleCircBuf[mFirstObstacle...])
         // There is exactly one obstacle for each tunnel section:
         // obstacle 0 is at section mFirstSection
@@ -102,6 +127,11 @@ class PlayScene : public Scene {
         // obstacle generator
         ObstacleGenerator mObstacleGen;
 
+        // per-frame instance data of the obstacle boxes, and the buffer we draw them
+        // from when we can't use instancing
+        ObstacleBatch *mObstacleBatch;
+        VertexBuf *mObstacleMergedBuf;
+
         // touch pointer ID and anchor position (where touch started)
         static const int STEERING_NONE = 0, STEERING_TOUCH = 1, STEERING_JOY = 2;
         int mSteering;  // is player steering at the moment? If so, how?
@@ -119,6 +149,12 @@ class PlayScene : public Scene {
         // update stuff properly
         DeltaClock mFrameClock;
 
+        // draw call and CPU time instrumentation
+        FrameStats mFrameStats;
+
+        // timings of the phases of the last frames
+        FrameProfiler mProfiler;
+
         // sign (string) that we're currently showing (NULL if none)
         const char *mSignText;
         bool mSignExpires; // does the sign expire after a while?
@@ -205,9 +241,28 @@ class PlayScene : public Scene {
             SetScore(GetScore() + s);
         }
 
+        // advances the game by deltaT seconds: moves the player, generates obstacles, detects
+        // collisions and so on. This doesn't touch GL, so it can run headless.
+        void UpdateGame(float deltaT);
+
+        // is the game over, and has the "game over" sign been shown for long enough?
+        bool IsGameExpired() {
+            return mLives <= 0 && Clock() > mGameOverExpire;
+        }
+
+        // plays the given tone, unless we are headless
+        void PlayTone(const char *tone) {
+            if (!mHeadless) {
+                SfxMan::GetInstance()->PlayTone(tone);
+            }
+        }
+
         // generate new obstacles as needed
         void GenObstacles();
 
+        // computes the cached model matrix for the given tunnel section
+        void UpdateSectionTransform(int section);
+
         // renders the tunnel walls
         void RenderTunnel();
 
@@ -18,6 +18,8 @@
 #include "shader.hpp"
 #include "vertexbuf.hpp"
 
+int Shader::sDrawCallCount = 0;
+
 Shader::Shader() {
     mVertShaderH = mFragShaderH = mProgramH = 0;
     mMVPMatrixLoc = -1;
@@ -172,6 +174,7 @@ void Shader::Render(IndexBuf *ibuf, glm::mat4* mvpMat) {
 
     // push MVP matrix to shader
     PushMVPMatrix(mvpMat);
+    ++sDrawCallCount;
 
     if (ibuf) {
         // draw with index buffer
@@ -39,6 +39,9 @@ class Shader {
 
         // Geometry we are rendering (this is only valid between BeginRender and EndRender)
         VertexBuf *mPreparedVertexBuf;
+
+        // number of draw calls issued by all shaders so far (see GetDrawCallCount)
+        static int sDrawCallCount;
     public:
         Shader();
         virtual ~Shader();
@@ -65,6 +68,10 @@ class Shader {
         // Finishes rendering (call this after you're done making calls to Render())
         virtual void EndRender();
 
+        // Returns how many draw calls all shaders have issued since the program started.
+        // Used for profiling (see FrameStats).
+        static int GetDrawCallCount() { return sDrawCallCount; }
+
         // Convenience method to render a single copy of a geometry.
         void RenderSimpleGeom(glm::mat4* mvpMat, SimpleGeom *sg) {
             BeginRender(sg->vbuf);
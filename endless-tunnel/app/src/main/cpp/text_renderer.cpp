@@ -26,28 +26,63 @@
 
 #define CORRECTION_Y -0.02f
 
-TextRenderer::TextRenderer(TrivialShader *t) {
+TextRenderer::TextRenderer(TrivialShader *t) : mStats("TextRenderer", "string") {
+    const BakedAsciiArt *glyphs[CHAR_CODES];
+    int totalVerts = 0, totalIndices = 0;
+    int i, v;
+
     mTrivialShader = t;
-    memset(mCharGeom, 0, sizeof(mCharGeom));
     mFontScale = 1.0f;
     mMatrix = glm::mat4(1.0f);
     mColor[0] = mColor[1] = mColor[2] = 1.0f;
 
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        mCache[i].text = NULL;
+        mCache[i].fontScale = 0.0f;
+        mCache[i].geom = NULL;
+    }
+    mLayoutVerts = NULL;
+    mLayoutIndices = NULL;
+    mLayoutVertCapacity = mLayoutIndexCapacity = 0;
+
     LOGD("Loading alphabet glyphs.");
-    int i;
     for (i = 0; i < CHAR_CODES; ++i) {
-        if (ALPHABET_ART[i]) {
-            LOGD("Creating glyph for chr %d.", i);
-            mCharGeom[i] = AsciiArtToGeom(ALPHABET_ART[i], ALPHABET_SCALE);
+        glyphs[i] = ALPHABET_ART[i] ? BakeAsciiArt(ALPHABET_ART[i], ALPHABET_SCALE) : NULL;
+        mGlyphVertCount[i] = glyphs[i] ? glyphs[i]->vertexCount : 0;
+        mGlyphIndexCount[i] = glyphs[i] ? glyphs[i]->indexCount : 0;
+        mGlyphFirstVert[i] = totalVerts;
+        mGlyphFirstIndex[i] = totalIndices;
+        totalVerts += mGlyphVertCount[i];
+        totalIndices += mGlyphIndexCount[i];
+    }
+
+    // pack all glyphs into the atlas; we only need x and y, glyphs are flat and white
+    mGlyphVerts = new GLfloat[totalVerts * 2];
+    mGlyphIndices = new GLushort[totalIndices];
+    for (i = 0; i < CHAR_CODES; ++i) {
+        GLfloat *out = mGlyphVerts + mGlyphFirstVert[i] * 2;
+        for (v = 0; v < mGlyphVertCount[i]; v++) {
+            out[v * 2] = glyphs[i]->vertices[v * ASCII_ART_VERTEX_FLOATS];
+            out[v * 2 + 1] = glyphs[i]->vertices[v * ASCII_ART_VERTEX_FLOATS + 1];
+        }
+        if (mGlyphIndexCount[i] > 0) {
+            memcpy(mGlyphIndices + mGlyphFirstIndex[i], glyphs[i]->indices,
+                    mGlyphIndexCount[i] * sizeof(GLushort));
         }
     }
+    LOGD("Glyph atlas has %d vertices, %d indices.", totalVerts, totalIndices);
 }
 
 TextRenderer::~TextRenderer() {
     int i;
-    for (i = 0; i < CHAR_CODES; i++) {
-        CleanUp(&mCharGeom[i]);
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        delete[] mCache[i].text;
+        CleanUp(&mCache[i].geom);
     }
+    delete[] mGlyphVerts;
+    delete[] mGlyphIndices;
+    delete[] mLayoutVerts;
+    delete[] mLayoutIndices;
 }
 
 TextRenderer* TextRenderer::SetFontScale(float scale) {
@@ -90,13 +125,137 @@ void TextRenderer::MeasureText(const char *str, float fontScale, float *outWidth
     }
 }
 
+void TextRenderer::ReserveLayout(int vertCount, int indexCount) {
+    if (vertCount > mLayoutVertCapacity) {
+        int capacity = mLayoutVertCapacity > 0 ? mLayoutVertCapacity : 256;
+        while (capacity < vertCount) {
+            capacity *= 2;
+        }
+        GLfloat *verts = new GLfloat[capacity * ASCII_ART_VERTEX_FLOATS];
+        if (mLayoutVerts) {
+            memcpy(verts, mLayoutVerts,
+                    mLayoutVertCapacity * ASCII_ART_VERTEX_FLOATS * sizeof(GLfloat));
+            delete[] mLayoutVerts;
+        }
+        mLayoutVerts = verts;
+        mLayoutVertCapacity = capacity;
+    }
+    if (indexCount > mLayoutIndexCapacity) {
+        int capacity = mLayoutIndexCapacity > 0 ? mLayoutIndexCapacity : 512;
+        while (capacity < indexCount) {
+            capacity *= 2;
+        }
+        GLushort *indices = new GLushort[capacity];
+        if (mLayoutIndices) {
+            memcpy(indices, mLayoutIndices, mLayoutIndexCapacity * sizeof(GLushort));
+            delete[] mLayoutIndices;
+        }
+        mLayoutIndices = indices;
+        mLayoutIndexCapacity = capacity;
+    }
+}
+
+void TextRenderer::LayoutText(const char *str, float charAdvance, float lineAdvance,
+        int *outVertCount, int *outIndexCount) {
+    bool hasMatrix = mMatrix != glm::mat4(1.0f);
+    float penX = 0.0f, penY = 0.0f;
+    int vertCount = 0, indexCount = 0;
+    int v;
+
+    for (; *str; ++str) {
+        if (*str == '\n') {
+            penX = 0.0f;
+            penY -= lineAdvance;
+            continue;
+        }
+
+        int code = (int) *str;
+        if (code >= 0 && code < CHAR_CODES && mGlyphIndexCount[code] > 0) {
+            int glyphVerts = mGlyphVertCount[code];
+            int glyphIndices = mGlyphIndexCount[code];
+            ReserveLayout(vertCount + glyphVerts, indexCount + glyphIndices);
+
+            // same transform as drawing the glyph with translate(pen) * scale(fontScale) *
+            // mMatrix, done here so the whole string is one draw call
+            const GLfloat *in = mGlyphVerts + mGlyphFirstVert[code] * 2;
+            GLfloat *out = mLayoutVerts + vertCount * ASCII_ART_VERTEX_FLOATS;
+            for (v = 0; v < glyphVerts; v++, in += 2, out += ASCII_ART_VERTEX_FLOATS) {
+                glm::vec4 pos(in[0], in[1], 0.0f, 1.0f);
+                if (hasMatrix) {
+                    pos = mMatrix * pos;
+                }
+                out[0] = penX + mFontScale * pos.x;
+                out[1] = penY + mFontScale * pos.y;
+                out[2] = pos.z;
+                out[3] = out[4] = out[5] = out[6] = 1.0f; // white, the shader tints it
+            }
+
+            const GLushort *inIndex = mGlyphIndices + mGlyphFirstIndex[code];
+            GLushort *outIndex = mLayoutIndices + indexCount;
+            for (v = 0; v < glyphIndices; v++) {
+                outIndex[v] = static_cast<GLushort>(vertCount + inIndex[v]);
+            }
+            vertCount += glyphVerts;
+            indexCount += glyphIndices;
+        }
+        penX += charAdvance;
+    }
+    *outVertCount = vertCount;
+    *outIndexCount = indexCount;
+}
+
+SimpleGeom* TextRenderer::GetTextGeom(const char *str, float charAdvance, float lineAdvance) {
+    CachedText entry;
+    int i;
+
+    for (i = 0; i < TEXT_CACHE_SIZE && mCache[i].text; i++) {
+        if (mCache[i].fontScale == mFontScale && mCache[i].matrix == mMatrix &&
+                !strcmp(mCache[i].text, str)) {
+            break;
+        }
+    }
+
+    if (i < TEXT_CACHE_SIZE && mCache[i].text) {
+        // cache hit: move it to the front
+        entry = mCache[i];
+    } else {
+        // cache miss: reuse the least recently used entry (or an empty one)
+        i = TEXT_CACHE_SIZE - 1;
+        entry = mCache[i];
+        delete[] entry.text;
+        entry.text = new char[strlen(str) + 1];
+        strcpy(entry.text, str);
+        entry.fontScale = mFontScale;
+        entry.matrix = mMatrix;
+        if (!entry.geom) {
+            entry.geom = new SimpleGeom(new VertexBuf(NULL, 0, ASCII_ART_VERTEX_STRIDE),
+                    new IndexBuf(NULL, 0));
+            entry.geom->vbuf->SetPrimitive(GL_LINES);
+            entry.geom->vbuf->SetColorsOffset(ASCII_ART_VERTEX_COLOR_OFFSET);
+        }
+
+        int vertCount, indexCount;
+        LayoutText(str, charAdvance, lineAdvance, &vertCount, &indexCount);
+        entry.geom->vbuf->Update(mLayoutVerts, vertCount * ASCII_ART_VERTEX_STRIDE);
+        entry.geom->ibuf->Update(mLayoutIndices, indexCount * sizeof(GLushort));
+    }
+
+    for (; i > 0; i--) {
+        mCache[i] = mCache[i - 1];
+    }
+    mCache[0] = entry;
+    return entry.geom;
+}
+
 TextRenderer* TextRenderer::RenderText(const char *str, float centerX, float centerY) {
     float aspect = SceneManager::GetInstance()->GetScreenAspect();
     glm::mat4 orthoMat = glm::ortho(0.0f, aspect, 0.0f, 1.0f);
-    glm::mat4 modelMat, mat, scaleMat;
+    glm::mat4 mat;
     int cols, rows;
     bool hadDepthTest;
 
+    mStats.BeginFrame();
+
     centerY += CORRECTION_Y * mFontScale;
 
     glLineWidth(TEXT_LINE_WIDTH);
@@ -107,7 +266,6 @@ TextRenderer* TextRenderer::RenderText(const char *str, float centerX, float cen
     mTrivialShader->SetTintColor(mColor[0], mColor[1], mColor[2]);
 
     _count_rows_cols(str, &cols, &rows);
-    scaleMat = glm::scale(glm::mat4(1.0f), glm::vec3(mFontScale, mFontScale, 1.0f));
     float charWidth = ALPHABET_GLYPH_COLS * ALPHABET_SCALE * mFontScale;
     float charHeight = ALPHABET_GLYPH_ROWS * ALPHABET_SCALE * mFontScale;
     float charSpacing = CHAR_SPACING_F * charWidth;
@@ -116,27 +274,20 @@ TextRenderer* TextRenderer::RenderText(const char *str, float centerX, float cen
     float height = rows * charHeight + (rows - 1) * lineSpacing;
     float startX = centerX - width * 0.5f + 0.5f * charWidth;
     float startY = centerY + height * 0.5f - 0.5f * charHeight;
-    float y = startY;
 
-    modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(startX, startY, 0.0f));
-    for (; *str; ++str) {
-        if (*str == '\n') {
-            y -= charHeight + lineSpacing;
-            modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(startX, y, 0.0f));
-        } else {
-            int code = (int) *str;
-            if (code >= 0 && code < CHAR_CODES && mCharGeom[code]) {
-                mat = orthoMat * modelMat * scaleMat * mMatrix;
-                mTrivialShader->RenderSimpleGeom(&mat, mCharGeom[code]);
-            }
-            modelMat = glm::translate(modelMat, glm::vec3(charWidth + charSpacing, 0.0f, 0.0f));
-        }
+    // the string is laid out around its first character, so we only need to move it
+    // into place
+    SimpleGeom *geom = GetTextGeom(str, charWidth + charSpacing, charHeight + lineSpacing);
+    if (geom->ibuf->GetCount() > 0) {
+        mat = orthoMat * glm::translate(glm::mat4(1.0f), glm::vec3(startX, startY, 0.0f));
+        mTrivialShader->RenderSimpleGeom(&mat, geom);
     }
 
     glLineWidth(1);
     if (hadDepthTest) {
         glEnable(GL_DEPTH_TEST);
     }
+
+    mStats.EndFrame();
     return this;
 }
-
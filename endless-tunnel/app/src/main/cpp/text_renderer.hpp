@@ -17,19 +17,64 @@
 #define endlesstunnel_text_renderer_hpp
 
 #include "engine.hpp"
+#include "frame_stats.hpp"
 
 /* Renders text to the screen. Uses the "normalized 2D coordinate system" as
- * described in the README. */
+ * described in the README.
+ *
+ * Each string is drawn with a single draw call: its glyphs are laid out on the CPU, in
+ * one pass, into a line list that is uploaded to a vertex/index buffer pair. The last
+ * few strings are kept in a cache, so text that doesn't change from frame to frame
+ * (such as the score) is not laid out or uploaded again. */
 class TextRenderer {
     private:
         static const int CHAR_CODES = 128;
-        SimpleGeom* mCharGeom[CHAR_CODES];
         TrivialShader *mTrivialShader;
 
+        // Glyph atlas: the geometry of all glyphs, packed in one vertex array (x, y per
+        // vertex) and one index array (line list, indices relative to the glyph's first
+        // vertex). Glyph c uses mGlyphVertCount[c] vertices from mGlyphFirstVert[c] and
+        // mGlyphIndexCount[c] indices from mGlyphFirstIndex[c].
+        GLfloat *mGlyphVerts;
+        GLushort *mGlyphIndices;
+        int mGlyphFirstVert[CHAR_CODES], mGlyphVertCount[CHAR_CODES];
+        int mGlyphFirstIndex[CHAR_CODES], mGlyphIndexCount[CHAR_CODES];
+
+        // laid out strings, most recently used first
+        static const int TEXT_CACHE_SIZE = 8;
+        struct CachedText {
+            char *text;
+            float fontScale;
+            glm::mat4 matrix;
+            SimpleGeom *geom;
+        };
+        CachedText mCache[TEXT_CACHE_SIZE];
+
+        // scratch space to lay out strings (grows as needed)
+        GLfloat *mLayoutVerts;
+        GLushort *mLayoutIndices;
+        int mLayoutVertCapacity, mLayoutIndexCapacity;
+
         float mFontScale;
         float mColor[3];
         glm::mat4 mMatrix;
 
+        // draw call and CPU time instrumentation, per string rendered
+        FrameStats mStats;
+
+        // returns the geometry for the given string with the current font scale and matrix,
+        // laying it out if it's not in the cache
+        SimpleGeom* GetTextGeom(const char *str, float charAdvance, float lineAdvance);
+
+        // lays out the given string into mLayoutVerts/mLayoutIndices. The first character
+        // is centered at 0,0; charAdvance and lineAdvance are the distances between the
+        // centers of consecutive characters and lines.
+        void LayoutText(const char *str, float charAdvance, float lineAdvance,
+                int *outVertCount, int *outIndexCount);
+
+        // makes sure the layout arrays can hold the given number of vertices and indices
+        void ReserveLayout(int vertCount, int indexCount);
+
     public:
         TextRenderer(TrivialShader *t);
         ~TextRenderer();
@@ -18,18 +18,57 @@
 
 #include "util.hpp"
 
+#define DEFAULT_RANDOM_SEED 0x2545f491u
+
+static unsigned _random_state = DEFAULT_RANDOM_SEED;
+
+// xorshift32: cheap, and unlike rand() it gives the same sequence everywhere
+static int _next_random() {
+    _random_state ^= _random_state << 13;
+    _random_state ^= _random_state >> 17;
+    _random_state ^= _random_state << 5;
+    return (int)(_random_state & 0x7fffffff);
+}
+
+void SeedRandom(unsigned seed) {
+    // xorshift gets stuck at zero
+    _random_state = seed ? seed : DEFAULT_RANDOM_SEED;
+}
+
 int Random(int uboundExclusive) {
-    int r = rand();
+    int r = _next_random();
     return r % uboundExclusive;
 }
 
 int Random(int lbound, int uboundExclusive) {
-    int r = rand();
+    int r = _next_random();
     r = r % (uboundExclusive - lbound);
     return lbound + r;
 }
 
+static bool _manual_clock = false;
+static double _manual_clock_time = 0.0;
+
+void UseManualClock(float startTime) {
+    _manual_clock = true;
+    _manual_clock_time = startTime;
+}
+
+void AdvanceClock(float deltaT) {
+    _manual_clock_time += deltaT;
+}
+
+double PreciseClock() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
 float Clock() {
+    if (_manual_clock) {
+        return (float)_manual_clock_time;
+    }
+
     static struct timespec _base;
     static bool firstCall = true;
 
@@ -30,6 +30,10 @@ template<typename T> void CleanUp(T** pptr) {
 int Random(int uboundExclusive);
 int Random(int lbound, int uboundExclusive);
 
+// Seeds the generator behind Random(). The sequence only depends on the seed (not on the
+// C library), so a seeded run plays out the same on the device and on a desktop.
+void SeedRandom(unsigned seed);
+
 template<typename T> T Max(T a, T b) { return a > b ? a : b; }
 template<typename T> T Min(T a, T b) { return a < b ? a : b; }
 template<typename T> T Clamp(T v, T min, T max) {
@@ -68,7 +72,17 @@ template<typename T> T Abs(T f) {
 }
 
 // Returns current wall clock time (seconds elapsed since an arbitrary fixed point in the past).
+// If the manual clock is in use, returns the manual clock's time instead.
 float Clock();
+
+// Switches Clock() to a manual clock that starts at startTime and only moves forward
+// when AdvanceClock() is called. This is used to run the game at a fixed timestep.
+void UseManualClock(float startTime);
+void AdvanceClock(float deltaT);
+
+// Returns the wall clock time in seconds with (at least) microsecond resolution. Unlike
+// Clock(), this is never affected by the manual clock, so it's what we time code with.
+double PreciseClock();
 float SineWave(float min, float max, float period, float phase);
 bool BlinkFunc(float period);
 
@@ -15,7 +15,7 @@
  */
 #include "vertexbuf.hpp"
 
-VertexBuf::VertexBuf(GLfloat *geomData, int dataSize, int stride) {
+VertexBuf::VertexBuf(const GLfloat *geomData, int dataSize, int stride) {
     MY_ASSERT(dataSize % stride == 0);
 
     mPrimitive = GL_TRIANGLES;
@@ -31,6 +31,14 @@ VertexBuf::VertexBuf(GLfloat *geomData, int dataSize, int stride) {
     UnbindBuffer();
 }
 
+void VertexBuf::Update(const GLfloat *geomData, int dataSize) {
+    MY_ASSERT(dataSize % mStride == 0);
+    mCount = dataSize / mStride;
+    BindBuffer();
+    glBufferData(GL_ARRAY_BUFFER, dataSize, geomData, GL_STREAM_DRAW);
+    UnbindBuffer();
+}
+
 void VertexBuf::BindBuffer() {
     glBindBuffer(GL_ARRAY_BUFFER, mVbo);
 }
@@ -29,12 +29,15 @@ class VertexBuf {
         int mCount;
 
     public:
-        VertexBuf(GLfloat *geomData, int dataSize, int stride);
+        VertexBuf(const GLfloat *geomData, int dataSize, int stride);
         ~VertexBuf();
 
         void BindBuffer();
         void UnbindBuffer();
 
+        // Replaces the buffer's contents, for geometry that is rebuilt every frame.
+        void Update(const GLfloat *geomData, int dataSize);
+
         int GetStride() { return mStride; }
         int GetCount() { return mCount; }
         int GetPositionsOffset() { return 0; }
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "android_asset_view.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __ANDROID__
+#include <android/asset_manager.h>
+
+// set by android_fopen_set_asset_manager()
+extern AAssetManager* android_asset_manager;
+#endif
+
+// map length bytes of fd at offset, which need not be page aligned
+static int map_fd(int fd, off_t offset, size_t length, AndroidAssetView* view) {
+    if (length == 0) {
+        return 0;
+    }
+    off_t aligned = offset & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    size_t mapSize = length + (size_t)(offset - aligned);
+    void* map = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, aligned);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    view->map = map;
+    view->mapSize = mapSize;
+    view->data = (const char*)map + (offset - aligned);
+    view->size = length;
+    return 1;
+}
+
+#ifdef __ANDROID__
+static int open_asset(const char* fname, AndroidAssetView* view) {
+    AAsset* asset = AAssetManager_open(android_asset_manager, fname, AASSET_MODE_BUFFER);
+    if (!asset) {
+        return 0;
+    }
+
+    // stored uncompressed in the APK: map it in place
+    off_t start, length;
+    int fd = AAsset_openFileDescriptor(asset, &start, &length);
+    if (fd >= 0) {
+        int mapped = map_fd(fd, start, (size_t)length, view);
+        close(fd);
+        if (mapped) {
+            AAsset_close(asset);
+            return 1;
+        }
+    }
+
+    // compressed: the asset manager inflates it once, keep the asset open
+    const void* buffer = AAsset_getBuffer(asset);
+    if (!buffer) {
+        AAsset_close(asset);
+        return 0;
+    }
+    view->data = buffer;
+    view->size = (size_t)AAsset_getLength(asset);
+    view->asset = asset;
+    return 1;
+}
+#endif
+
+int android_asset_view_open(const char* fname, AndroidAssetView* view) {
+    memset(view, 0, sizeof(*view));
+#ifdef __ANDROID__
+    if (android_asset_manager) {
+        return open_asset(fname, view);
+    }
+#endif
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    int mapped = fstat(fd, &st) == 0 && map_fd(fd, 0, (size_t)st.st_size, view);
+    close(fd);
+    return mapped;
+}
+
+void android_asset_view_close(AndroidAssetView* view) {
+    if (view->map) {
+        munmap(view->map, view->mapSize);
+    }
+#ifdef __ANDROID__
+    if (view->asset) {
+        AAsset_close((AAsset*)view->asset);
+    }
+#endif
+    memset(view, 0, sizeof(*view));
+}
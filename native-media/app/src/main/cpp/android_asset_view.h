@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_ASSET_VIEW_H
+#define ANDROID_ASSET_VIEW_H
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Read-only, zero-copy view of a whole asset: companion to android_fopen for
+   parsers that can work in place instead of through stdio.
+
+   On Android the asset comes from the asset manager given to
+   android_fopen_set_asset_manager(): uncompressed assets are mmap'd straight
+   from the APK, compressed ones fall back to AAsset_getBuffer(). Elsewhere
+   (or without an asset manager) fname is a regular file and is mmap'd. */
+
+typedef struct {
+    const void* data;
+    size_t size;
+
+    // private
+    void* map;
+    size_t mapSize;
+    void* asset;
+} AndroidAssetView;
+
+/* returns 0 and leaves view zeroed on failure */
+int android_asset_view_open(const char* fname, AndroidAssetView* view);
+void android_asset_view_close(AndroidAssetView* view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,560 @@
+/*
+ * Copyright (C) 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host check and benchmarks of the stream helpers that don't depend on OpenMAX AL,
+ * built when CMakeLists.txt is configured for the host rather than Android:
+ *   native_media_host check   prefetch ring over a throttled fake file, and the index
+ *                             of a synthetic open-GOP stream; exit 1 on error
+ *   native_media_host index   build, load and lookup times of the index of a long stream
+ *   native_media_host view    reading and indexing a file through stdio and through
+ *                             an mmap'd view (android_asset_view.h)
+ * With no argument, runs all of them.
+ */
+
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "android_asset_view.h"
+#include "ts_index.h"
+#include "ts_prefetch.h"
+
+// same buffer geometry as native-media-jni.c
+#define NB_BUFFERS 8
+#define BUFFER_SIZE (10 * 188)
+#define PREFETCH_BUFFERS 256
+#define PREFETCH_BLOCK_BUFFERS 32
+
+static double now_ms(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+static void sleep_us(uint64_t us)
+{
+    struct timespec t = { (time_t) (us / 1000000), (long) (us % 1000000) * 1000 };
+    nanosleep(&t, NULL);
+}
+
+static uint8_t *make_pattern(size_t size)
+{
+    uint8_t *data = malloc(size);
+    size_t i;
+    for (i = 0; data && i < size; i++) {
+        data[i] = (uint8_t) ((i * 2654435761u) >> 13);
+    }
+    return data;
+}
+
+// A file in memory, read through stdio at no more than bytesPerSecond (0: no limit),
+// like a slow storage device
+typedef struct {
+    const uint8_t *data;
+    size_t size, pos;
+    uint64_t bytesPerSecond;
+} FakeFile;
+
+static ssize_t fake_read(void *cookie, char *buf, size_t size)
+{
+    FakeFile *f = cookie;
+    size_t n = f->size - f->pos < size ? f->size - f->pos : size;
+    memcpy(buf, f->data + f->pos, n);
+    f->pos += n;
+    if (f->bytesPerSecond && n) {
+        sleep_us(n * 1000000ull / f->bytesPerSecond);
+    }
+    return (ssize_t) n;
+}
+
+static int fake_seek(void *cookie, off64_t *offset, int whence)
+{
+    FakeFile *f = cookie;
+    off64_t pos = whence == SEEK_SET ? *offset :
+                  whence == SEEK_CUR ? (off64_t) f->pos + *offset : (off64_t) f->size + *offset;
+    if (pos < 0 || pos > (off64_t) f->size) {
+        return -1;
+    }
+    f->pos = (size_t) pos;
+    *offset = pos;
+    return 0;
+}
+
+static FILE *open_fake_file(FakeFile *f)
+{
+    cookie_io_functions_t io = { fake_read, NULL, fake_seek, NULL };
+    return fopencookie(f, "rb", io);
+}
+
+/* Plays the file the way the buffer queue callback does: NB_BUFFERS buffers are
+ * held by the "player", which takes one more every frameUs as it releases the oldest.
+ * Checks that the bytes delivered are the file's, from offset, up to its last whole
+ * packet. With resetAfter, restarts at resetOffset after that many buffers.
+ */
+static int play(TsPrefetch *prefetch, const FakeFile *f, uint64_t frameUs,
+                uint32_t resetAfter, long resetOffset, const char *name)
+{
+    const char *held[NB_BUFFERS];
+    uint32_t count = 0, buffers = 0;
+    size_t pos = 0, end = f->size - f->size % 188;
+    int ok = 1;
+    double start = now_ms();
+    for (;;) {
+        if (resetAfter && buffers == resetAfter) {
+            ts_prefetch_reset(prefetch, resetOffset);
+            pos = (size_t) resetOffset;
+            count = 0;
+            resetAfter = 0;
+        }
+        if (count == NB_BUFFERS) {
+            ts_prefetch_release(prefetch, held[0]);
+            memmove(held, held + 1, sizeof(held[0]) * (NB_BUFFERS - 1));
+            count--;
+        }
+        uint32_t size;
+        char *buffer = ts_prefetch_take(prefetch, &size);
+        if (!buffer) {
+            break;
+        }
+        if (size == 0 || size % 188 || pos + size > end ||
+            memcmp(buffer, f->data + pos, size)) {
+            fprintf(stderr, "%s: wrong data in buffer %u at offset %zu\n", name, buffers, pos);
+            ok = 0;
+            break;
+        }
+        held[count++] = buffer;
+        pos += size;
+        buffers++;
+        if (frameUs) {
+            sleep_us(frameUs);
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        ts_prefetch_release(prefetch, held[i]);
+    }
+    if (ok && pos != end) {
+        fprintf(stderr, "%s: stopped at offset %zu of %zu\n", name, pos, end);
+        ok = 0;
+    }
+
+    TsPrefetchStats stats;
+    ts_prefetch_get_stats(prefetch, &stats);
+    printf("%-28s %7u buffers %8.1f ms %6u underruns, min %3u ready: %s\n", name, buffers,
+            now_ms() - start, stats.underruns, stats.minReady, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static int check_prefetch(void)
+{
+    // 3 MB, not a whole number of packets: the last partial packet is dropped
+    size_t size = 3 * 1024 * 1024 + 100;
+    uint8_t *data = make_pattern(size);
+    if (!data) {
+        return 0;
+    }
+    int ok = 1;
+
+    // 1) storage at 16 MB/s, player as fast as it can: the player has to wait
+    FakeFile slow = { data, size, 0, 16 * 1024 * 1024 };
+    FILE *file = open_fake_file(&slow);
+    TsPrefetch *prefetch = ts_prefetch_create(file, BUFFER_SIZE, PREFETCH_BUFFERS,
+                                              PREFETCH_BLOCK_BUFFERS);
+    ok = play(prefetch, &slow, 0, 0, 0, "throttled, unpaced player") && ok;
+    TsPrefetchStats stats;
+    ts_prefetch_get_stats(prefetch, &stats);
+    if (!stats.underruns) {
+        fprintf(stderr, "a player faster than the file never waited\n");
+        ok = 0;
+    }
+    ts_prefetch_destroy(prefetch);
+    fclose(file);
+
+    // 2) same storage, player at ~4 MB/s (a buffer per 450 us), with slow reads
+    //    hidden by the ring once it has filled
+    slow.pos = 0;
+    file = open_fake_file(&slow);
+    prefetch = ts_prefetch_create(file, BUFFER_SIZE, PREFETCH_BUFFERS, PREFETCH_BLOCK_BUFFERS);
+    sleep_us(100000);
+    ok = play(prefetch, &slow, 450, 0, 0, "throttled, paced player") && ok;
+    ts_prefetch_destroy(prefetch);
+    fclose(file);
+
+    // 3) rewind and seek in the middle of the stream, to a packet boundary
+    FakeFile fast = { data, size, 0, 0 };
+    file = open_fake_file(&fast);
+    prefetch = ts_prefetch_create(file, BUFFER_SIZE, PREFETCH_BUFFERS, PREFETCH_BLOCK_BUFFERS);
+    ok = play(prefetch, &fast, 0, 500, 0, "rewind after 500 buffers") && ok;
+    ts_prefetch_reset(prefetch, 0);
+    ok = play(prefetch, &fast, 0, 100, 4000 * 188, "seek after 100 buffers") && ok;
+    ts_prefetch_destroy(prefetch);
+    fclose(file);
+
+    free(data);
+    return ok;
+}
+
+/* Synthetic transport stream: a PAT and a PMT every second, and one H.264 stream
+ * (pid 0x101) at 25 fps, each frame a PES of packetsPerFrame packets. Frames are in
+ * decode order with an open GOP of 24 frames: each key frame (flagged as a random
+ * access point) is followed by the two B-frames displayed before it, so the stream
+ * starts with two PTS earlier than the first one. PTS start at firstPts.
+ */
+#define VIDEO_PID 0x101
+#define PTS_PER_FRAME 3600
+#define GOP_FRAMES 24
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    uint8_t continuity[VIDEO_PID + 1];
+} TsStream;
+
+static void put_packet(TsStream *ts, int pid, int payloadStart, int randomAccess,
+                       const uint8_t *payload, uint32_t size)
+{
+    uint8_t *p = ts->data + ts->size;
+    ts->size += 188;
+    memset(p, 0xff, 188);
+    p[0] = 0x47;
+    p[1] = (uint8_t) ((payloadStart ? 0x40 : 0) | (pid >> 8));
+    p[2] = (uint8_t) pid;
+    uint32_t header = 4;
+    if (randomAccess || size < 184) {
+        // adaptation field, stuffed up to the payload
+        p[3] = (uint8_t) (0x30 | (ts->continuity[pid]++ & 0x0f));
+        p[4] = (uint8_t) (183 - size);
+        if (p[4]) {
+            p[5] = randomAccess ? 0x40 : 0;
+        }
+        header = 5 + p[4];
+    } else {
+        p[3] = (uint8_t) (0x10 | (ts->continuity[pid]++ & 0x0f));
+    }
+    memcpy(p + header, payload, size);
+}
+
+static uint32_t put_pes_header(uint8_t *b, uint64_t pts)
+{
+    static const uint8_t header[9] = { 0, 0, 1, 0xe0, 0, 0, 0x80, 0x80, 5 };
+    memcpy(b, header, sizeof(header));
+    b[9] = (uint8_t) (0x21 | ((pts >> 29) & 0x0e));
+    b[10] = (uint8_t) (pts >> 22);
+    b[11] = (uint8_t) (((pts >> 14) & 0xfe) | 1);
+    b[12] = (uint8_t) (pts >> 7);
+    b[13] = (uint8_t) (((pts << 1) & 0xfe) | 1);
+    return 14;
+}
+
+// display order of the frame decoded in position frame (0, 1, 2, 3, ... -> 2, 0, 1, 5, ...)
+static uint32_t display_frame(uint32_t frame)
+{
+    return frame % 3 == 0 ? frame + 2 : frame - 1;
+}
+
+static int make_stream(TsStream *ts, uint32_t frames, uint32_t packetsPerFrame, uint64_t firstPts)
+{
+    // pat: program 1 on pmt pid 0x100; pmt: H.264 on pid 0x101 (CRCs are not checked)
+    static const uint8_t pat[17] = { 0, 0x00, 0xb0, 13, 0, 1, 0xc1, 0, 0, 0, 1, 0xe1, 0x00 };
+    static const uint8_t pmt[22] = { 0, 0x02, 0xb0, 18, 0, 1, 0xc1, 0, 0, 0xe1, 0x01, 0xf0, 0,
+                                     0x1b, 0xe1, 0x01, 0xf0, 0 };
+    memset(ts, 0, sizeof(*ts));
+    ts->data = malloc((size_t) (frames / 25 + 1) * 2 * 188 +
+                      (size_t) frames * packetsPerFrame * 188);
+    if (!ts->data) {
+        return 0;
+    }
+    uint32_t frame;
+    for (frame = 0; frame < frames; frame++) {
+        if (frame % 25 == 0) {
+            put_packet(ts, 0, 1, 0, pat, sizeof(pat));
+            put_packet(ts, 0x100, 1, 0, pmt, sizeof(pmt));
+        }
+        uint8_t payload[184];
+        int key = frame % GOP_FRAMES == 0;
+        uint64_t pts = (firstPts + (uint64_t) (display_frame(frame) - 2) * PTS_PER_FRAME) &
+                ((1ull << 33) - 1);
+        uint32_t size = put_pes_header(payload, pts);
+        // a non-IDR slice, only the random access indicator marks the key frames
+        static const uint8_t slice[4] = { 0, 0, 1, 0x41 };
+        memcpy(payload + size, slice, sizeof(slice));
+        size += sizeof(slice);
+        memset(payload + size, 0x55, 184 - size);
+        put_packet(ts, VIDEO_PID, 1, key, payload, key ? 182 : 184);
+        uint32_t i;
+        for (i = 1; i < packetsPerFrame; i++) {
+            memset(payload, (uint8_t) i, sizeof(payload));
+            put_packet(ts, VIDEO_PID, 0, 0, payload, sizeof(payload));
+        }
+    }
+    return 1;
+}
+
+static FILE *write_temp_file(const TsStream *ts)
+{
+    FILE *file = tmpfile();
+    if (file && (fwrite(ts->data, 1, ts->size, file) != ts->size || fflush(file) != 0)) {
+        fclose(file);
+        file = NULL;
+    }
+    return file;
+}
+
+static void temp_path(char *path, size_t size, const char *name)
+{
+    const char *dir = getenv("TMPDIR");
+    snprintf(path, size, "%s/native_media_%d_%s", dir ? dir : "/tmp", (int) getpid(), name);
+}
+
+static int check_index(void)
+{
+    // one minute, starting 10 s before the 33-bit PTS wrap
+    uint32_t frames = 60 * 25;
+    TsStream ts;
+    if (!make_stream(&ts, frames, 4, (1ull << 33) - 10 * 90000)) {
+        return 0;
+    }
+    int ok = 1;
+    TsIndex *index = ts_index_build_buffer(ts.data, ts.size);
+    FILE *file = write_temp_file(&ts);
+    TsIndex *fromFile = file ? ts_index_build(file) : NULL;
+    if (file) {
+        fclose(file);
+    }
+
+    // the last frame in display order is frames - 1, time 0 is display frame 2
+    uint32_t duration = (frames - 1 - 2) * PTS_PER_FRAME / 90;
+    // a key frame every 24 frames (960 ms), all more than TS_INDEX_INTERVAL_MS apart
+    uint32_t count = (frames + GOP_FRAMES - 1) / GOP_FRAMES;
+    if (!index || ts_index_duration(index) != duration || ts_index_count(index) != count) {
+        fprintf(stderr, "index: %u points over %u ms, expected %u over %u ms\n",
+                index ? ts_index_count(index) : 0, index ? ts_index_duration(index) : 0,
+                count, duration);
+        ok = 0;
+    }
+    if (!fromFile || !index || ts_index_count(fromFile) != ts_index_count(index) ||
+        ts_index_duration(fromFile) != ts_index_duration(index)) {
+        fprintf(stderr, "index: built from a file differs from built from memory\n");
+        ok = 0;
+    }
+
+    // every lookup lands on the first packet of the last key frame at or before it
+    uint32_t timeMs;
+    for (timeMs = 0; ok && timeMs <= duration; timeMs += 37) {
+        uint32_t pointMs;
+        long offset = ts_index_lookup(index, timeMs, &pointMs);
+        uint32_t expectMs = timeMs / (GOP_FRAMES * 40) * (GOP_FRAMES * 40);
+        TsPacketInfo info;
+        if (pointMs != expectMs || offset < 0 || (size_t) offset >= ts.size ||
+            (offset > 0 && (!ts_parse_packet(ts.data + offset, &info) || info.pid != VIDEO_PID ||
+                            !info.randomAccess || !info.hasPts))) {
+            fprintf(stderr, "index: lookup of %u ms gave %u ms at offset %ld, expected %u ms\n",
+                    timeMs, pointMs, offset, expectMs);
+            ok = 0;
+        }
+    }
+
+    // saved and loaded for the same file size only
+    char path[256];
+    temp_path(path, sizeof(path), "check.idx");
+    TsIndex *loaded = NULL;
+    if (!index || !ts_index_save(index, path) ||
+        !(loaded = ts_index_load(path, ts.size)) ||
+        ts_index_count(loaded) != ts_index_count(index) ||
+        ts_index_duration(loaded) != ts_index_duration(index)) {
+        fprintf(stderr, "index: save and load failed\n");
+        ok = 0;
+    }
+    TsIndex *other = ts_index_load(path, ts.size + 188);
+    if (other) {
+        fprintf(stderr, "index: loaded for a file of another size\n");
+        ok = 0;
+    }
+    remove(path);
+
+    printf("%-28s %7u points %8u ms: %s\n", "open GOP index", index ? ts_index_count(index) : 0,
+           index ? ts_index_duration(index) : 0, ok ? "ok" : "FAILED");
+    ts_index_destroy(other);
+    ts_index_destroy(loaded);
+    ts_index_destroy(fromFile);
+    ts_index_destroy(index);
+    free(ts.data);
+    return ok;
+}
+
+static void bench_index(void)
+{
+    // 10 minutes at 1.5 Mbit/s
+    uint32_t frames = 10 * 60 * 25;
+    TsStream ts;
+    if (!make_stream(&ts, frames, 40, 0)) {
+        return;
+    }
+    double mb = ts.size / 1e6;
+    printf("stream: %.1f MB, %u frames\n", mb, frames);
+
+    FILE *file = write_temp_file(&ts);
+    if (file) {
+        double start = now_ms();
+        TsIndex *index = ts_index_build(file);
+        double ms = now_ms() - start;
+        printf("  build from file     %8.1f ms %8.0f MB/s\n", ms, mb / ms * 1e3);
+        ts_index_destroy(index);
+        fclose(file);
+    }
+
+    double start = now_ms();
+    TsIndex *index = ts_index_build_buffer(ts.data, ts.size);
+    double ms = now_ms() - start;
+    printf("  build from memory   %8.1f ms %8.0f MB/s\n", ms, mb / ms * 1e3);
+
+    char path[256];
+    temp_path(path, sizeof(path), "bench.idx");
+    if (index && ts_index_save(index, path)) {
+        int runs = 100, i;
+        start = now_ms();
+        for (i = 0; i < runs; i++) {
+            ts_index_destroy(ts_index_load(path, ts.size));
+        }
+        printf("  load saved index    %8.1f us (%u points)\n", (now_ms() - start) * 1e3 / runs,
+               ts_index_count(index));
+        remove(path);
+    }
+
+    uint32_t lookups = 1000000, i, duration = ts_index_duration(index);
+    volatile long sum = 0;
+    start = now_ms();
+    for (i = 0; duration && i < lookups; i++) {
+        sum += ts_index_lookup(index, (uint32_t) ((i * 7919ull) % duration), NULL);
+    }
+    printf("  lookup              %8.1f ns\n", (now_ms() - start) * 1e6 / lookups);
+    ts_index_destroy(index);
+    free(ts.data);
+}
+
+// a sample per cache line, so that the compiler can't drop the reads
+static uint64_t touch(const uint8_t *data, size_t size)
+{
+    uint64_t sum = 0;
+    size_t i;
+    for (i = 0; i < size; i += 64) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+static void bench_view(void)
+{
+    uint32_t frames = 10 * 60 * 25;
+    TsStream ts;
+    if (!make_stream(&ts, frames, 40, 0)) {
+        return;
+    }
+    char path[256];
+    temp_path(path, sizeof(path), "view.ts");
+    FILE *file = fopen(path, "wb");
+    size_t written = file ? fwrite(ts.data, 1, ts.size, file) : 0;
+    if (file) {
+        fclose(file);
+    }
+    free(ts.data);
+    if (written != ts.size) {
+        fprintf(stderr, "view: unable to write %s\n", path);
+        remove(path);
+        return;
+    }
+    double mb = ts.size / 1e6;
+    printf("file: %.1f MB (in the page cache)\n", mb);
+
+    int round;
+    for (round = 0; round < 3; round++) {
+        // read path: 64 KB freads into a buffer, as a parser working through stdio
+        static uint8_t buffer[64 * 1024];
+        uint64_t readSum = 0;
+        double start = now_ms();
+        file = fopen(path, "rb");
+        size_t bytes;
+        while (file && (bytes = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            readSum += touch(buffer, bytes);
+        }
+        if (file) {
+            fclose(file);
+        }
+        double readMs = now_ms() - start;
+
+        // view: the parser reads the mapped file in place
+        AndroidAssetView view;
+        uint64_t viewSum = 0;
+        start = now_ms();
+        if (android_asset_view_open(path, &view)) {
+            viewSum = touch(view.data, view.size);
+            android_asset_view_close(&view);
+        }
+        double viewMs = now_ms() - start;
+
+        // index build, both ways
+        start = now_ms();
+        file = fopen(path, "rb");
+        TsIndex *fromFile = file ? ts_index_build(file) : NULL;
+        if (file) {
+            fclose(file);
+        }
+        double indexReadMs = now_ms() - start;
+        start = now_ms();
+        TsIndex *fromView = NULL;
+        if (android_asset_view_open(path, &view)) {
+            fromView = ts_index_build_buffer(view.data, view.size);
+            android_asset_view_close(&view);
+        }
+        double indexViewMs = now_ms() - start;
+
+        printf("  read %6.0f MB/s, view %6.0f MB/s | index: read %6.0f MB/s, view %6.0f MB/s%s\n",
+               mb / readMs * 1e3, mb / viewMs * 1e3, mb / indexReadMs * 1e3,
+               mb / indexViewMs * 1e3,
+               readSum != viewSum || !fromFile || !fromView ||
+               ts_index_count(fromFile) != ts_index_count(fromView) ? " (MISMATCH)" : "");
+        ts_index_destroy(fromFile);
+        ts_index_destroy(fromView);
+    }
+    remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    const char *mode = argc > 1 ? argv[1] : NULL;
+    if (mode && strcmp(mode, "check") && strcmp(mode, "index") && strcmp(mode, "view")) {
+        fprintf(stderr, "usage: %s [check|index|view]\n", argv[0]);
+        return 2;
+    }
+
+    int ok = 1;
+    if (!mode || !strcmp(mode, "check")) {
+        ok = check_prefetch() && ok;
+        ok = check_index() && ok;
+        printf("check: %s\n", ok ? "ok" : "FAILED");
+    }
+    if (!mode || !strcmp(mode, "index")) {
+        bench_index();
+    }
+    if (!mode || !strcmp(mode, "view")) {
+        bench_view();
+    }
+    return ok ? 0 : 1;
+}
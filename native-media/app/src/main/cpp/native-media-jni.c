@@ -25,9 +25,12 @@
 
 #include <assert.h>
 #include <jni.h>
+#include <limits.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 // for __android_log_print(ANDROID_LOG_INFO, "YourApp", "formatted message");
 #include <android/log.h>
@@ -42,6 +45,9 @@
 #include <android/native_window_jni.h>
 #include <android/asset_manager_jni.h>
 #include "android_fopen.h"
+#include "android_asset_view.h"
+#include "ts_index.h"
+#include "ts_prefetch.h"
 
 // engine interfaces
 static XAObjectItf engineObject = NULL;
@@ -67,7 +73,7 @@ static ANativeWindow* theNativeWindow;
 #define NB_BUFFERS 8
 
 // we're streaming MPEG-2 transport stream data, operate on transport stream block size
-#define MPEG2_TS_PACKET_SIZE 188
+// (MPEG2_TS_PACKET_SIZE, from ts_index.h)
 
 // number of MPEG-2 transport stream blocks per buffer, an arbitrary number
 #define PACKETS_PER_BUFFER 10
@@ -75,31 +81,64 @@ static ANativeWindow* theNativeWindow;
 // determines how much memory we're dedicating to memory caching
 #define BUFFER_SIZE (PACKETS_PER_BUFFER*MPEG2_TS_PACKET_SIZE)
 
-// where we cache in memory the data to play
-// note this memory is re-used by the buffer queue callback
-static char dataCache[BUFFER_SIZE * NB_BUFFERS];
+// number of buffers kept read ahead of the player by the prefetch thread,
+// must be more than NB_BUFFERS
+#define PREFETCH_BUFFERS 256
+
+// largest number of buffers read from the file in one go
+#define PREFETCH_BLOCK_BUFFERS 32
 
 // handle of the file to play
 static FILE *file;
 
-// has the app reached the end of the file
-static jboolean reachedEof = JNI_FALSE;
+// where we cache in memory the data to play, filled by a reader thread;
+// note this memory is re-used by the buffer queue callback
+static TsPrefetch *prefetch = NULL;
+
+// random access points of the file, to seek without reading from the start;
+// published by the index thread once it is loaded or built, NULL until then
+static _Atomic(TsIndex *) tsIndex = NULL;
+
+// loads or builds the index in the background, so that starting to play never
+// waits for a scan of the whole file
+static pthread_t indexThread;
+static int indexThreadRunning = 0;
+static char indexFilename[PATH_MAX];
+static char indexCacheDir[PATH_MAX];
+
+// where the next discontinuity restarts playback from
+static long seekOffset = 0;
+
+// has the app reached the end of the file, written by the callback thread only
+static atomic_int reachedEof = 0;
 
 // constant to identify a buffer context which is the end of the stream to decode
 static const int kEosBufferCntxt = 1980; // a magic value we can compare against
 
-// For mutual exclusion between callback thread and application thread(s).
-// The mutex protects reachedEof, discontinuity,
-// The condition is signalled when a discontinuity is acknowledged.
+// Discontinuity (seek) requests from application thread(s) to the callback thread.
+// A request increments discontinuityRequests; the callback checks it without a lock,
+// and only then takes the mutex to read seekOffset. It restarts the stream with the
+// mutex released, then sets discontinuityDone under the mutex and signals the
+// condition. The mutex protects seekOffset and discontinuityDone; nothing waits on
+// the prefetch thread while holding it.
 
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 
-// whether a discontinuity is in progress
-static jboolean discontinuity = JNI_FALSE;
+static atomic_uint discontinuityRequests = 0;
+static unsigned discontinuityDone = 0;
 
 static jboolean enqueueInitialBuffers(jboolean discontinuity);
 
+static void logPrefetchStats(void)
+{
+    TsPrefetchStats stats;
+    ts_prefetch_get_stats(prefetch, &stats);
+    LOGV("Prefetch: %llu buffers, %llu bytes read, %u underruns, min %u buffers ready",
+            (unsigned long long) stats.buffersDelivered, (unsigned long long) stats.bytesRead,
+            stats.underruns, stats.minReady);
+}
+
 // AndroidBufferQueueItf callback to supply MPEG-2 TS packets to the media player
 static XAresult AndroidBufferQueueCallback(
         XAAndroidBufferQueueItf caller,
@@ -117,28 +156,40 @@ static XAresult AndroidBufferQueueCallback(
     // pCallbackContext was specified as NULL at RegisterCallback and is unused here
     assert(NULL == pCallbackContext);
 
-    // note there is never any contention on this mutex unless a discontinuity request is active
-    ok = pthread_mutex_lock(&mutex);
-    assert(0 == ok);
+    // was a discontinuity requested? (only ever read and acknowledged on this thread)
+    static unsigned discontinuitySeen = 0;
+    unsigned requests = atomic_load(&discontinuityRequests);
+    if (requests != discontinuitySeen) {
+        ok = pthread_mutex_lock(&mutex);
+        assert(0 == ok);
+        requests = atomic_load(&discontinuityRequests);
+        long offset = seekOffset;
+        ok = pthread_mutex_unlock(&mutex);
+        assert(0 == ok);
 
-    // was a discontinuity requested?
-    if (discontinuity) {
         // Note: can't rewind after EOS, which we send when reaching EOF
         // (don't send EOS if you plan to play more content through the same player)
-        if (!reachedEof) {
+        if (!atomic_load(&reachedEof)) {
             // clear the buffer queue
             res = (*playerBQItf)->Clear(playerBQItf);
             assert(XA_RESULT_SUCCESS == res);
-            // rewind the data source so we are guaranteed to be at an appropriate point
-            rewind(file);
+            // move the data source to the requested random access point, this also
+            // drops everything prefetched and hands all buffers back
+            ts_prefetch_reset(prefetch, offset);
             // Enqueue the initial buffers, with a discontinuity indicator on first buffer
             (void) enqueueInitialBuffers(JNI_TRUE);
         }
-        // acknowledge the discontinuity request
-        discontinuity = JNI_FALSE;
-        ok = pthread_cond_signal(&cond);
+
+        // acknowledge the discontinuity requests
+        discontinuitySeen = requests;
+        ok = pthread_mutex_lock(&mutex);
+        assert(0 == ok);
+        discontinuityDone = requests;
+        ok = pthread_cond_broadcast(&cond);
         assert(0 == ok);
-        goto exit;
+        ok = pthread_mutex_unlock(&mutex);
+        assert(0 == ok);
+        return XA_RESULT_SUCCESS;
     }
 
     if ((pBufferData == NULL) && (pBufferContext != NULL)) {
@@ -147,32 +198,30 @@ static XAresult AndroidBufferQueueCallback(
             LOGV("EOS was processed\n");
             // our buffer with the EOS message has been consumed
             assert(0 == dataSize);
-            goto exit;
+            return XA_RESULT_SUCCESS;
         }
     }
 
     // pBufferData is a pointer to a buffer that we previously Enqueued
     assert((dataSize > 0) && ((dataSize % MPEG2_TS_PACKET_SIZE) == 0));
-    assert(dataCache <= (char *) pBufferData && (char *) pBufferData <
-            &dataCache[BUFFER_SIZE * NB_BUFFERS]);
-    assert(0 == (((char *) pBufferData - dataCache) % BUFFER_SIZE));
+    assert(ts_prefetch_owns(prefetch, (char *) pBufferData));
+
+    // the player is done with this buffer, the reader thread may refill it
+    ts_prefetch_release(prefetch, (char *) pBufferData);
 
     // don't bother trying to read more data once we've hit EOF
-    if (reachedEof) {
-        goto exit;
+    if (atomic_load(&reachedEof)) {
+        return XA_RESULT_SUCCESS;
     }
 
-    // note we do call fread from multiple threads, but never concurrently
-    size_t bytesRead;
-    bytesRead = fread(pBufferData, 1, BUFFER_SIZE, file);
-    if (bytesRead > 0) {
-        if ((bytesRead % MPEG2_TS_PACKET_SIZE) != 0) {
-            LOGV("Dropping last packet because it is not whole");
-        }
-        size_t packetsRead = bytesRead / MPEG2_TS_PACKET_SIZE;
-        size_t bufferSize = packetsRead * MPEG2_TS_PACKET_SIZE;
+    // hand the next prefetched buffer to the player; this only waits when the
+    // reader thread has fallen behind (counted as an underrun)
+    char *buffer;
+    uint32_t bufferSize;
+    buffer = ts_prefetch_take(prefetch, &bufferSize);
+    if (buffer != NULL) {
         res = (*caller)->Enqueue(caller, NULL /*pBufferContext*/,
-                pBufferData /*pData*/,
+                buffer /*pData*/,
                 bufferSize /*dataLength*/,
                 NULL /*pMsg*/,
                 0 /*msgLength*/);
@@ -189,12 +238,17 @@ static XAresult AndroidBufferQueueCallback(
                 msgEos /*pMsg*/,
                 sizeof(XAuint32)*2 /*msgLength*/);
         assert(XA_RESULT_SUCCESS == res);
-        reachedEof = JNI_TRUE;
+        // a seek can no longer be handled, wake up any thread waiting for one
+        ok = pthread_mutex_lock(&mutex);
+        assert(0 == ok);
+        atomic_store(&reachedEof, 1);
+        ok = pthread_cond_broadcast(&cond);
+        assert(0 == ok);
+        ok = pthread_mutex_unlock(&mutex);
+        assert(0 == ok);
+        logPrefetchStats();
     }
 
-exit:
-    ok = pthread_mutex_unlock(&mutex);
-    assert(0 == ok);
     return XA_RESULT_SUCCESS;
 }
 
@@ -274,33 +328,17 @@ void Java_com_example_nativemedia_NativeMedia_createEngine(JNIEnv* env, jclass c
 static jboolean enqueueInitialBuffers(jboolean discontinuity)
 {
 
-    /* Fill our cache.
-     * We want to read whole packets (integral multiples of MPEG2_TS_PACKET_SIZE).
-     * fread returns units of "elements" not bytes, so we ask for 1-byte elements
-     * and then check that the number of elements is a multiple of the packet size.
+    /* The prefetch thread fills our cache with whole packets (integral multiples of
+     * MPEG2_TS_PACKET_SIZE); take the first buffers from it as they become ready.
      */
-    size_t bytesRead;
-    bytesRead = fread(dataCache, 1, BUFFER_SIZE * NB_BUFFERS, file);
-    if (bytesRead <= 0) {
-        // could be premature EOF or I/O error
-        return JNI_FALSE;
-    }
-    if ((bytesRead % MPEG2_TS_PACKET_SIZE) != 0) {
-        LOGV("Dropping last packet because it is not whole");
-    }
-    size_t packetsRead = bytesRead / MPEG2_TS_PACKET_SIZE;
-    LOGV("Initially queueing %zu packets", packetsRead);
-
-    /* Enqueue the content of our cache before starting to play,
-       we don't want to starve the player */
     size_t i;
-    for (i = 0; i < NB_BUFFERS && packetsRead > 0; i++) {
-        // compute size of this buffer
-        size_t packetsThisBuffer = packetsRead;
-        if (packetsThisBuffer > PACKETS_PER_BUFFER) {
-            packetsThisBuffer = PACKETS_PER_BUFFER;
+    for (i = 0; i < NB_BUFFERS; i++) {
+        char *buffer;
+        uint32_t bufferSize;
+        buffer = ts_prefetch_take(prefetch, &bufferSize);
+        if (buffer == NULL) {
+            break;
         }
-        size_t bufferSize = packetsThisBuffer * MPEG2_TS_PACKET_SIZE;
         XAresult res;
         if (discontinuity) {
             // signal discontinuity
@@ -311,24 +349,92 @@ static jboolean enqueueInitialBuffers(jboolean discontinuity)
             //   so the total size of the message is the size of the key
             //   plus the size if itemSize, both XAuint32
             res = (*playerBQItf)->Enqueue(playerBQItf, NULL /*pBufferContext*/,
-                    dataCache + i*BUFFER_SIZE, bufferSize, items /*pMsg*/,
+                    buffer, bufferSize, items /*pMsg*/,
                     sizeof(XAuint32)*2 /*msgLength*/);
             discontinuity = JNI_FALSE;
         } else {
             res = (*playerBQItf)->Enqueue(playerBQItf, NULL /*pBufferContext*/,
-                    dataCache + i*BUFFER_SIZE, bufferSize, NULL, 0);
+                    buffer, bufferSize, NULL, 0);
         }
         assert(XA_RESULT_SUCCESS == res);
-        packetsRead -= packetsThisBuffer;
     }
+    if (i == 0) {
+        // could be premature EOF or I/O error
+        return JNI_FALSE;
+    }
+    LOGV("Initially queued %zu buffers", i);
 
     return JNI_TRUE;
 }
 
 
+// load the saved index of the file to play, or build it with one pass over the file
+// and save it in cacheDir for the next run
+static TsIndex *openIndex(const char *filename, const char *cacheDir)
+{
+    // parse the asset in place when it can be viewed without copying,
+    // otherwise read it through stdio
+    AndroidAssetView view;
+    FILE *scanFile = NULL;
+    long fileSize = 0;
+    if (android_asset_view_open(filename, &view)) {
+        fileSize = (long) view.size;
+    } else {
+        scanFile = android_fopen(filename, "rb");
+        if (scanFile == NULL) {
+            return NULL;
+        }
+        if (fseek(scanFile, 0, SEEK_END) == 0) {
+            fileSize = ftell(scanFile);
+        }
+    }
+
+    // the file itself is a read-only asset, its index goes next to it in the cache
+    char path[PATH_MAX];
+    const char *name = strrchr(filename, '/');
+    snprintf(path, sizeof(path), "%s/%s.idx", cacheDir, name ? name + 1 : filename);
+
+    TsIndex *index = ts_index_load(path, (uint64_t) fileSize);
+    if (index == NULL) {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        index = scanFile ? ts_index_build(scanFile) :
+                ts_index_build_buffer(view.data, view.size);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (index != NULL) {
+            LOGV("Indexed %ld bytes in %.1f ms (%.1f MB/s)", fileSize, seconds * 1e3,
+                    seconds > 0 ? fileSize / seconds / 1e6 : 0.0);
+            if (!ts_index_save(index, path)) {
+                LOGV("Unable to save index to %s", path);
+            }
+        }
+    }
+    if (index != NULL) {
+        LOGV("Index has %u random access points over %u ms",
+                ts_index_count(index), ts_index_duration(index));
+    }
+    if (scanFile != NULL) {
+        fclose(scanFile);
+    } else {
+        android_asset_view_close(&view);
+    }
+    return index;
+}
+
+
+// the index thread, reads the file through its own handle
+static void *indexThreadMain(void *arg)
+{
+    (void) arg;
+    atomic_store(&tsIndex, openIndex(indexFilename, indexCacheDir));
+    return NULL;
+}
+
+
 // create streaming media player
 jboolean Java_com_example_nativemedia_NativeMedia_createStreamingMediaPlayer(JNIEnv* env,
-        jclass clazz, jobject assetMgr, jstring filename)
+        jclass clazz, jobject assetMgr, jstring filename, jstring cacheDir)
 {
     XAresult res;
 
@@ -343,6 +449,22 @@ jboolean Java_com_example_nativemedia_NativeMedia_createStreamingMediaPlayer(JNI
         return JNI_FALSE;
     }
 
+    // index the file while it plays, seeking is possible once that is done
+    const char *cacheDirUtf8 = (*env)->GetStringUTFChars(env, cacheDir, NULL);
+    assert(NULL != cacheDirUtf8);
+    snprintf(indexFilename, sizeof(indexFilename), "%s", utf8);
+    snprintf(indexCacheDir, sizeof(indexCacheDir), "%s", cacheDirUtf8);
+    (*env)->ReleaseStringUTFChars(env, cacheDir, cacheDirUtf8);
+    indexThreadRunning = (pthread_create(&indexThread, NULL, indexThreadMain, NULL) == 0);
+
+    // start reading ahead while the player is being set up
+    prefetch = ts_prefetch_create(file, BUFFER_SIZE, PREFETCH_BUFFERS, PREFETCH_BLOCK_BUFFERS);
+    if (prefetch == NULL) {
+        fclose(file);
+        file = NULL;
+        return JNI_FALSE;
+    }
+
     // configure data source
     XADataLocator_AndroidBufferQueue loc_abq = { XA_DATALOCATOR_ANDROIDBUFFERQUEUE, NB_BUFFERS };
     XADataFormat_MIME format_mime = {
@@ -480,6 +602,20 @@ void Java_com_example_nativemedia_NativeMedia_shutdown(JNIEnv* env, jclass clazz
         engineEngine = NULL;
     }
 
+    // stop the reader thread, the player no longer holds any of its buffers
+    if (prefetch != NULL) {
+        logPrefetchStats();
+        ts_prefetch_destroy(prefetch);
+        prefetch = NULL;
+    }
+
+    // a scan in progress runs to its end, it can't be interrupted
+    if (indexThreadRunning) {
+        pthread_join(indexThread, NULL);
+        indexThreadRunning = 0;
+    }
+    ts_index_destroy(atomic_exchange(&tsIndex, NULL));
+
     // close the file
     if (file != NULL) {
         fclose(file);
@@ -502,34 +638,50 @@ void Java_com_example_nativemedia_NativeMedia_setSurface(JNIEnv *env, jclass cla
 }
 
 
-// rewind the streaming media player
-void Java_com_example_nativemedia_NativeMedia_rewindStreamingMediaPlayer(JNIEnv *env, jclass clazz)
+// restart the streaming media player at the random access point at or before timeMs
+static void seekStreamingMediaPlayer(uint32_t timeMs)
 {
     XAresult res;
     XAuint32  state;
+    int ok;
 
     if (!playerPlayItf) {
         return;
     }
+    TsIndex *index = atomic_load(&tsIndex);
+    if (index == NULL && timeMs > 0) {
+        LOGV("Seek to %u ms ignored, the stream is not indexed yet", timeMs);
+        return;
+    }
+    uint32_t pointMs;
+    long offset = ts_index_lookup(index, timeMs, &pointMs);
+    LOGV("Seek to %u ms starts at %u ms, offset %ld", timeMs, pointMs, offset);
+
     res = (*playerPlayItf)->GetPlayState(playerPlayItf, &state);
     assert(XA_RESULT_SUCCESS == res);
 
     if(state == XA_PLAYSTATE_PAUSED || state == XA_PLAYSTATE_STOPPED) {
-        discontinuity = JNI_TRUE;
+        ok = pthread_mutex_lock(&mutex);
+        assert(0 == ok);
+        seekOffset = offset;
+        atomic_fetch_add(&discontinuityRequests, 1);
+        ok = pthread_mutex_unlock(&mutex);
+        assert(0 == ok);
         return;
     }
 
     // make sure the streaming media player was created
     if (NULL != playerBQItf && NULL != file) {
         // first wait for buffers currently in queue to be drained
-        int ok;
         ok = pthread_mutex_lock(&mutex);
         assert(0 == ok);
-        discontinuity = JNI_TRUE;
-        // wait for discontinuity request to be observed by buffer queue callback
+        seekOffset = offset;
+        unsigned request = atomic_fetch_add(&discontinuityRequests, 1) + 1;
+        // wait for discontinuity request to be handled by buffer queue callback; the
+        // callback does not hold the mutex while it restarts the stream
         // Note: can't rewind after EOS, which we send when reaching EOF
         // (don't send EOS if you plan to play more content through the same player)
-        while (discontinuity && !reachedEof) {
+        while ((int)(request - discontinuityDone) > 0 && !atomic_load(&reachedEof)) {
             ok = pthread_cond_wait(&cond, &mutex);
             assert(0 == ok);
         }
@@ -538,3 +690,27 @@ void Java_com_example_nativemedia_NativeMedia_rewindStreamingMediaPlayer(JNIEnv
     }
 
 }
+
+
+// rewind the streaming media player
+void Java_com_example_nativemedia_NativeMedia_rewindStreamingMediaPlayer(JNIEnv *env, jclass clazz)
+{
+    seekStreamingMediaPlayer(0);
+}
+
+
+// seek the streaming media player, in milliseconds from the start of the stream
+void Java_com_example_nativemedia_NativeMedia_seekStreamingMediaPlayer(JNIEnv *env, jclass clazz,
+        jint timeMs)
+{
+    seekStreamingMediaPlayer(timeMs > 0 ? (uint32_t) timeMs : 0);
+}
+
+
+// duration of the stream in milliseconds, 0 until it is indexed
+jint Java_com_example_nativemedia_NativeMedia_getDurationStreamingMediaPlayer(JNIEnv *env,
+        jclass clazz)
+{
+    TsIndex *index = atomic_load(&tsIndex);
+    return index != NULL ? (jint) ts_index_duration(index) : 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_index.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TS_SYNC_BYTE 0x47
+#define PAT_PID 0
+#define PTS_MASK ((1ULL << 33) - 1)
+
+// packets read per fread while scanning
+#define SCAN_BLOCK_PACKETS 512
+
+#define INDEX_MAGIC "TSIX"
+#define INDEX_VERSION 2
+
+typedef struct {
+    uint32_t timeMs;
+    uint32_t packet;        // offset in TS packets, keeps entries 8 bytes
+} TsIndexEntry;
+
+struct TsIndex {
+    TsIndexEntry *entries;
+    uint32_t count, capacity;
+    uint32_t durationMs;
+    uint64_t fileSize;
+};
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t fileSize;
+    uint32_t count;
+    uint32_t durationMs;
+} TsIndexHeader;
+
+int ts_parse_packet(const uint8_t *packet, TsPacketInfo *info) {
+    if (packet[0] != TS_SYNC_BYTE || (packet[1] & 0x80)) {
+        return 0;
+    }
+    memset(info, 0, sizeof(*info));
+    info->payloadStart = (packet[1] >> 6) & 1;
+    info->pid = (uint16_t)(((packet[1] & 0x1f) << 8) | packet[2]);
+
+    uint32_t adaptationControl = (packet[3] >> 4) & 3;
+    if (adaptationControl == 0) {
+        return 0;   // reserved
+    }
+    uint32_t pos = 4;
+    if (adaptationControl & 2) {
+        uint32_t length = packet[4];
+        pos = 5 + length;
+        if (pos > MPEG2_TS_PACKET_SIZE) {
+            return 0;
+        }
+        if (length > 0) {
+            info->randomAccess = (packet[5] >> 6) & 1;
+            if ((packet[5] & 0x10) && length >= 7) {
+                uint64_t base = ((uint64_t)packet[6] << 25) | ((uint64_t)packet[7] << 17) |
+                                ((uint64_t)packet[8] << 9) | ((uint64_t)packet[9] << 1) |
+                                (packet[10] >> 7);
+                uint32_t extension = ((packet[10] & 1) << 8) | packet[11];
+                info->pcr = base * 300 + extension;
+                info->hasPcr = 1;
+            }
+        }
+    }
+
+    if ((adaptationControl & 1) && pos < MPEG2_TS_PACKET_SIZE) {
+        const uint8_t *p = packet + pos;
+        info->payload = p;
+        info->payloadSize = MPEG2_TS_PACKET_SIZE - pos;
+        // PES header with PTS: start code, '10' marker bits, PTS_DTS_flags
+        if (info->payloadStart && info->payloadSize >= 14 &&
+            p[0] == 0 && p[1] == 0 && p[2] == 1 && (p[6] & 0xc0) == 0x80 && (p[7] & 0x80)) {
+            info->pts = ((uint64_t)((p[9] >> 1) & 7) << 30) | ((uint64_t)p[10] << 22) |
+                        ((uint64_t)(p[11] >> 1) << 15) | ((uint64_t)p[12] << 7) | (p[13] >> 1);
+            info->hasPts = 1;
+        }
+    }
+    return 1;
+}
+
+// start of the PSI section in a payload, NULL if it does not fit
+static const uint8_t* section_start(const TsPacketInfo *info, uint8_t tableId,
+                                    uint32_t *sectionEnd) {
+    uint32_t start = 1 + info->payload[0];  // pointer_field
+    if (start + 3 > info->payloadSize || info->payload[start] != tableId) {
+        return NULL;
+    }
+    const uint8_t *section = info->payload + start;
+    uint32_t length = ((section[1] & 0x0f) << 8) | section[2];
+    // sections spanning packets are not supported, they do not happen for
+    // the single program streams this sample plays
+    if (length < 4 || start + 3 + length > info->payloadSize) {
+        return NULL;
+    }
+    *sectionEnd = 3 + length - 4;   // without CRC_32
+    return section;
+}
+
+// PMT PID of the first program in the PAT, -1 if none
+static int parse_pat(const TsPacketInfo *info) {
+    uint32_t end;
+    const uint8_t *section = section_start(info, 0x00, &end);
+    if (!section) {
+        return -1;
+    }
+    uint32_t i;
+    for (i = 8; i + 4 <= end; i += 4) {
+        uint32_t program = (section[i] << 8) | section[i + 1];
+        if (program != 0) {     // 0 is the network PID
+            return ((section[i + 2] & 0x1f) << 8) | section[i + 3];
+        }
+    }
+    return -1;
+}
+
+static int is_video_stream(uint8_t streamType) {
+    switch (streamType) {
+        case 0x01:  // MPEG-1 video
+        case 0x02:  // MPEG-2 video
+        case 0x10:  // MPEG-4 part 2
+        case 0x1b:  // H.264
+        case 0x24:  // H.265
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// PID of the first video elementary stream in the PMT, -1 if none
+static int parse_pmt(const TsPacketInfo *info, uint8_t *streamType) {
+    uint32_t end;
+    const uint8_t *section = section_start(info, 0x02, &end);
+    if (!section || end < 12) {
+        return -1;
+    }
+    uint32_t i = 12 + (((section[10] & 0x0f) << 8) | section[11]);
+    while (i + 5 <= end) {
+        if (is_video_stream(section[i])) {
+            *streamType = section[i];
+            return ((section[i + 1] & 0x1f) << 8) | section[i + 2];
+        }
+        i += 5 + (((section[i + 3] & 0x0f) << 8) | section[i + 4]);
+    }
+    return -1;
+}
+
+/* For streams that do not set random_access_indicator: look for a key frame
+ * (or the parameter sets that precede one) in the first packet of a PES.
+ */
+static int starts_key_frame(const TsPacketInfo *info, uint8_t streamType) {
+    const uint8_t *p = info->payload;
+    uint32_t size = info->payloadSize;
+    uint32_t i = 9 + p[8];  // skip the PES header
+    for (; i + 3 < size; i++) {
+        if (p[i] != 0 || p[i + 1] != 0 || p[i + 2] != 1) {
+            continue;
+        }
+        uint8_t code = p[i + 3];
+        switch (streamType) {
+            case 0x01:
+            case 0x02:
+                if (code == 0xb3 || code == 0xb8) {     // sequence or GOP header
+                    return 1;
+                }
+                break;
+            case 0x1b:
+                if ((code & 0x1f) == 5 || (code & 0x1f) == 7) {     // IDR or SPS
+                    return 1;
+                }
+                break;
+            case 0x24: {
+                uint8_t type = (code >> 1) & 0x3f;
+                if ((type >= 16 && type <= 21) || type == 32) {     // IRAP or VPS
+                    return 1;
+                }
+            } break;
+            default:
+                return 0;
+        }
+    }
+    return 0;
+}
+
+static int add_entry(TsIndex *index, uint32_t timeMs, uint32_t packet) {
+    if (index->count > 0 &&
+        timeMs < index->entries[index->count - 1].timeMs + TS_INDEX_INTERVAL_MS) {
+        return 1;
+    }
+    if (index->count == index->capacity) {
+        uint32_t capacity = index->capacity ? index->capacity * 2 : 64;
+        TsIndexEntry *entries = realloc(index->entries, capacity * sizeof(TsIndexEntry));
+        if (!entries) {
+            return 0;
+        }
+        index->entries = entries;
+        index->capacity = capacity;
+    }
+    index->entries[index->count].timeMs = timeMs;
+    index->entries[index->count].packet = packet;
+    index->count++;
+    return 1;
+}
+
+// state of the sequential scan, carried across blocks
+typedef struct {
+    int pmtPid, videoPid;
+    uint8_t streamType;
+    int havePts;
+    uint64_t firstPts;
+    uint32_t packet;
+} TsIndexScan;
+
+static int scan_packets(TsIndex *index, TsIndexScan *scan, const uint8_t *data, size_t packets) {
+    size_t i;
+    for (i = 0; i < packets; i++, scan->packet++) {
+        TsPacketInfo info;
+        if (!ts_parse_packet(data + i * MPEG2_TS_PACKET_SIZE, &info) ||
+            !info.payload || !info.payloadStart) {
+            continue;
+        }
+        if (info.pid == PAT_PID) {
+            if (scan->pmtPid < 0) {
+                scan->pmtPid = parse_pat(&info);
+            }
+        } else if (info.pid == scan->pmtPid) {
+            if (scan->videoPid < 0) {
+                scan->videoPid = parse_pmt(&info, &scan->streamType);
+            }
+        } else if (info.pid == scan->videoPid && info.hasPts) {
+            if (!scan->havePts) {
+                scan->firstPts = info.pts;
+                scan->havePts = 1;
+            }
+            // signed 33-bit difference, so that a PTS wrap still counts forward
+            int64_t delta = (int64_t)((info.pts - scan->firstPts) & PTS_MASK);
+            if (delta > (int64_t)(PTS_MASK >> 1)) {
+                delta -= (int64_t)PTS_MASK + 1;
+            }
+            if (delta < 0) {
+                // before the first PTS, e.g. the leading B-frames of an open GOP
+                continue;
+            }
+            uint32_t timeMs = (uint32_t)(delta / 90);
+            if (timeMs > index->durationMs) {
+                index->durationMs = timeMs;
+            }
+            if ((info.randomAccess || starts_key_frame(&info, scan->streamType)) &&
+                !add_entry(index, timeMs, scan->packet)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static TsIndex* create_index(TsIndexScan *scan) {
+    memset(scan, 0, sizeof(*scan));
+    scan->pmtPid = -1;
+    scan->videoPid = -1;
+    return calloc(1, sizeof(TsIndex));
+}
+
+TsIndex* ts_index_build(FILE *file) {
+    TsIndexScan scan;
+    TsIndex *index = create_index(&scan);
+    uint8_t *block = malloc(SCAN_BLOCK_PACKETS * MPEG2_TS_PACKET_SIZE);
+    if (!index || !block || fseek(file, 0, SEEK_SET) != 0) {
+        free(block);
+        free(index);
+        return NULL;
+    }
+
+    size_t bytes;
+    while ((bytes = fread(block, 1, SCAN_BLOCK_PACKETS * MPEG2_TS_PACKET_SIZE, file)) > 0) {
+        index->fileSize += bytes;
+        if (!scan_packets(index, &scan, block, bytes / MPEG2_TS_PACKET_SIZE)) {
+            ts_index_destroy(index);
+            index = NULL;
+            break;
+        }
+        if (bytes < SCAN_BLOCK_PACKETS * MPEG2_TS_PACKET_SIZE) {
+            break;
+        }
+    }
+    free(block);
+    return index;
+}
+
+TsIndex* ts_index_build_buffer(const void *data, size_t size) {
+    TsIndexScan scan;
+    TsIndex *index = create_index(&scan);
+    if (!index) {
+        return NULL;
+    }
+    index->fileSize = size;
+    if (!scan_packets(index, &scan, data, size / MPEG2_TS_PACKET_SIZE)) {
+        ts_index_destroy(index);
+        return NULL;
+    }
+    return index;
+}
+
+TsIndex* ts_index_load(const char *path, uint64_t fileSize) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    TsIndexHeader header;
+    TsIndex *index = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        !memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) &&
+        header.version == INDEX_VERSION && header.fileSize == fileSize) {
+        index = calloc(1, sizeof(TsIndex));
+        if (index) {
+            index->entries = malloc((header.count ? header.count : 1) * sizeof(TsIndexEntry));
+            if (index->entries &&
+                fread(index->entries, sizeof(TsIndexEntry), header.count, file) == header.count) {
+                index->count = index->capacity = header.count;
+                index->durationMs = header.durationMs;
+                index->fileSize = header.fileSize;
+            } else {
+                ts_index_destroy(index);
+                index = NULL;
+            }
+        }
+    }
+    fclose(file);
+    return index;
+}
+
+int ts_index_save(const TsIndex *index, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    TsIndexHeader header;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.fileSize = index->fileSize;
+    header.count = index->count;
+    header.durationMs = index->durationMs;
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(index->entries, sizeof(TsIndexEntry), index->count, file) == index->count;
+    if (fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        remove(path);
+    }
+    return ok;
+}
+
+void ts_index_destroy(TsIndex *index) {
+    if (index) {
+        free(index->entries);
+        free(index);
+    }
+}
+
+long ts_index_lookup(const TsIndex *index, uint32_t timeMs, uint32_t *pointMs) {
+    if (pointMs) {
+        *pointMs = 0;
+    }
+    if (!index || !index->count || timeMs < index->entries[0].timeMs) {
+        return 0;
+    }
+    // last entry with entries[i].timeMs <= timeMs
+    uint32_t low = 0, high = index->count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (index->entries[mid].timeMs <= timeMs) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    if (!low) {
+        // rewind: play from byte 0, not from the first video key frame
+        return 0;
+    }
+    if (pointMs) {
+        *pointMs = index->entries[low].timeMs;
+    }
+    return (long)index->entries[low].packet * MPEG2_TS_PACKET_SIZE;
+}
+
+uint32_t ts_index_count(const TsIndex *index) {
+    return index ? index->count : 0;
+}
+
+uint32_t ts_index_duration(const TsIndex *index) {
+    return index ? index->durationMs : 0;
+}
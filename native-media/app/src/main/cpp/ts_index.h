@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TS_INDEX_H
+#define TS_INDEX_H
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MPEG2_TS_PACKET_SIZE 188
+
+/* One parsed MPEG-2 transport stream packet (ISO/IEC 13818-1) */
+typedef struct {
+    uint16_t pid;
+    uint8_t payloadStart;   // payload_unit_start_indicator
+    uint8_t randomAccess;   // adaptation field random_access_indicator
+    uint8_t hasPcr;
+    uint8_t hasPts;         // set when a PES header with a PTS starts here
+    uint64_t pcr;           // 27 MHz
+    uint64_t pts;           // 90 kHz
+    const uint8_t *payload; // NULL when the packet carries no payload
+    uint32_t payloadSize;
+} TsPacketInfo;
+
+/* returns 0 if the packet is not a valid TS packet (bad sync byte,
+   transport error, malformed adaptation field) */
+int ts_parse_packet(const uint8_t *packet, TsPacketInfo *info);
+
+/* Time to byte offset index of the random access points of the first video
+ * stream, built in one sequential scan of the file. Entries are at least
+ * TS_INDEX_INTERVAL_MS apart, and times are relative to the first PTS.
+ */
+#define TS_INDEX_INTERVAL_MS 500
+
+typedef struct TsIndex TsIndex;
+
+/* scan the whole file */
+TsIndex* ts_index_build(FILE *file);
+
+/* scan a file that is already in memory (see android_asset_view.h) */
+TsIndex* ts_index_build_buffer(const void *data, size_t size);
+
+/* the index saved for a file of fileSize bytes, NULL if there is none */
+TsIndex* ts_index_load(const char *path, uint64_t fileSize);
+int ts_index_save(const TsIndex *index, const char *path);
+void ts_index_destroy(TsIndex *index);
+
+/* byte offset of the last random access point at or before timeMs; 0 (the
+   start of the file, with its PAT/PMT and any leading audio) when that is
+   the first point or there is none. *pointMs (may be NULL) receives the time
+   of that point, 0 from the start of the file */
+long ts_index_lookup(const TsIndex *index, uint32_t timeMs, uint32_t *pointMs);
+
+uint32_t ts_index_count(const TsIndex *index);
+uint32_t ts_index_duration(const TsIndex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
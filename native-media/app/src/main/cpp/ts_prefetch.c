@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ts_prefetch.h"
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#ifdef __ANDROID__
+#include <android/log.h>
+#define TAG "NativeMedia"
+#define LOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, TAG, __VA_ARGS__)
+#else
+#define LOGV(...) ((void)0)
+#endif
+
+#define MPEG2_TS_PACKET_SIZE 188
+
+/* Buffer i of the ring is (i % bufferCount); the three counters only grow:
+ *   released <= taken <= filled <= released + bufferCount
+ * filled is written by the reader thread only, taken and released by the
+ * consumer only. freeSem counts buffers the reader may fill, filledSem
+ * buffers the consumer may take (plus one extra post at end of stream).
+ */
+struct TsPrefetch {
+    FILE* file;
+    char* data;
+    uint32_t* sizes;
+    uint32_t bufferSize, bufferCount, blockBuffers;
+
+    atomic_uint filled;
+    atomic_uint taken;
+    atomic_uint released;
+    atomic_int eof;
+    atomic_int stop;
+    sem_t freeSem, filledSem;
+    pthread_t reader;
+    int readerRunning;
+
+    atomic_ullong bytesRead;
+    uint64_t buffersDelivered;
+    uint32_t underruns, minReady;
+};
+
+static void wait_sem(sem_t* sem) {
+    while (sem_wait(sem) != 0 && errno == EINTR) {
+    }
+}
+
+static void* reader_thread(void* arg) {
+    TsPrefetch* p = (TsPrefetch*)arg;
+    for (;;) {
+        wait_sem(&p->freeSem);
+        if (atomic_load(&p->stop)) {
+            break;
+        }
+        // grab as many free buffers as are contiguous in memory, up to a block
+        uint32_t start = atomic_load(&p->filled) % p->bufferCount;
+        uint32_t count = 1;
+        while (count < p->blockBuffers && start + count < p->bufferCount &&
+               sem_trywait(&p->freeSem) == 0) {
+            count++;
+        }
+
+        size_t bytes = fread(p->data + (size_t)start * p->bufferSize, 1,
+                             (size_t)count * p->bufferSize, p->file);
+        uint32_t full = (uint32_t)(bytes / p->bufferSize);
+        uint32_t rest = (uint32_t)(bytes % p->bufferSize);
+        if (rest % MPEG2_TS_PACKET_SIZE) {
+            LOGV("Dropping last packet because it is not whole");
+        }
+        rest -= rest % MPEG2_TS_PACKET_SIZE;
+
+        uint32_t i;
+        for (i = 0; i < full; i++) {
+            p->sizes[start + i] = p->bufferSize;
+        }
+        uint32_t produced = full;
+        if (rest) {
+            p->sizes[start + full] = rest;
+            produced++;
+        }
+        atomic_fetch_add(&p->bytesRead, bytes);
+        atomic_fetch_add(&p->filled, produced);
+        for (i = 0; i < produced; i++) {
+            sem_post(&p->filledSem);
+        }
+
+        if (bytes < (size_t)count * p->bufferSize) {
+            // EOF or I/O error: wake up a consumer waiting for more
+            atomic_store(&p->eof, 1);
+            sem_post(&p->filledSem);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void start_reader(TsPrefetch* p) {
+    atomic_store(&p->filled, 0);
+    atomic_store(&p->taken, 0);
+    atomic_store(&p->released, 0);
+    atomic_store(&p->eof, 0);
+    atomic_store(&p->stop, 0);
+    sem_init(&p->freeSem, 0, p->bufferCount);
+    sem_init(&p->filledSem, 0, 0);
+    p->readerRunning = (pthread_create(&p->reader, NULL, reader_thread, p) == 0);
+    assert(p->readerRunning);
+}
+
+static void stop_reader(TsPrefetch* p) {
+    if (p->readerRunning) {
+        atomic_store(&p->stop, 1);
+        sem_post(&p->freeSem);
+        pthread_join(p->reader, NULL);
+        p->readerRunning = 0;
+    }
+    sem_destroy(&p->freeSem);
+    sem_destroy(&p->filledSem);
+}
+
+TsPrefetch* ts_prefetch_create(FILE* file, uint32_t bufferSize,
+                               uint32_t bufferCount, uint32_t blockBuffers) {
+    if (!file || !bufferCount || !bufferSize ||
+        (bufferSize % MPEG2_TS_PACKET_SIZE) != 0) {
+        return NULL;
+    }
+    TsPrefetch* p = (TsPrefetch*)calloc(1, sizeof(TsPrefetch));
+    if (!p) {
+        return NULL;
+    }
+    p->file = file;
+    p->bufferSize = bufferSize;
+    p->bufferCount = bufferCount;
+    p->blockBuffers = blockBuffers ? blockBuffers : 1;
+    p->data = (char*)malloc((size_t)bufferSize * bufferCount);
+    p->sizes = (uint32_t*)calloc(bufferCount, sizeof(uint32_t));
+    if (!p->data || !p->sizes) {
+        free(p->data);
+        free(p->sizes);
+        free(p);
+        return NULL;
+    }
+    p->minReady = bufferCount;
+    start_reader(p);
+    return p;
+}
+
+void ts_prefetch_destroy(TsPrefetch* p) {
+    if (!p) {
+        return;
+    }
+    stop_reader(p);
+    free(p->data);
+    free(p->sizes);
+    free(p);
+}
+
+char* ts_prefetch_take(TsPrefetch* p, uint32_t* size) {
+    uint32_t taken = atomic_load(&p->taken);
+    uint32_t ready = atomic_load(&p->filled) - taken;
+    if (!ready) {
+        if (atomic_load(&p->eof) && atomic_load(&p->filled) == taken) {
+            return NULL;
+        }
+        p->underruns++;
+    }
+    if (ready < p->minReady) {
+        p->minReady = ready;
+    }
+
+    wait_sem(&p->filledSem);
+    if (atomic_load(&p->filled) == taken) {
+        // the extra post of end of stream
+        return NULL;
+    }
+    uint32_t index = taken % p->bufferCount;
+    atomic_store(&p->taken, taken + 1);
+    p->buffersDelivered++;
+    *size = p->sizes[index];
+    return p->data + (size_t)index * p->bufferSize;
+}
+
+void ts_prefetch_release(TsPrefetch* p, const char* buffer) {
+    uint32_t released = atomic_load(&p->released);
+    assert(released != atomic_load(&p->taken));
+    assert(buffer == p->data + (size_t)(released % p->bufferCount) * p->bufferSize);
+    (void)buffer;
+    atomic_store(&p->released, released + 1);
+    sem_post(&p->freeSem);
+}
+
+int ts_prefetch_reset(TsPrefetch* p, long offset) {
+    stop_reader(p);
+    int ok = (fseek(p->file, offset, SEEK_SET) == 0);
+    start_reader(p);
+    return ok;
+}
+
+int ts_prefetch_owns(const TsPrefetch* p, const char* buffer) {
+    return buffer >= p->data &&
+           buffer < p->data + (size_t)p->bufferSize * p->bufferCount &&
+           ((buffer - p->data) % p->bufferSize) == 0;
+}
+
+void ts_prefetch_get_stats(TsPrefetch* p, TsPrefetchStats* stats) {
+    stats->buffersDelivered = p->buffersDelivered;
+    stats->bytesRead = atomic_load(&p->bytesRead);
+    stats->underruns = p->underruns;
+    stats->minReady = p->minReady;
+}
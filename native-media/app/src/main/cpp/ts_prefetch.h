@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TS_PREFETCH_H
+#define TS_PREFETCH_H
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Prefetching reader for MPEG-2 transport streams.
+ *
+ * A reader thread keeps a ring of fixed size buffers filled from the file,
+ * reading as many free buffers as it can in one large block. The consumer
+ * (the buffer queue callback) takes filled buffers in order, and gives each
+ * one back once the player is done with it; in the common case neither side
+ * takes a lock. Buffers hold whole TS packets only.
+ *
+ * Buffer flow:
+ *   ts_prefetch_take()    -> buffer is handed to the player
+ *   ts_prefetch_release() -> the oldest taken buffer is free to refill
+ */
+
+typedef struct TsPrefetch TsPrefetch;
+
+typedef struct {
+    uint64_t buffersDelivered;
+    uint64_t bytesRead;
+    uint32_t underruns;     // takes that had to wait for the reader
+    uint32_t minReady;      // lowest number of filled buffers seen by a take
+} TsPrefetchStats;
+
+/* bufferSize must be a multiple of the TS packet size; the reader reads at
+   most blockBuffers buffers per read call */
+TsPrefetch* ts_prefetch_create(FILE* file, uint32_t bufferSize,
+                               uint32_t bufferCount, uint32_t blockBuffers);
+void ts_prefetch_destroy(TsPrefetch* prefetch);
+
+/* next filled buffer, waiting for the reader if none is ready;
+   returns NULL at end of stream, *size is the number of valid bytes */
+char* ts_prefetch_take(TsPrefetch* prefetch, uint32_t* size);
+
+/* hand back the oldest buffer returned by ts_prefetch_take() */
+void ts_prefetch_release(TsPrefetch* prefetch, const char* buffer);
+
+/* drop everything buffered (all taken buffers are considered released)
+   and restart reading at byte offset */
+int ts_prefetch_reset(TsPrefetch* prefetch, long offset);
+
+/* true if buffer is one of the ring buffers */
+int ts_prefetch_owns(const TsPrefetch* prefetch, const char* buffer);
+
+void ts_prefetch_get_stats(TsPrefetch* prefetch, TsPrefetchStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
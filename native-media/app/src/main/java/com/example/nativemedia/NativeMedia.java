@@ -30,6 +30,7 @@ import android.view.View;
 import android.widget.AdapterView;
 import android.widget.ArrayAdapter;
 import android.widget.Button;
+import android.widget.SeekBar;
 import android.widget.Spinner;
 
 import java.io.FileDescriptor;
@@ -262,7 +263,8 @@ public class NativeMedia extends Activity {
                         mNativeMediaPlayerVideoSink = mSelectedVideoSink;
                     }
                     if (mSourceString != null) {
-                        created = createStreamingMediaPlayer(assetMgr, mSourceString);
+                        created = createStreamingMediaPlayer(assetMgr, mSourceString,
+                                getCacheDir().getAbsolutePath());
                     }
                 }
                 if (created) {
@@ -307,6 +309,28 @@ public class NativeMedia extends Activity {
 
         });
 
+        // native MediaPlayer seek, to a position along the stream; the stream is
+        // indexed in the background, until then the duration is unknown (0)
+
+        ((SeekBar) findViewById(R.id.seek_native)).setOnSeekBarChangeListener(
+                new SeekBar.OnSeekBarChangeListener() {
+
+            public void onProgressChanged(SeekBar seekBar, int progress, boolean fromUser) {
+            }
+
+            public void onStartTrackingTouch(SeekBar seekBar) {
+            }
+
+            public void onStopTrackingTouch(SeekBar seekBar) {
+                int durationMs = getDurationStreamingMediaPlayer();
+                if (mNativeMediaPlayerVideoSink != null && durationMs > 0) {
+                    seekStreamingMediaPlayer(
+                            (int) ((long) durationMs * seekBar.getProgress() / seekBar.getMax()));
+                }
+            }
+
+        });
+
     }
 
     /** Called when the activity is about to be paused. */
@@ -340,11 +364,13 @@ public class NativeMedia extends Activity {
     /** Native methods, implemented in jni folder */
     public static native void createEngine();
     public static native boolean createStreamingMediaPlayer(AssetManager assetManager,
-                                                            String filename);
+                                                            String filename, String cacheDir);
     public static native void setPlayingStreamingMediaPlayer(boolean isPlaying);
     public static native void shutdown();
     public static native void setSurface(Surface surface);
     public static native void rewindStreamingMediaPlayer();
+    public static native void seekStreamingMediaPlayer(int timeMs);
+    public static native int getDurationStreamingMediaPlayer();
 
     /** Load jni .so on initialization */
     static {
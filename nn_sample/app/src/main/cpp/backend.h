@@ -0,0 +1,104 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_BACKEND_H
+#define NNAPI_BACKEND_H
+
+#include <memory>
+
+#include "model_graph.h"
+
+/**
+ * Execution
+ * A prepared graph together with its input and output buffers. The buffers are set
+ * once and kept, so the same execution can be run any number of times, e.g. on inputs
+ * refilled in place. Runs are asynchronous: Start() one, then Wait() for it before
+ * touching its buffers or starting it again. Use several executions to keep more than
+ * one run in flight.
+ */
+class Execution {
+public:
+    Execution(size_t inputCount, size_t outputCount) :
+            inputs_(inputCount, nullptr),
+            outputs_(outputCount, nullptr) {}
+    virtual ~Execution() {}
+
+    // Buffers hold one full tensor each; index is the position of the operand in the
+    // model inputs or outputs.
+    bool SetInput(uint32_t index, const float *buffer) {
+        if (index >= inputs_.size()) {
+            return false;
+        }
+        inputs_[index] = buffer;
+        return true;
+    }
+    bool SetOutput(uint32_t index, float *buffer) {
+        if (index >= outputs_.size()) {
+            return false;
+        }
+        outputs_[index] = buffer;
+        return true;
+    }
+
+    virtual bool Start() = 0;
+    virtual bool Wait() = 0;
+
+protected:
+    std::vector<const float *> inputs_;
+    std::vector<float *> outputs_;
+};
+
+/**
+ * Backend
+ * Something that can run a ModelGraph: NN API (NnapiBackend) or the portable CPU
+ * executor (CpuBackend).
+ */
+class Backend {
+public:
+    virtual ~Backend() {}
+
+    virtual const char *GetName() const = 0;
+
+    // Compile the graph. The graph, and the memory of its constants, must outlive the
+    // backend.
+    virtual bool Prepare(const ModelGraph &graph) = 0;
+
+    // Create an execution of the prepared graph. It must be destroyed before the backend.
+    virtual std::unique_ptr<Execution> CreateExecution() = 0;
+
+    // Run the graph once and wait for it. inputs and outputs hold one full tensor per
+    // model input and output, in the order given to ModelGraph::IdentifyInputsAndOutputs.
+    virtual bool Execute(const std::vector<const float *> &inputs,
+                         const std::vector<float *> &outputs) {
+        std::unique_ptr<Execution> execution = CreateExecution();
+        if (!execution) {
+            return false;
+        }
+        for (uint32_t idx = 0; idx < inputs.size(); idx++) {
+            if (!execution->SetInput(idx, inputs[idx])) {
+                return false;
+            }
+        }
+        for (uint32_t idx = 0; idx < outputs.size(); idx++) {
+            if (!execution->SetOutput(idx, outputs[idx])) {
+                return false;
+            }
+        }
+        return execution->Start() && execution->Wait();
+    }
+};
+
+#endif  // NNAPI_BACKEND_H
@@ -0,0 +1,466 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "cpu_backend.h"
+#include "graph_fusion.h"
+#include "log_util.h"
+
+#include <algorithm>
+
+namespace {
+
+// Smallest piece of a tensor handed to a thread. Below this, starting the workers
+// costs more than it saves, so TENSOR_SIZE models run on the calling thread.
+const size_t kMinChunkElements = 16384;
+
+// Chunks are kept a multiple of this many elements, so that every chunk but the
+// last one is made of whole SIMD vectors and cache lines.
+const size_t kChunkAlignment = 64;
+
+// Elements of each block of a fused operation that has no specialized kernel: the
+// intermediate values of a block (kMaxFusedSteps of them) stay in the L1 cache.
+const size_t kFusedBlockElements = 256;
+
+template <FusedActivation activation>
+inline float Activate(float value);
+
+template <>
+inline float Activate<FusedActivation::NONE>(float value) {
+    return value;
+}
+
+template <>
+inline float Activate<FusedActivation::RELU>(float value) {
+    return std::max(value, 0.0f);
+}
+
+template <>
+inline float Activate<FusedActivation::RELU1>(float value) {
+    return std::min(std::max(value, -1.0f), 1.0f);
+}
+
+template <>
+inline float Activate<FusedActivation::RELU6>(float value) {
+    return std::min(std::max(value, 0.0f), 6.0f);
+}
+
+template <OperationType type, FusedActivation activation>
+struct ElementwiseOp {
+    static float Apply(float a, float b) {
+        return Activate<activation>(type == OperationType::ADD ? a + b : a * b);
+    }
+};
+
+typedef ElementwiseOp<OperationType::ADD, FusedActivation::NONE> AddOp;
+typedef ElementwiseOp<OperationType::MUL, FusedActivation::NONE> MulOp;
+
+/**
+ * The loops. They have no branches and the pointers don't alias, so the compiler turns
+ * them into SIMD code (NEON on ARM, SSE on x86). Fused loops keep the intermediate
+ * values in registers.
+ */
+template <typename Op>
+void RunElementwise(const float *__restrict input0, const float *__restrict input1,
+                    float *__restrict output, size_t count) {
+    for (size_t idx = 0; idx < count; idx++) {
+        output[idx] = Op::Apply(input0[idx], input1[idx]);
+    }
+}
+
+// (input0 op0 input1) op1 input2
+template <typename Op0, typename Op1>
+void RunChain(const float *__restrict input0, const float *__restrict input1,
+              const float *__restrict input2, float *__restrict output, size_t count) {
+    for (size_t idx = 0; idx < count; idx++) {
+        output[idx] = Op1::Apply(Op0::Apply(input0[idx], input1[idx]), input2[idx]);
+    }
+}
+
+// (input0 op0 input1) op2 (input2 op1 input3)
+template <typename Op0, typename Op1, typename Op2>
+void RunTree(const float *__restrict input0, const float *__restrict input1,
+             const float *__restrict input2, const float *__restrict input3,
+             float *__restrict output, size_t count) {
+    for (size_t idx = 0; idx < count; idx++) {
+        output[idx] = Op2::Apply(Op0::Apply(input0[idx], input1[idx]),
+                                 Op1::Apply(input2[idx], input3[idx]));
+    }
+}
+
+/**
+ * Operation kernels (CpuBackend::OperationKernel): run an operation over elements
+ * [begin, end). inputs are the operation's inputs, in order.
+ */
+template <typename Op>
+void RunSingle(const Operation &, const float *const *inputs, float *output,
+               size_t begin, size_t end) {
+    RunElementwise<Op>(inputs[0] + begin, inputs[1] + begin, output + begin, end - begin);
+}
+
+template <typename Op0, typename Op1>
+void RunFusedChain(const Operation &operation, const float *const *inputs, float *output,
+                   size_t begin, size_t end) {
+    const FusedStep *steps = operation.steps.data();
+    uint32_t stepResult = static_cast<uint32_t>(operation.inputs.size());
+    uint32_t input2 = steps[1].operands[0] == stepResult ? steps[1].operands[1]
+                                                         : steps[1].operands[0];
+    RunChain<Op0, Op1>(inputs[steps[0].operands[0]] + begin,
+                       inputs[steps[0].operands[1]] + begin,
+                       inputs[input2] + begin, output + begin, end - begin);
+}
+
+template <typename Op0, typename Op1, typename Op2>
+void RunFusedTree(const Operation &operation, const float *const *inputs, float *output,
+                  size_t begin, size_t end) {
+    const FusedStep *steps = operation.steps.data();
+    RunTree<Op0, Op1, Op2>(inputs[steps[0].operands[0]] + begin,
+                           inputs[steps[0].operands[1]] + begin,
+                           inputs[steps[1].operands[0]] + begin,
+                           inputs[steps[1].operands[1]] + begin,
+                           output + begin, end - begin);
+}
+
+typedef void (*KernelFunction)(const float *, const float *, float *, size_t);
+
+KernelFunction SelectStepKernel(const FusedStep &step);
+
+/**
+ * Any other fused operation: its steps run one after the other over a block of elements
+ * at a time, the intermediate results going to a buffer on the stack.
+ */
+void RunFusedProgram(const Operation &operation, const float *const *inputs,
+                     float *output, size_t begin, size_t end) {
+    const size_t inputCount = operation.inputs.size();
+    const size_t stepCount = operation.steps.size();
+    KernelFunction kernels[ModelGraph::kMaxFusedSteps];
+    for (size_t stepIdx = 0; stepIdx < stepCount; stepIdx++) {
+        kernels[stepIdx] = SelectStepKernel(operation.steps[stepIdx]);
+    }
+
+    float results[ModelGraph::kMaxFusedSteps][kFusedBlockElements];
+    const float *values[ModelGraph::kMaxFusedInputs + ModelGraph::kMaxFusedSteps];
+    for (size_t blockBegin = begin; blockBegin < end; blockBegin += kFusedBlockElements) {
+        size_t count = std::min(kFusedBlockElements, end - blockBegin);
+        for (size_t idx = 0; idx < inputCount; idx++) {
+            values[idx] = inputs[idx] + blockBegin;
+        }
+        for (size_t stepIdx = 0; stepIdx < stepCount; stepIdx++) {
+            const FusedStep &step = operation.steps[stepIdx];
+            float *result = stepIdx + 1 == stepCount ? output + blockBegin : results[stepIdx];
+            kernels[stepIdx](values[step.operands[0]], values[step.operands[1]], result, count);
+            values[inputCount + stepIdx] = result;
+        }
+    }
+}
+
+/**
+ * Kernel selection. The type and activation of an operation are only known at run time;
+ * SelectForOperation turns them into the template argument of Selector::Select, which
+ * picks the kernel specialized for them.
+ */
+template <typename Selector, OperationType type>
+typename Selector::Kernel SelectForActivation(FusedActivation activation,
+                                              const Operation *operation) {
+    switch (activation) {
+        case FusedActivation::RELU:
+            return Selector::template Select<
+                    ElementwiseOp<type, FusedActivation::RELU>>(operation);
+        case FusedActivation::RELU1:
+            return Selector::template Select<
+                    ElementwiseOp<type, FusedActivation::RELU1>>(operation);
+        case FusedActivation::RELU6:
+            return Selector::template Select<
+                    ElementwiseOp<type, FusedActivation::RELU6>>(operation);
+        case FusedActivation::NONE:
+        default:
+            return Selector::template Select<
+                    ElementwiseOp<type, FusedActivation::NONE>>(operation);
+    }
+}
+
+template <typename Selector>
+typename Selector::Kernel SelectForOperation(OperationType type, FusedActivation activation,
+                                             const Operation *operation) {
+    return type == OperationType::ADD
+           ? SelectForActivation<Selector, OperationType::ADD>(activation, operation)
+           : SelectForActivation<Selector, OperationType::MUL>(activation, operation);
+}
+
+struct StepSelector {
+    typedef KernelFunction Kernel;
+    template <typename Op>
+    static Kernel Select(const Operation *) { return RunElementwise<Op>; }
+};
+
+struct SingleSelector {
+    typedef CpuBackend::OperationKernel Kernel;
+    template <typename Op>
+    static Kernel Select(const Operation *) { return RunSingle<Op>; }
+};
+
+// Only the last step of a specialized pattern may have an activation.
+struct ChainSelector {
+    typedef CpuBackend::OperationKernel Kernel;
+    template <typename Op>
+    static Kernel Select(const Operation *operation) {
+        return operation->steps[0].type == OperationType::ADD ? RunFusedChain<AddOp, Op>
+                                                              : RunFusedChain<MulOp, Op>;
+    }
+};
+
+struct TreeSelector {
+    typedef CpuBackend::OperationKernel Kernel;
+    template <typename Op>
+    static Kernel Select(const Operation *operation) {
+        bool add0 = operation->steps[0].type == OperationType::ADD;
+        bool add1 = operation->steps[1].type == OperationType::ADD;
+        if (add0) {
+            return add1 ? RunFusedTree<AddOp, AddOp, Op> : RunFusedTree<AddOp, MulOp, Op>;
+        }
+        return add1 ? RunFusedTree<MulOp, AddOp, Op> : RunFusedTree<MulOp, MulOp, Op>;
+    }
+};
+
+KernelFunction SelectStepKernel(const FusedStep &step) {
+    return SelectForOperation<StepSelector>(step.type, step.activation, nullptr);
+}
+
+bool ReadsInputsOnly(const FusedStep &step, size_t inputCount) {
+    return step.operands[0] < inputCount && step.operands[1] < inputCount;
+}
+
+bool ReadsStep(const FusedStep &step, uint32_t result) {
+    return step.operands[0] == result || step.operands[1] == result;
+}
+
+CpuBackend::OperationKernel SelectKernel(const Operation &operation) {
+    if (operation.type != OperationType::FUSED) {
+        return SelectForOperation<SingleSelector>(operation.type, operation.activation,
+                                                  &operation);
+    }
+
+    // ADD and MUL are commutative, so the patterns match whatever the order of the
+    // operands of a step.
+    const std::vector<FusedStep> &steps = operation.steps;
+    const uint32_t inputCount = static_cast<uint32_t>(operation.inputs.size());
+    const FusedStep &last = steps.back();
+    if (steps.size() == 2 && steps[0].activation == FusedActivation::NONE &&
+        ReadsInputsOnly(steps[0], inputCount) && ReadsStep(last, inputCount) &&
+        (last.operands[0] < inputCount || last.operands[1] < inputCount)) {
+        return SelectForOperation<ChainSelector>(last.type, last.activation, &operation);
+    }
+    if (steps.size() == 3 && steps[0].activation == FusedActivation::NONE &&
+        steps[1].activation == FusedActivation::NONE &&
+        ReadsInputsOnly(steps[0], inputCount) && ReadsInputsOnly(steps[1], inputCount) &&
+        ReadsStep(last, inputCount) && ReadsStep(last, inputCount + 1)) {
+        return SelectForOperation<TreeSelector>(last.type, last.activation, &operation);
+    }
+    return RunFusedProgram;
+}
+
+}  // namespace
+
+const int CpuBackend::kMaxThreads;
+
+CpuExecution::CpuExecution(CpuBackend *backend, size_t inputCount, size_t outputCount) :
+        Execution(inputCount, outputCount),
+        backend_(backend),
+        started_(false),
+        done_(false),
+        succeeded_(false) {
+}
+
+CpuExecution::~CpuExecution() {
+    if (started_) {
+        Wait();
+    }
+}
+
+bool CpuExecution::Start() {
+    if (started_) {
+        LOGE("CpuExecution::Start: the previous run was not waited for");
+        return false;
+    }
+    backend_->Enqueue(this);
+    return true;
+}
+
+bool CpuExecution::Wait() {
+    if (!started_) {
+        LOGE("CpuExecution::Wait: nothing was started");
+        return false;
+    }
+    backend_->WaitFor(this);
+    return succeeded_;
+}
+
+CpuBackend::CpuBackend(int threadCount, bool fuseOperations) :
+        fuseOperations_(fuseOperations),
+        graph_(nullptr),
+        pool_(threadCount > 0 ? threadCount
+                              : std::max(1, std::min(kMaxThreads,
+                                        static_cast<int>(std::thread::hardware_concurrency())))),
+        stopLauncher_(false) {
+}
+
+CpuBackend::~CpuBackend() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex_);
+        stopLauncher_ = true;
+    }
+    queueChanged_.notify_all();
+    if (launcher_.joinable()) {
+        launcher_.join();
+    }
+}
+
+bool CpuBackend::Prepare(const ModelGraph &graph) {
+    if (!graph.IsFinished()) {
+        LOGE("CpuBackend::Prepare: the graph is not finished");
+        return false;
+    }
+    std::lock_guard<std::mutex> runLock(runMutex_);
+    graph_ = nullptr;
+    steps_.clear();
+    fusedGraph_ = ModelGraph();
+    if (fuseOperations_ && !FuseElementwiseOperations(graph, &fusedGraph_)) {
+        return false;
+    }
+    const ModelGraph &compiled = fuseOperations_ ? fusedGraph_ : graph;
+
+    const std::vector<Operand> &operands = compiled.GetOperands();
+    operandData_.assign(operands.size(), nullptr);
+    temporaries_.clear();
+    for (size_t idx = 0; idx < operands.size(); idx++) {
+        if (operands[idx].lifetime == OperandLifetime::TEMPORARY) {
+            temporaries_.emplace_back(operands[idx].elementCount);
+            operandData_[idx] = temporaries_.back().data();
+        } else if (operands[idx].lifetime == OperandLifetime::CONSTANT) {
+            // Kernels never write to constants.
+            operandData_[idx] = const_cast<float *>(compiled.GetConstantData(idx));
+        }
+    }
+
+    for (const Operation &operation : compiled.GetOperations()) {
+        steps_.push_back({SelectKernel(operation), &operation});
+    }
+    graph_ = &compiled;
+    return true;
+}
+
+std::unique_ptr<Execution> CpuBackend::CreateExecution() {
+    if (!graph_) {
+        LOGE("CpuBackend::CreateExecution: the graph is not prepared");
+        return nullptr;
+    }
+    return std::unique_ptr<Execution>(new CpuExecution(this, graph_->GetInputs().size(),
+                                                       graph_->GetOutputs().size()));
+}
+
+void CpuBackend::Enqueue(CpuExecution *execution) {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if (!launcher_.joinable()) {
+        launcher_ = std::thread(&CpuBackend::LauncherLoop, this);
+    }
+    execution->started_ = true;
+    execution->done_ = false;
+    queue_.push_back(execution);
+    queueChanged_.notify_all();
+}
+
+void CpuBackend::WaitFor(CpuExecution *execution) {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    queueChanged_.wait(lock, [execution] { return execution->done_; });
+    execution->started_ = false;
+}
+
+void CpuBackend::LauncherLoop() {
+    std::unique_lock<std::mutex> lock(queueMutex_);
+    for (;;) {
+        queueChanged_.wait(lock, [this] { return stopLauncher_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            return;
+        }
+        CpuExecution *execution = queue_.front();
+        lock.unlock();
+
+        bool succeeded = Execute(execution->inputs_, execution->outputs_);
+
+        lock.lock();
+        queue_.pop_front();
+        execution->succeeded_ = succeeded;
+        execution->done_ = true;
+        queueChanged_.notify_all();
+    }
+}
+
+bool CpuBackend::Execute(const std::vector<const float *> &inputs,
+                         const std::vector<float *> &outputs) {
+    std::lock_guard<std::mutex> runLock(runMutex_);
+    if (!graph_ || inputs.size() != graph_->GetInputs().size() ||
+        outputs.size() != graph_->GetOutputs().size() ||
+        std::find(inputs.begin(), inputs.end(), nullptr) != inputs.end() ||
+        std::find(outputs.begin(), outputs.end(), nullptr) != outputs.end()) {
+        LOGE("CpuBackend::Execute: bad inputs or outputs");
+        return false;
+    }
+    for (size_t idx = 0; idx < inputs.size(); idx++) {
+        operandData_[graph_->GetInputs()[idx]] = const_cast<float *>(inputs[idx]);
+    }
+    for (size_t idx = 0; idx < outputs.size(); idx++) {
+        operandData_[graph_->GetOutputs()[idx]] = outputs[idx];
+    }
+
+    // Split each operation in a few chunks per thread, so that a slow core doesn't
+    // hold the others back.
+    size_t count = graph_->GetElementCount();
+    size_t chunkCount = static_cast<size_t>(pool_.GetThreadCount()) * 4;
+    size_t grain = (count / chunkCount + kChunkAlignment - 1) / kChunkAlignment *
+                   kChunkAlignment;
+    grain = std::max(grain, kMinChunkElements);
+
+    for (const Step &step : steps_) {
+        const Operation &operation = *step.operation;
+        const float *stepInputs[ModelGraph::kMaxFusedInputs];
+        for (size_t idx = 0; idx < operation.inputs.size(); idx++) {
+            stepInputs[idx] = operandData_[operation.inputs[idx]];
+        }
+        float *output = operandData_[operation.output];
+        OperationKernel kernel = step.kernel;
+        pool_.ParallelFor(count, grain, [&](size_t begin, size_t end) {
+            kernel(operation, stepInputs, output, begin, end);
+        });
+    }
+    return true;
+}
+
+size_t CpuBackend::GetBytesPerExecution() const {
+    if (!graph_) {
+        return 0;
+    }
+    size_t tensorCount = 0;
+    for (const Operation &operation : graph_->GetOperations()) {
+        tensorCount += operation.inputs.size() + 1;
+    }
+    return tensorCount * graph_->GetElementCount() * sizeof(float);
+}
+
+size_t CpuBackend::GetTemporaryBytes() const {
+    size_t bytes = 0;
+    for (const std::vector<float> &temporary : temporaries_) {
+        bytes += temporary.size() * sizeof(float);
+    }
+    return bytes;
+}
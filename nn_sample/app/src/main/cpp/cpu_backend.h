@@ -0,0 +1,125 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_CPU_BACKEND_H
+#define NNAPI_CPU_BACKEND_H
+
+#include <deque>
+
+#include "backend.h"
+#include "thread_pool.h"
+
+class CpuBackend;
+
+/**
+ * CpuExecution
+ * Runs are queued to the backend's launcher thread, which runs them one at a time, in
+ * the order they were started. The caller is free to prepare the next run meanwhile.
+ */
+class CpuExecution : public Execution {
+public:
+    CpuExecution(CpuBackend *backend, size_t inputCount, size_t outputCount);
+    ~CpuExecution() override;
+
+    bool Start() override;
+    bool Wait() override;
+
+private:
+    friend class CpuBackend;
+
+    CpuBackend *backend_;
+
+    // state of the last run, guarded by the backend's queue mutex
+    bool started_;
+    bool done_;
+    bool succeeded_;
+};
+
+/**
+ * CpuBackend
+ * Portable reference executor: runs the operations of a graph one after the other on
+ * the CPU, each one split across a pool of threads. It has no Android dependency, so
+ * it also runs on a Linux host.
+ *
+ * Unless told otherwise, Prepare first fuses the graph (FuseElementwiseOperations), so
+ * that each tree of operations is a single pass over the tensors, without intermediate
+ * tensors. The common trees, such as the sample's (a + b) * (c + d), run on kernels
+ * specialized for them at compile time; the others run block by block, keeping the
+ * intermediate values in a small buffer that stays in the L1 cache.
+ */
+class CpuBackend : public Backend {
+public:
+    // threadCount of 0 picks one thread per core, up to kMaxThreads.
+    explicit CpuBackend(int threadCount = 0, bool fuseOperations = true);
+    ~CpuBackend() override;
+
+    const char *GetName() const override { return "CPU"; }
+    bool Prepare(const ModelGraph &graph) override;
+    std::unique_ptr<Execution> CreateExecution() override;
+
+    // Runs on the calling thread. Inputs and outputs must not overlap.
+    bool Execute(const std::vector<const float *> &inputs,
+                 const std::vector<float *> &outputs) override;
+
+    int GetThreadCount() const { return pool_.GetThreadCount(); }
+
+    // Memory an execution reads and writes, counting each operation's tensors once, and
+    // memory taken by intermediate tensors. Valid once prepared.
+    size_t GetBytesPerExecution() const;
+    size_t GetTemporaryBytes() const;
+
+    static const int kMaxThreads = 4;
+
+    // runs an operation over elements [begin, end) of its tensors
+    typedef void (*OperationKernel)(const Operation &operation, const float *const *inputs,
+                                    float *output, size_t begin, size_t end);
+
+private:
+    friend class CpuExecution;
+
+    void Enqueue(CpuExecution *execution);
+    void WaitFor(CpuExecution *execution);
+    void LauncherLoop();
+
+    // one operation, with the kernel specialized for it
+    struct Step {
+        OperationKernel kernel;
+        const Operation *operation;
+    };
+
+    bool fuseOperations_;
+    ModelGraph fusedGraph_;
+    const ModelGraph *graph_;
+    ThreadPool pool_;
+    std::vector<Step> steps_;
+
+    // storage of the temporary operands, and the address of every operand during an
+    // execution
+    std::vector<std::vector<float>> temporaries_;
+    std::vector<float *> operandData_;
+
+    // one run at a time uses the temporaries
+    std::mutex runMutex_;
+
+    // queue of started executions, run by the launcher thread (started on first use)
+    std::thread launcher_;
+    std::mutex queueMutex_;
+    std::condition_variable queueChanged_;
+    std::deque<CpuExecution *> queue_;
+    bool stopLauncher_;
+};
+
+#endif  // NNAPI_CPU_BACKEND_H
@@ -0,0 +1,168 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "graph_fusion.h"
+#include "log_util.h"
+
+namespace {
+
+const int32_t kNone = -1;
+
+// Operand references while a tree is being flattened: inputs are numbered as they are
+// found, and steps are flagged until the number of inputs is known.
+const uint32_t kStepReference = 0x80000000u;
+
+struct FusionState {
+    const ModelGraph *graph;
+    std::vector<int32_t> producer;   // operation that computes each operand
+    std::vector<int32_t> fusedInto;  // operation that each operation is merged into
+    std::vector<uint32_t> inputs;    // of the tree being flattened, in the original graph
+    std::vector<FusedStep> steps;
+};
+
+/**
+ * Append the steps of the tree rooted at opIdx, children first, and return the reference
+ * to its result.
+ */
+uint32_t FlattenTree(FusionState *state, int32_t opIdx) {
+    const Operation &operation = state->graph->GetOperations()[opIdx];
+    FusedStep step;
+    step.type = operation.type;
+    step.activation = operation.activation;
+    for (int k = 0; k < 2; k++) {
+        uint32_t operand = operation.inputs[k];
+        int32_t producer = state->producer[operand];
+        if (producer != kNone && state->fusedInto[producer] == opIdx) {
+            step.operands[k] = FlattenTree(state, producer);
+            continue;
+        }
+        uint32_t inputIdx = 0;
+        while (inputIdx < state->inputs.size() && state->inputs[inputIdx] != operand) {
+            inputIdx++;
+        }
+        if (inputIdx == state->inputs.size()) {
+            state->inputs.push_back(operand);
+        }
+        step.operands[k] = inputIdx;
+    }
+    state->steps.push_back(step);
+    return kStepReference | static_cast<uint32_t>(state->steps.size() - 1);
+}
+
+}  // namespace
+
+bool FuseElementwiseOperations(const ModelGraph &graph, ModelGraph *fused) {
+    if (!graph.IsFinished()) {
+        LOGE("FuseElementwiseOperations: the graph is not finished");
+        return false;
+    }
+    const std::vector<Operand> &operands = graph.GetOperands();
+    const std::vector<Operation> &operations = graph.GetOperations();
+
+    FusionState state;
+    state.graph = &graph;
+    state.producer.assign(operands.size(), kNone);
+    state.fusedInto.assign(operations.size(), kNone);
+    std::vector<uint32_t> readCount(operands.size(), 0);
+    for (size_t opIdx = 0; opIdx < operations.size(); opIdx++) {
+        state.producer[operations[opIdx].output] = static_cast<int32_t>(opIdx);
+        for (uint32_t input : operations[opIdx].inputs) {
+            readCount[input]++;
+        }
+    }
+
+    // Merge each operation into the one reading its result, when that is the only use of
+    // a temporary. Operations are in execution order, so the trees below an operation are
+    // complete, and their size known, by the time it is reached.
+    std::vector<uint32_t> treeSize(operations.size(), 1);
+    for (size_t opIdx = 0; opIdx < operations.size(); opIdx++) {
+        const Operation &operation = operations[opIdx];
+        if (operation.type == OperationType::FUSED) {
+            continue;
+        }
+        for (uint32_t input : operation.inputs) {
+            int32_t producer = state.producer[input];
+            if (producer == kNone || readCount[input] != 1 ||
+                operands[input].lifetime != OperandLifetime::TEMPORARY ||
+                operations[producer].type == OperationType::FUSED ||
+                treeSize[opIdx] + treeSize[producer] > ModelGraph::kMaxFusedSteps) {
+                continue;
+            }
+            state.fusedInto[producer] = static_cast<int32_t>(opIdx);
+            treeSize[opIdx] += treeSize[producer];
+        }
+    }
+
+    // Copy the pools and the operands that are still needed.
+    for (const MemoryPool &pool : graph.GetMemoryPools()) {
+        fused->AddMemoryPool(pool.fd, pool.size, pool.protect, pool.data);
+    }
+    std::vector<uint32_t> newIndex(operands.size(), 0);
+    for (size_t idx = 0; idx < operands.size(); idx++) {
+        int32_t producer = state.producer[idx];
+        if (producer == kNone || state.fusedInto[producer] == kNone) {
+            newIndex[idx] = fused->AddOperandLike(operands[idx]);
+        }
+    }
+
+    // Add the operations that are not merged, each with its tree.
+    for (size_t opIdx = 0; opIdx < operations.size(); opIdx++) {
+        const Operation &operation = operations[opIdx];
+        if (state.fusedInto[opIdx] != kNone) {
+            continue;
+        }
+
+        std::vector<uint32_t> inputs;
+        bool added;
+        if (treeSize[opIdx] == 1) {
+            for (uint32_t input : operation.inputs) {
+                inputs.push_back(newIndex[input]);
+            }
+            added = operation.type == OperationType::FUSED
+                    ? fused->AddFusedOperation(inputs, newIndex[operation.output],
+                                               operation.steps)
+                    : fused->AddOperation(operation.type, inputs,
+                                          newIndex[operation.output], operation.activation);
+        } else {
+            state.inputs.clear();
+            state.steps.clear();
+            FlattenTree(&state, static_cast<int32_t>(opIdx));
+            uint32_t inputCount = static_cast<uint32_t>(state.inputs.size());
+            for (FusedStep &step : state.steps) {
+                for (uint32_t &reference : step.operands) {
+                    if (reference & kStepReference) {
+                        reference = inputCount + (reference & ~kStepReference);
+                    }
+                }
+            }
+            for (uint32_t input : state.inputs) {
+                inputs.push_back(newIndex[input]);
+            }
+            added = fused->AddFusedOperation(inputs, newIndex[operation.output], state.steps);
+        }
+        if (!added) {
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> inputs, outputs;
+    for (uint32_t input : graph.GetInputs()) {
+        inputs.push_back(newIndex[input]);
+    }
+    for (uint32_t output : graph.GetOutputs()) {
+        outputs.push_back(newIndex[output]);
+    }
+    return fused->IdentifyInputsAndOutputs(inputs, outputs) && fused->Finish();
+}
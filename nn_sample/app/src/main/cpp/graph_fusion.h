@@ -0,0 +1,36 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_GRAPH_FUSION_H
+#define NNAPI_GRAPH_FUSION_H
+
+#include "model_graph.h"
+
+/**
+ * Build into fused (an empty graph) a copy of graph where every tree of elementwise
+ * operations linked by temporaries is merged into one FUSED operation. A temporary is
+ * merged away when it is read by exactly one operation; the ones read more than once, and
+ * the model outputs, are still computed into a tensor. For the sample's graph,
+ *        (tensor0 + tensor1) * (tensor2 + tensor3)
+ * becomes a single operation, without the two intermediate tensors.
+ *
+ * Operands keep their order, minus the merged temporaries, and so do the model inputs
+ * and outputs; memory pools keep their indexes. Trees are split to stay within
+ * ModelGraph::kMaxFusedSteps operations.
+ */
+bool FuseElementwiseOperations(const ModelGraph &graph, ModelGraph *fused);
+
+#endif  // NNAPI_GRAPH_FUSION_H
@@ -0,0 +1,372 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Host check and benchmark of the CPU backend, built when CMakeLists.txt is configured
+ * for the host rather than Android:
+ *   nn_host_bench check   compare the backend against a scalar reference, exit 1 on error
+ *   nn_host_bench sweep   time the sample graph over a range of tensor sizes
+ *   nn_host_bench pipeline
+ *                         throughput of many small computations, the way SimpleModel
+ *                         runs them: new executions, one reused execution, or
+ *                         kPipelineDepth executions in flight
+ *   nn_host_bench fusion  the sample graph on large 2-D tensors, fused and unfused: time,
+ *                         memory traffic and intermediate tensors of each
+ * With no argument, both run.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "cpu_backend.h"
+
+namespace {
+
+// Fill a tensor with small values that are exact in float, so that any order of
+// evaluation gives the same results.
+void FillTensor(std::vector<float> *tensor, uint32_t seed) {
+    for (size_t idx = 0; idx < tensor->size(); idx++) {
+        int value = static_cast<int>((idx * 7 + seed * 13) % 17) - 8;
+        (*tensor)[idx] = static_cast<float>(value) / 4;
+    }
+}
+
+// The sample graph, (tensor0 + tensor1) * (tensor2 + tensor3), with its two weight
+// tensors in one host memory pool.
+struct SampleGraph {
+    explicit SampleGraph(const std::vector<uint32_t> &dimensions) {
+        elementCount = 1;
+        for (uint32_t dimension : dimensions) {
+            elementCount *= dimension;
+        }
+        weights.resize(2 * elementCount);
+        FillTensor(&weights, 1);
+        uint32_t pool = graph.AddMemoryPool(-1, weights.size() * sizeof(float), 0,
+                                            weights.data());
+        built = BuildSimpleGraph(&graph, dimensions, pool, 0);
+    }
+
+    ModelGraph graph;
+    std::vector<float> weights;
+    size_t elementCount;
+    bool built;
+};
+
+double MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+// Best time of a few rounds of Execute, in microseconds per execution.
+double TimeExecute(CpuBackend *backend, const std::vector<const float *> &inputs,
+                   const std::vector<float *> &outputs, size_t elementCount) {
+    int repeats = std::max(3, static_cast<int>(20000000 / elementCount));
+    double best = 0.0;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int idx = 0; idx < repeats; idx++) {
+            backend->Execute(inputs, outputs);
+        }
+        double time = MicrosecondsSince(start) / repeats;
+        best = round == 0 ? time : std::min(best, time);
+    }
+    return best;
+}
+
+bool CheckSampleGraph() {
+    bool success = true;
+    // Sizes around the point where the backend splits the work across threads.
+    for (uint32_t size : {1u, 7u, 200u, 16383u, 16385u, 100003u}) {
+        for (const std::vector<uint32_t> &dimensions :
+                {std::vector<uint32_t>{size}, std::vector<uint32_t>{1, size}}) {
+            SampleGraph sample(dimensions);
+            if (!sample.built) {
+                fprintf(stderr, "Failed to build the graph of %u elements\n", size);
+                return false;
+            }
+            std::vector<float> input1(size), input2(size), expected(size), output(size);
+            FillTensor(&input1, 2);
+            FillTensor(&input2, 3);
+            for (uint32_t idx = 0; idx < size; idx++) {
+                expected[idx] = (sample.weights[idx] + input1[idx]) *
+                                (sample.weights[size + idx] + input2[idx]);
+            }
+
+            for (int threads : {1, 3}) {
+                for (bool fuse : {false, true}) {
+                    CpuBackend backend(threads, fuse);
+                    std::fill(output.begin(), output.end(), -1.0f);
+                    if (!backend.Prepare(sample.graph) ||
+                        !backend.Execute({input1.data(), input2.data()}, {output.data()}) ||
+                        memcmp(output.data(), expected.data(), size * sizeof(float))) {
+                        fprintf(stderr, "Wrong result: %zu-D, %u elements, %d threads, %s\n",
+                                dimensions.size(), size, threads, fuse ? "fused" : "unfused");
+                        success = false;
+                    }
+                }
+            }
+        }
+    }
+    printf("check: %s\n", success ? "ok" : "FAILED");
+    return success;
+}
+
+void SweepTensorSizes() {
+    printf("%10s %8s %12s %10s %8s\n", "elements", "threads", "us/exec", "GB/s", "speedup");
+    for (uint32_t size : {200u, 4096u, 65536u, 262144u, 1u << 20, 4u << 20}) {
+        SampleGraph sample({size});
+        std::vector<float> input1(size), input2(size), output(size);
+        FillTensor(&input1, 2);
+        FillTensor(&input2, 3);
+
+        double singleThreadTime = 0.0;
+        for (int threads : {1, 2, CpuBackend::kMaxThreads}) {
+            CpuBackend backend(threads);
+            if (!backend.Prepare(sample.graph)) {
+                fprintf(stderr, "Failed to prepare the graph of %u elements\n", size);
+                return;
+            }
+            double time = TimeExecute(&backend, {input1.data(), input2.data()},
+                                      {output.data()}, size);
+            if (threads == 1) {
+                singleThreadTime = time;
+            }
+            printf("%10u %8d %12.2f %10.2f %7.2fx\n", size, backend.GetThreadCount(), time,
+                   backend.GetBytesPerExecution() / (time * 1e3), singleThreadTime / time);
+        }
+    }
+}
+
+// One computation of SimpleModel: its input tensors filled with a value each, an
+// execution bound to them, and the output tensor the result is read from.
+struct ComputeSlot {
+    explicit ComputeSlot(size_t elementCount) :
+            input1(elementCount),
+            input2(elementCount),
+            output(elementCount) {}
+
+    void Fill(float inputValue1, float inputValue2) {
+        std::fill(input1.begin(), input1.end(), inputValue1);
+        std::fill(input2.begin(), input2.end(), inputValue2);
+    }
+    bool Bind(Execution *execution) {
+        return execution->SetInput(0, input1.data()) &&
+               execution->SetInput(1, input2.data()) &&
+               execution->SetOutput(0, output.data());
+    }
+
+    std::vector<float> input1;
+    std::vector<float> input2;
+    std::vector<float> output;
+    std::unique_ptr<Execution> execution;
+};
+
+// Same as SimpleModel::kPipelineDepth
+const int kPipelineDepth = 3;
+
+// Runs count computations in one of three ways, and checks their results. inputValue1
+// and inputValue2 of computation idx are both idx % 16.
+class PipelineBenchmark {
+public:
+    PipelineBenchmark(const SampleGraph &sample, CpuBackend *backend) :
+            sample_(sample),
+            backend_(backend) {}
+
+    // Create, bind and destroy an execution per computation.
+    bool RunWithNewExecutions(int count) {
+        ComputeSlot slot(sample_.elementCount);
+        for (int idx = 0; idx < count; idx++) {
+            slot.Fill(idx % 16, idx % 16);
+            slot.execution = backend_->CreateExecution();
+            if (!slot.execution || !slot.Bind(slot.execution.get()) ||
+                !slot.execution->Start() || !slot.execution->Wait() ||
+                !CheckResult(idx, slot.output[0])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // One execution, bound once, started for each computation.
+    bool RunWithOneExecution(int count) {
+        ComputeSlot slot(sample_.elementCount);
+        slot.execution = backend_->CreateExecution();
+        if (!slot.execution || !slot.Bind(slot.execution.get())) {
+            return false;
+        }
+        for (int idx = 0; idx < count; idx++) {
+            slot.Fill(idx % 16, idx % 16);
+            if (!slot.execution->Start() || !slot.execution->Wait() ||
+                !CheckResult(idx, slot.output[0])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // kPipelineDepth executions, each bound once, as in SimpleModel::ComputeBatch: the
+    // inputs of the next computation are filled while the previous ones run.
+    bool RunPipelined(int count) {
+        std::vector<std::unique_ptr<ComputeSlot>> slots;
+        for (int idx = 0; idx < kPipelineDepth; idx++) {
+            slots.emplace_back(new ComputeSlot(sample_.elementCount));
+            slots.back()->execution = backend_->CreateExecution();
+            if (!slots.back()->execution || !slots.back()->Bind(slots.back()->execution.get())) {
+                return false;
+            }
+        }
+        bool inFlight[kPipelineDepth] = {};
+        bool success = true;
+        for (int idx = 0; idx < count + kPipelineDepth; idx++) {
+            // This slot was started kPipelineDepth iterations ago.
+            ComputeSlot &slot = *slots[idx % kPipelineDepth];
+            if (inFlight[idx % kPipelineDepth]) {
+                success = slot.execution->Wait() &&
+                          CheckResult(idx - kPipelineDepth, slot.output[0]) && success;
+                inFlight[idx % kPipelineDepth] = false;
+            }
+            if (idx < count && success) {
+                slot.Fill(idx % 16, idx % 16);
+                success = slot.execution->Start();
+                inFlight[idx % kPipelineDepth] = success;
+            }
+        }
+        return success;
+    }
+
+private:
+    bool CheckResult(int idx, float result) {
+        float value = idx % 16;
+        float expected = (sample_.weights[0] + value) *
+                         (sample_.weights[sample_.elementCount] + value);
+        if (result != expected) {
+            fprintf(stderr, "Wrong result of computation %d: %f, expected %f\n", idx,
+                    result, expected);
+            return false;
+        }
+        return true;
+    }
+
+    const SampleGraph &sample_;
+    CpuBackend *backend_;
+};
+
+bool BenchmarkPipeline() {
+    printf("%10s %14s %12s %14s %8s\n", "elements", "executions", "us/compute",
+           "computes/s", "speedup");
+    for (uint32_t size : {200u, 4096u, 65536u}) {
+        SampleGraph sample({size});
+        CpuBackend backend(1);
+        if (!backend.Prepare(sample.graph)) {
+            fprintf(stderr, "Failed to prepare the graph of %u elements\n", size);
+            return false;
+        }
+        PipelineBenchmark benchmark(sample, &backend);
+        int count = std::max(200, static_cast<int>(4000000 / size));
+
+        const char *names[] = {"new", "reused", "pipelined"};
+        double newExecutionTime = 0.0;
+        for (int mode = 0; mode < 3; mode++) {
+            double best = 0.0;
+            for (int round = 0; round < 3; round++) {
+                auto start = std::chrono::steady_clock::now();
+                bool success = mode == 0 ? benchmark.RunWithNewExecutions(count) :
+                               mode == 1 ? benchmark.RunWithOneExecution(count) :
+                               benchmark.RunPipelined(count);
+                if (!success) {
+                    fprintf(stderr, "Failed to run the %s executions\n", names[mode]);
+                    return false;
+                }
+                double time = MicrosecondsSince(start) / count;
+                best = round == 0 ? time : std::min(best, time);
+            }
+            if (mode == 0) {
+                newExecutionTime = best;
+            }
+            printf("%10u %14s %12.2f %14.0f %7.2fx\n", size, names[mode], best, 1e6 / best,
+                   newExecutionTime / best);
+        }
+    }
+    return true;
+}
+
+bool BenchmarkFusion() {
+    printf("%12s %8s %12s %12s %10s %8s %8s\n", "shape", "graph", "us/exec", "MB traffic",
+           "MB temps", "GB/s", "speedup");
+    for (uint32_t side : {512u, 1024u, 2048u, 4096u}) {
+        SampleGraph sample({side, side});
+        size_t size = sample.elementCount;
+        std::vector<float> input1(size), input2(size);
+        FillTensor(&input1, 2);
+        FillTensor(&input2, 3);
+        std::vector<float> outputs[2] = {std::vector<float>(size), std::vector<float>(size)};
+
+        char shape[32];
+        snprintf(shape, sizeof(shape), "%ux%u", side, side);
+        double unfusedTime = 0.0;
+        for (int fuse = 0; fuse < 2; fuse++) {
+            CpuBackend backend(1, fuse);
+            if (!backend.Prepare(sample.graph)) {
+                fprintf(stderr, "Failed to prepare the graph of %s elements\n", shape);
+                return false;
+            }
+            double time = TimeExecute(&backend, {input1.data(), input2.data()},
+                                      {outputs[fuse].data()}, size);
+            if (!fuse) {
+                unfusedTime = time;
+            }
+            printf("%12s %8s %12.1f %12.1f %10.1f %8.2f %7.2fx\n", shape,
+                   fuse ? "fused" : "unfused", time, backend.GetBytesPerExecution() / 1e6,
+                   backend.GetTemporaryBytes() / 1e6,
+                   backend.GetBytesPerExecution() / (time * 1e3), unfusedTime / time);
+        }
+        if (outputs[0] != outputs[1]) {
+            fprintf(stderr, "The fused graph of %s elements gives different results\n", shape);
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    const char *mode = argc > 1 ? argv[1] : nullptr;
+    if (mode && strcmp(mode, "check") && strcmp(mode, "sweep") && strcmp(mode, "pipeline") &&
+        strcmp(mode, "fusion")) {
+        fprintf(stderr, "usage: %s [check|sweep|pipeline|fusion]\n", argv[0]);
+        return 2;
+    }
+
+    bool success = true;
+    if (!mode || !strcmp(mode, "check")) {
+        success = CheckSampleGraph();
+    }
+    if (!mode || !strcmp(mode, "sweep")) {
+        SweepTensorSizes();
+    }
+    if (!mode || !strcmp(mode, "pipeline")) {
+        success = BenchmarkPipeline() && success;
+    }
+    if (!mode || !strcmp(mode, "fusion")) {
+        success = BenchmarkFusion() && success;
+    }
+    return success ? 0 : 1;
+}
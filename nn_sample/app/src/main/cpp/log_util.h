@@ -0,0 +1,36 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_LOG_UTIL_H
+#define NNAPI_LOG_UTIL_H
+
+#ifndef LOG_TAG
+#define LOG_TAG "NNAPI_DEMO"
+#endif
+
+/**
+ * Error logging for the code that doesn't depend on NN API (the graph and the CPU
+ * backend), so that it also builds and runs on a Linux host.
+ */
+#ifdef __ANDROID__
+#include <android/log.h>
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+#define LOGE(...) (fprintf(stderr, LOG_TAG ": " __VA_ARGS__), fputc('\n', stderr))
+#endif
+
+#endif  // NNAPI_LOG_UTIL_H
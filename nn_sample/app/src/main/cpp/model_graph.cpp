@@ -0,0 +1,250 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "model_graph.h"
+#include "log_util.h"
+
+const uint32_t ModelGraph::kNoPool;
+const uint32_t ModelGraph::kMaxFusedSteps;
+const uint32_t ModelGraph::kMaxFusedInputs;
+
+ModelGraph::ModelGraph() :
+        finished_(false),
+        elementCount_(0) {
+}
+
+uint32_t ModelGraph::AddMemoryPool(int fd, size_t size, int protect, const void *data) {
+    pools_.push_back({fd, size, protect, static_cast<const uint8_t *>(data)});
+    return static_cast<uint32_t>(pools_.size() - 1);
+}
+
+uint32_t ModelGraph::AddOperand(const std::vector<uint32_t> &dimensions) {
+    Operand operand;
+    operand.dimensions = dimensions;
+    operand.elementCount = 1;
+    for (uint32_t dim : dimensions) {
+        operand.elementCount *= dim;
+    }
+    operand.lifetime = OperandLifetime::TEMPORARY;
+    operand.data = nullptr;
+    operand.pool = kNoPool;
+    operand.poolOffset = 0;
+    operands_.push_back(operand);
+    return static_cast<uint32_t>(operands_.size() - 1);
+}
+
+uint32_t ModelGraph::AddOperandLike(const Operand &operand) {
+    uint32_t index = AddOperand(operand.dimensions);
+    if (operand.lifetime == OperandLifetime::CONSTANT) {
+        operands_[index].lifetime = OperandLifetime::CONSTANT;
+        operands_[index].data = operand.data;
+        operands_[index].pool = operand.pool;
+        operands_[index].poolOffset = operand.poolOffset;
+    }
+    return index;
+}
+
+bool ModelGraph::SetOperandValue(uint32_t operand, const float *data, size_t length) {
+    if (finished_ || operand >= operands_.size() ||
+        length != operands_[operand].elementCount * sizeof(float)) {
+        LOGE("ModelGraph::SetOperandValue failed for operand (%u)", operand);
+        return false;
+    }
+    operands_[operand].lifetime = OperandLifetime::CONSTANT;
+    operands_[operand].data = data;
+    return true;
+}
+
+bool ModelGraph::SetOperandValueFromPool(uint32_t operand, uint32_t pool, size_t offset,
+                                         size_t length) {
+    if (finished_ || operand >= operands_.size() || pool >= pools_.size() ||
+        length != operands_[operand].elementCount * sizeof(float) ||
+        offset + length > pools_[pool].size) {
+        LOGE("ModelGraph::SetOperandValueFromPool failed for operand (%u)", operand);
+        return false;
+    }
+    operands_[operand].lifetime = OperandLifetime::CONSTANT;
+    operands_[operand].pool = pool;
+    operands_[operand].poolOffset = offset;
+    return true;
+}
+
+bool ModelGraph::AddOperation(OperationType type, const std::vector<uint32_t> &inputs,
+                              uint32_t output, FusedActivation activation) {
+    if (finished_ || type == OperationType::FUSED || inputs.size() != 2 ||
+        output >= operands_.size()) {
+        LOGE("ModelGraph::AddOperation failed for operation (%zu)", operations_.size());
+        return false;
+    }
+    for (uint32_t input : inputs) {
+        if (input >= operands_.size()) {
+            LOGE("ModelGraph::AddOperation: unknown operand (%u)", input);
+            return false;
+        }
+    }
+    operations_.push_back({type, inputs, output, activation, {}});
+    return true;
+}
+
+bool ModelGraph::AddFusedOperation(const std::vector<uint32_t> &inputs, uint32_t output,
+                                   const std::vector<FusedStep> &steps) {
+    if (finished_ || inputs.empty() || inputs.size() > kMaxFusedInputs || steps.empty() ||
+        steps.size() > kMaxFusedSteps || output >= operands_.size()) {
+        LOGE("ModelGraph::AddFusedOperation failed for operation (%zu)", operations_.size());
+        return false;
+    }
+    for (uint32_t input : inputs) {
+        if (input >= operands_.size()) {
+            LOGE("ModelGraph::AddFusedOperation: unknown operand (%u)", input);
+            return false;
+        }
+    }
+    // Steps only read the inputs and the results of earlier steps.
+    for (size_t stepIdx = 0; stepIdx < steps.size(); stepIdx++) {
+        const FusedStep &step = steps[stepIdx];
+        if (step.type == OperationType::FUSED ||
+            step.operands[0] >= inputs.size() + stepIdx ||
+            step.operands[1] >= inputs.size() + stepIdx) {
+            LOGE("ModelGraph::AddFusedOperation: bad step (%zu)", stepIdx);
+            return false;
+        }
+    }
+    operations_.push_back({OperationType::FUSED, inputs, output, FusedActivation::NONE, steps});
+    return true;
+}
+
+bool ModelGraph::IdentifyInputsAndOutputs(const std::vector<uint32_t> &inputs,
+                                          const std::vector<uint32_t> &outputs) {
+    if (finished_) {
+        return false;
+    }
+    for (uint32_t input : inputs) {
+        if (input >= operands_.size() ||
+            operands_[input].lifetime != OperandLifetime::TEMPORARY) {
+            LOGE("ModelGraph::IdentifyInputsAndOutputs: bad input operand (%u)", input);
+            return false;
+        }
+        operands_[input].lifetime = OperandLifetime::MODEL_INPUT;
+    }
+    for (uint32_t output : outputs) {
+        if (output >= operands_.size() ||
+            operands_[output].lifetime != OperandLifetime::TEMPORARY) {
+            LOGE("ModelGraph::IdentifyInputsAndOutputs: bad output operand (%u)", output);
+            return false;
+        }
+        operands_[output].lifetime = OperandLifetime::MODEL_OUTPUT;
+    }
+    inputs_ = inputs;
+    outputs_ = outputs;
+    return true;
+}
+
+/**
+ * Validate the graph: all operands have the same shape (there is no broadcasting), every
+ * operation only reads values that are available by the time it runs, and every
+ * temporary and output operand is written by exactly one operation.
+ */
+bool ModelGraph::Finish() {
+    if (finished_) {
+        return true;
+    }
+    if (operands_.empty() || operations_.empty() || inputs_.empty() || outputs_.empty()) {
+        LOGE("ModelGraph::Finish: empty graph");
+        return false;
+    }
+
+    elementCount_ = operands_[0].elementCount;
+    for (size_t idx = 0; idx < operands_.size(); idx++) {
+        if (operands_[idx].dimensions != operands_[0].dimensions) {
+            LOGE("ModelGraph::Finish: operand (%zu) has a different shape", idx);
+            return false;
+        }
+    }
+
+    std::vector<bool> available(operands_.size());
+    for (size_t idx = 0; idx < operands_.size(); idx++) {
+        available[idx] = operands_[idx].lifetime == OperandLifetime::MODEL_INPUT ||
+                         operands_[idx].lifetime == OperandLifetime::CONSTANT;
+    }
+    for (size_t opIdx = 0; opIdx < operations_.size(); opIdx++) {
+        const Operation &operation = operations_[opIdx];
+        for (uint32_t input : operation.inputs) {
+            if (!available[input]) {
+                LOGE("ModelGraph::Finish: operation (%zu) reads operand (%u) before it "
+                     "is computed", opIdx, input);
+                return false;
+            }
+        }
+        if (available[operation.output]) {
+            LOGE("ModelGraph::Finish: operand (%u) is written more than once",
+                 operation.output);
+            return false;
+        }
+        available[operation.output] = true;
+    }
+    for (uint32_t output : outputs_) {
+        if (!available[output]) {
+            LOGE("ModelGraph::Finish: output operand (%u) is never computed", output);
+            return false;
+        }
+    }
+
+    finished_ = true;
+    return true;
+}
+
+const float *ModelGraph::GetConstantData(uint32_t operand) const {
+    const Operand &value = operands_[operand];
+    if (value.pool == kNoPool) {
+        return value.data;
+    }
+    return reinterpret_cast<const float *>(pools_[value.pool].data + value.poolOffset);
+}
+
+/**
+ * The graph of SimpleModel (see SimpleModel::CreateCompiledModel):
+ *
+ * tensor0 ---+
+ *            +--- ADD ---> intermediateOutput0 ---+
+ * tensor1 ---+                                    |
+ *                                                 +--- MUL---> output
+ * tensor2 ---+                                    |
+ *            +--- ADD ---> intermediateOutput1 ---+
+ * tensor3 ---+
+ */
+bool BuildSimpleGraph(ModelGraph *graph, const std::vector<uint32_t> &dimensions,
+                      uint32_t weightsPool, size_t weightsOffset) {
+    uint32_t tensor0 = graph->AddOperand(dimensions);
+    uint32_t tensor1 = graph->AddOperand(dimensions);
+    uint32_t tensor2 = graph->AddOperand(dimensions);
+    uint32_t tensor3 = graph->AddOperand(dimensions);
+    uint32_t intermediateOutput0 = graph->AddOperand(dimensions);
+    uint32_t intermediateOutput1 = graph->AddOperand(dimensions);
+    uint32_t multiplierOutput = graph->AddOperand(dimensions);
+
+    // tensor0 and tensor2 are the trained weights, stored one after the other.
+    size_t tensorBytes = graph->GetOperands()[tensor0].elementCount * sizeof(float);
+    return graph->SetOperandValueFromPool(tensor0, weightsPool, weightsOffset, tensorBytes) &&
+           graph->SetOperandValueFromPool(tensor2, weightsPool, weightsOffset + tensorBytes,
+                                          tensorBytes) &&
+           graph->AddOperation(OperationType::ADD, {tensor0, tensor1}, intermediateOutput0,
+                               FusedActivation::NONE) &&
+           graph->AddOperation(OperationType::ADD, {tensor2, tensor3}, intermediateOutput1,
+                               FusedActivation::NONE) &&
+           graph->AddOperation(OperationType::MUL, {intermediateOutput0, intermediateOutput1},
+                               multiplierOutput, FusedActivation::NONE) &&
+           graph->IdentifyInputsAndOutputs({tensor1, tensor3}, {multiplierOutput}) &&
+           graph->Finish();
+}
@@ -0,0 +1,176 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_MODEL_GRAPH_H
+#define NNAPI_MODEL_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Operations supported by the graph. All are elementwise over tensors of the same shape.
+ * FUSED operations are made by FuseElementwiseOperations (graph_fusion.h) out of a tree
+ * of ADD and MUL; only the CPU backend runs them.
+ */
+enum class OperationType {
+    ADD,
+    MUL,
+    FUSED,
+};
+
+/**
+ * Activation applied to the result of an operation, with the same semantics
+ * as the NN API FuseCode values.
+ */
+enum class FusedActivation {
+    NONE,
+    RELU,
+    RELU1,
+    RELU6,
+};
+
+/**
+ * Where the value of an operand comes from.
+ */
+enum class OperandLifetime {
+    TEMPORARY,      // computed by an operation, only used inside the graph
+    MODEL_INPUT,    // provided at each execution
+    MODEL_OUTPUT,   // computed by an operation and returned by each execution
+    CONSTANT,       // fixed when the graph is built, e.g. trained weights
+};
+
+/**
+ * A region of memory that holds constant operand values, such as the trained weights in
+ * model_data.bin. Backends that can share memory with the runtime (NN API) use the file
+ * descriptor; the others read the host mapping directly.
+ */
+struct MemoryPool {
+    int fd;
+    size_t size;
+    int protect;
+    const uint8_t *data;
+};
+
+/**
+ * A TENSOR_FLOAT32 operand.
+ */
+struct Operand {
+    std::vector<uint32_t> dimensions;
+    uint32_t elementCount;
+    OperandLifetime lifetime;
+
+    // For CONSTANT operands: either a host pointer (pool == kNoPool), or an offset into one
+    // of the graph's memory pools.
+    const float *data;
+    uint32_t pool;
+    size_t poolOffset;
+};
+
+/**
+ * One ADD or MUL inside a FUSED operation. Operands index the inputs of the fused
+ * operation, then the results of the previous steps: with n inputs, operand n + k is the
+ * result of step k. The last step computes the output.
+ */
+struct FusedStep {
+    OperationType type;
+    uint32_t operands[2];
+    FusedActivation activation;
+};
+
+struct Operation {
+    OperationType type;
+    std::vector<uint32_t> inputs;
+    uint32_t output;
+    FusedActivation activation;
+
+    // for FUSED operations
+    std::vector<FusedStep> steps;
+};
+
+/**
+ * ModelGraph
+ * A small, backend independent description of a model: tensor operands and the
+ * operations between them. It is built the same way as an ANeuralNetworksModel, with
+ * operands identified by the order in which they are added. Backends (NnapiBackend,
+ * CpuBackend) take a finished graph and compile it for their own runtime.
+ *
+ * Operations must be added in execution order: every operation input must be a constant,
+ * a model input, or the output of an earlier operation.
+ */
+class ModelGraph {
+public:
+    static const uint32_t kNoPool = UINT32_MAX;
+
+    // limits on the steps and inputs of a FUSED operation
+    static const uint32_t kMaxFusedSteps = 8;
+    static const uint32_t kMaxFusedInputs = kMaxFusedSteps + 1;
+
+    ModelGraph();
+
+    uint32_t AddMemoryPool(int fd, size_t size, int protect, const void *data);
+    uint32_t AddOperand(const std::vector<uint32_t> &dimensions);
+
+    // Add an operand with the same shape and value as the given operand of another
+    // graph (its memory pool, if any, must have the same index in both graphs).
+    uint32_t AddOperandLike(const Operand &operand);
+
+    bool SetOperandValue(uint32_t operand, const float *data, size_t length);
+    bool SetOperandValueFromPool(uint32_t operand, uint32_t pool, size_t offset,
+                                 size_t length);
+    bool AddOperation(OperationType type, const std::vector<uint32_t> &inputs,
+                      uint32_t output, FusedActivation activation);
+    bool AddFusedOperation(const std::vector<uint32_t> &inputs, uint32_t output,
+                           const std::vector<FusedStep> &steps);
+    bool IdentifyInputsAndOutputs(const std::vector<uint32_t> &inputs,
+                                  const std::vector<uint32_t> &outputs);
+    bool Finish();
+
+    bool IsFinished() const { return finished_; }
+    const std::vector<MemoryPool> &GetMemoryPools() const { return pools_; }
+    const std::vector<Operand> &GetOperands() const { return operands_; }
+    const std::vector<Operation> &GetOperations() const { return operations_; }
+    const std::vector<uint32_t> &GetInputs() const { return inputs_; }
+    const std::vector<uint32_t> &GetOutputs() const { return outputs_; }
+
+    // Host address of the value of a CONSTANT operand.
+    const float *GetConstantData(uint32_t operand) const;
+
+    // Number of elements of each operand the graph reads and writes, all of the same
+    // shape. Valid once the graph is finished.
+    uint32_t GetElementCount() const { return elementCount_; }
+
+private:
+    bool finished_;
+    uint32_t elementCount_;
+    std::vector<MemoryPool> pools_;
+    std::vector<Operand> operands_;
+    std::vector<Operation> operations_;
+    std::vector<uint32_t> inputs_;
+    std::vector<uint32_t> outputs_;
+};
+
+/**
+ * Build the graph of the sample,
+ *        (tensor0 + tensor1) * (tensor2 + tensor3),
+ * with tensors of the given dimensions. tensor0 and tensor2 are constants read from the
+ * given pool at weightsOffset (one tensor after the other); tensor1 and tensor3 are the
+ * model inputs.
+ */
+bool BuildSimpleGraph(ModelGraph *graph, const std::vector<uint32_t> &dimensions,
+                      uint32_t weightsPool, size_t weightsOffset);
+
+#endif  // NNAPI_MODEL_GRAPH_H
@@ -18,12 +18,14 @@
 #include <string>
 #include <iomanip>
 #include <sstream>
+#include <vector>
 #include <fcntl.h>
 
 #include <android/asset_manager_jni.h>
 #include <android/log.h>
 #include <android/sharedmem.h>
 #include <sys/mman.h>
+#include <unistd.h>
 
 #include "simple_model.h"
 
@@ -52,11 +54,22 @@ Java_com_example_android_nnapidemo_MainActivity_initModel(
                             "Failed to open the model_data file descriptor.");
         return 0;
     }
-    SimpleModel* nn_model = new SimpleModel(length, PROT_READ, fd, offset);
+    // The model owns the descriptor it is given. Keep ours, in case we need a second try.
+    SimpleModel* nn_model = new SimpleModel(length, PROT_READ, dup(fd), offset);
     if (!nn_model->CreateCompiledModel()) {
+        // No NN API driver could take the model: run it on the CPU backend instead.
+        delete(nn_model);
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "Failed to prepare the model.");
-        return 0;
+                            "Failed to prepare the model for NN API, using the CPU.");
+        nn_model = new SimpleModel(length, PROT_READ, fd, offset, SimpleModel::BACKEND_CPU);
+        if (!nn_model->CreateCompiledModel()) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                                "Failed to prepare the model.");
+            delete(nn_model);
+            return 0;
+        }
+    } else {
+        close(fd);
     }
 
     return (jlong)(uintptr_t)nn_model;
@@ -77,6 +90,40 @@ Java_com_example_android_nnapidemo_MainActivity_startCompute(
     return result;
 }
 
+extern "C"
+JNIEXPORT jfloatArray
+JNICALL
+Java_com_example_android_nnapidemo_MainActivity_computeBatch(
+        JNIEnv *env,
+        jobject /* this */,
+        jlong _nnModel,
+        jfloatArray inputValues1,
+        jfloatArray inputValues2) {
+    SimpleModel* nn_model = (SimpleModel*) _nnModel;
+    jsize count = env->GetArrayLength(inputValues1);
+    if (env->GetArrayLength(inputValues2) != count) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "The input arrays have different lengths.");
+        return nullptr;
+    }
+
+    std::vector<float> results(count);
+    jfloat *values1 = env->GetFloatArrayElements(inputValues1, nullptr);
+    jfloat *values2 = env->GetFloatArrayElements(inputValues2, nullptr);
+    bool success = nn_model->ComputeBatch(values1, values2, count, results.data());
+    env->ReleaseFloatArrayElements(inputValues1, values1, JNI_ABORT);
+    env->ReleaseFloatArrayElements(inputValues2, values2, JNI_ABORT);
+    if (!success) {
+        return nullptr;
+    }
+
+    jfloatArray resultArray = env->NewFloatArray(count);
+    if (resultArray) {
+        env->SetFloatArrayRegion(resultArray, 0, count, results.data());
+    }
+    return resultArray;
+}
+
 extern "C"
 JNIEXPORT void
 JNICALL
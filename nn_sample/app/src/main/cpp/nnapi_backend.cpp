@@ -0,0 +1,360 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "nnapi_backend.h"
+#include "log_util.h"
+
+namespace {
+
+FuseCode ToFuseCode(FusedActivation activation) {
+    switch (activation) {
+        case FusedActivation::RELU:
+            return ANEURALNETWORKS_FUSED_RELU;
+        case FusedActivation::RELU1:
+            return ANEURALNETWORKS_FUSED_RELU1;
+        case FusedActivation::RELU6:
+            return ANEURALNETWORKS_FUSED_RELU6;
+        case FusedActivation::NONE:
+        default:
+            return ANEURALNETWORKS_FUSED_NONE;
+    }
+}
+
+}  // namespace
+
+NnapiExecution::NnapiExecution(ANeuralNetworksCompilation *compilation, size_t inputCount,
+                               size_t outputCount, uint32_t tensorBytes) :
+        Execution(inputCount, outputCount),
+        compilation_(compilation),
+        tensorBytes_(tensorBytes),
+        inputMemories_(inputCount, {nullptr, 0}),
+        outputMemories_(outputCount, {nullptr, 0}),
+        execution_(nullptr),
+        event_(nullptr) {
+}
+
+NnapiExecution::~NnapiExecution() {
+    if (execution_) {
+        Wait();
+    }
+}
+
+bool NnapiExecution::SetInputFromMemory(uint32_t index, ANeuralNetworksMemory *memory,
+                                        size_t offset) {
+    if (index >= inputMemories_.size()) {
+        return false;
+    }
+    inputMemories_[index] = {memory, offset};
+    return true;
+}
+
+bool NnapiExecution::SetOutputFromMemory(uint32_t index, ANeuralNetworksMemory *memory,
+                                         size_t offset) {
+    if (index >= outputMemories_.size()) {
+        return false;
+    }
+    outputMemories_[index] = {memory, offset};
+    return true;
+}
+
+/**
+ * Tie the inputs and outputs to execution_. Those bound to memory are passed from it, to
+ * minimize the number of copies of raw data; the others are passed from their buffer.
+ */
+bool NnapiExecution::BindAll() {
+    int32_t status = ANEURALNETWORKS_NO_ERROR;
+    for (uint32_t idx = 0; idx < inputs_.size() && status == ANEURALNETWORKS_NO_ERROR; idx++) {
+        if (inputMemories_[idx].memory) {
+            status = ANeuralNetworksExecution_setInputFromMemory(
+                    execution_, idx, nullptr, inputMemories_[idx].memory,
+                    inputMemories_[idx].offset, tensorBytes_);
+        } else if (inputs_[idx]) {
+            status = ANeuralNetworksExecution_setInput(execution_, idx, nullptr, inputs_[idx],
+                                                       tensorBytes_);
+        } else {
+            LOGE("NnapiExecution: no buffer for input (%u)", idx);
+            return false;
+        }
+    }
+    for (uint32_t idx = 0; idx < outputs_.size() && status == ANEURALNETWORKS_NO_ERROR; idx++) {
+        if (outputMemories_[idx].memory) {
+            status = ANeuralNetworksExecution_setOutputFromMemory(
+                    execution_, idx, nullptr, outputMemories_[idx].memory,
+                    outputMemories_[idx].offset, tensorBytes_);
+        } else if (outputs_[idx]) {
+            status = ANeuralNetworksExecution_setOutput(execution_, idx, nullptr, outputs_[idx],
+                                                        tensorBytes_);
+        } else {
+            LOGE("NnapiExecution: no buffer for output (%u)", idx);
+            return false;
+        }
+    }
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("Failed to set the inputs and outputs of the execution");
+        return false;
+    }
+    return true;
+}
+
+bool NnapiExecution::Start() {
+    if (execution_) {
+        LOGE("NnapiExecution::Start: the previous run was not waited for");
+        return false;
+    }
+
+    // Create an ANeuralNetworksExecution object from the compiled model.
+    // Note:
+    //   1. All the input and output data are tied to the ANeuralNetworksExecution object.
+    //   2. Multiple concurrent execution instances could be created from the same compiled model.
+    int32_t status = ANeuralNetworksExecution_create(compilation_, &execution_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksExecution_create failed");
+        execution_ = nullptr;
+        return false;
+    }
+    if (!BindAll()) {
+        ANeuralNetworksExecution_free(execution_);
+        execution_ = nullptr;
+        return false;
+    }
+
+    // Start the execution of the model.
+    // Note that the execution here is asynchronous, and an ANeuralNetworksEvent object will be
+    // created to monitor the status of the execution.
+    status = ANeuralNetworksExecution_startCompute(execution_, &event_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksExecution_startCompute failed");
+        ANeuralNetworksExecution_free(execution_);
+        execution_ = nullptr;
+        event_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool NnapiExecution::Wait() {
+    if (!execution_) {
+        LOGE("NnapiExecution::Wait: nothing was started");
+        return false;
+    }
+
+    // Wait until the completion of the execution. This could be done on a different
+    // thread than the one that started it.
+    int32_t status = ANeuralNetworksEvent_wait(event_);
+    ANeuralNetworksEvent_free(event_);
+    ANeuralNetworksExecution_free(execution_);
+    event_ = nullptr;
+    execution_ = nullptr;
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksEvent_wait failed");
+        return false;
+    }
+    return true;
+}
+
+NnapiBackend::NnapiBackend() :
+        model_(nullptr),
+        compilation_(nullptr),
+        preference_(ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER),
+        tensorBytes_(0),
+        inputCount_(0),
+        outputCount_(0),
+        operandCount_(0) {
+}
+
+NnapiBackend::~NnapiBackend() {
+    ANeuralNetworksCompilation_free(compilation_);
+    ANeuralNetworksModel_free(model_);
+    for (ANeuralNetworksMemory *memory : pools_) {
+        ANeuralNetworksMemory_free(memory);
+    }
+}
+
+/**
+ * Add the tensor operands of the graph, in the same order, so that NN API operand
+ * indexes are the graph's. Constants are set from their memory pool when they have one.
+ */
+bool NnapiBackend::AddOperands(const ModelGraph &graph) {
+    for (const MemoryPool &pool : graph.GetMemoryPools()) {
+        ANeuralNetworksMemory *memory = nullptr;
+        int32_t status = ANeuralNetworksMemory_createFromFd(pool.size, pool.protect, pool.fd,
+                                                            0, &memory);
+        if (status != ANEURALNETWORKS_NO_ERROR) {
+            LOGE("ANeuralNetworksMemory_createFromFd failed for a memory pool");
+            return false;
+        }
+        pools_.push_back(memory);
+    }
+
+    const std::vector<Operand> &operands = graph.GetOperands();
+    for (uint32_t idx = 0; idx < operands.size(); idx++) {
+        const Operand &operand = operands[idx];
+        ANeuralNetworksOperandType float32TensorType{
+                .type = ANEURALNETWORKS_TENSOR_FLOAT32,
+                .dimensionCount = static_cast<uint32_t>(operand.dimensions.size()),
+                .dimensions = operand.dimensions.data(),
+                .scale = 0.0f,
+                .zeroPoint = 0,
+        };
+        int32_t status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
+        if (status != ANEURALNETWORKS_NO_ERROR) {
+            LOGE("ANeuralNetworksModel_addOperand failed for operand (%u)", idx);
+            return false;
+        }
+        if (operand.lifetime != OperandLifetime::CONSTANT) {
+            continue;
+        }
+
+        size_t length = operand.elementCount * sizeof(float);
+        if (operand.pool == ModelGraph::kNoPool) {
+            status = ANeuralNetworksModel_setOperandValue(model_, idx, operand.data, length);
+        } else {
+            status = ANeuralNetworksModel_setOperandValueFromMemory(
+                    model_, idx, pools_[operand.pool], operand.poolOffset, length);
+        }
+        if (status != ANEURALNETWORKS_NO_ERROR) {
+            LOGE("ANeuralNetworksModel_setOperandValue failed for operand (%u)", idx);
+            return false;
+        }
+    }
+    operandCount_ = static_cast<uint32_t>(operands.size());
+    return true;
+}
+
+/**
+ * Add the operations. NN API takes the fused activation as a constant INT32 scalar
+ * operand; one is added for each FuseCode the graph uses, and shared by the operations.
+ */
+bool NnapiBackend::AddOperations(const ModelGraph &graph) {
+    ANeuralNetworksOperandType scalarInt32Type{
+            .type = ANEURALNETWORKS_INT32,
+            .dimensionCount = 0,
+            .dimensions = nullptr,
+            .scale = 0.0f,
+            .zeroPoint = 0,
+    };
+
+    activationOperands_.assign(ANEURALNETWORKS_FUSED_RELU6 + 1, -1);
+    const std::vector<Operation> &operations = graph.GetOperations();
+    for (size_t opIdx = 0; opIdx < operations.size(); opIdx++) {
+        const Operation &operation = operations[opIdx];
+        if (operation.type == OperationType::FUSED) {
+            LOGE("NnapiBackend: FUSED operation (%zu) is not supported", opIdx);
+            return false;
+        }
+        FuseCode fuseCode = ToFuseCode(operation.activation);
+        if (activationOperands_[fuseCode] < 0) {
+            int32_t status = ANeuralNetworksModel_addOperand(model_, &scalarInt32Type);
+            if (status == ANEURALNETWORKS_NO_ERROR) {
+                status = ANeuralNetworksModel_setOperandValue(model_, operandCount_,
+                                                              &fuseCode, sizeof(fuseCode));
+            }
+            if (status != ANEURALNETWORKS_NO_ERROR) {
+                LOGE("Failed to add the fused activation operand (%u)", operandCount_);
+                return false;
+            }
+            activationOperands_[fuseCode] = operandCount_++;
+        }
+
+        uint32_t inputOperands[] = {
+                operation.inputs[0],
+                operation.inputs[1],
+                static_cast<uint32_t>(activationOperands_[fuseCode]),
+        };
+        ANeuralNetworksOperationType type = operation.type == OperationType::ADD
+                                            ? ANEURALNETWORKS_ADD : ANEURALNETWORKS_MUL;
+        int32_t status = ANeuralNetworksModel_addOperation(
+                model_, type, sizeof(inputOperands) / sizeof(inputOperands[0]),
+                inputOperands, 1, &operation.output);
+        if (status != ANEURALNETWORKS_NO_ERROR) {
+            LOGE("ANeuralNetworksModel_addOperation failed for operation (%zu)", opIdx);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NnapiBackend::Prepare(const ModelGraph &graph) {
+    if (!graph.IsFinished()) {
+        LOGE("NnapiBackend::Prepare: the graph is not finished");
+        return false;
+    }
+    tensorBytes_ = graph.GetElementCount() * sizeof(float);
+    inputCount_ = graph.GetInputs().size();
+    outputCount_ = graph.GetOutputs().size();
+
+    int32_t status = ANeuralNetworksModel_create(&model_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksModel_create failed");
+        return false;
+    }
+    if (!AddOperands(graph) || !AddOperations(graph)) {
+        return false;
+    }
+
+    const std::vector<uint32_t> &inputs = graph.GetInputs();
+    const std::vector<uint32_t> &outputs = graph.GetOutputs();
+    status = ANeuralNetworksModel_identifyInputsAndOutputs(model_,
+                                                           inputs.size(), inputs.data(),
+                                                           outputs.size(), outputs.data());
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksModel_identifyInputsAndOutputs failed");
+        return false;
+    }
+
+    // Finish constructing the model.
+    // The values of constant and intermediate operands cannot be altered after
+    // the finish function is called.
+    status = ANeuralNetworksModel_finish(model_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksModel_finish failed");
+        return false;
+    }
+
+    // Create the ANeuralNetworksCompilation object for the constructed model.
+    status = ANeuralNetworksCompilation_create(model_, &compilation_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksCompilation_create failed");
+        return false;
+    }
+
+    // Set the preference for the compilation, so that the runtime and drivers
+    // can make better decisions.
+    status = ANeuralNetworksCompilation_setPreference(compilation_, preference_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksCompilation_setPreference failed");
+        return false;
+    }
+
+    status = ANeuralNetworksCompilation_finish(compilation_);
+    if (status != ANEURALNETWORKS_NO_ERROR) {
+        LOGE("ANeuralNetworksCompilation_finish failed");
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<Execution> NnapiBackend::CreateExecution() {
+    return CreateNnapiExecution();
+}
+
+std::unique_ptr<NnapiExecution> NnapiBackend::CreateNnapiExecution() {
+    if (!compilation_) {
+        LOGE("NnapiBackend::CreateExecution: the model is not compiled");
+        return nullptr;
+    }
+    return std::unique_ptr<NnapiExecution>(
+            new NnapiExecution(compilation_, inputCount_, outputCount_, tensorBytes_));
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_NNAPI_BACKEND_H
+#define NNAPI_NNAPI_BACKEND_H
+
+#include <android/NeuralNetworks.h>
+
+#include "backend.h"
+
+/**
+ * NnapiExecution
+ * Keeps the input and output bindings of NN API executions. An ANeuralNetworksExecution
+ * can only be computed once, so Start() creates one from the compilation and binds it,
+ * and Wait() frees it; the bindings, and any memory the inputs and outputs are passed
+ * through, are set up once.
+ */
+class NnapiExecution : public Execution {
+public:
+    NnapiExecution(ANeuralNetworksCompilation *compilation, size_t inputCount,
+                   size_t outputCount, uint32_t tensorBytes);
+    ~NnapiExecution() override;
+
+    // Pass the given model input (or output) to the runtime from memory, rather than
+    // from the buffer given to SetInput (SetOutput). That buffer may then be null, or
+    // the host mapping of the memory, for whoever fills it (reads it).
+    bool SetInputFromMemory(uint32_t index, ANeuralNetworksMemory *memory, size_t offset);
+    bool SetOutputFromMemory(uint32_t index, ANeuralNetworksMemory *memory, size_t offset);
+
+    bool Start() override;
+    bool Wait() override;
+
+private:
+    struct MemoryBinding {
+        ANeuralNetworksMemory *memory;
+        size_t offset;
+    };
+
+    bool BindAll();
+
+    ANeuralNetworksCompilation *compilation_;
+    uint32_t tensorBytes_;
+    std::vector<MemoryBinding> inputMemories_;
+    std::vector<MemoryBinding> outputMemories_;
+
+    // the run in flight, if any
+    ANeuralNetworksExecution *execution_;
+    ANeuralNetworksEvent *event_;
+};
+
+/**
+ * NnapiBackend
+ * Translates a ModelGraph into an ANeuralNetworksModel, compiles it and runs it through
+ * the NN API runtime. Constants in memory pools are passed as ANeuralNetworksMemory, so
+ * the runtime reads them straight from the file they are in.
+ */
+class NnapiBackend : public Backend {
+public:
+    NnapiBackend();
+    ~NnapiBackend() override;
+
+    const char *GetName() const override { return "NNAPI"; }
+
+    // Must be called before Prepare. Defaults to ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER.
+    void SetPreference(int32_t preference) { preference_ = preference; }
+
+    bool Prepare(const ModelGraph &graph) override;
+    std::unique_ptr<Execution> CreateExecution() override;
+
+    // Same as CreateExecution, for callers that pass inputs or outputs through memory.
+    std::unique_ptr<NnapiExecution> CreateNnapiExecution();
+
+private:
+    bool AddOperands(const ModelGraph &graph);
+    bool AddOperations(const ModelGraph &graph);
+
+    ANeuralNetworksModel *model_;
+    ANeuralNetworksCompilation *compilation_;
+    int32_t preference_;
+    uint32_t tensorBytes_;
+    size_t inputCount_;
+    size_t outputCount_;
+
+    // one ANeuralNetworksMemory per memory pool of the graph
+    std::vector<ANeuralNetworksMemory *> pools_;
+
+    // NN API operand holding each FuseCode, created when first used
+    std::vector<int64_t> activationOperands_;
+    uint32_t operandCount_;
+};
+
+#endif  // NNAPI_NNAPI_BACKEND_H
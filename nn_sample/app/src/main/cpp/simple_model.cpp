@@ -14,10 +14,13 @@
  * limitations under the License.
  */
 #include "simple_model.h"
+#include "nnapi_backend.h"
 
 #include <android/log.h>
 #include <android/sharedmem.h>
 #include <sys/mman.h>
+#include <algorithm>
+#include <climits>
 #include <string>
 #include <unistd.h>
 
@@ -26,46 +29,145 @@
  *
  * Initialize the member variables, including the shared memory objects.
  */
-SimpleModel::SimpleModel(size_t size, int protect, int fd, size_t offset) :
-        model_(nullptr),
-        compilation_(nullptr),
+SimpleModel::SimpleModel(size_t size, int protect, int fd, size_t offset,
+                         BackendType backendType) :
+        backendType_(backendType),
+        modelData_(MAP_FAILED),
+        modelDataSize_(size + offset),
+        modelPool_(ModelGraph::kNoPool),
         dimLength_(TENSOR_SIZE),
+        offset_(offset),
         modelDataFd_(fd),
-        offset_(offset) {
+        nextTicket_(0) {
     tensorSize_ = dimLength_;
-    inputTensor1_.resize(tensorSize_);
-
-    // Create ANeuralNetworksMemory from a file containing the trained data.
-    int32_t status = ANeuralNetworksMemory_createFromFd(size + offset, protect, fd, 0,
-                                                        &memoryModel_);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+    referenceOutput_.resize(tensorSize_);
+    for (ExecutionSlot &slot : slots_) {
+        slot.inputTensor2Fd = -1;
+        slot.outputTensorFd = -1;
+        slot.memoryInput2 = nullptr;
+        slot.memoryOutput = nullptr;
+        slot.inputTensor2 = nullptr;
+        slot.outputTensor = nullptr;
+        slot.ticket = -1;
+    }
+
+    // Map the file containing the trained data, so that the CPU backend can read it. NN API
+    // gets the file descriptor instead, and creates its own ANeuralNetworksMemory from it.
+    modelData_ = mmap(nullptr, modelDataSize_, protect, MAP_SHARED, fd, 0);
+    if (modelData_ == MAP_FAILED) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksMemory_createFromFd failed for trained weights");
+                            "mmap failed for trained weights");
         return;
     }
+    modelPool_ = graph_.AddMemoryPool(fd, modelDataSize_, protect, modelData_);
+
+    for (ExecutionSlot &slot : slots_) {
+        if (!CreateSlot(&slot)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Allocate the input and output tensors of an execution slot.
+ */
+bool SimpleModel::CreateSlot(ExecutionSlot *slot) {
+    slot->inputTensor1.resize(tensorSize_);
 
     // Create ASharedMemory to hold the data for the second input tensor and output output tensor.
-    inputTensor2Fd_ = ASharedMemory_create("input2", tensorSize_ * sizeof(float));
-    outputTensorFd_ = ASharedMemory_create("output", tensorSize_ * sizeof(float));
+    slot->inputTensor2Fd = ASharedMemory_create("input2", tensorSize_ * sizeof(float));
+    slot->outputTensorFd = ASharedMemory_create("output", tensorSize_ * sizeof(float));
 
     // Create ANeuralNetworksMemory objects from the corresponding ASharedMemory objects.
-    status = ANeuralNetworksMemory_createFromFd(tensorSize_ * sizeof(float),
-                                                PROT_READ,
-                                                inputTensor2Fd_, 0,
-                                                &memoryInput2_);
+    int32_t status = ANeuralNetworksMemory_createFromFd(tensorSize_ * sizeof(float),
+                                                        PROT_READ,
+                                                        slot->inputTensor2Fd, 0,
+                                                        &slot->memoryInput2);
     if (status != ANEURALNETWORKS_NO_ERROR) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
                             "ANeuralNetworksMemory_createFromFd failed for Input2");
-        return;
+        return false;
     }
     status = ANeuralNetworksMemory_createFromFd(tensorSize_ * sizeof(float),
                                                 PROT_READ | PROT_WRITE,
-                                                outputTensorFd_, 0,
-                                                &memoryOutput_);
+                                                slot->outputTensorFd, 0,
+                                                &slot->memoryOutput);
     if (status != ANEURALNETWORKS_NO_ERROR) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
                             "ANeuralNetworksMemory_createFromFd failed for Output");
-        return;
+        return false;
+    }
+
+    // Map the shared memory once: we write tensor3 and read the output through these
+    // mappings for every computation.
+    void *inputTensor2 = mmap(nullptr, tensorSize_ * sizeof(float), PROT_READ | PROT_WRITE,
+                              MAP_SHARED, slot->inputTensor2Fd, 0);
+    void *outputTensor = mmap(nullptr, tensorSize_ * sizeof(float), PROT_READ | PROT_WRITE,
+                              MAP_SHARED, slot->outputTensorFd, 0);
+    if (inputTensor2 != MAP_FAILED) {
+        slot->inputTensor2 = reinterpret_cast<float *>(inputTensor2);
+    }
+    if (outputTensor != MAP_FAILED) {
+        slot->outputTensor = reinterpret_cast<float *>(outputTensor);
+    }
+    if (!slot->inputTensor2 || !slot->outputTensor) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                            "mmap failed for the input2 or output shared memory");
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Create the execution of a slot on the backend, and bind it to the slot's tensors.
+ */
+bool SimpleModel::CreateSlotExecution(ExecutionSlot *slot) {
+    if (!slot->inputTensor2 || !slot->outputTensor) {
+        return false;
+    }
+
+    if (backendType_ == BACKEND_NNAPI) {
+        std::unique_ptr<NnapiExecution> execution =
+                static_cast<NnapiBackend *>(backend_.get())->CreateNnapiExecution();
+        if (!execution) {
+            return false;
+        }
+
+        // tensor3 and the output are passed through shared memory, to minimize the copies
+        // of raw data. Note that the index "1" here means the second operand of the model
+        // inputs {tensor1, tensor3}, which means tensor3.
+        execution->SetInputFromMemory(1, slot->memoryInput2, 0);
+        execution->SetOutputFromMemory(0, slot->memoryOutput, 0);
+        slot->execution = std::move(execution);
+    } else {
+        slot->execution = backend_->CreateExecution();
+        if (!slot->execution) {
+            return false;
+        }
+    }
+    slot->execution->SetInput(0, slot->inputTensor1.data());
+    slot->execution->SetInput(1, slot->inputTensor2);
+    slot->execution->SetOutput(0, slot->outputTensor);
+    return true;
+}
+
+void SimpleModel::DestroySlot(ExecutionSlot *slot) {
+    // This waits for the computation in flight, if any.
+    slot->execution.reset();
+
+    if (slot->inputTensor2) {
+        munmap(slot->inputTensor2, tensorSize_ * sizeof(float));
+    }
+    if (slot->outputTensor) {
+        munmap(slot->outputTensor, tensorSize_ * sizeof(float));
+    }
+    ANeuralNetworksMemory_free(slot->memoryInput2);
+    ANeuralNetworksMemory_free(slot->memoryOutput);
+    if (slot->inputTensor2Fd >= 0) {
+        close(slot->inputTensor2Fd);
+    }
+    if (slot->outputTensorFd >= 0) {
+        close(slot->outputTensorFd);
     }
 }
 
@@ -93,7 +195,8 @@ SimpleModel::SimpleModel(size_t size, int protect, int fd, size_t offset) :
  * Besides the two input tensors, an optional fused activation function can
  * also be defined for ADD and MUL. In this example, we'll simply set it to NONE.
  *
- * The graph then has 10 operands:
+ * The graph is built as a ModelGraph (see BuildSimpleGraph), then compiled by the backend.
+ * For NN API, NnapiBackend turns it into an ANeuralNetworksModel of 8 operands:
  *  - 2 tensors that are inputs to the model. These are fed to the two
  *      ADD operations.
  *  - 2 constant tensors that are the other two inputs to the ADD operations.
@@ -105,266 +208,102 @@ SimpleModel::SimpleModel(size_t size, int protect, int fd, size_t offset) :
  * @return true for success, false otherwise
  */
 bool SimpleModel::CreateCompiledModel() {
-    int32_t status;
-
-    // Create the ANeuralNetworksModel handle.
-    status = ANeuralNetworksModel_create(&model_);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_create failed");
+    if (modelPool_ == ModelGraph::kNoPool) {
         return false;
     }
 
-    uint32_t dimensions[] = {dimLength_};
-    ANeuralNetworksOperandType float32TensorType{
-            .type = ANEURALNETWORKS_TENSOR_FLOAT32,
-            .dimensionCount = sizeof(dimensions) / sizeof(dimensions[0]),
-            .dimensions = dimensions,
-            .scale = 0.0f,
-            .zeroPoint = 0,
-    };
-    ANeuralNetworksOperandType scalarInt32Type{
-            .type = ANEURALNETWORKS_INT32,
-            .dimensionCount = 0,
-            .dimensions = nullptr,
-            .scale = 0.0f,
-            .zeroPoint = 0,
-    };
-
-    /**
-     * Add operands and operations to construct the model.
-     *
-     * Operands are implicitly identified by the order in which they are added to the model,
-     * starting from 0.
-     *
-     * These indexes are not returned by the model_addOperand call. The application must
-     * manage these values. Here, we use opIdx to do the bookkeeping.
-     */
-    uint32_t opIdx = 0;
-
-    // We first add the operand for the NONE activation function, and set its
-    // value to ANEURALNETWORKS_FUSED_NONE.
-    // This constant scalar operand will be used for all 3 operations.
-    status = ANeuralNetworksModel_addOperand(model_, &scalarInt32Type);
-    uint32_t fusedActivationFuncNone = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+    // tensor0 and tensor2 are read from the trained data file, starting at offset_.
+    if (!BuildSimpleGraph(&graph_, {dimLength_}, modelPool_, offset_)) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            fusedActivationFuncNone);
+                            "Failed to build the model graph");
         return false;
     }
 
-    FuseCode fusedActivationCodeValue = ANEURALNETWORKS_FUSED_NONE;
-    status = ANeuralNetworksModel_setOperandValue(
-            model_, fusedActivationFuncNone, &fusedActivationCodeValue,
-            sizeof(fusedActivationCodeValue));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_setOperandValue failed for operand (%d)",
-                            fusedActivationFuncNone);
-        return false;
-    }
-
-    // Add operands for the tensors.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t tensor0 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            tensor0);
-        return false;
-    }
-    // tensor0 is a constant tensor that was established during training.
-    // We read these values from the corresponding ANeuralNetworksMemory object.
-    status = ANeuralNetworksModel_setOperandValueFromMemory(model_,
-                                                            tensor0,
-                                                            memoryModel_,
-                                                            offset_,
-                                                            tensorSize_ * sizeof(float));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_setOperandValueFromMemory failed for operand (%d)",
-                            tensor0);
-        return false;
-    }
-
-    // tensor1 is one of the user provided input tensors to the trained model.
-    // Its value is determined pre-execution.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t tensor1 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            tensor1);
-        return false;
-    }
+    if (backendType_ == BACKEND_NNAPI) {
+        std::unique_ptr<NnapiBackend> nnapiBackend(new NnapiBackend());
 
-    // tensor2 is a constant tensor that was established during training.
-    // We read these values from the corresponding ANeuralNetworksMemory object.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t tensor2 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            tensor2);
-        return false;
-    }
-    status = ANeuralNetworksModel_setOperandValueFromMemory(
-            model_, tensor2, memoryModel_, offset_ + tensorSize_ * sizeof(float),
-            tensorSize_ * sizeof(float));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_setOperandValueFromMemory failed for operand (%d)",
-                            tensor2);
-        return false;
-    }
-
-    // tensor3 is one of the user provided input tensors to the trained model.
-    // Its value is determined pre-execution.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t tensor3 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            tensor3);
-        return false;
-    }
-
-    // intermediateOutput0 is the output of the first ADD operation.
-    // Its value is computed during execution.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t intermediateOutput0 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            intermediateOutput0);
-        return false;
-    }
-
-    // intermediateOutput1 is the output of the second ADD operation.
-    // Its value is computed during execution.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t intermediateOutput1 = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            intermediateOutput1);
-        return false;
-    }
+        // Here we prefer to get the answer quickly, so we choose
+        // ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER.
+        nnapiBackend->SetPreference(ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER);
+        backend_ = std::move(nnapiBackend);
 
-    // multiplierOutput is the output of the MUL operation.
-    // Its value will be computed during execution.
-    status = ANeuralNetworksModel_addOperand(model_, &float32TensorType);
-    uint32_t multiplierOutput = opIdx++;
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperand failed for operand (%d)",
-                            multiplierOutput);
-        return false;
+        // The sample's tensors are far too small to be worth splitting across threads.
+        referenceBackend_.reset(new CpuBackend(1));
+        if (!referenceBackend_->Prepare(graph_)) {
+            return false;
+        }
+    } else {
+        backend_.reset(new CpuBackend());
     }
 
-    // Add the first ADD operation.
-    std::vector<uint32_t> add1InputOperands = {
-            tensor0,
-            tensor1,
-            fusedActivationFuncNone,
-    };
-    status = ANeuralNetworksModel_addOperation(model_, ANEURALNETWORKS_ADD,
-                                               add1InputOperands.size(), add1InputOperands.data(),
-                                               1, &intermediateOutput0);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+    if (!backend_->Prepare(graph_)) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperation failed for ADD_1");
+                            "Failed to prepare the %s backend", backend_->GetName());
         return false;
     }
 
-    // Add the second ADD operation.
-    // Note the fusedActivationFuncNone is used again.
-    std::vector<uint32_t> add2InputOperands = {
-            tensor2,
-            tensor3,
-            fusedActivationFuncNone,
-    };
-    status = ANeuralNetworksModel_addOperation(model_, ANEURALNETWORKS_ADD,
-                                               add2InputOperands.size(),add2InputOperands.data(),
-                                               1, &intermediateOutput1);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperation failed for ADD_2");
-        return false;
+    for (ExecutionSlot &slot : slots_) {
+        if (!CreateSlotExecution(&slot)) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                                "Failed to create the executions");
+            return false;
+        }
     }
+    return true;
+}
 
-    // Add the MUL operation.
-    // Note that intermediateOutput0 and intermediateOutput1 are specified
-    // as inputs to the operation.
-    std::vector<uint32_t> mulInputOperands = {
-            intermediateOutput0,
-            intermediateOutput1,
-            fusedActivationFuncNone};
-    status = ANeuralNetworksModel_addOperation(model_, ANEURALNETWORKS_MUL,
-                                               mulInputOperands.size(),mulInputOperands.data(),
-                                               1, &multiplierOutput);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_addOperation failed for MUL");
-        return false;
+/**
+ * Fill the inputs of a free slot and start computing on it.
+ * @return the slot, or nullptr if there is error or no free slot.
+ */
+SimpleModel::ExecutionSlot *SimpleModel::StartSlot(float inputValue1, float inputValue2) {
+    ExecutionSlot *slot = nullptr;
+    for (ExecutionSlot &candidate : slots_) {
+        if (candidate.execution && candidate.ticket < 0) {
+            slot = &candidate;
+            break;
+        }
     }
-
-    // Identify the input and output tensors to the model.
-    // Inputs: {tensor1, tensor3}
-    // Outputs: {multiplierOutput}
-    std::vector<uint32_t> modelInputOperands = {
-            tensor1, tensor3,
-    };
-    status = ANeuralNetworksModel_identifyInputsAndOutputs(model_,
-                                                           modelInputOperands.size(),
-                                                           modelInputOperands.data(),
-                                                           1,
-                                                           &multiplierOutput);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+    if (!slot) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_identifyInputsAndOutputs failed");
-        return false;
+                            "No free execution slot");
+        return nullptr;
     }
 
-    // Finish constructing the model.
-    // The values of constant and intermediate operands cannot be altered after
-    // the finish function is called.
-    status = ANeuralNetworksModel_finish(model_);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksModel_finish failed");
-        return false;
-    }
+    // Set all the elements of the first input tensor (tensor1) to the same value as inputValue1.
+    // It's not a realistic example but it shows how to pass a small tensor
+    // to an execution.
+    std::fill(slot->inputTensor1.begin(), slot->inputTensor1.end(), inputValue1);
 
-    // Create the ANeuralNetworksCompilation object for the constructed model.
-    status = ANeuralNetworksCompilation_create(model_, &compilation_);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksCompilation_create failed");
-        return false;
-    }
+    // Set the values of the the second input operand (tensor3) to be inputValue2.
+    // In reality, the values in the shared memory region will be manipulated by
+    // other modules or processes.
+    std::fill(slot->inputTensor2, slot->inputTensor2 + tensorSize_, inputValue2);
 
-    // Set the preference for the compilation, so that the runtime and drivers
-    // can make better decisions.
-    // Here we prefer to get the answer quickly, so we choose
-    // ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER.
-    status = ANeuralNetworksCompilation_setPreference(compilation_,
-                                                      ANEURALNETWORKS_PREFER_FAST_SINGLE_ANSWER);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+    if (!slot->execution->Start()) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksCompilation_setPreference failed");
-        return false;
+                            "Failed to start the execution on the %s backend",
+                            backend_->GetName());
+        return nullptr;
     }
+    slot->ticket = nextTicket_;
+    nextTicket_ = nextTicket_ == INT_MAX ? 0 : nextTicket_ + 1;
+    return slot;
+}
 
-    // Finish the compilation.
-    status = ANeuralNetworksCompilation_finish(compilation_);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
+/**
+ * Wait for the computation of a slot, read its result and free the slot. The tensors
+ * keep their values until the slot is started again.
+ */
+bool SimpleModel::FinishSlot(ExecutionSlot *slot, float *result) {
+    bool success = slot->execution->Wait();
+    slot->ticket = -1;
+    if (!success) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksCompilation_finish failed");
+                            "Execution failed on the %s backend", backend_->GetName());
         return false;
     }
-
+    *result = slot->outputTensor[0];
     return true;
 }
 
@@ -381,128 +320,88 @@ bool SimpleModel::Compute(float inputValue1, float inputValue2,
         return false;
     }
 
-    // Create an ANeuralNetworksExecution object from the compiled model.
-    // Note:
-    //   1. All the input and output data are tied to the ANeuralNetworksExecution object.
-    //   2. Multiple concurrent execution instances could be created from the same compiled model.
-    // This sample only uses one execution of the compiled model.
-    ANeuralNetworksExecution *execution;
-    int32_t status = ANeuralNetworksExecution_create(compilation_, &execution);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksExecution_create failed");
+    ExecutionSlot *slot = StartSlot(inputValue1, inputValue2);
+    if (!slot || !FinishSlot(slot, result)) {
         return false;
     }
 
-    // Set all the elements of the first input tensor (tensor1) to the same value as inputValue1.
-    // It's not a realistic example but it shows how to pass a small tensor
-    // to an execution.
-    std::fill(inputTensor1_.data(), inputTensor1_.data() + tensorSize_,
-              inputValue1);
-
-    // Tell the execution to associate inputTensor1 to the first of the two model inputs.
-    // Note that the index "0" here means the first operand of the modelInput list
-    // {tensor1, tensor3}, which means tensor1.
-    status = ANeuralNetworksExecution_setInput(execution, 0, nullptr,
-                                               inputTensor1_.data(),
-                                               tensorSize_ * sizeof(float));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksExecution_setInput failed for input1");
-        return false;
+    // Validate the results against the CPU backend.
+    if (referenceBackend_ &&
+        referenceBackend_->Execute({slot->inputTensor1.data(), slot->inputTensor2},
+                                   {referenceOutput_.data()})) {
+        for (int32_t idx = 0; idx < tensorSize_; idx++) {
+            float delta = slot->outputTensor[idx] - referenceOutput_[idx];
+            delta = (delta < 0.0f) ? (-delta) : delta;
+            if (delta > FLOAT_EPISILON) {
+                __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                                    "Output computation Error: output0(%f), delta(%f) @ idx(%d)",
+                                    slot->outputTensor[0], delta, idx);
+            }
+        }
     }
+    return true;
+}
 
-    // Set the values of the the second input operand (tensor3) to be inputValue2.
-    // In reality, the values in the shared memory region will be manipulated by
-    // other modules or processes.
-    float *inputTensor2Ptr = reinterpret_cast<float *>(mmap(nullptr, tensorSize_ * sizeof(float),
-                                                            PROT_READ | PROT_WRITE, MAP_SHARED,
-                                                            inputTensor2Fd_, 0));
-    for (int i = 0; i < tensorSize_; i++) {
-        *inputTensor2Ptr = inputValue2;
-        inputTensor2Ptr++;
-    }
-    munmap(inputTensor2Ptr, tensorSize_ * sizeof(float));
-
-    // ANeuralNetworksExecution_setInputFromMemory associates the operand with a shared memory
-    // region to minimize the number of copies of raw data.
-    // Note that the index "1" here means the second operand of the modelInput list
-    // {tensor1, tensor3}, which means tensor3.
-    status = ANeuralNetworksExecution_setInputFromMemory(execution, 1, nullptr,
-                                                         memoryInput2_, 0,
-                                                         tensorSize_ * sizeof(float));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksExecution_setInputFromMemory failed for input2");
+/**
+ * Compute for a batch of input pairs. Up to kPipelineDepth computations are in flight:
+ * the inputs of the next one are filled, and the result of the oldest one is read,
+ * while the others run.
+ */
+bool SimpleModel::ComputeBatch(const float *inputValues1, const float *inputValues2,
+                               size_t count, float *results) {
+    if (!inputValues1 || !inputValues2 || !results) {
         return false;
     }
 
-    // Set the output tensor that will be filled by executing the model.
-    // We use shared memory here to minimize the copies needed for getting the output data.
-    status = ANeuralNetworksExecution_setOutputFromMemory(execution, 0, nullptr,
-                                                          memoryOutput_, 0,
-                                                          tensorSize_ * sizeof(float));
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksExecution_setOutputFromMemory failed for output");
-        return false;
+    int tickets[kPipelineDepth];
+    std::fill(tickets, tickets + kPipelineDepth, -1);
+    bool success = true;
+    for (size_t idx = 0; idx < count + kPipelineDepth; idx++) {
+        // This entry was submitted kPipelineDepth iterations ago.
+        int &ticket = tickets[idx % kPipelineDepth];
+        if (ticket >= 0) {
+            success = WaitCompute(ticket, &results[idx - kPipelineDepth]) && success;
+            ticket = -1;
+        }
+        if (idx < count && success) {
+            ticket = SubmitCompute(inputValues1[idx], inputValues2[idx]);
+            success = ticket >= 0;
+        }
     }
+    return success;
+}
 
-    // Start the execution of the model.
-    // Note that the execution here is asynchronous, and an ANeuralNetworksEvent object will be
-    // created to monitor the status of the execution.
-    ANeuralNetworksEvent *event = nullptr;
-    status = ANeuralNetworksExecution_startCompute(execution, &event);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksExecution_startCompute failed");
-        return false;
-    }
+int SimpleModel::SubmitCompute(float inputValue1, float inputValue2) {
+    ExecutionSlot *slot = StartSlot(inputValue1, inputValue2);
+    return slot ? slot->ticket : -1;
+}
 
-    // Wait until the completion of the execution. This could be done on a different
-    // thread. By waiting immediately, we effectively make this a synchronous call.
-    status = ANeuralNetworksEvent_wait(event);
-    if (status != ANEURALNETWORKS_NO_ERROR) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                            "ANeuralNetworksEvent_wait failed");
+bool SimpleModel::WaitCompute(int ticket, float *result) {
+    if (!result || ticket < 0) {
         return false;
     }
-
-    ANeuralNetworksEvent_free(event);
-    ANeuralNetworksExecution_free(execution);
-
-    // Validate the results.
-    const float goldenRef = (inputValue1 + 0.5f) * (inputValue2 + 0.5f);
-    float *outputTensorPtr = reinterpret_cast<float *>(mmap(nullptr,
-                                                            tensorSize_ * sizeof(float),
-                                                            PROT_READ, MAP_SHARED,
-                                                            outputTensorFd_, 0));
-    for (int32_t idx = 0; idx < tensorSize_; idx++) {
-        float delta = outputTensorPtr[idx] - goldenRef;
-        delta = (delta < 0.0f) ? (-delta) : delta;
-        if (delta > FLOAT_EPISILON) {
-            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
-                                "Output computation Error: output0(%f), delta(%f) @ idx(%d)",
-                                outputTensorPtr[0], delta, idx);
+    for (ExecutionSlot &slot : slots_) {
+        if (slot.ticket == ticket) {
+            return FinishSlot(&slot, result);
         }
     }
-    *result = outputTensorPtr[0];
-    munmap(outputTensorPtr, tensorSize_ * sizeof(float));
-    return result;
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG,
+                        "No computation in flight for ticket (%d)", ticket);
+    return false;
 }
 
 /**
  * SimpleModel Destructor.
  *
- * Release NN API objects and close the file descriptors.
+ * Release the executions, backends and NN API objects, and close the file descriptors.
  */
 SimpleModel::~SimpleModel() {
-    ANeuralNetworksCompilation_free(compilation_);
-    ANeuralNetworksModel_free(model_);
-    ANeuralNetworksMemory_free(memoryModel_);
-    ANeuralNetworksMemory_free(memoryInput2_);
-    ANeuralNetworksMemory_free(memoryOutput_);
-    close(inputTensor2Fd_);
-    close(outputTensorFd_);
+    for (ExecutionSlot &slot : slots_) {
+        DestroySlot(&slot);
+    }
+    backend_.reset();
+    if (modelData_ != MAP_FAILED) {
+        munmap(modelData_, modelDataSize_);
+    }
     close(modelDataFd_);
-}
\ No newline at end of file
+}
@@ -18,8 +18,12 @@
 #define NNAPI_SIMPLE_MODEL_H
 
 #include <android/NeuralNetworks.h>
+#include <memory>
 #include <vector>
 
+#include "backend.h"
+#include "cpu_backend.h"
+
 #define FLOAT_EPISILON (1e-6)
 #define TENSOR_SIZE 200
 #define LOG_TAG "NNAPI_DEMO"
@@ -35,30 +39,85 @@
  *       dimLength x dimLength
  *   with NO fused_activation operation
  *
+ * The graph is described once as a ModelGraph, and run by the chosen backend. Results
+ * of Compute are checked against the CPU backend.
+ *
+ * Computations go through a small ring of execution slots. Each slot owns its input and
+ * output tensors, mapped once, and an Execution bound to them once, so a computation
+ * only refills the inputs. With several slots, filling the inputs of the next
+ * computation and reading the result of the previous one overlap with the one in
+ * flight (see SubmitCompute, WaitCompute and ComputeBatch).
  */
 class SimpleModel {
 public:
-    explicit SimpleModel(size_t size, int protect, int fd, size_t offset);
+    enum BackendType {
+        BACKEND_NNAPI,
+        BACKEND_CPU,
+    };
+
+    explicit SimpleModel(size_t size, int protect, int fd, size_t offset,
+                         BackendType backendType = BACKEND_NNAPI);
     ~SimpleModel();
 
     bool CreateCompiledModel();
     bool Compute(float inputValue1, float inputValue2, float *result);
 
+    // Compute for count pairs of input values, keeping up to kPipelineDepth computations
+    // in flight. results[i] is the result for inputValues1[i] and inputValues2[i].
+    bool ComputeBatch(const float *inputValues1, const float *inputValues2, size_t count,
+                      float *results);
+
+    // Start computing asynchronously. Returns a ticket to pass to WaitCompute, or -1 on
+    // error or if kPipelineDepth computations have not been waited for yet.
+    int SubmitCompute(float inputValue1, float inputValue2);
+    bool WaitCompute(int ticket, float *result);
+
+    static const int kPipelineDepth = 3;
+
 private:
-    ANeuralNetworksModel *model_;
-    ANeuralNetworksCompilation *compilation_;
-    ANeuralNetworksMemory *memoryModel_;
-    ANeuralNetworksMemory *memoryInput2_;
-    ANeuralNetworksMemory *memoryOutput_;
+    struct ExecutionSlot {
+        std::unique_ptr<Execution> execution;
+
+        // tensor1 is passed from process memory; tensor3 and the output through shared
+        // memory, mapped for the whole life of the slot
+        std::vector<float> inputTensor1;
+        int inputTensor2Fd;
+        int outputTensorFd;
+        ANeuralNetworksMemory *memoryInput2;
+        ANeuralNetworksMemory *memoryOutput;
+        float *inputTensor2;
+        float *outputTensor;
+
+        // ticket of the computation in flight, or -1 if the slot is free
+        int ticket;
+    };
+
+    bool CreateSlot(ExecutionSlot *slot);
+    bool CreateSlotExecution(ExecutionSlot *slot);
+    void DestroySlot(ExecutionSlot *slot);
+    ExecutionSlot *StartSlot(float inputValue1, float inputValue2);
+    bool FinishSlot(ExecutionSlot *slot, float *result);
+
+    ModelGraph graph_;
+    BackendType backendType_;
+    std::unique_ptr<Backend> backend_;
+
+    // golden reference for the results of backend_, unless that is the CPU already
+    std::unique_ptr<CpuBackend> referenceBackend_;
+    std::vector<float> referenceOutput_;
+
+    // host mapping of the trained data file, the graph's memory pool for the weights
+    void *modelData_;
+    size_t modelDataSize_;
+    uint32_t modelPool_;
 
     uint32_t dimLength_;
     uint32_t tensorSize_;
     size_t offset_;
-
-    std::vector<float> inputTensor1_;
     int modelDataFd_;
-    int inputTensor2Fd_;
-    int outputTensorFd_;
+
+    ExecutionSlot slots_[kPipelineDepth];
+    int nextTicket_;
 };
 
 #endif  // NNAPI_SIMPLE_MODEL_H
\ No newline at end of file
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount) :
+        generation_(0),
+        stop_(false),
+        busyWorkers_(0),
+        fn_(nullptr),
+        count_(0),
+        grain_(1),
+        nextChunk_(0) {
+    for (int i = 1; i < threadCount; i++) {
+        threads_.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, size_t grain,
+                             const std::function<void(size_t, size_t)> &fn) {
+    if (grain == 0) {
+        grain = 1;
+    }
+    if (threads_.empty() || count <= grain) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> dispatchLock(dispatchMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        count_ = count;
+        grain_ = grain;
+        nextChunk_.store(0);
+        busyWorkers_ = static_cast<int>(threads_.size());
+        generation_++;
+    }
+    wake_.notify_all();
+
+    RunChunks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busyWorkers_ == 0; });
+    fn_ = nullptr;
+}
+
+void ThreadPool::RunChunks() {
+    for (;;) {
+        size_t begin = nextChunk_.fetch_add(1) * grain_;
+        if (begin >= count_) {
+            return;
+        }
+        (*fn_)(begin, std::min(begin + grain_, count_));
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    uint64_t seenGeneration = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seenGeneration; });
+            if (stop_) {
+                return;
+            }
+            seenGeneration = generation_;
+        }
+
+        RunChunks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busyWorkers_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright 2017 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NNAPI_THREAD_POOL_H
+#define NNAPI_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * ThreadPool
+ * A fixed set of worker threads that split loops with the calling thread.
+ */
+class ThreadPool {
+public:
+    // threadCount counts the calling thread, so ThreadPool(1) starts no threads.
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    int GetThreadCount() const { return static_cast<int>(threads_.size()) + 1; }
+
+    // Call fn(begin, end) over [0, count), in chunks of grain items, on the workers and
+    // the calling thread. Returns when all chunks are done. Small loops (count <= grain)
+    // run on the calling thread only. Calls from several threads are serialized.
+    void ParallelFor(size_t count, size_t grain,
+                     const std::function<void(size_t, size_t)> &fn);
+
+private:
+    void WorkerLoop();
+    void RunChunks();
+
+    std::vector<std::thread> threads_;
+    std::mutex dispatchMutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_;
+    bool stop_;
+    int busyWorkers_;
+
+    // the loop being run
+    const std::function<void(size_t, size_t)> *fn_;
+    size_t count_;
+    size_t grain_;
+    std::atomic<size_t> nextChunk_;
+};
+
+#endif  // NNAPI_THREAD_POOL_H
@@ -40,6 +40,8 @@ public class MainActivity extends Activity {
 
     public native float startCompute(long modelHandle, float input1, float input2);
 
+    public native float[] computeBatch(long modelHandle, float[] inputs1, float[] inputs2);
+
     public native void destroyModel(long modelHandle);
 
     @Override
@@ -57,14 +59,20 @@ public class MainActivity extends Activity {
                     EditText edt1 = (EditText) findViewById(R.id.inputValue1);
                     EditText edt2 = (EditText) findViewById(R.id.inputValue2);
 
-                    String inputValue1 = edt1.getText().toString();
-                    String inputValue2 = edt2.getText().toString();
-                    if (!inputValue1.isEmpty() && !inputValue2.isEmpty()) {
+                    // Each input is a value, or a comma separated list of values to
+                    // compute as a batch.
+                    float[] inputValues1 = parseValues(edt1.getText().toString());
+                    float[] inputValues2 = parseValues(edt2.getText().toString());
+                    if (inputValues1 != null && inputValues2 != null) {
+                        if (inputValues1.length != inputValues2.length) {
+                            Toast.makeText(getApplicationContext(),
+                                    "Enter the same number of values in both inputs",
+                                    Toast.LENGTH_SHORT).show();
+                            return;
+                        }
                         Toast.makeText(getApplicationContext(), "Computing",
                                 Toast.LENGTH_SHORT).show();
-                        new ComputeTask().execute(
-                                Float.valueOf(inputValue1),
-                                Float.valueOf(inputValue2));
+                        new ComputeTask().execute(inputValues1, inputValues2);
                     }
                 } else {
                     Toast.makeText(getApplicationContext(), "Model initializing, please wait",
@@ -83,6 +91,22 @@ public class MainActivity extends Activity {
         super.onDestroy();
     }
 
+    private static float[] parseValues(String text) {
+        if (text.isEmpty()) {
+            return null;
+        }
+        String[] items = text.split(",");
+        float[] values = new float[items.length];
+        try {
+            for (int i = 0; i < items.length; i++) {
+                values[i] = Float.valueOf(items[i].trim());
+            }
+        } catch (NumberFormatException e) {
+            return null;
+        }
+        return values;
+    }
+
     private class InitModelTask extends AsyncTask<String, Void, Long> {
         @Override
         protected Long doInBackground(String... modelName) {
@@ -100,21 +124,34 @@ public class MainActivity extends Activity {
         }
     }
 
-    private class ComputeTask extends AsyncTask<Float, Void, Float> {
+    private class ComputeTask extends AsyncTask<float[], Void, float[]> {
         @Override
-        protected Float doInBackground(Float... inputs) {
+        protected float[] doInBackground(float[]... inputs) {
             if (inputs.length != 2) {
                 Log.e(LOG_TAG, "Incorrect number of input values");
-                return 0.0f;
+                return null;
             }
             // Reusing the same prepared model with different inputs.
-            return startCompute(modelHandle, inputs[0], inputs[1]);
+            if (inputs[0].length == 1) {
+                return new float[] {startCompute(modelHandle, inputs[0][0], inputs[1][0])};
+            }
+            // Several inputs are pipelined: the next computation starts while the
+            // result of the previous one is read.
+            return computeBatch(modelHandle, inputs[0], inputs[1]);
         }
 
         @Override
-        protected void onPostExecute(Float result) {
+        protected void onPostExecute(float[] results) {
+            StringBuilder text = new StringBuilder();
+            if (results == null) {
+                text.append(getString(R.string.none));
+            } else {
+                for (int i = 0; i < results.length; i++) {
+                    text.append(i == 0 ? "" : ", ").append(results[i]);
+                }
+            }
             TextView tv = (TextView) findViewById(R.id.textView);
-            tv.setText(String.valueOf(result));
+            tv.setText(text.toString());
         }
     }
 }
@@ -33,6 +33,7 @@ static int  sDemoStopped  = 0;
 static long sTimeOffset   = 0;
 static int  sTimeOffsetInit = 0;
 static long sTimeStopped  = 0;
+static long sStatsTime    = 0;
 
 static long
 _getTime(void)
@@ -134,4 +135,12 @@ Java_com_example_SanAngeles_DemoRenderer_nativeRender( JNIEnv*  env )
     //__android_log_print(ANDROID_LOG_INFO, "SanAngeles", "curTime=%ld", curTime);
 
     appRender(curTime, sWindowWidth, sWindowHeight);
+
+    /* report how much vertex data we send from client memory, every 5 s */
+    if (curTime - sStatsTime >= 5000) {
+        sStatsTime = curTime;
+        __android_log_print(ANDROID_LOG_INFO, "SanAngeles",
+                            "client vertex data: %ld bytes/frame",
+                            appGetSubmittedBytes());
+    }
 }
@@ -42,6 +42,12 @@ extern void appInit();
 extern void appDeinit();
 extern void appRender(long tick, int width, int height);
 
+/* Returns the number of bytes of vertex and index data that the last
+ * appRender() call sent from client memory. Data in buffer objects, which
+ * is uploaded once in appInit(), isn't counted.
+ */
+extern long appGetSubmittedBytes();
+
 /* Value is non-zero when application is alive, and 0 when it is closing.
  * Defined by the application framework.
  */
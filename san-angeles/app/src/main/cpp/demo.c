@@ -23,9 +23,13 @@
  */
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
 #include <math.h>
 #include <float.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "importgl.h"
 
@@ -39,6 +43,8 @@
 #undef PI
 #define PI 3.1415926535897932f
 #define RANDOM_UINT_MAX 65535
+// Maximum number of threads used to build the supershapes in appInit().
+#define MAX_BUILD_THREADS 4
 
 
 static unsigned long sRandomSeed = 0;
@@ -66,6 +72,16 @@ static long floatToFixed(float value)
 #define FIXED(value) floatToFixed(value)
 
 
+// One vertex of a packed GL object: all attributes interleaved, so a vertex
+// is read from one place. Objects with 2 vertex components leave position[2]
+// zero and objects without normals leave the normal zero.
+typedef struct {
+    GLfixed position[3];
+    GLfixed normal[3];
+    GLubyte color[4];
+} PACKED_VERTEX;
+
+
 // Definition of one GL object in this demo.
 typedef struct {
     /* Vertex array and color array are enabled for all objects, so their
@@ -77,12 +93,28 @@ typedef struct {
      * (i.e. tightly packed array). Color array is supposed to have 4
      * components per color with GL_UNSIGNED_BYTE datatype and stride 0.
      * Normal array is supposed to use GL_FIXED datatype and stride 0.
+     *
+     * If index array is non-NULL, the object is drawn as indexCount
+     * indices into the other arrays, otherwise as count vertices.
+     *
+     * Once packed (see packGLObject), the arrays above are freed and the
+     * object is drawn from packedVertices and packedIndices instead, or from
+     * the buffer objects they were uploaded to (see uploadGLObject).
      */
     GLfixed *vertexArray;
     GLubyte *colorArray;
     GLfixed *normalArray;
+    GLushort *indexArray;
     GLint vertexComponents;
     GLsizei count;
+    GLsizei indexCount;
+    int useNormalArray;
+
+    PACKED_VERTEX *packedVertices;
+    GLushort *packedIndices;
+    GLsizei packedCount;
+    GLsizei packedIndexCount;
+    GLuint vertexBuffer, indexBuffer;   // 0 if not uploaded
 } GLOBJECT;
 
 
@@ -96,6 +128,10 @@ static long sNextCamTrackStartTick = 0x7fffffff;
 static GLOBJECT *sSuperShapeObjects[SUPERSHAPE_COUNT] = { NULL };
 static GLOBJECT *sGroundPlane = NULL;
 
+// Bytes of vertex and index data submitted from client memory in the
+// current frame.
+static long sSubmittedBytes = 0;
+
 
 typedef struct {
     float x, y, z;
@@ -106,6 +142,13 @@ static void freeGLObject(GLOBJECT *object)
 {
     if (object == NULL)
         return;
+    if (object->vertexBuffer)
+        glDeleteBuffers(1, &object->vertexBuffer);
+    if (object->indexBuffer)
+        glDeleteBuffers(1, &object->indexBuffer);
+    free(object->packedIndices);
+    free(object->packedVertices);
+    free(object->indexArray);
     free(object->normalArray);
     free(object->colorArray);
     free(object->vertexArray);
@@ -114,13 +157,21 @@ static void freeGLObject(GLOBJECT *object)
 
 
 static GLOBJECT * newGLObject(long vertices, int vertexComponents,
-                              int useNormalArray)
+                              int useNormalArray, long indices)
 {
     GLOBJECT *result;
     result = (GLOBJECT *)malloc(sizeof(GLOBJECT));
     if (result == NULL)
         return NULL;
     result->count = vertices;
+    result->indexCount = indices;
+    result->useNormalArray = useNormalArray;
+    result->packedVertices = NULL;
+    result->packedIndices = NULL;
+    result->packedCount = 0;
+    result->packedIndexCount = 0;
+    result->vertexBuffer = 0;
+    result->indexBuffer = 0;
     result->vertexComponents = vertexComponents;
     result->vertexArray = (GLfixed *)malloc(vertices * vertexComponents *
                                             sizeof(GLfixed));
@@ -132,9 +183,14 @@ static GLOBJECT * newGLObject(long vertices, int vertexComponents,
     }
     else
         result->normalArray = NULL;
+    if (indices > 0)
+        result->indexArray = (GLushort *)malloc(indices * sizeof(GLushort));
+    else
+        result->indexArray = NULL;
     if (result->vertexArray == NULL ||
         result->colorArray == NULL ||
-        (useNormalArray && result->normalArray == NULL))
+        (useNormalArray && result->normalArray == NULL) ||
+        (indices > 0 && result->indexArray == NULL))
     {
         freeGLObject(result);
         return NULL;
@@ -143,10 +199,205 @@ static GLOBJECT * newGLObject(long vertices, int vertexComponents,
 }
 
 
+static unsigned long hashPackedVertex(const PACKED_VERTEX *vertex)
+{
+    const GLfixed *words = vertex->position;
+    unsigned long hash = 0;
+    int i;
+    // position and normal, plus the color bytes as one word
+    for (i = 0; i < 6; ++i)
+        hash = (hash ^ (unsigned long)words[i]) * 0x9e3779b1UL;
+    hash ^= vertex->color[0] | (vertex->color[1] << 8) |
+            (vertex->color[2] << 16) | ((unsigned long)vertex->color[3] << 24);
+    hash *= 0x9e3779b1UL;
+    // the table uses the low bits, which the multiplications don't mix well
+    return hash ^ (hash >> 15);
+}
+
+
+/* Interleaves the attributes of the object into packedVertices, merging
+ * vertices whose attributes are all equal, and builds packedIndices to draw
+ * the same triangles. The separate arrays are freed. Doesn't call GL, so it
+ * can run on any thread. Returns non-zero on success; on failure the object
+ * is left as it was.
+ */
+static int packGLObject(GLOBJECT *object)
+{
+    const long count = object->count;
+    const long drawn = object->indexArray ? object->indexCount : count;
+    PACKED_VERTEX *packed;
+    GLushort *indices;
+    long *table, *remap;
+    long tableSize, i, packedCount;
+
+    // open addressing hash table of packed vertex indices, at most half full
+    for (tableSize = 16; tableSize < count * 2; tableSize *= 2)
+        ;
+    packed = (PACKED_VERTEX *)malloc(count * sizeof(PACKED_VERTEX));
+    indices = (GLushort *)malloc(drawn * sizeof(GLushort));
+    table = (long *)malloc((tableSize + count) * sizeof(long));
+    if (packed == NULL || indices == NULL || table == NULL)
+    {
+        free(packed);
+        free(indices);
+        free(table);
+        return 0;
+    }
+    // where each vertex of the object went in the packed array
+    remap = table + tableSize;
+    for (i = 0; i < tableSize; ++i)
+        table[i] = -1;
+
+    packedCount = 0;
+    for (i = 0; i < count; ++i)
+    {
+        PACKED_VERTEX *vertex = &packed[packedCount];
+        unsigned long slot;
+        int a;
+
+        memset(vertex, 0, sizeof(PACKED_VERTEX));
+        for (a = 0; a < object->vertexComponents; ++a)
+            vertex->position[a] =
+                object->vertexArray[i * object->vertexComponents + a];
+        if (object->normalArray)
+        {
+            for (a = 0; a < 3; ++a)
+                vertex->normal[a] = object->normalArray[i * 3 + a];
+        }
+        for (a = 0; a < 4; ++a)
+            vertex->color[a] = object->colorArray[i * 4 + a];
+
+        slot = hashPackedVertex(vertex) & (tableSize - 1);
+        while (table[slot] >= 0 &&
+               memcmp(&packed[table[slot]], vertex, sizeof(PACKED_VERTEX)))
+            slot = (slot + 1) & (tableSize - 1);
+        if (table[slot] < 0)
+            table[slot] = packedCount++;
+        remap[i] = table[slot];
+    }
+    assert(packedCount <= 65536);
+    for (i = 0; i < drawn; ++i)
+    {
+        const long src = object->indexArray ? object->indexArray[i] : i;
+        indices[i] = (GLushort)remap[src];
+    }
+    free(table);
+
+    free(object->vertexArray);
+    free(object->colorArray);
+    free(object->normalArray);
+    free(object->indexArray);
+    object->vertexArray = NULL;
+    object->colorArray = NULL;
+    object->normalArray = NULL;
+    object->indexArray = NULL;
+
+    // give back the space of the merged vertices
+    object->packedVertices = (PACKED_VERTEX *)realloc(packed,
+                                 packedCount * sizeof(PACKED_VERTEX));
+    if (object->packedVertices == NULL)
+        object->packedVertices = packed;
+    object->packedIndices = indices;
+    object->packedCount = packedCount;
+    object->packedIndexCount = drawn;
+    return 1;
+}
+
+
+/* Uploads a packed object to buffer objects, so that it doesn't have to be
+ * sent from client memory each time it's drawn. If that fails, the object
+ * is drawn from its packed arrays.
+ */
+static void uploadGLObject(GLOBJECT *object)
+{
+    GLuint buffers[2] = { 0, 0 };
+
+    if (object->packedVertices == NULL)
+        return;
+
+    while (glGetError() != GL_NO_ERROR)
+        ;
+    glGenBuffers(2, buffers);
+    if (buffers[0] == 0 || buffers[1] == 0)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, object->packedCount * sizeof(PACKED_VERTEX),
+                 object->packedVertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 object->packedIndexCount * sizeof(GLushort),
+                 object->packedIndices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        glDeleteBuffers(2, buffers);
+        return;
+    }
+
+    object->vertexBuffer = buffers[0];
+    object->indexBuffer = buffers[1];
+    free(object->packedVertices);
+    free(object->packedIndices);
+    object->packedVertices = NULL;
+    object->packedIndices = NULL;
+}
+
+
+static void drawPackedGLObject(GLOBJECT *object)
+{
+    const GLsizei stride = sizeof(PACKED_VERTEX);
+    const char *vertices = (const char *)object->packedVertices;
+    const GLushort *indices = object->packedIndices;
+
+    if (object->vertexBuffer)
+    {
+        // pointers are offsets into the buffer objects
+        glBindBuffer(GL_ARRAY_BUFFER, object->vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object->indexBuffer);
+        vertices = NULL;
+        indices = NULL;
+    }
+    else
+        sSubmittedBytes += object->packedCount * sizeof(PACKED_VERTEX) +
+                           object->packedIndexCount * sizeof(GLushort);
+
+    glVertexPointer(object->vertexComponents, GL_FIXED, stride,
+                    vertices + offsetof(PACKED_VERTEX, position));
+    glColorPointer(4, GL_UNSIGNED_BYTE, stride,
+                   vertices + offsetof(PACKED_VERTEX, color));
+    if (object->useNormalArray)
+    {
+        glNormalPointer(GL_FIXED, stride,
+                        vertices + offsetof(PACKED_VERTEX, normal));
+        glEnableClientState(GL_NORMAL_ARRAY);
+    }
+    else
+        glDisableClientState(GL_NORMAL_ARRAY);
+    glDrawElements(GL_TRIANGLES, object->packedIndexCount, GL_UNSIGNED_SHORT,
+                   indices);
+
+    if (object->vertexBuffer)
+    {
+        // other draws use client memory
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+
 static void drawGLObject(GLOBJECT *object)
 {
+    long vertices;
+
     assert(object != NULL);
 
+    if (object->vertexBuffer || object->packedVertices)
+    {
+        drawPackedGLObject(object);
+        return;
+    }
+
     glVertexPointer(object->vertexComponents, GL_FIXED,
                     0, object->vertexArray);
     glColorPointer(4, GL_UNSIGNED_BYTE, 0, object->colorArray);
@@ -162,38 +413,75 @@ static void drawGLObject(GLOBJECT *object)
     }
     else
         glDisableClientState(GL_NORMAL_ARRAY);
-    glDrawArrays(GL_TRIANGLES, 0, object->count);
+
+    // count the client arrays as sent in full
+    vertices = object->count;
+    if (object->indexArray)
+        sSubmittedBytes += object->indexCount * sizeof(GLushort);
+    sSubmittedBytes += vertices * (object->vertexComponents * sizeof(GLfixed) +
+                                   4 * sizeof(GLubyte));
+    if (object->normalArray)
+        sSubmittedBytes += vertices * 3 * sizeof(GLfixed);
+
+    if (object->indexArray)
+        glDrawElements(GL_TRIANGLES, object->indexCount, GL_UNSIGNED_SHORT,
+                       object->indexArray);
+    else
+        glDrawArrays(GL_TRIANGLES, 0, object->count);
 }
 
 
-static void vector3Sub(VECTOR3 *dest, VECTOR3 *v1, VECTOR3 *v2)
+static float ssFunc(const float t, const float *p)
 {
-    dest->x = v1->x - v2->x;
-    dest->y = v1->y - v2->y;
-    dest->z = v1->z - v2->z;
+    return (float)(pow(pow(fabs(cos(p[0] * t / 4)) / p[1], p[4]) +
+                       pow(fabs(sin(p[0] * t / 4)) / p[2], p[5]), 1 / p[3]));
 }
 
 
-static void superShapeMap(VECTOR3 *point, float r1, float r2, float t, float p)
+// Supershape radius and sin/cos for each longitude (or latitude) of a
+// supershape. The radius of a longitude only depends on the longitude and
+// the radius of a latitude only on the latitude, so these are computed once
+// per column and row of the mesh, not for each quad.
+typedef struct {
+    double *r, *cosine, *sine;
+} SSTABLE;
+
+
+// Allocates the table. All three arrays share one block, table->r.
+static void newSSTable(SSTABLE *table, int count)
 {
-    // sphere-mapping of supershape parameters
-    point->x = (float)(cos(t) * cos(p) / r1 / r2);
-    point->y = (float)(sin(t) * cos(p) / r1 / r2);
-    point->z = (float)(sin(p) / r2);
+    table->r = (double *)malloc(count * 3 * sizeof(double));
+    if (table->r == NULL)
+        return;
+    table->cosine = table->r + count;
+    table->sine = table->cosine + count;
 }
 
 
-static float ssFunc(const float t, const float *p)
+static void fillSSTable(SSTABLE *table, int count, float begin, int index,
+                        int resol, const float *params)
 {
-    return (float)(pow(pow(fabs(cos(p[0] * t / 4)) / p[1], p[4]) +
-                       pow(fabs(sin(p[0] * t / 4)) / p[2], p[5]), 1 / p[3]));
+    int i;
+    for (i = 0; i < count; ++i, ++index)
+    {
+        const float angle = begin + index * 2 * PI / resol;
+        table->r[i] = ssFunc(angle, params);
+        table->cosine[i] = cos(angle);
+        table->sine[i] = sin(angle);
+    }
 }
 
 
 // Creates and returns a supershape object.
 // Based on Paul Bourke's POV-Ray implementation.
 // http://astronomy.swin.edu.au/~pbourke/povray/supershape/
-static GLOBJECT * createSuperShape(const float *params)
+/* The object is a grid of vertices shared by the quads around them, drawn
+ * with an index array. Normals and colors are per quad: the demo uses flat
+ * shading, where a triangle takes them from its last vertex, so each quad
+ * stores its normal and color in its own upper left corner vertex (pd),
+ * which is the last vertex of both of its triangles.
+ */
+static GLOBJECT * createSuperShape(const float *params, const float *baseColor)
 {
     const int resol1 = (int)params[SUPERSHAPE_PARAMS - 3];
     const int resol2 = (int)params[SUPERSHAPE_PARAMS - 2];
@@ -203,145 +491,157 @@ static GLOBJECT * createSuperShape(const float *params)
     const int latitudeEnd = resol2 / 2;    // non-inclusive
     const int longitudeCount = resol1;
     const int latitudeCount = latitudeEnd - latitudeBegin;
-    const long triangleCount = longitudeCount * latitudeCount * 2;
-    const long vertices = triangleCount * 3;
+    // One more row and column of vertices than quads, plus a copy of the
+    // second row for the lower edge kludge (see below).
+    const int columns = longitudeCount + 1;
+    const int kludgeRow = latitudeCount + 1;
+    const long vertices = columns * (latitudeCount + 2);
+    const long indices = longitudeCount * latitudeCount * 6;
     GLOBJECT *result;
-    float baseColor[3];
-    int a, longitude, latitude;
-    long currentVertex, currentQuad;
-
-    result = newGLObject(vertices, 3, 1);
-    if (result == NULL)
+    SSTABLE longitudes, latitudes;
+    float *points;
+    int longitude, latitude;
+    long i, currentIndex;
+
+    assert(vertices <= 65536);
+    result = newGLObject(vertices, 3, 1, indices);
+    points = (float *)malloc(vertices * 3 * sizeof(float));
+    newSSTable(&longitudes, columns);
+    newSSTable(&latitudes, latitudeCount + 1);
+    if (result == NULL || points == NULL ||
+        longitudes.r == NULL || latitudes.r == NULL)
+    {
+        freeGLObject(result);
+        free(points);
+        free(longitudes.r);
+        free(latitudes.r);
         return NULL;
+    }
 
-    for (a = 0; a < 3; ++a)
-        baseColor[a] = ((randomUInt() % 155) + 100) / 255.f;
-
-    currentQuad = 0;
-    currentVertex = 0;
+    // longitude -pi to pi, latitude 0 to pi/2
+    fillSSTable(&longitudes, columns, -PI, 0, resol1, params);
+    fillSSTable(&latitudes, latitudeCount + 1, -PI / 2, latitudeBegin, resol2,
+                &params[6]);
 
-    // longitude -pi to pi
+    // sphere-mapping of supershape parameters
+    for (latitude = 0; latitude <= latitudeCount; ++latitude)
+    {
+        const double rp = latitudes.r[latitude];
+        const double cp = latitudes.cosine[latitude];
+        const float z = (float)(latitudes.sine[latitude] / rp);
+        float *point = points + latitude * columns * 3;
+        for (longitude = 0; longitude < columns; ++longitude, point += 3)
+        {
+            const double rt = longitudes.r[longitude];
+            point[0] = (float)(longitudes.cosine[longitude] * cp / rt / rp);
+            point[1] = (float)(longitudes.sine[longitude] * cp / rt / rp);
+            point[2] = z;
+        }
+    }
+    // kludge to set lower edge of the object to fixed level: the bottom of
+    // the second row of quads is at z = 0.
+    memcpy(points + kludgeRow * columns * 3, points + columns * 3,
+           columns * 3 * sizeof(float));
+    for (longitude = 0; longitude < columns; ++longitude)
+        points[(kludgeRow * columns + longitude) * 3 + 2] = 0;
+
+    for (i = 0; i < vertices * 3; ++i)
+        result->vertexArray[i] = FIXED(points[i]);
+    // only the vertices that some quad's normal and color go to are used
+    memset(result->normalArray, 0, vertices * 3 * sizeof(GLfixed));
+    memset(result->colorArray, 0, vertices * 4 * sizeof(GLubyte));
+
+    currentIndex = 0;
     for (longitude = 0; longitude < longitudeCount; ++longitude)
     {
-
-        // latitude 0 to pi/2
-        for (latitude = latitudeBegin; latitude < latitudeEnd; ++latitude)
+        for (latitude = 0; latitude < latitudeCount; ++latitude)
         {
-            float t1 = -PI + longitude * 2 * PI / resol1;
-            float t2 = -PI + (longitude + 1) * 2 * PI / resol1;
-            float p1 = -PI / 2 + latitude * 2 * PI / resol2;
-            float p2 = -PI / 2 + (latitude + 1) * 2 * PI / resol2;
-            float r0, r1, r2, r3;
-
-            r0 = ssFunc(t1, params);
-            r1 = ssFunc(p1, &params[6]);
-            r2 = ssFunc(t2, params);
-            r3 = ssFunc(p2, &params[6]);
-
-            if (r0 != 0 && r1 != 0 && r2 != 0 && r3 != 0)
+            const int bottom = latitude == 1 ? kludgeRow : latitude;
+            const int ia = bottom * columns + longitude;
+            const int ib = ia + 1;
+            const int id = (latitude + 1) * columns + longitude;
+            const int ic = id + 1;
+            VECTOR3 v1, v2, n;
+            float ca;
+            int a, color[3];
+
+            if (longitudes.r[longitude] == 0 ||
+                longitudes.r[longitude + 1] == 0 ||
+                latitudes.r[latitude] == 0 ||
+                latitudes.r[latitude + 1] == 0)
+                continue;
+
+            v1.x = points[ib * 3] - points[ia * 3];
+            v1.y = points[ib * 3 + 1] - points[ia * 3 + 1];
+            v1.z = points[ib * 3 + 2] - points[ia * 3 + 2];
+            v2.x = points[id * 3] - points[ia * 3];
+            v2.y = points[id * 3 + 1] - points[ia * 3 + 1];
+            v2.z = points[id * 3 + 2] - points[ia * 3 + 2];
+
+            // Calculate normal with cross product. It will be normalized
+            // later due to automatic normalization (GL_NORMALIZE).
+            n.x = v1.y * v2.z - v1.z * v2.y;
+            n.y = v1.z * v2.x - v1.x * v2.z;
+            n.z = v1.x * v2.y - v1.y * v2.x;
+
+            result->normalArray[id * 3] = FIXED(n.x);
+            result->normalArray[id * 3 + 1] = FIXED(n.y);
+            result->normalArray[id * 3 + 2] = FIXED(n.z);
+
+            ca = points[ia * 3 + 2] + 0.5f;
+            for (a = 0; a < 3; ++a)
             {
-                VECTOR3 pa, pb, pc, pd;
-                VECTOR3 v1, v2, n;
-                float ca;
-                int i;
-                //float lenSq, invLenSq;
-
-                superShapeMap(&pa, r0, r1, t1, p1);
-                superShapeMap(&pb, r2, r1, t2, p1);
-                superShapeMap(&pc, r2, r3, t2, p2);
-                superShapeMap(&pd, r0, r3, t1, p2);
-
-                // kludge to set lower edge of the object to fixed level
-                if (latitude == latitudeBegin + 1)
-                    pa.z = pb.z = 0;
-
-                vector3Sub(&v1, &pb, &pa);
-                vector3Sub(&v2, &pd, &pa);
-
-                // Calculate normal with cross product.
-                /*   i    j    k      i    j
-                 * v1.x v1.y v1.z | v1.x v1.y
-                 * v2.x v2.y v2.z | v2.x v2.y
-                 */
-
-                n.x = v1.y * v2.z - v1.z * v2.y;
-                n.y = v1.z * v2.x - v1.x * v2.z;
-                n.z = v1.x * v2.y - v1.y * v2.x;
-
-                /* Pre-normalization of the normals is disabled here because
-                 * they will be normalized anyway later due to automatic
-                 * normalization (GL_NORMALIZE). It is enabled because the
-                 * objects are scaled with glScale.
-                 */
-                /*
-                lenSq = n.x * n.x + n.y * n.y + n.z * n.z;
-                invLenSq = (float)(1 / sqrt(lenSq));
-                n.x *= invLenSq;
-                n.y *= invLenSq;
-                n.z *= invLenSq;
-                */
-
-                ca = pa.z + 0.5f;
-
-                for (i = currentVertex * 3;
-                     i < (currentVertex + 6) * 3;
-                     i += 3)
-                {
-                    result->normalArray[i] = FIXED(n.x);
-                    result->normalArray[i + 1] = FIXED(n.y);
-                    result->normalArray[i + 2] = FIXED(n.z);
-                }
-                for (i = currentVertex * 4;
-                     i < (currentVertex + 6) * 4;
-                     i += 4)
-                {
-                    int a, color[3];
-                    for (a = 0; a < 3; ++a)
-                    {
-                        color[a] = (int)(ca * baseColor[a] * 255);
-                        if (color[a] > 255) color[a] = 255;
-                    }
-                    result->colorArray[i] = (GLubyte)color[0];
-                    result->colorArray[i + 1] = (GLubyte)color[1];
-                    result->colorArray[i + 2] = (GLubyte)color[2];
-                    result->colorArray[i + 3] = 0;
-                }
-                result->vertexArray[currentVertex * 3] = FIXED(pa.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pa.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pa.z);
-                ++currentVertex;
-                result->vertexArray[currentVertex * 3] = FIXED(pb.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pb.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pb.z);
-                ++currentVertex;
-                result->vertexArray[currentVertex * 3] = FIXED(pd.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pd.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pd.z);
-                ++currentVertex;
-                result->vertexArray[currentVertex * 3] = FIXED(pb.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pb.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pb.z);
-                ++currentVertex;
-                result->vertexArray[currentVertex * 3] = FIXED(pc.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pc.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pc.z);
-                ++currentVertex;
-                result->vertexArray[currentVertex * 3] = FIXED(pd.x);
-                result->vertexArray[currentVertex * 3 + 1] = FIXED(pd.y);
-                result->vertexArray[currentVertex * 3 + 2] = FIXED(pd.z);
-                ++currentVertex;
-            } // r0 && r1 && r2 && r3
-            ++currentQuad;
+                color[a] = (int)(ca * baseColor[a] * 255);
+                if (color[a] > 255) color[a] = 255;
+            }
+            result->colorArray[id * 4] = (GLubyte)color[0];
+            result->colorArray[id * 4 + 1] = (GLubyte)color[1];
+            result->colorArray[id * 4 + 2] = (GLubyte)color[2];
+            result->colorArray[id * 4 + 3] = 0;
+
+            // same triangles as pa, pb, pd and pb, pc, pd
+            result->indexArray[currentIndex++] = (GLushort)ia;
+            result->indexArray[currentIndex++] = (GLushort)ib;
+            result->indexArray[currentIndex++] = (GLushort)id;
+            result->indexArray[currentIndex++] = (GLushort)ib;
+            result->indexArray[currentIndex++] = (GLushort)ic;
+            result->indexArray[currentIndex++] = (GLushort)id;
         } // latitude
     } // longitude
 
-    // Set number of vertices in object to the actual amount created.
-    result->count = currentVertex;
+    // Set number of indices in object to the actual amount created.
+    result->indexCount = currentIndex;
 
+    free(points);
+    free(longitudes.r);
+    free(latitudes.r);
     return result;
 }
 
 
+// Work for one of the threads that build the supershapes: shapes first,
+// first + step, first + 2 * step, ...
+typedef struct {
+    int first, step;
+    float (*baseColors)[3];
+} SUPERSHAPE_JOB;
+
+
+static void * buildSuperShapes(void *arg)
+{
+    const SUPERSHAPE_JOB *job = (const SUPERSHAPE_JOB *)arg;
+    int a;
+    for (a = job->first; a < (int)SUPERSHAPE_COUNT; a += job->step)
+    {
+        sSuperShapeObjects[a] = createSuperShape(sSuperShapeParams[a],
+                                                 job->baseColors[a]);
+        if (sSuperShapeObjects[a] != NULL)
+            packGLObject(sSuperShapeObjects[a]);
+    }
+    return NULL;
+}
+
+
 static GLOBJECT * createGroundPlane()
 {
     const int scale = 4;
@@ -353,7 +653,7 @@ static GLOBJECT * createGroundPlane()
     int x, y;
     long currentVertex, currentQuad;
 
-    result = newGLObject(vertices, 2, 0);
+    result = newGLObject(vertices, 2, 0, 0);
     if (result == NULL)
         return NULL;
 
@@ -447,6 +747,7 @@ static void drawFadeQuad()
         glDisableClientState(GL_NORMAL_ARRAY);
         glVertexPointer(2, GL_FIXED, 0, quadVertices);
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        sSubmittedBytes += sizeof(quadVertices);
 
         glEnableClientState(GL_COLOR_ARRAY);
 
@@ -462,7 +763,11 @@ static void drawFadeQuad()
 // Called from the app framework.
 void appInit()
 {
-    int a;
+    float baseColors[SUPERSHAPE_COUNT][3];
+    SUPERSHAPE_JOB jobs[MAX_BUILD_THREADS];
+    pthread_t threads[MAX_BUILD_THREADS];
+    int started[MAX_BUILD_THREADS];
+    int a, threadCount;
 
     glEnable(GL_NORMALIZE);
     glEnable(GL_DEPTH_TEST);
@@ -479,13 +784,51 @@ void appInit()
 
     seedRandom(15);
 
+    // Pick the colors up front, in the order the shapes used to pick them,
+    // so that the shapes can be built in parallel.
+    for (a = 0; a < SUPERSHAPE_COUNT; ++a)
+    {
+        int i;
+        for (i = 0; i < 3; ++i)
+            baseColors[a][i] = ((randomUInt() % 155) + 100) / 255.f;
+    }
+
+    threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > MAX_BUILD_THREADS)
+        threadCount = MAX_BUILD_THREADS;
+    for (a = 0; a < threadCount; ++a)
+    {
+        jobs[a].first = a;
+        jobs[a].step = threadCount;
+        jobs[a].baseColors = baseColors;
+    }
+    // This thread builds the first share; if a thread can't be started,
+    // its share is built here too.
+    for (a = 1; a < threadCount; ++a)
+    {
+        started[a] = pthread_create(&threads[a], NULL, buildSuperShapes,
+                                    &jobs[a]) == 0;
+        if (!started[a])
+            buildSuperShapes(&jobs[a]);
+    }
+    buildSuperShapes(&jobs[0]);
+    for (a = 1; a < threadCount; ++a)
+    {
+        if (started[a])
+            pthread_join(threads[a], NULL);
+    }
     for (a = 0; a < SUPERSHAPE_COUNT; ++a)
     {
-        sSuperShapeObjects[a] = createSuperShape(sSuperShapeParams[a]);
         assert(sSuperShapeObjects[a] != NULL);
+        uploadGLObject(sSuperShapeObjects[a]);
     }
+
     sGroundPlane = createGroundPlane();
     assert(sGroundPlane != NULL);
+    packGLObject(sGroundPlane);
+    uploadGLObject(sGroundPlane);
 }
 
 
@@ -757,6 +1100,8 @@ void appRender(long tick, int width, int height)
     if (!gAppAlive)
         return;
 
+    sSubmittedBytes = 0;
+
     // Actual tick value is "blurred" a little bit.
     sTick = (sTick + tick - sStartTick) >> 1;
 
@@ -790,3 +1135,10 @@ void appRender(long tick, int width, int height)
     // Draw fade quad over whole window (when changing cameras).
     drawFadeQuad();
 }
+
+
+// Called from the app framework.
+long appGetSubmittedBytes()
+{
+    return sSubmittedBytes;
+}
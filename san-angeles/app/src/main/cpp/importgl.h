@@ -77,17 +77,22 @@ FNDEF(EGLBoolean, eglSwapBuffers, (EGLDisplay dpy, EGLSurface draw));
 FNDEF(EGLBoolean, eglTerminate, (EGLDisplay dpy));
 #endif /* !ANDROID_NDK */
 
+FNDEF(void, glBindBuffer, (GLenum target, GLuint buffer));
 FNDEF(void, glBlendFunc, (GLenum sfactor, GLenum dfactor));
+FNDEF(void, glBufferData, (GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage));
 FNDEF(void, glClear, (GLbitfield mask));
 FNDEF(void, glClearColorx, (GLclampx red, GLclampx green, GLclampx blue, GLclampx alpha));
 FNDEF(void, glColor4x, (GLfixed red, GLfixed green, GLfixed blue, GLfixed alpha));
 FNDEF(void, glColorPointer, (GLint size, GLenum type, GLsizei stride, const GLvoid *pointer));
+FNDEF(void, glDeleteBuffers, (GLsizei n, const GLuint *buffers));
 FNDEF(void, glDisable, (GLenum cap));
 FNDEF(void, glDisableClientState, (GLenum array));
 FNDEF(void, glDrawArrays, (GLenum mode, GLint first, GLsizei count));
+FNDEF(void, glDrawElements, (GLenum mode, GLsizei count, GLenum type, const GLvoid *indices));
 FNDEF(void, glEnable, (GLenum cap));
 FNDEF(void, glEnableClientState, (GLenum array));
 FNDEF(void, glFrustumx, (GLfixed left, GLfixed right, GLfixed bottom, GLfixed top, GLfixed zNear, GLfixed zFar));
+FNDEF(void, glGenBuffers, (GLsizei n, GLuint *buffers));
 FNDEF(GLenum, glGetError, (void));
 FNDEF(void, glLightxv, (GLenum light, GLenum pname, const GLfixed *params));
 FNDEF(void, glLoadIdentity, (void));
@@ -129,17 +134,22 @@ FNDEF(void, glViewport, (GLint x, GLint y, GLsizei width, GLsizei height));
 #define eglTerminate            FNPTR(eglTerminate)
 #endif /* !ANDROID_NDK */
 
+#define glBindBuffer            FNPTR(glBindBuffer)
 #define glBlendFunc             FNPTR(glBlendFunc)
+#define glBufferData            FNPTR(glBufferData)
 #define glClear                 FNPTR(glClear)
 #define glClearColorx           FNPTR(glClearColorx)
 #define glColor4x               FNPTR(glColor4x)
 #define glColorPointer          FNPTR(glColorPointer)
+#define glDeleteBuffers         FNPTR(glDeleteBuffers)
 #define glDisable               FNPTR(glDisable)
 #define glDisableClientState    FNPTR(glDisableClientState)
 #define glDrawArrays            FNPTR(glDrawArrays)
+#define glDrawElements          FNPTR(glDrawElements)
 #define glEnable                FNPTR(glEnable)
 #define glEnableClientState     FNPTR(glEnableClientState)
 #define glFrustumx              FNPTR(glFrustumx)
+#define glGenBuffers            FNPTR(glGenBuffers)
 #define glGetError              FNPTR(glGetError)
 #define glLightxv               FNPTR(glLightxv)
 #define glLoadIdentity          FNPTR(glLoadIdentity)
@@ -33,7 +33,8 @@
 #include "gl3stub.h"    // GLES3 stubs
 #include "GLContext.h"  // EGL & OpenGL manager
 #include "shader.h"     // Shader compiler support
-#include "vecmath.h"  // Vector math support, C++ implementation n current version
+#include "vecmath.h"  // Vector math support, NEON/SSE where available
+#include "batchTransform.h"  // Batched per instance matrices
 #include "tapCamera.h"        // Tap/Pinch camera control
 #include "JNIHelper.h"        // JNI support
 #include "gestureDetector.h"  // Tap/Doubletap/Pinch detector
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//--------------------------------------------------------------------------------
+// batchTransform.cpp
+//--------------------------------------------------------------------------------
+#include "batchTransform.h"
+
+#include <algorithm>
+
+namespace ndk_helper {
+
+const int32_t BatchTransform::kMaxThreads;
+
+using simd::Float4;
+using simd::Load;
+using simd::Store;
+using simd::Transform;
+using simd::Transform3;
+
+//--------------------------------------------------------------------------------
+// InstanceTransforms
+//--------------------------------------------------------------------------------
+void InstanceTransforms::Add(const Vec3& translation, const Vec2& rotation,
+                             const Vec2& spin) {
+  translation_x.push_back(translation.x_);
+  translation_y.push_back(translation.y_);
+  translation_z.push_back(translation.z_);
+  rotation_x.push_back(rotation.x_);
+  rotation_y.push_back(rotation.y_);
+  spin_x.push_back(spin.x_);
+  spin_y.push_back(spin.y_);
+}
+
+void InstanceTransforms::Clear() {
+  translation_x.clear();
+  translation_y.clear();
+  translation_z.clear();
+  rotation_x.clear();
+  rotation_y.clear();
+  spin_x.clear();
+  spin_y.clear();
+}
+
+//--------------------------------------------------------------------------------
+// BatchTransform
+//--------------------------------------------------------------------------------
+BatchTransform::BatchTransform(int32_t thread_count)
+    : job_count_(0), job_generation_(0), pending_workers_(0), exit_(false) {
+  if (thread_count <= 0) {
+    thread_count = static_cast<int32_t>(std::thread::hardware_concurrency());
+  }
+  thread_count = std::max(1, std::min(thread_count, kMaxThreads));
+  for (int32_t i = 1; i < thread_count; ++i) {
+    workers_.push_back(std::thread(&BatchTransform::WorkerLoop, this, i));
+  }
+}
+
+BatchTransform::~BatchTransform() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    exit_ = true;
+  }
+  job_ready_.notify_all();
+  for (auto& worker : workers_) worker.join();
+}
+
+void BatchTransform::GetRange(int32_t index, int32_t count, int32_t* begin,
+                              int32_t* end) {
+  // split on multiples of 4 instances, keeps each part's writes apart
+  int32_t parts = GetThreadCount();
+  int32_t chunk = ((count + parts - 1) / parts + 3) & ~3;
+  *begin = std::min(count, index * chunk);
+  *end = std::min(count, *begin + chunk);
+}
+
+void BatchTransform::WorkerLoop(int32_t index) {
+  int32_t generation = 0;
+  while (true) {
+    std::function<void(int32_t, int32_t)> job;
+    int32_t count;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      job_ready_.wait(lock, [this, generation] {
+        return exit_ || job_generation_ != generation;
+      });
+      if (exit_) return;
+      generation = job_generation_;
+      job = job_;
+      count = job_count_;
+    }
+
+    int32_t begin, end;
+    GetRange(index, count, &begin, &end);
+    if (begin < end) job(begin, end);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_workers_ == 0) job_done_.notify_one();
+  }
+}
+
+void BatchTransform::Run(int32_t count,
+                         const std::function<void(int32_t, int32_t)>& job) {
+  if (count < kParallelThreshold || workers_.empty()) {
+    job(0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job_ = job;
+    job_count_ = count;
+    job_generation_++;
+    pending_workers_ = static_cast<int32_t>(workers_.size());
+  }
+  job_ready_.notify_all();
+
+  // the calling thread takes the first part
+  int32_t begin, end;
+  GetRange(0, count, &begin, &end);
+  job(begin, end);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_done_.wait(lock, [this] { return pending_workers_ == 0; });
+  job_ = nullptr;
+}
+
+void BatchTransform::Multiply(const Mat4& lhs, const float* rhs, float* out,
+                              int32_t count, int32_t stride) {
+  Float4 l[4] = {Load(lhs.f_), Load(lhs.f_ + 4), Load(lhs.f_ + 8),
+                 Load(lhs.f_ + 12)};
+  Run(count, [&](int32_t begin, int32_t end) {
+    for (int32_t i = begin; i < end; ++i) {
+      const float* r = rhs + i * stride;
+      float* o = out + i * stride;
+      // load all of rhs first, out may be the same matrix
+      float m[16];
+      std::copy(r, r + 16, m);
+      for (int32_t j = 0; j < 16; j += 4) {
+        Store(o + j, Transform(l, m[j], m[j + 1], m[j + 2], m[j + 3]));
+      }
+    }
+  });
+}
+
+void BatchTransform::UpdateModelView(InstanceTransforms* instances,
+                                     const Mat4& view, const Mat4& projection,
+                                     float* mvp, float* mv, int32_t stride) {
+  Float4 v[4] = {Load(view.f_), Load(view.f_ + 4), Load(view.f_ + 8),
+                 Load(view.f_ + 12)};
+  Float4 p[4] = {Load(projection.f_), Load(projection.f_ + 4),
+                 Load(projection.f_ + 8), Load(projection.f_ + 12)};
+
+  Run(instances->Size(), [&](int32_t begin, int32_t end) {
+    float* rotation_x = instances->rotation_x.data();
+    float* rotation_y = instances->rotation_y.data();
+    const float* spin_x = instances->spin_x.data();
+    const float* spin_y = instances->spin_y.data();
+    const float* translation_x = instances->translation_x.data();
+    const float* translation_y = instances->translation_y.data();
+    const float* translation_z = instances->translation_z.data();
+
+    for (int32_t i = begin; i < end; ++i) {
+      rotation_x[i] += spin_x[i];
+      rotation_y[i] += spin_y[i];
+      float cx = cosf(rotation_x[i]), sx = sinf(rotation_x[i]);
+      float cy = cosf(rotation_y[i]), sy = sinf(rotation_y[i]);
+
+      // columns of RotationX(x) * RotationY(y); the translation only sets
+      // the last column of the model matrix
+      Float4 c[4];
+      c[0] = Transform3(v, cy, sy * sx, sy * cx);
+      c[1] = Transform3(v, 0.f, cx, -sx);
+      c[2] = Transform3(v, -sy, cy * sx, cy * cx);
+      c[3] = simd::Add(Transform3(v, translation_x[i], translation_y[i],
+                                  translation_z[i]),
+                       v[3]);
+
+      // mvp from the registers, the destination may be write-combined
+      // memory that is slow to read back
+      float* out_mv = mv + i * stride;
+      float* out_mvp = mvp + i * stride;
+      for (int32_t j = 0; j < 4; ++j) {
+        Store(out_mv + j * 4, c[j]);
+        Store(out_mvp + j * 4, Transform(p, c[j]));
+      }
+    }
+  });
+}
+
+}  // namespace ndk_helper
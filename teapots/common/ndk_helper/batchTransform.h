@@ -0,0 +1,100 @@
+/*
+ * Copyright 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BATCHTRANSFORM_H_
+#define BATCHTRANSFORM_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "vecmath.h"
+
+namespace ndk_helper {
+
+/******************************************************************
+ * Per instance transforms, in structure of arrays layout so a batch
+ * update streams through each component
+ *
+ */
+struct InstanceTransforms {
+  std::vector<float> translation_x;
+  std::vector<float> translation_y;
+  std::vector<float> translation_z;
+  std::vector<float> rotation_x;  // radians
+  std::vector<float> rotation_y;
+  std::vector<float> spin_x;  // added to the rotation on every update
+  std::vector<float> spin_y;
+
+  void Add(const Vec3& translation, const Vec2& rotation, const Vec2& spin);
+  void Clear();
+  int32_t Size() const { return static_cast<int32_t>(rotation_x.size()); }
+};
+
+/******************************************************************
+ * Batched matrix computation for many instances
+ *
+ * Matrices are column major (as Mat4) and written straight to the
+ * destination, e.g. a mapped uniform buffer, stride floats apart.
+ * Large batches are split across worker threads.
+ *
+ */
+class BatchTransform {
+ private:
+  static const int32_t kMaxThreads = 4;
+  // below this many instances a batch runs on the calling thread only
+  static const int32_t kParallelThreshold = 2048;
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable job_ready_;
+  std::condition_variable job_done_;
+  std::function<void(int32_t, int32_t)> job_;
+  int32_t job_count_;
+  int32_t job_generation_;
+  int32_t pending_workers_;
+  bool exit_;
+
+  void WorkerLoop(int32_t index);
+  void Run(int32_t count, const std::function<void(int32_t, int32_t)>& job);
+  void GetRange(int32_t index, int32_t count, int32_t* begin, int32_t* end);
+
+ public:
+  // thread_count 0: one per core, up to kMaxThreads
+  explicit BatchTransform(int32_t thread_count = 0);
+  virtual ~BatchTransform();
+
+  // out[i] = lhs * rhs[i] for count matrices
+  void Multiply(const Mat4& lhs, const float* rhs, float* out, int32_t count,
+                int32_t stride);
+
+  // Advance each instance's rotation by its spin, then write
+  //   mv  = view * Translation * RotationX * RotationY
+  //   mvp = projection * mv
+  // Matches composing the Mat4s one by one (up to float rounding), without
+  // building any of the intermediate matrices.
+  void UpdateModelView(InstanceTransforms* instances, const Mat4& view,
+                       const Mat4& projection, float* mvp, float* mv,
+                       int32_t stride);
+
+  int32_t GetThreadCount() const {
+    return static_cast<int32_t>(workers_.size()) + 1;
+  }
+};
+
+}  // namespace ndk_helper
+#endif /* BATCHTRANSFORM_H_ */
@@ -0,0 +1,617 @@
+/*
+ * Copyright 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check and benchmarks of the ndk_helper math, built when CMakeLists.txt
+ * is configured for the host rather than Android:
+ *   ndk_helper_host_bench check    vecmath against the scalar code it
+ *                                  replaced, and BatchTransform against the
+ *                                  Mat4 chain; exit 1 on a mismatch
+ *   ndk_helper_host_bench vecmath  vecmath against the scalar code
+ *   ndk_helper_host_bench batch    BatchTransform::UpdateModelView() against
+ *                                  more-teapots' per-instance Mat4 chain
+ * With no argument, runs all of them.
+ *
+ * Results must be bit exact where the SIMD path rounds like the scalar code
+ * (SSE, plain C++). With fused multiply-add (aarch64, x86 built with FMA) or
+ * ARMv7 NEON, which flushes denormals, they may differ in the last bits and
+ * are compared with a relative tolerance instead. The same source builds on
+ * an ARM Linux host to check the NEON path.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "batchTransform.h"
+#include "vecmath.h"
+
+using ndk_helper::BatchTransform;
+using ndk_helper::InstanceTransforms;
+using ndk_helper::Mat4;
+using ndk_helper::Quaternion;
+using ndk_helper::Vec2;
+using ndk_helper::Vec3;
+using ndk_helper::Vec4;
+
+namespace {
+
+#if defined(__FMA__) || defined(__ARM_NEON__) || defined(__ARM_NEON)
+const bool kExact = false;
+#else
+const bool kExact = true;
+#endif
+const double kTolerance = 1e-4;
+
+double NowNs() {
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+ * Scalar reference: the vecmath code before the SIMD paths, unchanged apart
+ * from working on plain column major float arrays.
+ */
+namespace ref {
+
+void Multiply(const float* f, const float* rhs, float* ret) {
+  for (int c = 0; c < 4; ++c) {
+    for (int r = 0; r < 4; ++r) {
+      ret[c * 4 + r] = f[r] * rhs[c * 4] + f[4 + r] * rhs[c * 4 + 1] +
+                       f[8 + r] * rhs[c * 4 + 2] + f[12 + r] * rhs[c * 4 + 3];
+    }
+  }
+}
+
+void Transform(const float* f, const float* v, float* ret) {
+  for (int r = 0; r < 4; ++r) {
+    ret[r] = v[0] * f[r] + v[1] * f[4 + r] + v[2] * f[8 + r] + v[3] * f[12 + r];
+  }
+}
+
+void Inverse(const float* f, float* ret) {
+  float pos = 0;
+  float neg = 0;
+  const float temp[6] = {f[0] * f[5] * f[10],  f[4] * f[9] * f[2],
+                         f[8] * f[1] * f[6],   -f[8] * f[5] * f[2],
+                         -f[4] * f[1] * f[10], -f[0] * f[9] * f[6]};
+  for (int i = 0; i < 6; ++i) {
+    if (temp[i] >= 0)
+      pos += temp[i];
+    else
+      neg += temp[i];
+  }
+  float det_1 = pos + neg;
+
+  for (int i = 0; i < 16; ++i) ret[i] = (i % 5) == 0 ? 1.f : 0.f;
+  if (det_1 == 0.0) return;
+
+  det_1 = 1.0f / det_1;
+  ret[0] = (f[5] * f[10] - f[9] * f[6]) * det_1;
+  ret[1] = -(f[1] * f[10] - f[9] * f[2]) * det_1;
+  ret[2] = (f[1] * f[6] - f[5] * f[2]) * det_1;
+  ret[4] = -(f[4] * f[10] - f[8] * f[6]) * det_1;
+  ret[5] = (f[0] * f[10] - f[8] * f[2]) * det_1;
+  ret[6] = -(f[0] * f[6] - f[4] * f[2]) * det_1;
+  ret[8] = (f[4] * f[9] - f[8] * f[5]) * det_1;
+  ret[9] = -(f[0] * f[9] - f[8] * f[1]) * det_1;
+  ret[10] = (f[0] * f[5] - f[4] * f[1]) * det_1;
+
+  ret[12] = -(f[12] * ret[0] + f[13] * ret[4] + f[14] * ret[8]);
+  ret[13] = -(f[12] * ret[1] + f[13] * ret[5] + f[14] * ret[9]);
+  ret[14] = -(f[12] * ret[2] + f[13] * ret[6] + f[14] * ret[10]);
+}
+
+// x y z w
+void QuaternionMultiply(const float* q, const float* rhs, float* ret) {
+  ret[0] = q[0] * rhs[3] + q[1] * rhs[2] - q[2] * rhs[1] + q[3] * rhs[0];
+  ret[1] = -q[0] * rhs[2] + q[1] * rhs[3] + q[2] * rhs[0] + q[3] * rhs[1];
+  ret[2] = q[0] * rhs[1] - q[1] * rhs[0] + q[2] * rhs[3] + q[3] * rhs[2];
+  ret[3] = -q[0] * rhs[0] - q[1] * rhs[1] - q[2] * rhs[2] + q[3] * rhs[3];
+}
+
+// axis 0, 1, 2: x, y, z
+void Rotation(int axis, float angle, float* ret) {
+  float c = cosf(angle);
+  float s = sinf(angle);
+  int a = (axis + 1) % 3;
+  int b = (axis + 2) % 3;
+  for (int i = 0; i < 16; ++i) ret[i] = (i % 5) == 0 ? 1.f : 0.f;
+  ret[a * 4 + a] = c;
+  ret[b * 4 + a] = s;
+  ret[a * 4 + b] = -s;
+  ret[b * 4 + b] = c;
+}
+
+}  // namespace ref
+
+/*
+ * Double precision inverse by Gauss-Jordan elimination, to check the general
+ * inverse, which has no scalar predecessor.
+ */
+bool InverseDouble(const float* f, double* ret) {
+  double a[4][8];
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      a[r][c] = f[c * 4 + r];
+      a[r][c + 4] = r == c ? 1.0 : 0.0;
+    }
+  }
+  for (int c = 0; c < 4; ++c) {
+    int pivot = c;
+    for (int r = c + 1; r < 4; ++r) {
+      if (fabs(a[r][c]) > fabs(a[pivot][c])) pivot = r;
+    }
+    if (a[pivot][c] == 0.0) return false;
+    for (int k = 0; k < 8; ++k) std::swap(a[c][k], a[pivot][k]);
+    double p = a[c][c];
+    for (int k = 0; k < 8; ++k) a[c][k] /= p;
+    for (int r = 0; r < 4; ++r) {
+      if (r == c) continue;
+      double m = a[r][c];
+      for (int k = 0; k < 8; ++k) a[r][k] -= m * a[c][k];
+    }
+  }
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < 4; ++c) ret[c * 4 + r] = a[r][c + 4];
+  }
+  return true;
+}
+
+class Checker {
+ public:
+  Checker() : failures_(0), max_diff_(0) {}
+
+  // exact: bit exact unless kExact is false
+  void Compare(const char* what, const float* a, const float* b, int n,
+               bool exact) {
+    for (int i = 0; i < n; ++i) {
+      if (memcmp(&a[i], &b[i], sizeof(float)) == 0) continue;
+      double diff =
+          fabs(a[i] - b[i]) / std::max(1.0, static_cast<double>(fabs(b[i])));
+      max_diff_ = std::max(max_diff_, diff);
+      if ((exact && kExact) || diff > kTolerance) Fail(what, i, a[i], b[i]);
+    }
+  }
+
+  void Fail(const char* what, int i, double a, double b) {
+    if (failures_++ < 10) {
+      printf("check: %s [%d] %.9g, expected %.9g\n", what, i, a, b);
+    }
+  }
+
+  int failures() const { return failures_; }
+  double max_diff() const { return max_diff_; }
+
+ private:
+  int failures_;
+  double max_diff_;
+};
+
+const int kCount = 20000;
+
+struct TestData {
+  std::vector<float> a;
+  std::vector<float> b;
+  std::vector<float> affine;
+
+  TestData() : a(kCount * 16), b(kCount * 16), affine(kCount * 16) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-4.f, 4.f);
+    for (int i = 0; i < kCount * 16; ++i) {
+      a[i] = dist(rng);
+      b[i] = dist(rng);
+    }
+    // rotation * scale + translation, like model and view matrices
+    for (int i = 0; i < kCount; ++i) {
+      float t[16], r[16], s[16];
+      ref::Rotation(0, dist(rng), t);
+      ref::Rotation(1, dist(rng), r);
+      ref::Multiply(t, r, s);
+      ref::Rotation(2, dist(rng), t);
+      ref::Multiply(s, t, r);
+      for (int c = 0; c < 3; ++c) {
+        float scale = 0.5f + fabsf(dist(rng));
+        for (int k = 0; k < 3; ++k) r[c * 4 + k] *= scale;
+        r[12 + c] = dist(rng);
+      }
+      memcpy(&affine[i * 16], r, sizeof(r));
+    }
+  }
+};
+
+bool CheckVecmath() {
+  TestData data;
+  Checker check;
+  float o[16], v[4];
+
+  for (int i = 0; i < kCount; ++i) {
+    const float* fa = &data.a[i * 16];
+    const float* fb = &data.b[i * 16];
+    Mat4 ma(fa), mb(fb);
+
+    Mat4 m = ma * mb;
+    ref::Multiply(fa, fb, o);
+    check.Compare("Mat4 * Mat4", m.Ptr(), o, 16, true);
+    m = ma;
+    m *= mb;
+    check.Compare("Mat4 *= Mat4", m.Ptr(), o, 16, true);
+    Mat4 copy(m);
+    check.Compare("Mat4 copy", copy.Ptr(), o, 16, true);
+
+    m = ma + mb;
+    for (int k = 0; k < 16; ++k) o[k] = fa[k] + fb[k];
+    check.Compare("Mat4 + Mat4", m.Ptr(), o, 16, true);
+    m = ma - mb;
+    for (int k = 0; k < 16; ++k) o[k] = fa[k] - fb[k];
+    check.Compare("Mat4 - Mat4", m.Ptr(), o, 16, true);
+    m = ma * 1.7f;
+    for (int k = 0; k < 16; ++k) o[k] = fa[k] * 1.7f;
+    check.Compare("Mat4 * float", m.Ptr(), o, 16, true);
+    m = ma;
+    m.Transpose();
+    for (int k = 0; k < 16; ++k) o[k] = fa[(k % 4) * 4 + k / 4];
+    check.Compare("Transpose", m.Ptr(), o, 16, true);
+
+    Vec4 va(fa), vb(fb);
+    (ma * vb).Value(v[0], v[1], v[2], v[3]);
+    ref::Transform(fa, fb, o);
+    check.Compare("Mat4 * Vec4", v, o, 4, true);
+
+    // these used z for w before, w is now computed like x, y and z
+    (va + vb).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = fa[k] + fb[k];
+    check.Compare("Vec4 + Vec4", v, o, 4, true);
+    (va - vb).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = fa[k] - fb[k];
+    check.Compare("Vec4 - Vec4", v, o, 4, true);
+    Vec4 t = va;
+    t *= vb;
+    t.Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = fa[k] * fb[k];
+    check.Compare("Vec4 *= Vec4", v, o, 4, true);
+    (va / vb).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = fa[k] / fb[k];
+    check.Compare("Vec4 / Vec4", v, o, 4, true);
+    (va / 3.f).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = fa[k] / 3.f;
+    check.Compare("Vec4 / float", v, o, 4, true);
+    (2.f / va).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = 2.f / fa[k];
+    check.Compare("float / Vec4", v, o, 4, true);
+    (-va).Value(v[0], v[1], v[2], v[3]);
+    for (int k = 0; k < 4; ++k) o[k] = -fa[k];
+    check.Compare("-Vec4", v, o, 4, true);
+
+    Quaternion qa(fa + 4), qb(fb + 4);
+    (qa * qb).Value(v[0], v[1], v[2], v[3]);
+    ref::QuaternionMultiply(fa + 4, fb + 4, o);
+    check.Compare("Quaternion *", v, o, 4, true);
+    qa *= qb;
+    qa.Value(v[0], v[1], v[2], v[3]);
+    check.Compare("Quaternion *=", v, o, 4, true);
+
+    float rx[16], ry[16], rz[16], rxy[16];
+    ref::Rotation(0, fa[8], rx);
+    ref::Rotation(1, fa[9], ry);
+    ref::Rotation(2, fa[10], rz);
+    ref::Multiply(rx, ry, rxy);
+    ref::Multiply(rxy, rz, o);
+    m = Mat4::RotationX(fa[8]) * Mat4::RotationY(fa[9]) *
+        Mat4::RotationZ(fa[10]);
+    check.Compare("Rotation", m.Ptr(), o, 16, true);
+
+    // the affine path of Inverse() is the old algorithm
+    m = Mat4(&data.affine[i * 16]);
+    m.Inverse();
+    ref::Inverse(&data.affine[i * 16], o);
+    check.Compare("Inverse (affine)", m.Ptr(), o, 16, true);
+  }
+
+  // general inverse, against a double precision one. Random matrices with a
+  // dominant diagonal are well conditioned enough for a fixed tolerance.
+  std::mt19937 rng(5678);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < kCount; ++i) {
+    float f[16];
+    for (int k = 0; k < 16; ++k) f[k] = dist(rng) + ((k % 5) == 0 ? 4.f : 0.f);
+    double d[16];
+    if (!InverseDouble(f, d)) continue;
+    Mat4 m(f);
+    m.Inverse();
+    float expected[16];
+    for (int k = 0; k < 16; ++k) expected[k] = static_cast<float>(d[k]);
+    check.Compare("Inverse (general)", m.Ptr(), expected, 16, false);
+  }
+  {
+    Mat4 p = Mat4::Perspective(1.f, 1.5f, 0.1f, 100.f);
+    Mat4 inv = p;
+    inv.Inverse();
+    Mat4 id = p * inv;
+    Mat4 expected;
+    check.Compare("Inverse (perspective)", id.Ptr(), expected.Ptr(), 16,
+                  false);
+
+    float zero[16] = {0};
+    Mat4 singular(zero);
+    singular.Inverse();
+    check.Compare("Inverse (singular)", singular.Ptr(), expected.Ptr(), 16,
+                  true);
+  }
+
+  printf("check: vecmath %s, %d failures, max relative difference %g\n",
+         kExact ? "bit exact" : "within tolerance", check.failures(),
+         check.max_diff());
+  return check.failures() == 0;
+}
+
+/*
+ * Best time per call over several alternating runs of each.
+ */
+template <typename Simd, typename Scalar>
+void Bench(const char* name, Simd simd, Scalar scalar) {
+  const int kRepeat = 50;
+  double best[2] = {1e30, 1e30};
+  for (int run = 0; run < 16; ++run) {
+    for (int k = 0; k < 2; ++k) {
+      bool is_simd = ((run + k) & 1) != 0;
+      double start = NowNs();
+      for (int r = 0; r < kRepeat; ++r) {
+        if (is_simd)
+          simd();
+        else
+          scalar();
+      }
+      double t = NowNs() - start;
+      best[is_simd ? 0 : 1] = std::min(best[is_simd ? 0 : 1], t);
+    }
+  }
+  printf("%-16s simd %6.2f ns  scalar %6.2f ns  %.2fx\n", name,
+         best[0] / (kRepeat * kCount), best[1] / (kRepeat * kCount),
+         best[1] / best[0]);
+}
+
+void BenchVecmath() {
+  TestData data;
+  std::vector<Mat4> ma, mb, maffine, mout(kCount);
+  std::vector<Vec4> va;
+  std::vector<Quaternion> qa, qout(kCount);
+  std::vector<float> out(kCount * 16);
+  for (int i = 0; i < kCount; ++i) {
+    ma.push_back(Mat4(&data.a[i * 16]));
+    mb.push_back(Mat4(&data.b[i * 16]));
+    maffine.push_back(Mat4(&data.affine[i * 16]));
+    va.push_back(Vec4(&data.b[i * 16]));
+    qa.push_back(Quaternion(&data.a[i * 16]));
+  }
+  const float* a = data.a.data();
+  const float* b = data.b.data();
+  const float* affine = data.affine.data();
+  float* o = out.data();
+
+  Bench("Mat4 * Mat4",
+        [&] {
+          for (int i = 0; i < kCount; ++i) mout[i] = ma[i] * mb[i];
+        },
+        [&] {
+          for (int i = 0; i < kCount; ++i)
+            ref::Multiply(a + i * 16, b + i * 16, o + i * 16);
+        });
+  Bench("Inverse (affine)",
+        [&] {
+          for (int i = 0; i < kCount; ++i) (mout[i] = maffine[i]).Inverse();
+        },
+        [&] {
+          for (int i = 0; i < kCount; ++i)
+            ref::Inverse(affine + i * 16, o + i * 16);
+        });
+  Bench("Mat4 * Vec4",
+        [&] {
+          for (int i = 0; i < kCount; ++i) {
+            float* v = o + i * 4;
+            (ma[i] * va[i]).Value(v[0], v[1], v[2], v[3]);
+          }
+        },
+        [&] {
+          for (int i = 0; i < kCount; ++i)
+            ref::Transform(a + i * 16, b + i * 16, o + i * 4);
+        });
+  Bench("Quaternion *",
+        [&] {
+          for (int i = 1; i < kCount; ++i) qout[i] = qa[i] * qa[i - 1];
+        },
+        [&] {
+          for (int i = 1; i < kCount; ++i)
+            ref::QuaternionMultiply(a + i * 16, a + i * 16 - 16, o + i * 4);
+        });
+
+  // keep the results alive
+  float sink = 0;
+  for (int i = 0; i < kCount; ++i) sink += mout[i].Ptr()[5] + out[i * 16 + 5];
+  if (sink == 0.123f) printf("%g\n", sink);
+}
+
+/*
+ * more-teapots' instances: a side^3 grid of teapots spinning about x and y,
+ * with the per-instance Mat4 chain it used before BatchTransform.
+ */
+struct Teapots {
+  int32_t count;
+  std::vector<Mat4> models;
+  std::vector<Vec2> spins;
+  std::vector<Vec2> rotations;
+  InstanceTransforms instances;
+  Mat4 view;
+  Mat4 projection;
+
+  explicit Teapots(int32_t side) : count(side * side * side) {
+    const float kPi = 3.14159265f;
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+    const float total_width = 500.f;
+    float gap = total_width / (side - 1);
+    float offset = -total_width / 2.f;
+    for (int32_t x = 0; x < side; ++x)
+      for (int32_t y = 0; y < side; ++y)
+        for (int32_t z = 0; z < side; ++z) {
+          Vec3 translation(x * gap + offset, y * gap + offset,
+                           z * gap + offset);
+          float rotation_x = dist(rng);
+          float rotation_y = dist(rng);
+          Vec2 spin(rotation_x * 0.05f, rotation_y * 0.05f);
+          Vec2 rotation(rotation_x * kPi, rotation_y * kPi);
+          models.push_back(Mat4::Translation(translation));
+          spins.push_back(spin);
+          rotations.push_back(rotation);
+          instances.Add(translation, rotation, spin);
+        }
+    view = Mat4::LookAt(Vec3(0.f, 0.f, 2000.f), Vec3(0.f, 0.f, 0.f),
+                        Vec3(0.f, 1.f, 0.f)) *
+           Mat4::RotationY(0.3f);
+    projection = Mat4::Perspective(1.f, 1.5f, 5.f, 10000.f);
+  }
+
+  void UpdateModelView(float* mvp, float* mv) {
+    for (int32_t i = 0; i < count; ++i) {
+      float x, y;
+      rotations[i] += spins[i];
+      rotations[i].Value(x, y);
+      Mat4 rotation = Mat4::RotationX(x) * Mat4::RotationY(y);
+      Mat4 v = view * models[i] * rotation;
+      Mat4 vp = projection * v;
+      memcpy(mvp + i * 16, vp.Ptr(), sizeof(float) * 16);
+      memcpy(mv + i * 16, v.Ptr(), sizeof(float) * 16);
+    }
+  }
+};
+
+// largest difference relative to each column's magnitude, the outputs are
+// sums of terms up to the scene size
+double MaxColumnDiff(const float* a, const float* b, int32_t count) {
+  double max_diff = 0;
+  for (int32_t i = 0; i < count * 4; ++i) {
+    double scale = 1.0;
+    for (int32_t k = 0; k < 4; ++k)
+      scale = std::max(scale, static_cast<double>(fabs(b[i * 4 + k])));
+    for (int32_t k = 0; k < 4; ++k)
+      max_diff = std::max(max_diff, fabs(a[i * 4 + k] - b[i * 4 + k]) / scale);
+  }
+  return max_diff;
+}
+
+bool CheckBatch() {
+  bool ok = true;
+  for (int32_t threads = 1; threads <= 4; threads *= 2) {
+    // large enough to split across the threads
+    Teapots teapots(16);
+    BatchTransform batch(threads);
+    int32_t n = teapots.count;
+    std::vector<float> expected(n * 32), out(n * 32);
+    for (int32_t frame = 0; frame < 10; ++frame) {
+      teapots.UpdateModelView(expected.data(), expected.data() + n * 16);
+      batch.UpdateModelView(&teapots.instances, teapots.view,
+                            teapots.projection, out.data(),
+                            out.data() + n * 16, 16);
+    }
+    double diff = MaxColumnDiff(out.data(), expected.data(), n * 2);
+    if (diff > kTolerance) {
+      printf("check: UpdateModelView with %d threads, difference %g\n",
+             batch.GetThreadCount(), diff);
+      ok = false;
+    }
+
+    // in place, as the stride allows
+    std::mt19937 rng(threads);
+    std::uniform_real_distribution<float> dist(-4.f, 4.f);
+    for (int32_t i = 0; i < n * 16; ++i) out[i] = dist(rng);
+    for (int32_t i = 0; i < n; ++i) {
+      Mat4 m = teapots.view * Mat4(&out[i * 16]);
+      memcpy(&expected[i * 16], m.Ptr(), sizeof(float) * 16);
+    }
+    batch.Multiply(teapots.view, out.data(), out.data(), n, 16);
+    if (memcmp(out.data(), expected.data(), sizeof(float) * n * 16)) {
+      printf("check: Multiply with %d threads differs from Mat4 *\n",
+             batch.GetThreadCount());
+      ok = false;
+    }
+  }
+  printf("check: batch transform %s\n", ok ? "within tolerance" : "FAILED");
+  return ok;
+}
+
+/*
+ * Instances per millisecond of UpdateModelView() against the Mat4 chain,
+ * for a few grid sizes.
+ */
+void BenchBatch() {
+  const int32_t kSides[] = {8, 16, 32};
+  for (int32_t side : kSides) {
+    Teapots teapots(side);
+    int32_t n = teapots.count;
+    // about two million instance updates per run
+    int32_t frames = std::max(4, 2000000 / n);
+    std::vector<float> out(n * 32);
+
+    double start = NowNs();
+    for (int32_t frame = 0; frame < frames; ++frame)
+      teapots.UpdateModelView(out.data(), out.data() + n * 16);
+    double chain = (NowNs() - start) / frames;
+    printf("%6d instances  Mat4 chain        %7.0f instances/ms\n", n,
+           n * 1e6 / chain);
+
+    for (int32_t threads = 1; threads <= 4; threads *= 2) {
+      BatchTransform batch(threads);
+      start = NowNs();
+      for (int32_t frame = 0; frame < frames; ++frame)
+        batch.UpdateModelView(&teapots.instances, teapots.view,
+                              teapots.projection, out.data(),
+                              out.data() + n * 16, 16);
+      double t = (NowNs() - start) / frames;
+      printf("%6d instances  batch, %d thread%s %7.0f instances/ms  %.2fx\n",
+             n, batch.GetThreadCount(), threads > 1 ? "s" : " ",
+             n * 1e6 / t, chain / t);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* mode = argc > 1 ? argv[1] : nullptr;
+  if (mode && strcmp(mode, "check") && strcmp(mode, "vecmath") &&
+      strcmp(mode, "batch")) {
+    fprintf(stderr, "usage: %s [check|vecmath|batch]\n", argv[0]);
+    return 2;
+  }
+
+  bool ok = true;
+  if (!mode || !strcmp(mode, "check")) {
+    ok = CheckVecmath() && ok;
+    ok = CheckBatch() && ok;
+    printf("check: %s\n", ok ? "ok" : "FAILED");
+  }
+  if (!mode || !strcmp(mode, "vecmath")) {
+    BenchVecmath();
+  }
+  if (!mode || !strcmp(mode, "batch")) {
+    BenchBatch();
+  }
+  return ok ? 0 : 1;
+}
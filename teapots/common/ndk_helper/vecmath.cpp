@@ -53,60 +53,32 @@ Mat4::Mat4() {
 }
 
 Mat4::Mat4(const float* mIn) {
-  for (int32_t i = 0; i < 16; ++i) f_[i] = mIn[i];
+  for (int32_t i = 0; i < 16; i += 4) simd::Store(f_ + i, simd::Load(mIn + i));
 }
 
 Mat4 Mat4::operator*(const Mat4& rhs) const {
+  simd::Float4 lhs[4] = {simd::Load(f_), simd::Load(f_ + 4),
+                         simd::Load(f_ + 8), simd::Load(f_ + 12)};
   Mat4 ret;
-  ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-              f_[12] * rhs.f_[3];
-  ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-              f_[13] * rhs.f_[3];
-  ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-              f_[14] * rhs.f_[3];
-  ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-              f_[15] * rhs.f_[3];
-
-  ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-              f_[12] * rhs.f_[7];
-  ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-              f_[13] * rhs.f_[7];
-  ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-              f_[14] * rhs.f_[7];
-  ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-              f_[15] * rhs.f_[7];
-
-  ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-              f_[12] * rhs.f_[11];
-  ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-              f_[13] * rhs.f_[11];
-  ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-               f_[14] * rhs.f_[11];
-  ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-               f_[15] * rhs.f_[11];
-
-  ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-               f_[12] * rhs.f_[15];
-  ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-               f_[13] * rhs.f_[15];
-  ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-               f_[14] * rhs.f_[15];
-  ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-               f_[15] * rhs.f_[15];
-
+  simd::Store(ret.f_, simd::Transform(lhs, simd::Load(rhs.f_)));
+  simd::Store(ret.f_ + 4, simd::Transform(lhs, simd::Load(rhs.f_ + 4)));
+  simd::Store(ret.f_ + 8, simd::Transform(lhs, simd::Load(rhs.f_ + 8)));
+  simd::Store(ret.f_ + 12, simd::Transform(lhs, simd::Load(rhs.f_ + 12)));
   return ret;
 }
 
 Vec4 Mat4::operator*(const Vec4& rhs) const {
-  Vec4 ret;
-  ret.x_ = rhs.x_ * f_[0] + rhs.y_ * f_[4] + rhs.z_ * f_[8] + rhs.w_ * f_[12];
-  ret.y_ = rhs.x_ * f_[1] + rhs.y_ * f_[5] + rhs.z_ * f_[9] + rhs.w_ * f_[13];
-  ret.z_ = rhs.x_ * f_[2] + rhs.y_ * f_[6] + rhs.z_ * f_[10] + rhs.w_ * f_[14];
-  ret.w_ = rhs.x_ * f_[3] + rhs.y_ * f_[7] + rhs.z_ * f_[11] + rhs.w_ * f_[15];
-  return ret;
+  simd::Float4 lhs[4] = {simd::Load(f_), simd::Load(f_ + 4),
+                         simd::Load(f_ + 8), simd::Load(f_ + 12)};
+  return Vec4().Store(simd::Transform(lhs, rhs.Load()));
 }
 
 Mat4 Mat4::Inverse() {
+  if (f_[3] != 0.f || f_[7] != 0.f || f_[11] != 0.f || f_[15] != 1.f) {
+    *this = InverseGeneral();
+    return *this;
+  }
+
   Mat4 ret;
   float det_1;
   float pos = 0;
@@ -149,24 +121,24 @@ Mat4 Mat4::Inverse() {
     // Error
   } else {
     det_1 = 1.0f / det_1;
-    ret.f_[0] = (f_[5] * f_[10] - f_[9] * f_[6]) * det_1;
-    ret.f_[1] = -(f_[1] * f_[10] - f_[9] * f_[2]) * det_1;
-    ret.f_[2] = (f_[1] * f_[6] - f_[5] * f_[2]) * det_1;
-    ret.f_[4] = -(f_[4] * f_[10] - f_[8] * f_[6]) * det_1;
-    ret.f_[5] = (f_[0] * f_[10] - f_[8] * f_[2]) * det_1;
-    ret.f_[6] = -(f_[0] * f_[6] - f_[4] * f_[2]) * det_1;
-    ret.f_[8] = (f_[4] * f_[9] - f_[8] * f_[5]) * det_1;
-    ret.f_[9] = -(f_[0] * f_[9] - f_[8] * f_[1]) * det_1;
-    ret.f_[10] = (f_[0] * f_[5] - f_[4] * f_[1]) * det_1;
+
+    // columns of inverse(A) are the cross products of the rows of A
+    simd::Float4 rows[4] = {simd::Load(f_), simd::Load(f_ + 4),
+                            simd::Load(f_ + 8), simd::Load(f_ + 12)};
+    simd::Transpose(rows);
+    simd::Float4 cols[3];
+    cols[0] = simd::Mul(simd::Cross(rows[1], rows[2]), det_1);
+    cols[1] = simd::Mul(simd::Cross(rows[2], rows[0]), det_1);
+    cols[2] = simd::Mul(simd::Cross(rows[0], rows[1]), det_1);
 
     /* Calculate -C * inverse(A) */
-    ret.f_[12] =
-        -(f_[12] * ret.f_[0] + f_[13] * ret.f_[4] + f_[14] * ret.f_[8]);
-    ret.f_[13] =
-        -(f_[12] * ret.f_[1] + f_[13] * ret.f_[5] + f_[14] * ret.f_[9]);
-    ret.f_[14] =
-        -(f_[12] * ret.f_[2] + f_[13] * ret.f_[6] + f_[14] * ret.f_[10]);
+    simd::Float4 translation =
+        simd::Mul(simd::Transform3(cols, f_[12], f_[13], f_[14]), -1.f);
 
+    simd::Store(ret.f_, cols[0]);
+    simd::Store(ret.f_ + 4, cols[1]);
+    simd::Store(ret.f_ + 8, cols[2]);
+    simd::Store(ret.f_ + 12, translation);
     ret.f_[3] = 0.0f;
     ret.f_[7] = 0.0f;
     ret.f_[11] = 0.0f;
@@ -177,6 +149,48 @@ Mat4 Mat4::Inverse() {
   return *this;
 }
 
+Mat4 Mat4::InverseGeneral() const {
+  // 2x2 sub-determinants of the first and last two columns. The same
+  // expansion works for either storage order, inverse(transpose(M)) is
+  // transpose(inverse(M)).
+  const float* m = f_;
+  float s0 = m[0] * m[5] - m[4] * m[1];
+  float s1 = m[0] * m[6] - m[4] * m[2];
+  float s2 = m[0] * m[7] - m[4] * m[3];
+  float s3 = m[1] * m[6] - m[5] * m[2];
+  float s4 = m[1] * m[7] - m[5] * m[3];
+  float s5 = m[2] * m[7] - m[6] * m[3];
+  float c5 = m[10] * m[15] - m[14] * m[11];
+  float c4 = m[9] * m[15] - m[13] * m[11];
+  float c3 = m[9] * m[14] - m[13] * m[10];
+  float c2 = m[8] * m[15] - m[12] * m[11];
+  float c1 = m[8] * m[14] - m[12] * m[10];
+  float c0 = m[8] * m[13] - m[12] * m[9];
+
+  Mat4 ret;
+  float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  if (det == 0.f) return ret;
+  float det_1 = 1.0f / det;
+
+  ret.f_[0] = (m[5] * c5 - m[6] * c4 + m[7] * c3) * det_1;
+  ret.f_[1] = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * det_1;
+  ret.f_[2] = (m[13] * s5 - m[14] * s4 + m[15] * s3) * det_1;
+  ret.f_[3] = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * det_1;
+  ret.f_[4] = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * det_1;
+  ret.f_[5] = (m[0] * c5 - m[2] * c2 + m[3] * c1) * det_1;
+  ret.f_[6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * det_1;
+  ret.f_[7] = (m[8] * s5 - m[10] * s2 + m[11] * s1) * det_1;
+  ret.f_[8] = (m[4] * c4 - m[5] * c2 + m[7] * c0) * det_1;
+  ret.f_[9] = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * det_1;
+  ret.f_[10] = (m[12] * s4 - m[13] * s2 + m[15] * s0) * det_1;
+  ret.f_[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * det_1;
+  ret.f_[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * det_1;
+  ret.f_[13] = (m[0] * c3 - m[1] * c1 + m[2] * c0) * det_1;
+  ret.f_[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * det_1;
+  ret.f_[15] = (m[8] * s3 - m[9] * s1 + m[10] * s0) * det_1;
+  return ret;
+}
+
 //--------------------------------------------------------------------------------
 // Misc
 //--------------------------------------------------------------------------------
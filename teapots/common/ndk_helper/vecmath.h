@@ -18,13 +18,21 @@
 #define VECMATH_H_
 
 #include <cmath>
+#ifdef __ANDROID__
 #include "JNIHelper.h"
+#else
+// host builds (see host_bench.cpp) have no JNIHelper, Dump() prints instead
+#include <cstdio>
+#define LOGI(...) (printf(__VA_ARGS__), printf("\n"))
+#endif
+#include "vecmathSimd.h"
 
 namespace ndk_helper {
 
 /******************************************************************
  * Helper class for vector math operations
- * Currently all implementations are in pure C++.
+ * Vec4, Mat4 and Quaternion are 16 byte aligned and use NEON/SSE where
+ * available (see vecmathSimd.h), the rest is pure C++.
  * Each class is an opaque class so caller does not have a direct access
  * to each element. This is for an ease of future optimization to use vector
  *operations.
@@ -50,6 +58,7 @@ class Vec2 {
   friend class Vec4;
   friend class Mat4;
   friend class Quaternion;
+  friend struct InstanceTransforms;
 
   Vec2() { x_ = y_ = 0.f; }
 
@@ -213,6 +222,7 @@ class Vec3 {
   friend class Vec4;
   friend class Mat4;
   friend class Quaternion;
+  friend struct InstanceTransforms;
 
   Vec3() { x_ = y_ = z_ = 0.f; }
 
@@ -403,10 +413,16 @@ class Vec3 {
  * 4 elements vector class
  *
  */
-class Vec4 {
+class alignas(16) Vec4 {
  private:
   float x_, y_, z_, w_;
 
+  simd::Float4 Load() const { return simd::Load(&x_); }
+  Vec4& Store(simd::Float4 v) {
+    simd::Store(&x_, v);
+    return *this;
+  }
+
  public:
   friend class Vec3;
   friend class Mat4;
@@ -435,136 +451,65 @@ class Vec4 {
     w_ = fW;
   }
 
-  Vec4(const float* pVec) {
-    x_ = (*pVec++);
-    y_ = (*pVec++);
-    z_ = *pVec;
-    w_ = *pVec;
-  }
+  Vec4(const float* pVec) { Store(simd::Load(pVec)); }
 
   // Operators
   Vec4 operator*(const Vec4& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ * rhs.x_;
-    ret.y_ = y_ * rhs.y_;
-    ret.z_ = z_ * rhs.z_;
-    ret.w_ = z_ * rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Mul(Load(), rhs.Load()));
   }
 
   Vec4 operator/(const Vec4& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ / rhs.x_;
-    ret.y_ = y_ / rhs.y_;
-    ret.z_ = z_ / rhs.z_;
-    ret.w_ = z_ / rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Div(Load(), rhs.Load()));
   }
 
   Vec4 operator+(const Vec4& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ + rhs.x_;
-    ret.y_ = y_ + rhs.y_;
-    ret.z_ = z_ + rhs.z_;
-    ret.w_ = z_ + rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Add(Load(), rhs.Load()));
   }
 
   Vec4 operator-(const Vec4& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ - rhs.x_;
-    ret.y_ = y_ - rhs.y_;
-    ret.z_ = z_ - rhs.z_;
-    ret.w_ = z_ - rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Sub(Load(), rhs.Load()));
   }
 
   Vec4& operator+=(const Vec4& rhs) {
-    x_ += rhs.x_;
-    y_ += rhs.y_;
-    z_ += rhs.z_;
-    w_ += rhs.w_;
-    return *this;
+    return Store(simd::Add(Load(), rhs.Load()));
   }
 
   Vec4& operator-=(const Vec4& rhs) {
-    x_ -= rhs.x_;
-    y_ -= rhs.y_;
-    z_ -= rhs.z_;
-    w_ -= rhs.w_;
-    return *this;
+    return Store(simd::Sub(Load(), rhs.Load()));
   }
 
   Vec4& operator*=(const Vec4& rhs) {
-    x_ *= rhs.x_;
-    y_ *= rhs.y_;
-    z_ *= rhs.z_;
-    w_ *= rhs.w_;
-    return *this;
+    return Store(simd::Mul(Load(), rhs.Load()));
   }
 
   Vec4& operator/=(const Vec4& rhs) {
-    x_ /= rhs.x_;
-    y_ /= rhs.y_;
-    z_ /= rhs.z_;
-    w_ /= rhs.w_;
-    return *this;
+    return Store(simd::Div(Load(), rhs.Load()));
   }
 
   // External operators
   friend Vec4 operator-(const Vec4& rhs) { return Vec4(rhs) *= -1; }
 
   friend Vec4 operator*(const float lhs, const Vec4& rhs) {
-    Vec4 ret;
-    ret.x_ = lhs * rhs.x_;
-    ret.y_ = lhs * rhs.y_;
-    ret.z_ = lhs * rhs.z_;
-    ret.w_ = lhs * rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Mul(rhs.Load(), lhs));
   }
 
   friend Vec4 operator/(const float lhs, const Vec4& rhs) {
-    Vec4 ret;
-    ret.x_ = lhs / rhs.x_;
-    ret.y_ = lhs / rhs.y_;
-    ret.z_ = lhs / rhs.z_;
-    ret.w_ = lhs / rhs.w_;
-    return ret;
+    return Vec4().Store(simd::Div(simd::Splat(lhs), rhs.Load()));
   }
 
   // Operators with float
   Vec4 operator*(const float& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ * rhs;
-    ret.y_ = y_ * rhs;
-    ret.z_ = z_ * rhs;
-    ret.w_ = w_ * rhs;
-    return ret;
+    return Vec4().Store(simd::Mul(Load(), rhs));
   }
 
-  Vec4& operator*=(const float& rhs) {
-    x_ = x_ * rhs;
-    y_ = y_ * rhs;
-    z_ = z_ * rhs;
-    w_ = w_ * rhs;
-    return *this;
-  }
+  Vec4& operator*=(const float& rhs) { return Store(simd::Mul(Load(), rhs)); }
 
   Vec4 operator/(const float& rhs) const {
-    Vec4 ret;
-    ret.x_ = x_ / rhs;
-    ret.y_ = y_ / rhs;
-    ret.z_ = z_ / rhs;
-    ret.w_ = w_ / rhs;
-    return ret;
+    return Vec4().Store(simd::Div(Load(), simd::Splat(rhs)));
   }
 
   Vec4& operator/=(const float& rhs) {
-    x_ = x_ / rhs;
-    y_ = y_ / rhs;
-    z_ = z_ / rhs;
-    w_ = w_ / rhs;
-    return *this;
+    return Store(simd::Div(Load(), simd::Splat(rhs)));
   }
 
   // Compare
@@ -625,134 +570,74 @@ class Vec4 {
  */
 class Mat4 {
  private:
-  float f_[16];
+  alignas(16) float f_[16];
+
+  Mat4 InverseGeneral() const;
 
  public:
   friend class Vec3;
   friend class Vec4;
   friend class Quaternion;
+  friend class BatchTransform;
 
   Mat4();
   Mat4(const float*);
+  Mat4(const Mat4& rhs) { *this = rhs; }
 
   Mat4 operator*(const Mat4& rhs) const;
   Vec4 operator*(const Vec4& rhs) const;
 
-  Mat4 operator+(const Mat4& rhs) const {
-    Mat4 ret;
-    for (int32_t i = 0; i < 16; ++i) {
-      ret.f_[i] = f_[i] + rhs.f_[i];
-    }
-    return ret;
-  }
+  Mat4 operator+(const Mat4& rhs) const { return Mat4(*this) += rhs; }
 
-  Mat4 operator-(const Mat4& rhs) const {
-    Mat4 ret;
-    for (int32_t i = 0; i < 16; ++i) {
-      ret.f_[i] = f_[i] - rhs.f_[i];
-    }
-    return ret;
-  }
+  Mat4 operator-(const Mat4& rhs) const { return Mat4(*this) -= rhs; }
 
   Mat4& operator+=(const Mat4& rhs) {
-    for (int32_t i = 0; i < 16; ++i) {
-      f_[i] += rhs.f_[i];
+    for (int32_t i = 0; i < 16; i += 4) {
+      simd::Store(f_ + i,
+                  simd::Add(simd::Load(f_ + i), simd::Load(rhs.f_ + i)));
     }
     return *this;
   }
 
   Mat4& operator-=(const Mat4& rhs) {
-    for (int32_t i = 0; i < 16; ++i) {
-      f_[i] -= rhs.f_[i];
+    for (int32_t i = 0; i < 16; i += 4) {
+      simd::Store(f_ + i,
+                  simd::Sub(simd::Load(f_ + i), simd::Load(rhs.f_ + i)));
     }
     return *this;
   }
 
   Mat4& operator*=(const Mat4& rhs) {
-    Mat4 ret;
-    ret.f_[0] = f_[0] * rhs.f_[0] + f_[4] * rhs.f_[1] + f_[8] * rhs.f_[2] +
-                f_[12] * rhs.f_[3];
-    ret.f_[1] = f_[1] * rhs.f_[0] + f_[5] * rhs.f_[1] + f_[9] * rhs.f_[2] +
-                f_[13] * rhs.f_[3];
-    ret.f_[2] = f_[2] * rhs.f_[0] + f_[6] * rhs.f_[1] + f_[10] * rhs.f_[2] +
-                f_[14] * rhs.f_[3];
-    ret.f_[3] = f_[3] * rhs.f_[0] + f_[7] * rhs.f_[1] + f_[11] * rhs.f_[2] +
-                f_[15] * rhs.f_[3];
-
-    ret.f_[4] = f_[0] * rhs.f_[4] + f_[4] * rhs.f_[5] + f_[8] * rhs.f_[6] +
-                f_[12] * rhs.f_[7];
-    ret.f_[5] = f_[1] * rhs.f_[4] + f_[5] * rhs.f_[5] + f_[9] * rhs.f_[6] +
-                f_[13] * rhs.f_[7];
-    ret.f_[6] = f_[2] * rhs.f_[4] + f_[6] * rhs.f_[5] + f_[10] * rhs.f_[6] +
-                f_[14] * rhs.f_[7];
-    ret.f_[7] = f_[3] * rhs.f_[4] + f_[7] * rhs.f_[5] + f_[11] * rhs.f_[6] +
-                f_[15] * rhs.f_[7];
-
-    ret.f_[8] = f_[0] * rhs.f_[8] + f_[4] * rhs.f_[9] + f_[8] * rhs.f_[10] +
-                f_[12] * rhs.f_[11];
-    ret.f_[9] = f_[1] * rhs.f_[8] + f_[5] * rhs.f_[9] + f_[9] * rhs.f_[10] +
-                f_[13] * rhs.f_[11];
-    ret.f_[10] = f_[2] * rhs.f_[8] + f_[6] * rhs.f_[9] + f_[10] * rhs.f_[10] +
-                 f_[14] * rhs.f_[11];
-    ret.f_[11] = f_[3] * rhs.f_[8] + f_[7] * rhs.f_[9] + f_[11] * rhs.f_[10] +
-                 f_[15] * rhs.f_[11];
-
-    ret.f_[12] = f_[0] * rhs.f_[12] + f_[4] * rhs.f_[13] + f_[8] * rhs.f_[14] +
-                 f_[12] * rhs.f_[15];
-    ret.f_[13] = f_[1] * rhs.f_[12] + f_[5] * rhs.f_[13] + f_[9] * rhs.f_[14] +
-                 f_[13] * rhs.f_[15];
-    ret.f_[14] = f_[2] * rhs.f_[12] + f_[6] * rhs.f_[13] + f_[10] * rhs.f_[14] +
-                 f_[14] * rhs.f_[15];
-    ret.f_[15] = f_[3] * rhs.f_[12] + f_[7] * rhs.f_[13] + f_[11] * rhs.f_[14] +
-                 f_[15] * rhs.f_[15];
-
-    *this = ret;
+    *this = *this * rhs;
     return *this;
   }
 
-  Mat4 operator*(const float rhs) {
-    Mat4 ret;
-    for (int32_t i = 0; i < 16; ++i) {
-      ret.f_[i] = f_[i] * rhs;
-    }
-    return ret;
-  }
+  Mat4 operator*(const float rhs) { return Mat4(*this) *= rhs; }
 
   Mat4& operator*=(const float rhs) {
-    for (int32_t i = 0; i < 16; ++i) {
-      f_[i] *= rhs;
+    for (int32_t i = 0; i < 16; i += 4) {
+      simd::Store(f_ + i, simd::Mul(simd::Load(f_ + i), rhs));
     }
     return *this;
   }
 
   Mat4& operator=(const Mat4& rhs) {
-    for (int32_t i = 0; i < 16; ++i) {
-      f_[i] = rhs.f_[i];
+    for (int32_t i = 0; i < 16; i += 4) {
+      simd::Store(f_ + i, simd::Load(rhs.f_ + i));
     }
     return *this;
   }
 
+  // Inverts in place and returns the result. Affine matrices (last row
+  // 0 0 0 1, e.g. any model or view matrix) take a fast path, others a
+  // full 4x4 inverse. A singular matrix becomes identity.
   Mat4 Inverse();
 
   Mat4 Transpose() {
-    Mat4 ret;
-    ret.f_[0] = f_[0];
-    ret.f_[1] = f_[4];
-    ret.f_[2] = f_[8];
-    ret.f_[3] = f_[12];
-    ret.f_[4] = f_[1];
-    ret.f_[5] = f_[5];
-    ret.f_[6] = f_[9];
-    ret.f_[7] = f_[13];
-    ret.f_[8] = f_[2];
-    ret.f_[9] = f_[6];
-    ret.f_[10] = f_[10];
-    ret.f_[11] = f_[14];
-    ret.f_[12] = f_[3];
-    ret.f_[13] = f_[7];
-    ret.f_[14] = f_[11];
-    ret.f_[15] = f_[15];
-    *this = ret;
+    simd::Float4 m[4] = {simd::Load(f_), simd::Load(f_ + 4),
+                         simd::Load(f_ + 8), simd::Load(f_ + 12)};
+    simd::Transpose(m);
+    for (int32_t i = 0; i < 4; ++i) simd::Store(f_ + i * 4, m[i]);
     return *this;
   }
 
@@ -819,7 +704,7 @@ class Mat4 {
  * Quaternion class
  *
  */
-class Quaternion {
+class alignas(16) Quaternion {
  private:
   float x_, y_, z_, w_;
 
@@ -857,21 +742,28 @@ class Quaternion {
   }
 
   Quaternion operator*(const Quaternion rhs) {
+    // rhs components as multiplied by each of x, y, z and w, the sign
+    // flips are exact
+    simd::Float4 by_w = simd::Load(&rhs.x_);
+    simd::Float4 by_x = simd::Mul(simd::SwapHalves(simd::SwapPairs(by_w)),
+                                  simd::Set(1.f, -1.f, 1.f, -1.f));
+    simd::Float4 by_y = simd::Mul(simd::SwapHalves(by_w),
+                                  simd::Set(1.f, 1.f, -1.f, -1.f));
+    simd::Float4 by_z = simd::Mul(simd::SwapPairs(by_w),
+                                  simd::Set(-1.f, 1.f, 1.f, -1.f));
+
+    simd::Float4 q = simd::Mul(by_x, x_);
+    q = simd::MulAdd(q, by_y, y_);
+    q = simd::MulAdd(q, by_z, z_);
+    q = simd::MulAdd(q, by_w, w_);
+
     Quaternion ret;
-    ret.x_ = x_ * rhs.w_ + y_ * rhs.z_ - z_ * rhs.y_ + w_ * rhs.x_;
-    ret.y_ = -x_ * rhs.z_ + y_ * rhs.w_ + z_ * rhs.x_ + w_ * rhs.y_;
-    ret.z_ = x_ * rhs.y_ - y_ * rhs.x_ + z_ * rhs.w_ + w_ * rhs.z_;
-    ret.w_ = -x_ * rhs.x_ - y_ * rhs.y_ - z_ * rhs.z_ + w_ * rhs.w_;
+    simd::Store(&ret.x_, q);
     return ret;
   }
 
   Quaternion& operator*=(const Quaternion rhs) {
-    Quaternion ret;
-    ret.x_ = x_ * rhs.w_ + y_ * rhs.z_ - z_ * rhs.y_ + w_ * rhs.x_;
-    ret.y_ = -x_ * rhs.z_ + y_ * rhs.w_ + z_ * rhs.x_ + w_ * rhs.y_;
-    ret.z_ = x_ * rhs.y_ - y_ * rhs.x_ + z_ * rhs.w_ + w_ * rhs.z_;
-    ret.w_ = -x_ * rhs.x_ - y_ * rhs.y_ - z_ * rhs.z_ + w_ * rhs.w_;
-    *this = ret;
+    *this = *this * rhs;
     return *this;
   }
 
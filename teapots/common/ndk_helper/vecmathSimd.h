@@ -0,0 +1,240 @@
+/*
+ * Copyright 2013 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VECMATHSIMD_H_
+#define VECMATHSIMD_H_
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#if defined(__FMA__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace ndk_helper {
+
+/******************************************************************
+ * 4 float vector helpers for the vecmath implementation
+ * NEON on ARM, SSE on x86 and plain C++ elsewhere. Loads and stores
+ * are unaligned so any float pointer works, aligned data is faster.
+ * MulAdd is fused where the CPU has it (aarch64, x86 with FMA), so
+ * results there may differ from separate multiply and add in the
+ * last bit.
+ *
+ */
+namespace simd {
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+typedef float32x4_t Float4;
+inline Float4 Load(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, Float4 v) { vst1q_f32(p, v); }
+inline Float4 Set(float x, float y, float z, float w) {
+  float f[4] = {x, y, z, w};
+  return vld1q_f32(f);
+}
+inline Float4 Splat(float f) { return vdupq_n_f32(f); }
+inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+inline Float4 Mul(Float4 a, float b) { return vmulq_n_f32(a, b); }
+inline Float4 Div(Float4 a, Float4 b) {
+#if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#else
+  // no divide in ARMv7 NEON, the reciprocal estimate is not exact
+  float fa[4], fb[4];
+  vst1q_f32(fa, a);
+  vst1q_f32(fb, b);
+  for (int i = 0; i < 4; ++i) fa[i] /= fb[i];
+  return vld1q_f32(fa);
+#endif
+}
+// acc + a * b
+inline Float4 MulAdd(Float4 acc, Float4 a, Float4 b) {
+#if defined(__aarch64__)
+  return vfmaq_f32(acc, a, b);
+#else
+  return vmlaq_f32(acc, a, b);
+#endif
+}
+inline Float4 MulAdd(Float4 acc, Float4 a, float b) {
+#if defined(__aarch64__)
+  return vfmaq_n_f32(acc, a, b);
+#else
+  return vmlaq_n_f32(acc, a, b);
+#endif
+}
+// (y, z, x, ?)
+inline Float4 RotateXYZ(Float4 v) {
+  float32x2_t xy = vget_low_f32(v);
+  return vcombine_f32(vext_f32(xy, vget_high_f32(v), 1), xy);
+}
+// (y, x, w, z)
+inline Float4 SwapPairs(Float4 v) { return vrev64q_f32(v); }
+// (z, w, x, y)
+inline Float4 SwapHalves(Float4 v) { return vextq_f32(v, v, 2); }
+// lhs columns * rhs, a column held in a register
+inline Float4 Transform(const Float4* lhs, Float4 rhs) {
+#if defined(__aarch64__)
+  Float4 c = vmulq_laneq_f32(lhs[0], rhs, 0);
+  c = vfmaq_laneq_f32(c, lhs[1], rhs, 1);
+  c = vfmaq_laneq_f32(c, lhs[2], rhs, 2);
+  return vfmaq_laneq_f32(c, lhs[3], rhs, 3);
+#else
+  float32x2_t xy = vget_low_f32(rhs), zw = vget_high_f32(rhs);
+  Float4 c = vmulq_lane_f32(lhs[0], xy, 0);
+  c = vmlaq_lane_f32(c, lhs[1], xy, 1);
+  c = vmlaq_lane_f32(c, lhs[2], zw, 0);
+  return vmlaq_lane_f32(c, lhs[3], zw, 1);
+#endif
+}
+// columns to rows, in place
+inline void Transpose(Float4* m) {
+  float32x4x2_t t01 = vtrnq_f32(m[0], m[1]);
+  float32x4x2_t t23 = vtrnq_f32(m[2], m[3]);
+  m[0] = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+  m[1] = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+  m[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+  m[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+#elif defined(__SSE__)
+typedef __m128 Float4;
+inline Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+inline Float4 Set(float x, float y, float z, float w) {
+  return _mm_setr_ps(x, y, z, w);
+}
+inline Float4 Splat(float f) { return _mm_set1_ps(f); }
+inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+inline Float4 Sub(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+inline Float4 Mul(Float4 a, float b) { return _mm_mul_ps(a, _mm_set1_ps(b)); }
+inline Float4 Div(Float4 a, Float4 b) { return _mm_div_ps(a, b); }
+inline Float4 MulAdd(Float4 acc, Float4 a, Float4 b) {
+#if defined(__FMA__)
+  return _mm_fmadd_ps(a, b, acc);
+#else
+  return _mm_add_ps(acc, _mm_mul_ps(a, b));
+#endif
+}
+inline Float4 MulAdd(Float4 acc, Float4 a, float b) {
+  return MulAdd(acc, a, _mm_set1_ps(b));
+}
+inline Float4 RotateXYZ(Float4 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+inline Float4 SwapPairs(Float4 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+inline Float4 SwapHalves(Float4 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+inline Float4 Transform(const Float4* lhs, Float4 rhs) {
+  Float4 c = _mm_mul_ps(lhs[0], _mm_shuffle_ps(rhs, rhs, 0x00));
+  c = MulAdd(c, lhs[1], _mm_shuffle_ps(rhs, rhs, 0x55));
+  c = MulAdd(c, lhs[2], _mm_shuffle_ps(rhs, rhs, 0xaa));
+  return MulAdd(c, lhs[3], _mm_shuffle_ps(rhs, rhs, 0xff));
+}
+inline void Transpose(Float4* m) { _MM_TRANSPOSE4_PS(m[0], m[1], m[2], m[3]); }
+#else
+struct Float4 {
+  float f[4];
+};
+inline Float4 Load(const float* p) {
+  Float4 v = {{p[0], p[1], p[2], p[3]}};
+  return v;
+}
+inline void Store(float* p, Float4 v) {
+  p[0] = v.f[0];
+  p[1] = v.f[1];
+  p[2] = v.f[2];
+  p[3] = v.f[3];
+}
+inline Float4 Set(float x, float y, float z, float w) {
+  Float4 v = {{x, y, z, w}};
+  return v;
+}
+inline Float4 Splat(float f) { return Set(f, f, f, f); }
+inline Float4 Add(Float4 a, Float4 b) {
+  return Set(a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2],
+             a.f[3] + b.f[3]);
+}
+inline Float4 Sub(Float4 a, Float4 b) {
+  return Set(a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2],
+             a.f[3] - b.f[3]);
+}
+inline Float4 Mul(Float4 a, Float4 b) {
+  return Set(a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2],
+             a.f[3] * b.f[3]);
+}
+inline Float4 Mul(Float4 a, float b) {
+  return Set(a.f[0] * b, a.f[1] * b, a.f[2] * b, a.f[3] * b);
+}
+inline Float4 Div(Float4 a, Float4 b) {
+  return Set(a.f[0] / b.f[0], a.f[1] / b.f[1], a.f[2] / b.f[2],
+             a.f[3] / b.f[3]);
+}
+inline Float4 MulAdd(Float4 acc, Float4 a, Float4 b) {
+  return Add(acc, Mul(a, b));
+}
+inline Float4 MulAdd(Float4 acc, Float4 a, float b) {
+  return Add(acc, Mul(a, b));
+}
+inline Float4 RotateXYZ(Float4 v) { return Set(v.f[1], v.f[2], v.f[0], 0.f); }
+inline Float4 SwapPairs(Float4 v) { return Set(v.f[1], v.f[0], v.f[3], v.f[2]); }
+inline Float4 SwapHalves(Float4 v) {
+  return Set(v.f[2], v.f[3], v.f[0], v.f[1]);
+}
+inline Float4 Transform(const Float4* lhs, Float4 rhs) {
+  Float4 c = Mul(lhs[0], rhs.f[0]);
+  c = MulAdd(c, lhs[1], rhs.f[1]);
+  c = MulAdd(c, lhs[2], rhs.f[2]);
+  return MulAdd(c, lhs[3], rhs.f[3]);
+}
+inline void Transpose(Float4* m) {
+  for (int i = 0; i < 4; ++i) {
+    for (int j = i + 1; j < 4; ++j) {
+      float f = m[i].f[j];
+      m[i].f[j] = m[j].f[i];
+      m[j].f[i] = f;
+    }
+  }
+}
+#endif
+
+// lhs columns * (x, y, z, w)
+inline Float4 Transform(const Float4* lhs, float x, float y, float z,
+                        float w) {
+  return MulAdd(MulAdd(MulAdd(Mul(lhs[0], x), lhs[1], y), lhs[2], z), lhs[3],
+                w);
+}
+
+// same, for w == 0
+inline Float4 Transform3(const Float4* lhs, float x, float y, float z) {
+  return MulAdd(MulAdd(Mul(lhs[0], x), lhs[1], y), lhs[2], z);
+}
+
+// cross product of the xyz parts, w is undefined
+inline Float4 Cross(Float4 a, Float4 b) {
+  Float4 a_yzx = RotateXYZ(a), b_yzx = RotateXYZ(b);
+  return Sub(Mul(a_yzx, RotateXYZ(b_yzx)), Mul(RotateXYZ(a_yzx), b_yzx));
+}
+
+}  // namespace simd
+}  // namespace ndk_helper
+#endif /* VECMATHSIMD_H_ */
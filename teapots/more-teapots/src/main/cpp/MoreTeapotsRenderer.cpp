@@ -94,7 +94,8 @@ void MoreTeapotsRenderer::Init(const int32_t numX, const int32_t numY,
   teapot_x_ = numX;
   teapot_y_ = numY;
   teapot_z_ = numZ;
-  vec_mat_models_.reserve(teapot_x_ * teapot_y_ * teapot_z_);
+  instances_.Clear();
+  vec_colors_.clear();
 
   UpdateViewport();
 
@@ -109,18 +110,17 @@ void MoreTeapotsRenderer::Init(const int32_t numX, const int32_t numY,
   for (int32_t x = 0; x < teapot_x_; ++x)
     for (int32_t y = 0; y < teapot_y_; ++y)
       for (int32_t z = 0; z < teapot_z_; ++z) {
-        vec_mat_models_.push_back(ndk_helper::Mat4::Translation(
-            x * gap_x + offset_x, y * gap_y + offset_y,
-            z * gap_z + offset_z));
         vec_colors_.push_back(ndk_helper::Vec3(
             random() / float(RAND_MAX * 1.1), random() / float(RAND_MAX * 1.1),
             random() / float(RAND_MAX * 1.1)));
 
         float rotation_x = random() / float(RAND_MAX) - 0.5f;
         float rotation_y = random() / float(RAND_MAX) - 0.5f;
-        vec_rotations_.push_back(ndk_helper::Vec2(rotation_x * 0.05f, rotation_y * 0.05f));
-        vec_current_rotations_.push_back(
-            ndk_helper::Vec2(rotation_x * M_PI, rotation_y * M_PI));
+        instances_.Add(
+            ndk_helper::Vec3(x * gap_x + offset_x, y * gap_y + offset_y,
+                             z * gap_z + offset_z),
+            ndk_helper::Vec2(rotation_x * M_PI, rotation_y * M_PI),
+            ndk_helper::Vec2(rotation_x * 0.05f, rotation_y * 0.05f));
       }
 
   if (geometry_instancing_support_) {
@@ -306,24 +306,9 @@ void MoreTeapotsRenderer::Render() {
         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
     float* mat_mvp = p;
     float* mat_mv = p + teapot_x_ * teapot_y_ * teapot_z_ * ubo_matrix_stride_;
-    for (int32_t i = 0; i < teapot_x_ * teapot_y_ * teapot_z_; ++i) {
-      // Rotation
-      float x, y;
-      vec_current_rotations_[i] += vec_rotations_[i];
-      vec_current_rotations_[i].Value(x, y);
-      ndk_helper::Mat4 mat_rotation =
-          ndk_helper::Mat4::RotationX(x) * ndk_helper::Mat4::RotationY(y);
-
-      // Feed Projection and Model View matrices to the shaders
-      ndk_helper::Mat4 mat_v = mat_view_ * vec_mat_models_[i] * mat_rotation;
-      ndk_helper::Mat4 mat_vp = mat_projection_ * mat_v;
-
-      memcpy(mat_mvp, mat_vp.Ptr(), sizeof(mat_v));
-      mat_mvp += ubo_matrix_stride_;
-
-      memcpy(mat_mv, mat_v.Ptr(), sizeof(mat_v));
-      mat_mv += ubo_matrix_stride_;
-    }
+    // Rotate, then feed Projection and Model View matrices to the shaders
+    batch_transform_.UpdateModelView(&instances_, mat_view_, mat_projection_,
+                                     mat_mvp, mat_mv, ubo_matrix_stride_);
     glUnmapBuffer(GL_UNIFORM_BUFFER);
 
     // Instanced rendering
@@ -333,24 +318,25 @@ void MoreTeapotsRenderer::Render() {
 
   } else {
     // Regular rendering pass
-    for (int32_t i = 0; i < teapot_x_ * teapot_y_ * teapot_z_; ++i) {
+    const int32_t num_teapots = teapot_x_ * teapot_y_ * teapot_z_;
+    const int32_t MATRIX_SIZE = 16;
+    matrices_.resize(num_teapots * MATRIX_SIZE * 2);
+    float* mat_mvp = matrices_.data();
+    float* mat_mv = mat_mvp + num_teapots * MATRIX_SIZE;
+    batch_transform_.UpdateModelView(&instances_, mat_view_, mat_projection_,
+                                     mat_mvp, mat_mv, MATRIX_SIZE);
+
+    for (int32_t i = 0; i < num_teapots; ++i) {
       // Set diffuse
       float x, y, z;
       vec_colors_[i].Value(x, y, z);
       glUniform4f(shader_param_.material_diffuse_, x, y, z, 1.f);
 
-      // Rotation
-      vec_current_rotations_[i] += vec_rotations_[i];
-      vec_current_rotations_[i].Value(x, y);
-      ndk_helper::Mat4 mat_rotation =
-          ndk_helper::Mat4::RotationX(x) * ndk_helper::Mat4::RotationY(y);
-
       // Feed Projection and Model View matrices to the shaders
-      ndk_helper::Mat4 mat_v = mat_view_ * vec_mat_models_[i] * mat_rotation;
-      ndk_helper::Mat4 mat_vp = mat_projection_ * mat_v;
       glUniformMatrix4fv(shader_param_.matrix_projection_, 1, GL_FALSE,
-                         mat_vp.Ptr());
-      glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE, mat_v.Ptr());
+                         mat_mvp + i * MATRIX_SIZE);
+      glUniformMatrix4fv(shader_param_.matrix_view_, 1, GL_FALSE,
+                         mat_mv + i * MATRIX_SIZE);
 
       glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_SHORT,
                      BUFFER_OFFSET(0));
@@ -88,10 +88,10 @@ class MoreTeapotsRenderer {
 
   ndk_helper::Mat4 mat_projection_;
   ndk_helper::Mat4 mat_view_;
-  std::vector<ndk_helper::Mat4> vec_mat_models_;
+  ndk_helper::InstanceTransforms instances_;
   std::vector<ndk_helper::Vec3> vec_colors_;
-  std::vector<ndk_helper::Vec2> vec_rotations_;
-  std::vector<ndk_helper::Vec2> vec_current_rotations_;
+  ndk_helper::BatchTransform batch_transform_;
+  std::vector<float> matrices_;  // mvp + mv per teapot for the GLES2 pass
 
   ndk_helper::TapCamera* camera_;
 
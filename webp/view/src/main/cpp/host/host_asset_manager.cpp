@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for the asset manager: assets are files under a directory.
+ * AAsset_getBuffer() maps the file, as the platform does for uncompressed
+ * assets, so its pages count as memory only once they are touched;
+ * AAsset_read() reads the file as a stream.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <android/asset_manager.h>
+
+struct AAssetManager {
+    std::string root_;
+};
+
+struct AAsset {
+    int    fd_;
+    off_t  length_;
+    void*  map_;
+};
+
+AAssetManager* HostAssetManager_create(const char* root) {
+    return new AAssetManager { root };
+}
+
+void HostAssetManager_destroy(AAssetManager* mgr) {
+    delete mgr;
+}
+
+AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename,
+                           int mode) {
+    std::string path = mgr->root_ + "/" + filename;
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0) {
+        return nullptr;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return nullptr;
+    }
+    return new AAsset { fd, st.st_size, nullptr };
+}
+
+int AAsset_read(AAsset* asset, void* buf, size_t count) {
+    ssize_t len = read(asset->fd_, buf, count);
+    return static_cast<int>(len);
+}
+
+const void* AAsset_getBuffer(AAsset* asset) {
+    if (!asset->map_) {
+        void* map = mmap(nullptr, asset->length_, PROT_READ, MAP_PRIVATE,
+                         asset->fd_, 0);
+        asset->map_ = (map == MAP_FAILED) ? nullptr : map;
+    }
+    return asset->map_;
+}
+
+off_t AAsset_getLength(AAsset* asset) {
+    return asset->length_;
+}
+
+void AAsset_close(AAsset* asset) {
+    if (asset->map_) {
+        munmap(asset->map_, asset->length_);
+    }
+    close(asset->fd_);
+    delete asset;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host stand-in for the NDK's android/asset_manager.h, covering what the
+ * decoders use. Assets are files under the directory given to
+ * HostAssetManager_create() (see host_asset_manager.cpp).
+ */
+#ifndef __HOST_ANDROID_ASSET_MANAGER_H__
+#define __HOST_ANDROID_ASSET_MANAGER_H__
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AAssetManager AAssetManager;
+typedef struct AAsset AAsset;
+
+enum {
+    AASSET_MODE_UNKNOWN = 0,
+    AASSET_MODE_RANDOM = 1,
+    AASSET_MODE_STREAMING = 2,
+    AASSET_MODE_BUFFER = 3
+};
+
+AAsset* AAssetManager_open(AAssetManager* mgr, const char* filename,
+                           int mode);
+int AAsset_read(AAsset* asset, void* buf, size_t count);
+const void* AAsset_getBuffer(AAsset* asset);
+off_t AAsset_getLength(AAsset* asset);
+void AAsset_close(AAsset* asset);
+
+// host only: asset manager reading files under root
+AAssetManager* HostAssetManager_create(const char* root);
+void HostAssetManager_destroy(AAssetManager* mgr);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // __HOST_ANDROID_ASSET_MANAGER_H__
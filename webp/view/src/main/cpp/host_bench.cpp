@@ -0,0 +1,1088 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host check and benchmarks of the webp view decoders, built when
+ * CMakeLists.txt is configured for the host rather than Android:
+ *   webp_host_bench check  WebpAnimation against libwebp's WebPAnimDecoder,
+ *                          played in order, looped and seeked, the loop
+ *                          counts of the slide-show, and incremental decoding
+ *                          against the frame ring, and tiled viewports
+ *                          against the whole picture; exit 1 on a mismatch
+ *   webp_host_bench anim   sustained frame rate of a 1080p animation
+ *   webp_host_bench incremental
+ *                          time to the first decoded row and peak memory of
+ *                          large pictures decoded through the frame ring or
+ *                          incrementally into the window
+ *   webp_host_bench tile   time to viewport and cache hit rate of the tiled
+ *                          decoder over a pan and zoom session on a 50 MP
+ *                          photo
+ * With no argument, runs all of them.
+ *
+ * Pictures are generated and encoded with libwebp, then written into a
+ * temporary directory that the host asset manager reads from.
+ */
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <android/asset_manager.h>
+#include <webp/decode.h>
+#include <webp/demux.h>
+#include <webp/encode.h>
+#include "webp_anim.h"
+#include "webp_decode.h"
+#include "webp_tile.h"
+
+namespace {
+
+double GetTimeInMs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
+}
+
+uint32_t Random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+struct Picture {
+    int32_t width_, height_;
+    std::vector<uint8_t> rgba_;
+};
+
+enum class Alpha { OPAQUE, MIXED };
+
+/*
+ * MakePicture(): gradients with a few blocks and some noise on top, enough
+ *     structure for the encoder to behave as on real pictures. MIXED alpha
+ *     has fully transparent, opaque and translucent blocks.
+ */
+Picture MakePicture(int32_t width, int32_t height, uint32_t seed,
+                    Alpha alpha) {
+    Picture picture { width, height,
+                      std::vector<uint8_t>(width * height * 4) };
+    uint32_t state = seed * 2654435761u + 1;
+    uint32_t base[3] = { Random(&state) & 0xFF, Random(&state) & 0xFF,
+                         Random(&state) & 0xFF };
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t* px = &picture.rgba_[(y * width + x) * 4];
+            uint32_t block = ((x / 24) ^ (y / 16)) & 3;
+            uint32_t noise = Random(&state) & 7;
+            px[0] = static_cast<uint8_t>(base[0] + x * 255 / width +
+                                         block * 40);
+            px[1] = static_cast<uint8_t>(base[1] + y * 255 / height);
+            px[2] = static_cast<uint8_t>(base[2] + x + y + noise);
+            px[3] = 0xFF;
+            if (alpha == Alpha::MIXED) {
+                static const uint8_t levels[4] = { 0, 0xFF, 0x80, 0x30 };
+                px[3] = levels[((x / 8) + (y / 8)) & 3];
+            }
+        }
+    }
+    return picture;
+}
+
+std::vector<uint8_t> Encode(const Picture& picture, bool lossless) {
+    uint8_t* output = nullptr;
+    size_t size = lossless ?
+        WebPEncodeLosslessRGBA(picture.rgba_.data(), picture.width_,
+                               picture.height_, picture.width_ * 4, &output) :
+        WebPEncodeRGBA(picture.rgba_.data(), picture.width_, picture.height_,
+                       picture.width_ * 4, 80.0f, &output);
+    std::vector<uint8_t> file(output, output + size);
+    WebPFree(output);
+    return file;
+}
+
+void Put24(std::vector<uint8_t>* out, uint32_t value) {
+    for (int i = 0; i < 3; i++) {
+        out->push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+void Put32(std::vector<uint8_t>* out, uint32_t value) {
+    Put24(out, value);
+    out->push_back(static_cast<uint8_t>(value >> 24));
+}
+
+void PutChunk(std::vector<uint8_t>* out, const char* fourcc,
+              const std::vector<uint8_t>& payload) {
+    out->insert(out->end(), fourcc, fourcc + 4);
+    Put32(out, static_cast<uint32_t>(payload.size()));
+    out->insert(out->end(), payload.begin(), payload.end());
+    if (payload.size() & 1) {
+        out->push_back(0);
+    }
+}
+
+struct AnimFrame {
+    int32_t  x_, y_;        // even
+    Picture  picture_;
+    uint32_t duration_;
+    bool     lossless_, blend_, dispose_;
+};
+
+/*
+ * MuxAnimation(): wrap encoded frames into ANMF chunks of an animated file,
+ *     the way WebPAnimEncoder lays them out
+ */
+std::vector<uint8_t> MuxAnimation(int32_t width, int32_t height,
+                                  uint32_t loopCount,
+                                  const std::vector<AnimFrame>& frames) {
+    std::vector<uint8_t> body, payload;
+    payload.push_back(0x10 | 0x02);  // alpha, animation
+    Put24(&payload, 0);
+    Put24(&payload, width - 1);
+    Put24(&payload, height - 1);
+    PutChunk(&body, "VP8X", payload);
+
+    payload.clear();
+    Put32(&payload, 0xFFFFFFFF);     // background: white
+    payload.push_back(static_cast<uint8_t>(loopCount));
+    payload.push_back(static_cast<uint8_t>(loopCount >> 8));
+    PutChunk(&body, "ANIM", payload);
+
+    for (auto& frame : frames) {
+        payload.clear();
+        Put24(&payload, frame.x_ / 2);
+        Put24(&payload, frame.y_ / 2);
+        Put24(&payload, frame.picture_.width_ - 1);
+        Put24(&payload, frame.picture_.height_ - 1);
+        Put24(&payload, frame.duration_);
+        payload.push_back((frame.blend_ ? 0 : 2) | (frame.dispose_ ? 1 : 0));
+        // frame data: the chunks of a still file, without RIFF and VP8X
+        std::vector<uint8_t> still = Encode(frame.picture_, frame.lossless_);
+        size_t offset = 12;
+        while (offset + 8 <= still.size()) {
+            uint32_t size = still[offset + 4] | (still[offset + 5] << 8) |
+                            (still[offset + 6] << 16) |
+                            (still[offset + 7] << 24);
+            size_t next = offset + 8 + size + (size & 1);
+            if (memcmp(&still[offset], "VP8X", 4)) {
+                payload.insert(payload.end(), still.begin() + offset,
+                               still.begin() + std::min(next, still.size()));
+            }
+            offset = next;
+        }
+        PutChunk(&body, "ANMF", payload);
+    }
+
+    std::vector<uint8_t> file;
+    file.insert(file.end(), "RIFF", "RIFF" + 4);
+    Put32(&file, static_cast<uint32_t>(body.size() + 4));
+    file.insert(file.end(), "WEBP", "WEBP" + 4);
+    file.insert(file.end(), body.begin(), body.end());
+    return file;
+}
+
+/*
+ * Small animation going through every kind of frame: opaque and translucent
+ * rectangles, blended or not, disposed to background or not, and key frames
+ * that are full frames or follow a disposed one.
+ */
+std::vector<AnimFrame> MakeTestFrames(int32_t width, int32_t height) {
+    struct Layout {
+        int32_t x, y, width, height;
+        Alpha   alpha;
+        bool    blend, dispose;
+        uint32_t duration;
+    };
+    const Layout layouts[] = {
+        { 0, 0, width, height, Alpha::OPAQUE, true, false, 40 },
+        { 8, 8, 32, 32, Alpha::OPAQUE, true, false, 40 },
+        { 20, 10, 40, 30, Alpha::MIXED, true, true, 60 },
+        { 40, 20, 48, 40, Alpha::MIXED, true, false, 0 },
+        { 0, 0, width, height, Alpha::MIXED, false, false, 80 },
+        { 10, 30, 50, 30, Alpha::MIXED, true, true, 40 },
+        { 0, 0, width, height, Alpha::MIXED, true, false, 40 },
+        { 0, 0, width, height, Alpha::OPAQUE, true, true, 10 },
+        { 16, 16, 40, 24, Alpha::MIXED, true, false, 40 },
+        { 4, 2, 60, 50, Alpha::MIXED, false, false, 120 },
+        { 30, 12, 36, 36, Alpha::MIXED, true, false, 40 },
+    };
+    std::vector<AnimFrame> frames;
+    uint32_t seed = 1;
+    for (auto& layout : layouts) {
+        frames.push_back(AnimFrame {
+            layout.x, layout.y,
+            MakePicture(layout.width, layout.height, seed++, layout.alpha),
+            layout.duration, true, layout.blend, layout.dispose });
+    }
+    return frames;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+// temporary asset directory, removed with its files
+class AssetDir {
+  public:
+    AssetDir() : mgr_(nullptr) {
+        char path[] = "/tmp/webp_host_bench.XXXXXX";
+        if (mkdtemp(path)) {
+            path_ = path;
+            mgr_ = HostAssetManager_create(path);
+        }
+    }
+    ~AssetDir() {
+        for (auto& name : files_) {
+            unlink((path_ + "/" + name).c_str());
+        }
+        if (mgr_) {
+            HostAssetManager_destroy(mgr_);
+            rmdir(path_.c_str());
+        }
+    }
+    AAssetManager* Manager(void) const { return mgr_; }
+    bool Add(const char* name, const std::vector<uint8_t>& data) {
+        files_.push_back(name);
+        return mgr_ && WriteFile(path_ + "/" + name, data);
+    }
+
+  private:
+    std::string path_;
+    std::vector<std::string> files_;
+    AAssetManager* mgr_;
+};
+
+// every frame of one loop, composited by libwebp's own animation decoder
+std::vector<std::vector<uint8_t>> ReferenceFrames(
+    const std::vector<uint8_t>& file) {
+    std::vector<std::vector<uint8_t>> frames;
+    WebPAnimDecoderOptions options;
+    WebPAnimDecoderOptionsInit(&options);
+    options.color_mode = MODE_RGBA;
+    WebPData data = { file.data(), file.size() };
+    WebPAnimDecoder* dec = WebPAnimDecoderNew(&data, &options);
+    if (!dec) {
+        return frames;
+    }
+    WebPAnimInfo info;
+    WebPAnimDecoderGetInfo(dec, &info);
+    size_t size = info.canvas_width * info.canvas_height * 4;
+    while (WebPAnimDecoderHasMoreFrames(dec)) {
+        uint8_t* canvas;
+        int timestamp;
+        if (!WebPAnimDecoderGetNext(dec, &canvas, &timestamp)) {
+            frames.clear();
+            break;
+        }
+        frames.push_back(std::vector<uint8_t>(canvas, canvas + size));
+    }
+    WebPAnimDecoderDelete(dec);
+    return frames;
+}
+
+bool CheckFrame(WebpAnimation* anim, uint32_t idx,
+                const std::vector<uint8_t>& expected, const char* what) {
+    uint32_t duration;
+    const uint8_t* canvas = anim->GetFrame(idx, &duration);
+    if (!canvas || memcmp(canvas, expected.data(), expected.size())) {
+        printf("check: %s: frame %u differs from WebPAnimDecoder\n", what, idx);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * CheckAnimation(): frames played in order, in later loops (from the cache)
+ *     and in random order must all match WebPAnimDecoder's
+ */
+bool CheckAnimation(void) {
+    const int32_t width = 96, height = 64;
+    std::vector<AnimFrame> frames = MakeTestFrames(width, height);
+    std::vector<uint8_t> file = MuxAnimation(width, height, 3, frames);
+    std::vector<std::vector<uint8_t>> expected = ReferenceFrames(file);
+    WebpAnimation anim(file.data(), file.size());
+    if (!anim.IsValid() || expected.size() != frames.size() ||
+        anim.FrameCount() != frames.size() || anim.LoopCount() != 3 ||
+        anim.Width() != static_cast<uint32_t>(width) ||
+        anim.Height() != static_cast<uint32_t>(height)) {
+        printf("check: test animation does not load\n");
+        return false;
+    }
+
+    bool ok = true;
+    uint32_t count = anim.FrameCount();
+    for (uint32_t idx = 0; idx < count; idx++) {
+        ok = CheckFrame(&anim, idx, expected[idx], "first loop") && ok;
+    }
+    uint32_t hits, misses, firstMisses;
+    anim.GetCacheStats(&hits, &firstMisses);
+    for (int loop = 2; loop <= 3; loop++) {
+        for (uint32_t idx = 0; idx < count; idx++) {
+            ok = CheckFrame(&anim, idx, expected[idx], "later loop") && ok;
+        }
+    }
+    anim.GetCacheStats(&hits, &misses);
+    printf("check: animation, %u frames, %u cached, %u cache hits in 2 "
+           "more loops\n", count, firstMisses, hits);
+    if (!firstMisses || misses != firstMisses || hits != 2 * firstMisses) {
+        printf("check: later loops are not played from the cache\n");
+        ok = false;
+    }
+
+    uint32_t state = 7;
+    for (int seek = 0; seek < 64; seek++) {
+        uint32_t idx = Random(&state) % count;
+        ok = CheckFrame(&anim, idx, expected[idx], "seek") && ok;
+    }
+
+    // FrameAtTime() against the frame durations
+    uint32_t start = 0;
+    for (uint32_t idx = 0; idx < count; idx++) {
+        uint32_t end = start + frames[idx].duration_;
+        if (end > start &&
+            (anim.FrameAtTime(start) != idx ||
+             anim.FrameAtTime(end - 1) != idx ||
+             anim.FrameAtTime(anim.Duration() + start) != idx)) {
+            printf("check: FrameAtTime(%u) is not frame %u\n", start, idx);
+            ok = false;
+        }
+        start = end;
+    }
+    if (anim.Duration() != start) {
+        printf("check: duration %u ms, expected %u ms\n", anim.Duration(),
+               start);
+        ok = false;
+    }
+    return ok;
+}
+
+/*
+ * PlayFrames(): pull count frames out of decoder as the view does, keep
+ *     their display times and, if frames is given, their pixels
+ */
+bool PlayFrames(WebpDecoder* decoder, uint32_t count, size_t frameSize,
+                std::vector<uint32_t>* durations,
+                std::vector<std::vector<uint8_t>>* frames) {
+    decoder->DecodeFrame();
+    double deadline = GetTimeInMs() + 60000;
+    while (durations->size() < count) {
+        uint32_t duration;
+        uint8_t* frame = decoder->GetDecodedFrame(&duration);
+        if (!frame) {
+            if (GetTimeInMs() > deadline) {
+                return false;
+            }
+            usleep(100);
+            continue;
+        }
+        durations->push_back(duration);
+        if (frames) {
+            frames->push_back(std::vector<uint8_t>(frame, frame + frameSize));
+        }
+        decoder->DecodeFrame();
+    }
+    return true;
+}
+
+/*
+ * CheckLoopCount(): the slide-show plays an animation as many times as the
+ *     file says, or for WebpDecoder::kINFINITE_LOOP_TIME when it loops
+ *     forever, then goes on to the next file
+ */
+bool CheckLoopCount(void) {
+    const int32_t width = 96, height = 64;
+    std::vector<AnimFrame> frames = MakeTestFrames(width, height);
+    std::vector<uint8_t> twice = MuxAnimation(width, height, 2, frames);
+    std::vector<uint8_t> forever = MuxAnimation(width, height, 0, frames);
+    AssetDir assets;
+    if (!assets.Add("twice.webp", twice) ||
+        !assets.Add("forever.webp", forever) ||
+        !assets.Add("still.webp",
+                    Encode(MakePicture(width, height, 99, Alpha::OPAQUE),
+                           true))) {
+        printf("check: cannot write test files\n");
+        return false;
+    }
+
+    // the view's timing: very short frames are shown for 100 ms
+    std::vector<uint32_t> loopDurations;
+    uint32_t loopTime = 0;
+    for (auto& frame : frames) {
+        loopDurations.push_back(frame.duration_ <= 10 ? 100 :
+                                frame.duration_);
+        loopTime += loopDurations.back();
+    }
+    uint32_t foreverLoops = (WebpDecoder::kINFINITE_LOOP_TIME + loopTime - 1) /
+                            loopTime;
+    std::vector<uint32_t> expected;
+    for (int loop = 0; loop < 2; loop++) {
+        expected.insert(expected.end(), loopDurations.begin(),
+                        loopDurations.end());
+    }
+    for (uint32_t loop = 0; loop < foreverLoops; loop++) {
+        expected.insert(expected.end(), loopDurations.begin(),
+                        loopDurations.end());
+    }
+    expected.push_back(0);
+    expected.insert(expected.end(), loopDurations.begin(),
+                    loopDurations.end());
+
+    const char* files[] = { "twice.webp", "forever.webp", "still.webp" };
+    DecodeSurfaceDescriptor surface { width, height, width,
+                                      SurfaceFormat::SURFACE_FORMAT_RGBX_8888 };
+    WebpDecoder* decoder = new WebpDecoder(files, 3, &surface,
+                                           assets.Manager());
+    std::vector<uint32_t> durations;
+    std::vector<std::vector<uint8_t>> shown;
+    bool ok = PlayFrames(decoder, static_cast<uint32_t>(expected.size()),
+                         width * height * 4, &durations, &shown);
+    decoder->DestroyDecoder();
+    if (!ok || durations != expected) {
+        printf("check: slide-show played %zu frames, expected 2 loops, %u "
+               "loops, the still picture and the first animation again\n",
+               durations.size(), foreverLoops);
+        return false;
+    }
+
+    // frames handed out are the reference canvases composed over black
+    std::vector<std::vector<uint8_t>> reference = ReferenceFrames(twice);
+    for (size_t idx = 0; idx < 2 * reference.size(); idx++) {
+        const std::vector<uint8_t>& canvas = reference[idx % reference.size()];
+        std::vector<uint8_t> pixels(canvas.size());
+        for (size_t px = 0; px < canvas.size(); px += 4) {
+            StoreRGBAPixel(&canvas[px], &pixels[px], 4);
+        }
+        if (pixels != shown[idx]) {
+            printf("check: slide-show frame %zu differs from "
+                   "WebPAnimDecoder\n", idx);
+            return false;
+        }
+    }
+    printf("check: slide-show, loop count 2: 2 loops, loop count 0: %u "
+           "loops of %u ms\n", foreverLoops, loopTime);
+    return true;
+}
+
+struct RowProgress {
+    int32_t nextRow_;
+    bool    ordered_;
+};
+
+void OnRowsDecoded(void* ctx, int32_t startRow, int32_t endRow) {
+    RowProgress* progress = reinterpret_cast<RowProgress*>(ctx);
+    progress->ordered_ = progress->ordered_ &&
+                         startRow == progress->nextRow_ && endRow > startRow;
+    progress->nextRow_ = endRow;
+}
+
+/*
+ * CheckIncremental(): decoding into a caller's buffer gives the pixels of
+ *     the frame ring, with rows reported in order down to the last one
+ */
+bool CheckIncremental(void) {
+    const int32_t width = 320, height = 240, stride = 336;
+    AssetDir assets;
+    const char* files[] = { "lossy.webp", "lossless.webp" };
+    for (int i = 0; i < 2; i++) {
+        if (!assets.Add(files[i],
+                        Encode(MakePicture(640, 480, 11, Alpha::MIXED),
+                               i == 1))) {
+            printf("check: cannot write test files\n");
+            return false;
+        }
+    }
+    DecodeSurfaceDescriptor surface { width, height, stride,
+                                      SurfaceFormat::SURFACE_FORMAT_RGBA_8888 };
+    size_t frameSize = stride * height * 4;
+    WebpDecoder* ring = new WebpDecoder(files, 2, &surface, assets.Manager());
+    std::vector<uint32_t> durations;
+    std::vector<std::vector<uint8_t>> expected;
+    bool ok = PlayFrames(ring, 2, frameSize, &durations, &expected);
+    ring->DestroyDecoder();
+    if (!ok) {
+        printf("check: frame ring did not decode the test files\n");
+        return false;
+    }
+
+    WebpDecoder* decoder = new WebpDecoder(files, 2, &surface,
+                                           assets.Manager(), 0);
+    for (int i = 0; i < 2 && ok; i++) {
+        std::vector<uint8_t> frame(frameSize, 0);
+        RowProgress progress { 0, true };
+        if (!decoder->DecodeFrameInto(frame.data(), OnRowsDecoded,
+                                      &progress)) {
+            printf("check: %s: incremental decoding failed\n", files[i]);
+            ok = false;
+            break;
+        }
+        if (!progress.ordered_ || progress.nextRow_ != height) {
+            printf("check: %s: rows reported out of order or not to the "
+                   "end (%d of %d)\n", files[i], progress.nextRow_, height);
+            ok = false;
+        }
+        for (int32_t row = 0; row < height; row++) {
+            size_t offset = row * stride * 4;
+            if (memcmp(&frame[offset], &expected[i][offset], width * 4)) {
+                printf("check: %s: row %d differs from the frame ring\n",
+                       files[i], row);
+                ok = false;
+                break;
+            }
+        }
+    }
+    DecoderStats stats;
+    decoder->GetStats(&stats);
+    decoder->DestroyDecoder();
+    if (ok) {
+        printf("check: incremental decoding, 2 pictures, first rows after "
+               "%.1f ms on average\n",
+               stats.totalFirstRowTime_ / 1000.0 / stats.incrementalFrames_);
+    }
+    return ok;
+}
+
+/*
+ * RenderUntilComplete(): render a viewport again each time a tile is
+ * decoded, as the view does, until all of its tiles are shown; return the
+ * time it took in ms, or a negative time if it never completed
+ */
+double RenderUntilComplete(WebpTileDecoder* tiles, int32_t id, float left,
+                           float top, float scale, uint8_t* dst) {
+    double start = GetTimeInMs(), deadline = start + 60000;
+    uint32_t generation = tiles->Generation();
+    while (!tiles->RenderViewport(id, left, top, scale, dst)) {
+        while (tiles->Generation() == generation) {
+            if (GetTimeInMs() > deadline) {
+                return -1.0;
+            }
+            usleep(100);
+        }
+        generation = tiles->Generation();
+    }
+    return GetTimeInMs() - start;
+}
+
+struct ImageAdder {
+    WebpTileDecoder*            tiles_;
+    const std::vector<uint8_t>* file_;
+    uint32_t                    count_;
+};
+
+void* AddImages(void* ctx) {
+    ImageAdder* adder = reinterpret_cast<ImageAdder*>(ctx);
+    for (uint32_t i = 0; i < adder->count_; i++) {
+        adder->tiles_->AddImage(adder->file_->data(), adder->file_->size());
+    }
+    return nullptr;
+}
+
+/*
+ * CheckTiles(): viewports at full resolution show the pixels of the whole
+ *     picture decoded at once, while more pictures are registered from
+ *     another thread. Every tile is counted once per viewport: the first
+ *     pass misses exactly the tiles it decodes, the second one only hits.
+ */
+bool CheckTiles(void) {
+    const int32_t width = 320, height = 240, stride = 336;
+    std::vector<uint8_t> file = Encode(MakePicture(1000, 700, 13,
+                                                   Alpha::MIXED), true);
+    int32_t picWidth, picHeight;
+    uint8_t* picture = WebPDecodeRGBA(file.data(), file.size(),
+                                      &picWidth, &picHeight);
+    if (!picture) {
+        printf("check: cannot decode the tiled test picture\n");
+        return false;
+    }
+    DecodeSurfaceDescriptor surface { width, height, stride,
+                                      SurfaceFormat::SURFACE_FORMAT_RGBA_8888 };
+    WebpTileDecoder* tiles = new WebpTileDecoder(surface);
+    int32_t id = tiles->AddImage(file.data(), file.size());
+
+    ImageAdder adder { tiles, &file, 4096 };
+    pthread_t thread;
+    bool adding = pthread_create(&thread, nullptr, AddImages, &adder) == 0;
+
+    const float viewports[][2] = { { 0, 0 }, { 300, 200 }, { 680, 460 } };
+    std::vector<uint8_t> window(stride * height * 4);
+    std::vector<uint8_t> expected(window.size());
+    TileStats passStats[2];
+    bool ok = true;
+    for (int pass = 0; pass < 2 && ok; pass++) {
+        for (auto& viewport : viewports) {
+            float left = viewport[0], top = viewport[1];
+            if (RenderUntilComplete(tiles, id, left, top, 1.0f,
+                                    window.data()) < 0) {
+                printf("check: viewport %.0f,%.0f never completed\n",
+                       left, top);
+                ok = false;
+                break;
+            }
+            std::fill(expected.begin(), expected.end(), 0);
+            for (int32_t y = 0; y < height; y++) {
+                for (int32_t x = 0; x < width; x++) {
+                    int32_t px = static_cast<int32_t>(left) + x;
+                    int32_t py = static_cast<int32_t>(top) + y;
+                    if (px < picWidth && py < picHeight) {
+                        StoreRGBAPixel(&picture[(py * picWidth + px) * 4],
+                                       &expected[(y * stride + x) * 4], 4);
+                    }
+                }
+            }
+            for (int32_t y = 0; y < height && ok; y++) {
+                size_t offset = y * stride * 4;
+                if (memcmp(&window[offset], &expected[offset], width * 4)) {
+                    printf("check: viewport %.0f,%.0f: row %d differs from "
+                           "the whole picture\n", left, top, y);
+                    ok = false;
+                }
+            }
+        }
+        tiles->GetStats(&passStats[pass]);
+    }
+    if (adding) {
+        pthread_join(thread, nullptr);
+    }
+    delete tiles;
+    WebPFree(picture);
+    if (!ok) {
+        return false;
+    }
+
+    const TileStats& first = passStats[0];
+    const TileStats& second = passStats[1];
+    uint32_t lookups = first.hits_ + first.misses_;
+    if (first.misses_ != first.decodedTiles_ ||
+        second.misses_ != first.misses_ ||
+        second.hits_ - first.hits_ != lookups) {
+        printf("check: tiles counted more than once per viewport: "
+               "%u hits %u misses for %u decoded tiles, then %u hits "
+               "%u misses\n", first.hits_, first.misses_,
+               first.decodedTiles_, second.hits_ - first.hits_,
+               second.misses_ - first.misses_);
+        return false;
+    }
+    printf("check: tiled viewports, %u tiles decoded, %u hits on the second "
+           "pass\n", first.decodedTiles_, second.hits_ - first.hits_);
+    return true;
+}
+
+/*
+ * 1080p clip like the ones WebPAnimEncoder writes: a full frame on every
+ * scene change, then rectangles of what moved, some of them translucent
+ */
+std::vector<uint8_t> Make1080pClip(uint32_t* frameCount) {
+    const int32_t width = 1920, height = 1080;
+    const uint32_t kFRAMES = 48, kSCENE = 16;
+    std::vector<AnimFrame> frames;
+    for (uint32_t idx = 0; idx < kFRAMES; idx++) {
+        if (idx % kSCENE == 0) {
+            frames.push_back(AnimFrame {
+                0, 0, MakePicture(width, height, idx, Alpha::OPAQUE),
+                40, false, false, false });
+        } else if (idx & 1) {
+            int32_t step = idx % kSCENE;
+            frames.push_back(AnimFrame {
+                (step * 96) & ~1, (step * 48) & ~1,
+                MakePicture(384, 216, idx, Alpha::OPAQUE),
+                40, false, false, false });
+        } else {
+            frames.push_back(AnimFrame {
+                720, 900, MakePicture(480, 120, idx, Alpha::MIXED),
+                40, true, true, false });
+        }
+    }
+    *frameCount = kFRAMES;
+    return MuxAnimation(width, height, 0, frames);
+}
+
+void BenchAnimation(void) {
+    uint32_t frameCount;
+    std::vector<uint8_t> clip = Make1080pClip(&frameCount);
+    const int kLOOPS = 5;
+    printf("anim: 1920x1080, %u frames, %zu bytes\n", frameCount,
+           clip.size());
+
+    // libwebp's animation decoder composites every loop again
+    WebPAnimDecoderOptions options;
+    WebPAnimDecoderOptionsInit(&options);
+    WebPData data = { clip.data(), clip.size() };
+    WebPAnimDecoder* dec = WebPAnimDecoderNew(&data, &options);
+    double start = GetTimeInMs();
+    for (int loop = 0; loop < kLOOPS; loop++) {
+        WebPAnimDecoderReset(dec);
+        while (WebPAnimDecoderHasMoreFrames(dec)) {
+            uint8_t* canvas;
+            int timestamp;
+            WebPAnimDecoderGetNext(dec, &canvas, &timestamp);
+        }
+    }
+    double animDecoderTime = GetTimeInMs() - start;
+    WebPAnimDecoderDelete(dec);
+    printf("anim: %-28s %6.1f fps\n", "WebPAnimDecoder",
+           kLOOPS * frameCount * 1000.0 / animDecoderTime);
+
+    WebpAnimation anim(clip.data(), clip.size());
+    double loopTime[kLOOPS];
+    for (int loop = 0; loop < kLOOPS; loop++) {
+        start = GetTimeInMs();
+        for (uint32_t idx = 0; idx < frameCount; idx++) {
+            uint32_t duration;
+            anim.GetFrame(idx, &duration);
+        }
+        loopTime[loop] = GetTimeInMs() - start;
+    }
+    double laterTime = 0;
+    for (int loop = 1; loop < kLOOPS; loop++) {
+        laterTime += loopTime[loop];
+    }
+    uint32_t hits, misses;
+    anim.GetCacheStats(&hits, &misses);
+    printf("anim: %-28s %6.1f fps\n", "WebpAnimation, first loop",
+           frameCount * 1000.0 / loopTime[0]);
+    printf("anim: %-28s %6.1f fps  (%u frames cached, %u hits)\n",
+           "WebpAnimation, later loops",
+           (kLOOPS - 1) * frameCount * 1000.0 / laterTime, misses, hits);
+
+    // whole slide-show path: worker thread, frame ring, scaling to window
+    AssetDir assets;
+    const char* files[] = { "clip.webp" };
+    if (!assets.Add(files[0], clip)) {
+        printf("anim: cannot write test file\n");
+        return;
+    }
+    DecodeSurfaceDescriptor surface { 1920, 1080, 1920,
+                                      SurfaceFormat::SURFACE_FORMAT_RGBX_8888 };
+    WebpDecoder* decoder = new WebpDecoder(files, 1, &surface,
+                                           assets.Manager());
+    std::vector<uint32_t> durations;
+    start = GetTimeInMs();
+    bool played = PlayFrames(decoder, kLOOPS * frameCount, 0, &durations,
+                             nullptr);
+    double playTime = GetTimeInMs() - start;
+    DecoderStats stats;
+    decoder->GetStats(&stats);
+    decoder->DestroyDecoder();
+    if (!played) {
+        printf("anim: slide-show stalled\n");
+        return;
+    }
+    printf("anim: %-28s %6.1f fps  (decode avg %.1f ms, max %.1f ms)\n",
+           "slide-show to 1080p window",
+           durations.size() * 1000.0 / playTime,
+           stats.totalDecodeTime_ / 1000.0 / stats.decodedFrames_,
+           stats.maxDecodeTime_ / 1000.0);
+}
+
+const int32_t kWINDOW_WIDTH = 1920, kWINDOW_HEIGHT = 1080;
+
+struct DecodeResult {
+    double firstRowTime_, wholeTime_;  // ms
+    long   peakMemory_;                // kB above the start of the decode
+    bool   ok_;
+};
+
+long ReadStatusKb(const char* field) {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return 0;
+    }
+    char line[256];
+    long kb = 0;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), file)) {
+        if (!strncmp(line, field, len)) {
+            kb = atol(line + len);
+            break;
+        }
+    }
+    fclose(file);
+    return kb;
+}
+
+/*
+ * StartMeasure(): window buffer as the view gets it from the window, then
+ *     the resident memory to measure the decode against
+ */
+long StartMeasure(std::vector<uint8_t>* window) {
+    window->assign(kWINDOW_WIDTH * kWINDOW_HEIGHT * 4, 0);
+    malloc_trim(0);
+    return ReadStatusKb("VmRSS:");
+}
+
+DecodeSurfaceDescriptor WindowSurface(void) {
+    return DecodeSurfaceDescriptor { kWINDOW_WIDTH, kWINDOW_HEIGHT,
+                                     kWINDOW_WIDTH,
+                                     SurfaceFormat::SURFACE_FORMAT_RGBA_8888 };
+}
+
+/*
+ * DecodeThroughRing(): the slide-show's default path, the worker decodes
+ *     the whole mapped file into a frame of the ring, which the view copies
+ *     into the window. Rows show up all at once, when the frame is copied.
+ *     A few more frames are played so the ring is in use as in the view.
+ */
+DecodeResult DecodeThroughRing(AAssetManager* mgr, const char* file) {
+    DecodeResult result { 0, 0, 0, false };
+    std::vector<uint8_t> window;
+    long startKb = StartMeasure(&window);
+    DecodeSurfaceDescriptor surface = WindowSurface();
+    const char* files[] = { file };
+
+    double start = GetTimeInMs();
+    WebpDecoder* decoder = new WebpDecoder(files, 1, &surface, mgr);
+    decoder->DecodeFrame();
+    double deadline = start + 60000;
+    for (uint32_t shown = 0;
+         shown <= WebpDecoder::kDEFAULT_FRAME_RING_SIZE &&
+         GetTimeInMs() < deadline; ) {
+        uint8_t* frame = decoder->GetDecodedFrame();
+        if (!frame) {
+            usleep(100);
+            continue;
+        }
+        memcpy(window.data(), frame, window.size());
+        if (!shown++) {
+            result.firstRowTime_ = result.wholeTime_ = GetTimeInMs() - start;
+            result.ok_ = true;
+        }
+        decoder->DecodeFrame();
+    }
+    result.peakMemory_ = ReadStatusKb("VmHWM:") - startKb;
+    decoder->DestroyDecoder();
+    return result;
+}
+
+void OnFirstRows(void* ctx, int32_t startRow, int32_t endRow) {
+    double* firstRowTime = reinterpret_cast<double*>(ctx);
+    if (*firstRowTime == 0) {
+        *firstRowTime = GetTimeInMs();
+    }
+}
+
+/*
+ * DecodeIntoWindow(): the file is streamed through WebPIDecoder straight
+ *     into the window buffer, rows are reported as they are decoded
+ */
+DecodeResult DecodeIntoWindow(AAssetManager* mgr, const char* file) {
+    DecodeResult result { 0, 0, 0, false };
+    std::vector<uint8_t> window;
+    long startKb = StartMeasure(&window);
+    DecodeSurfaceDescriptor surface = WindowSurface();
+    const char* files[] = { file };
+
+    double start = GetTimeInMs(), firstRowTime = 0;
+    WebpDecoder* decoder = new WebpDecoder(files, 1, &surface, mgr, 0);
+    result.ok_ = decoder->DecodeFrameInto(window.data(), OnFirstRows,
+                                          &firstRowTime);
+    result.wholeTime_ = GetTimeInMs() - start;
+    result.firstRowTime_ = firstRowTime - start;
+    result.peakMemory_ = ReadStatusKb("VmHWM:") - startKb;
+    decoder->DestroyDecoder();
+    return result;
+}
+
+/*
+ * RunInChild(): decode in a child process, so that the peak memory the
+ *     kernel reports is the one of that decode only
+ */
+DecodeResult RunInChild(DecodeResult (*decode)(AAssetManager*, const char*),
+                        AAssetManager* mgr, const char* file) {
+    DecodeResult result { 0, 0, 0, false };
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return result;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        result = decode(mgr, file);
+        bool sent = write(fds[1], &result, sizeof(result)) == sizeof(result);
+        _exit(sent ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+        result.ok_ = false;
+    }
+    close(fds[0]);
+    if (pid > 0) {
+        waitpid(pid, nullptr, 0);
+    }
+    return result;
+}
+
+void BenchIncremental(void) {
+    struct {
+        const char* name_;
+        int32_t     width_, height_;
+        bool        lossless_;
+    } pictures[] = {
+        { "photo.webp", 4032, 3024, false },
+        { "graphics.webp", 2560, 1440, true },
+    };
+    AssetDir assets;
+    for (auto& picture : pictures) {
+        std::vector<uint8_t> file = Encode(
+            MakePicture(picture.width_, picture.height_, 5, Alpha::OPAQUE),
+            picture.lossless_);
+        if (!assets.Add(picture.name_, file)) {
+            printf("incremental: cannot write test file\n");
+            return;
+        }
+        printf("incremental: %dx%d %s, %zu bytes, into a %dx%d window\n",
+               picture.width_, picture.height_,
+               picture.lossless_ ? "lossless" : "lossy", file.size(),
+               kWINDOW_WIDTH, kWINDOW_HEIGHT);
+
+        DecodeResult ring = RunInChild(DecodeThroughRing, assets.Manager(),
+                                       picture.name_);
+        DecodeResult direct = RunInChild(DecodeIntoWindow, assets.Manager(),
+                                         picture.name_);
+        const DecodeResult* results[] = { &ring, &direct };
+        const char* names[] = { "frame ring", "into window" };
+        for (int i = 0; i < 2; i++) {
+            if (!results[i]->ok_) {
+                printf("incremental:   %-12s failed\n", names[i]);
+                continue;
+            }
+            printf("incremental:   %-12s first row %7.1f ms  whole %7.1f ms"
+                   "  peak memory +%.1f MB\n", names[i],
+                   results[i]->firstRowTime_, results[i]->wholeTime_,
+                   results[i]->peakMemory_ / 1024.0);
+        }
+    }
+}
+
+/*
+ * BenchTiles(): a session on a large photo in the window, opened to fit,
+ *     zoomed in to full resolution, panned, panned back and zoomed out.
+ *     Each viewport is rendered until all of its tiles are shown.
+ */
+void BenchTiles(void) {
+    const int32_t width = 8192, height = 6144;
+    std::vector<uint8_t> file = Encode(
+        MakePicture(width, height, 9, Alpha::OPAQUE), false);
+    printf("tile: %dx%d lossy, %zu bytes, into a %dx%d window\n", width,
+           height, file.size(), kWINDOW_WIDTH, kWINDOW_HEIGHT);
+
+    std::vector<uint8_t> window(kWINDOW_WIDTH * kWINDOW_HEIGHT * 4);
+    WebpTileDecoder* tiles = new WebpTileDecoder(WindowSurface());
+    int32_t id = tiles->AddImage(file.data(), file.size());
+
+    struct Viewport {
+        float centerX_, centerY_, scale_;
+    };
+    float fit = std::min(static_cast<float>(kWINDOW_WIDTH) / width,
+                         static_cast<float>(kWINDOW_HEIGHT) / height);
+    float cx = width / 2.0f, cy = height / 2.0f;
+    std::vector<Viewport> open { { cx, cy, fit } };
+    std::vector<Viewport> zoomIn, pan, panBack, zoomOut;
+    for (float scale = 0.25f; scale <= 1.0f; scale *= 2.0f) {
+        zoomIn.push_back(Viewport { cx, cy, scale });
+    }
+    for (int32_t step = 1; step <= 8; step++) {
+        pan.push_back(Viewport { cx + step * 240.0f, cy, 1.0f });
+        panBack.push_back(Viewport { cx + (8 - step) * 240.0f, cy, 1.0f });
+    }
+    zoomOut.assign(zoomIn.rbegin() + 1, zoomIn.rend());
+    zoomOut.push_back(open[0]);
+
+    struct {
+        const char* name_;
+        const std::vector<Viewport>* viewports_;
+    } phases[] = {
+        { "open", &open }, { "zoom in", &zoomIn }, { "pan", &pan },
+        { "pan back", &panBack }, { "zoom out", &zoomOut },
+    };
+    TileStats last;
+    tiles->GetStats(&last);
+    for (auto& phase : phases) {
+        double total = 0, longest = 0;
+        for (auto& viewport : *phase.viewports_) {
+            float left = viewport.centerX_ -
+                         kWINDOW_WIDTH / 2.0f / viewport.scale_;
+            float top = viewport.centerY_ -
+                        kWINDOW_HEIGHT / 2.0f / viewport.scale_;
+            double time = RenderUntilComplete(tiles, id, left, top,
+                                              viewport.scale_, window.data());
+            if (time < 0) {
+                printf("tile: %s: viewport never completed\n", phase.name_);
+                delete tiles;
+                return;
+            }
+            total += time;
+            longest = std::max(longest, time);
+        }
+        TileStats stats;
+        tiles->GetStats(&stats);
+        uint32_t hits = stats.hits_ - last.hits_;
+        uint32_t misses = stats.misses_ - last.misses_;
+        printf("tile:   %-9s %zu viewports, time to viewport %7.1f ms "
+               "average %7.1f ms max, %3u hits %3u misses, hit rate %5.1f%%\n",
+               phase.name_, phase.viewports_->size(),
+               total / phase.viewports_->size(), longest, hits, misses,
+               100.0 * hits / std::max(1u, hits + misses));
+        last = stats;
+    }
+    printf("tile: %u tiles decoded in %.1f ms on average, %u evicted, "
+           "%.1f MB cached\n", last.decodedTiles_,
+           last.totalDecodeTime_ / 1000.0 / std::max(1u, last.decodedTiles_),
+           last.evictedTiles_, last.cacheBytes_ / 1048576.0);
+    delete tiles;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* mode = argc > 1 ? argv[1] : nullptr;
+    if (mode && strcmp(mode, "check") && strcmp(mode, "anim") &&
+        strcmp(mode, "incremental") && strcmp(mode, "tile")) {
+        fprintf(stderr, "usage: %s [check|anim|incremental|tile]\n",
+                argv[0]);
+        return 2;
+    }
+
+    bool ok = true;
+    if (!mode || !strcmp(mode, "check")) {
+        ok = CheckAnimation() && ok;
+        ok = CheckLoopCount() && ok;
+        ok = CheckIncremental() && ok;
+        ok = CheckTiles() && ok;
+        printf("check: %s\n", ok ? "ok" : "FAILED");
+    }
+    if (!mode || !strcmp(mode, "anim")) {
+        BenchAnimation();
+    }
+    if (!mode || !strcmp(mode, "incremental")) {
+        BenchIncremental();
+    }
+    if (!mode || !strcmp(mode, "tile")) {
+        BenchTiles();
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <webp/decode.h>
+#include "webp_anim.h"
+
+WebpAnimation::WebpAnimation(const uint8_t* data, size_t len)
+    : demux_(nullptr), width_(0), height_(0), loopCount_(0), duration_(0),
+      current_(-1), cacheHits_(0), cacheMisses_(0) {
+    WebPData webpData = { data, len };
+    demux_ = WebPDemux(&webpData);
+    if (!demux_) {
+        return;
+    }
+    width_ = WebPDemuxGetI(demux_, WEBP_FF_CANVAS_WIDTH);
+    height_ = WebPDemuxGetI(demux_, WEBP_FF_CANVAS_HEIGHT);
+    loopCount_ = WebPDemuxGetI(demux_, WEBP_FF_LOOP_COUNT);
+
+    // collect frame geometry and timing, and find out key frames
+    WebPIterator iter;
+    if (WebPDemuxGetFrame(demux_, 1, &iter)) {
+        do {
+            FrameInfo info;
+            info.x_ = iter.x_offset, info.y_ = iter.y_offset;
+            info.width_ = iter.width, info.height_ = iter.height;
+            info.timestamp_ = duration_;
+            info.duration_ = static_cast<uint32_t>(iter.duration);
+            info.disposeToBackground_ =
+                (iter.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND);
+            info.blend_ = (iter.blend_method == WEBP_MUX_BLEND);
+            info.hasAlpha_ = (iter.has_alpha != 0);
+            info.snapshot_ = -1;
+
+            bool fullFrame = (info.width_ == static_cast<int32_t>(width_) &&
+                              info.height_ == static_cast<int32_t>(height_));
+            if (frames_.empty()) {
+                info.keyFrame_ = true;
+            } else if ((!info.hasAlpha_ || !info.blend_) && fullFrame) {
+                info.keyFrame_ = true;
+            } else {
+                const FrameInfo& prev = frames_.back();
+                bool prevFull = (prev.width_ == static_cast<int32_t>(width_) &&
+                                 prev.height_ == static_cast<int32_t>(height_));
+                info.keyFrame_ = prev.disposeToBackground_ &&
+                                 (prevFull || prev.keyFrame_);
+            }
+            duration_ += info.duration_;
+            frames_.push_back(info);
+        } while (WebPDemuxNextFrame(&iter));
+        WebPDemuxReleaseIterator(&iter);
+    }
+    if (frames_.empty() || !width_ || !height_) {
+        WebPDemuxDelete(demux_);
+        demux_ = nullptr;
+        return;
+    }
+
+    canvas_.resize(width_ * height_ * 4);
+    PickSnapshots();
+}
+
+WebpAnimation::~WebpAnimation() {
+    if (demux_) {
+        WebPDemuxDelete(demux_);
+        demux_ = nullptr;
+    }
+}
+
+uint32_t WebpAnimation::FrameAtTime(uint32_t timeMs) const {
+    if (frames_.empty() || !duration_) {
+        return 0;
+    }
+    timeMs %= duration_;
+    // binary search the last frame starting no later than timeMs
+    uint32_t low = 0, high = static_cast<uint32_t>(frames_.size()) - 1;
+    while (low < high) {
+        uint32_t mid = (low + high + 1) / 2;
+        if (frames_[mid].timestamp_ <= timeMs) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+void WebpAnimation::ClearRect(int32_t x, int32_t y,
+                              int32_t width, int32_t height) {
+    for (int32_t row = y; row < y + height; row++) {
+        memset(&canvas_[(row * width_ + x) * 4], 0, width * 4);
+    }
+}
+
+/*
+ * CompositeFrame():
+ *     draw frame idx on top of the canvas, which must be holding frame
+ *     idx - 1 unless frame idx is a key frame
+ */
+bool WebpAnimation::CompositeFrame(uint32_t idx) {
+    const FrameInfo& info = frames_[idx];
+    if (info.keyFrame_) {
+        memset(canvas_.data(), 0, canvas_.size());
+    } else {
+        assert(current_ == static_cast<int32_t>(idx) - 1);
+        const FrameInfo& prev = frames_[idx - 1];
+        if (prev.disposeToBackground_) {
+            ClearRect(prev.x_, prev.y_, prev.width_, prev.height_);
+        }
+    }
+
+    WebPIterator iter;
+    if (!WebPDemuxGetFrame(demux_, idx + 1, &iter)) {
+        return false;
+    }
+    int32_t stride = info.width_ * 4;
+    fragment_.resize(stride * info.height_);
+    uint8_t* decoded = WebPDecodeRGBAInto(iter.fragment.bytes,
+                                          iter.fragment.size,
+                                          fragment_.data(), fragment_.size(),
+                                          stride);
+    WebPDemuxReleaseIterator(&iter);
+    if (!decoded) {
+        current_ = -1;
+        return false;
+    }
+
+    for (int32_t row = 0; row < info.height_; row++) {
+        const uint8_t* src = &fragment_[row * stride];
+        uint8_t* dst = &canvas_[((info.y_ + row) * width_ + info.x_) * 4];
+        // a key frame is drawn over a cleared canvas: nothing to blend with
+        if (!info.blend_ || !info.hasAlpha_ || info.keyFrame_) {
+            memcpy(dst, src, stride);
+            continue;
+        }
+        // non-premultiplied "src over dst", as WebPAnimDecoder does
+        for (int32_t col = 0; col < info.width_; col++, src += 4, dst += 4) {
+            uint32_t srcA = src[3];
+            if (srcA == 0) {
+                continue;
+            }
+            if (srcA == 0xFF) {
+                memcpy(dst, src, 4);
+                continue;
+            }
+            uint32_t dstFactorA = (dst[3] * (256 - srcA)) >> 8;
+            uint32_t blendA = srcA + dstFactorA;
+            uint32_t scale = (1UL << 24) / blendA;
+            for (int32_t c = 0; c < 3; c++) {
+                dst[c] = static_cast<uint8_t>(
+                    ((src[c] * srcA + dst[c] * dstFactorA) * scale) >> 24);
+            }
+            dst[3] = static_cast<uint8_t>(blendA);
+        }
+    }
+    current_ = static_cast<int32_t>(idx);
+    return true;
+}
+
+/*
+ * PickSnapshots(): choose the frames kept in the cache, the ones covering
+ *                  the largest area first
+ */
+void WebpAnimation::PickSnapshots(void) {
+    uint32_t maxCached = static_cast<uint32_t>(kCACHE_BUDGET / canvas_.size());
+    uint64_t minArea = static_cast<uint64_t>(width_) * height_ /
+                       kSNAPSHOT_MIN_AREA;
+    std::vector<uint32_t> candidates;
+    for (uint32_t idx = 0; idx < frames_.size(); idx++) {
+        const FrameInfo& info = frames_[idx];
+        if (static_cast<uint64_t>(info.width_) * info.height_ >= minArea) {
+            candidates.push_back(idx);
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [this](uint32_t a, uint32_t b) {
+        return frames_[a].width_ * frames_[a].height_ >
+               frames_[b].width_ * frames_[b].height_;
+    });
+    if (candidates.size() > maxCached) {
+        candidates.resize(maxCached);
+    }
+    for (auto idx : candidates) {
+        frames_[idx].snapshot_ = static_cast<int32_t>(snapshots_.size());
+        snapshots_.push_back(std::vector<uint8_t>());
+    }
+}
+
+const uint8_t* WebpAnimation::GetFrame(uint32_t idx, uint32_t* duration) {
+    if (!IsValid() || idx >= frames_.size()) {
+        return nullptr;
+    }
+    if (duration) {
+        *duration = frames_[idx].duration_;
+    }
+    if (current_ == static_cast<int32_t>(idx)) {
+        return canvas_.data();
+    }
+
+    // nearest starting point: current canvas, cached canvas or key frame
+    int32_t start = -1;
+    if (current_ >= 0 && current_ < static_cast<int32_t>(idx)) {
+        start = current_;
+    }
+    for (int32_t frame = idx; frame > start; frame--) {
+        int32_t snapshot = frames_[frame].snapshot_;
+        if (snapshot >= 0 && !snapshots_[snapshot].empty()) {
+            cacheHits_++;
+            canvas_ = snapshots_[snapshot];
+            current_ = start = frame;
+            break;
+        }
+        if (frames_[frame].keyFrame_) {
+            start = frame - 1;
+            current_ = -1;
+            break;
+        }
+    }
+
+    for (uint32_t frame = start + 1; frame <= idx; frame++) {
+        if (!CompositeFrame(frame)) {
+            return nullptr;
+        }
+        int32_t snapshot = frames_[frame].snapshot_;
+        if (snapshot >= 0 && snapshots_[snapshot].empty()) {
+            cacheMisses_++;
+            snapshots_[snapshot] = canvas_;
+        }
+    }
+    return canvas_.data();
+}
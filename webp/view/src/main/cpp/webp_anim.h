@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __WEBP_ANIM_H__
+#define __WEBP_ANIM_H__
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <webp/demux.h>
+
+/*
+ * Animated webp player:
+ *     Frames are extracted with WebPDemux and composited into a persistent
+ *     RGBA canvas, applying each frame's blending and the previous frame's
+ *     disposal as the spec requires.
+ *     Frames are meant to be played in order: getting the next frame only
+ *     composites that frame. Jumping to a frame restarts from the closest of:
+ *       - the canvas currently composited
+ *       - a key frame (does not depend on previous canvas content)
+ *       - a canvas snapshot in the cache
+ *     The cache keeps the composited canvas of the frames that are the most
+ *     expensive to composite again: frames covering at least
+ *     1/kSNAPSHOT_MIN_AREA of the canvas (full key frames among them),
+ *     largest first, as many as fit in kCACHE_BUDGET bytes. They are picked
+ *     when the file is opened and never evicted, so every loop after the
+ *     first one copies those frames from the cache instead of decoding them,
+ *     and seeking does not need to decode from the beginning.
+ *     Compressed data is not copied: it must stay valid while the object is
+ *     alive.
+ */
+class WebpAnimation {
+  public:
+    static const uint32_t kSNAPSHOT_MIN_AREA = 4;
+    static const uint32_t kCACHE_BUDGET = 32 * 1024 * 1024;
+
+    explicit WebpAnimation(const uint8_t* data, size_t len);
+    ~WebpAnimation();
+
+    bool     IsValid(void) const { return demux_ != nullptr; }
+    uint32_t Width(void) const { return width_; }
+    uint32_t Height(void) const { return height_; }
+    uint32_t FrameCount(void) const {
+        return static_cast<uint32_t>(frames_.size());
+    }
+    // times the animation is played, 0 for looping forever
+    uint32_t LoopCount(void) const { return loopCount_; }
+    // total play time of one loop in milli-seconds
+    uint32_t Duration(void) const { return duration_; }
+
+    // index of the frame displayed at timeMs from animation start
+    uint32_t FrameAtTime(uint32_t timeMs) const;
+
+    // composite frame idx, return canvas (RGBA, stride Width() * 4) and
+    // the frame display time in milli-seconds
+    const uint8_t* GetFrame(uint32_t idx, uint32_t* duration);
+
+    // hits: cached frames copied from the cache, misses: cached frames that
+    // had to be composited
+    void     GetCacheStats(uint32_t* hits, uint32_t* misses) const {
+        *hits = cacheHits_, *misses = cacheMisses_;
+    }
+
+  private:
+    struct FrameInfo {
+        int32_t  x_, y_, width_, height_;
+        uint32_t timestamp_, duration_;
+        bool     disposeToBackground_;
+        bool     blend_;
+        bool     hasAlpha_;
+        bool     keyFrame_;
+        int32_t  snapshot_;    // index into snapshots_, -1 if not cached
+    };
+
+    bool     CompositeFrame(uint32_t idx);
+    void     ClearRect(int32_t x, int32_t y, int32_t width, int32_t height);
+    void     PickSnapshots(void);
+
+    WebPDemuxer* demux_;
+    uint32_t width_, height_, loopCount_, duration_;
+    std::vector<FrameInfo> frames_;
+    std::vector<uint8_t>   canvas_;
+    std::vector<uint8_t>   fragment_;
+    int32_t  current_;     // frame in canvas_, -1 for none
+
+    // composited canvas of the cached frames, empty until first composited
+    std::vector<std::vector<uint8_t>> snapshots_;
+    uint32_t cacheHits_, cacheMisses_;
+};
+#endif // __WEBP_ANIM_H__
@@ -14,18 +14,32 @@
  * limitations under the License.
  */
 #include <cassert>
-#include <pthread.h>
+#include <cstring>
+#include <ctime>
 #include <webp/decode.h>
 #include "webp_decode.h"
 
+static uint64_t GetTimeInUs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
 WebpDecoder::WebpDecoder(const char** files, uint32_t count,
                          DecodeSurfaceDescriptor* frameBuf,
-                         AAssetManager* assetMgr)
-    : assetMgr_(assetMgr),
-      buf_(nullptr), stopPending_(false),
-      state_(state_idle), worker_(nullptr) {
-    for (auto i = 0; i < count; i++) {
-        files_.push(files[i]);
+                         AAssetManager* assetMgr, uint32_t ringSize)
+    : assetMgr_(assetMgr), nextFile_(0), animFrame_(0),
+      animLoop_(0), animTime_(0),
+      writeIdx_(0), readIdx_(0),
+      started_(false), stopPending_(false), waiting_(false) {
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+    memset(&stats_, 0, sizeof(stats_));
+    stats_.minDecodeTime_ = UINT32_MAX;
+
+    for (uint32_t i = 0; i < count; i++) {
+        files_.push_back(files[i]);
+        fileData_.push_back(FileData {nullptr, nullptr, 0, nullptr});
     }
     if (count && assetMgr && frameBuf) {
         bufInfo_ = *frameBuf;
@@ -41,24 +55,62 @@ WebpDecoder::WebpDecoder(const char** files, uint32_t count,
                 assert(0);
                 return;
         }
-        // allocate a private decode buffer
+        // allocate private decode buffers for the frame ring
         uint32_t size = bufInfo_.height_ * bufInfo_.stride_ * bytePerPix_;
-        buf_ = new uint8_t [size];
-        assert(buf_);
+        for (uint32_t i = 0; i < ringSize; i++) {
+            FrameSlot slot { new uint8_t [size], state_idle, 0 };
+            assert(slot.buf_);
+            frames_.push_back(slot);
+            UpdateMemoryUsage(size);
+        }
     }
 }
 
 /*
- * GetDecodedFrame():  return decoded frame if available,
+ * UpdateMemoryUsage(): track memory held by decoder, caller holds lock_
+ *                      or decoder is not shared with worker thread yet
+ */
+void WebpDecoder::UpdateMemoryUsage(int64_t delta) {
+    stats_.memory_ += delta;
+    if (stats_.memory_ > stats_.peakMemory_)
+        stats_.peakMemory_ = stats_.memory_;
+}
+
+/*
+ * GetDecodedFrame():  return the oldest decoded frame if available,
  *                     return nullptr otherwise
+ *    The frame stays valid until the next DecodeFrame() call
  */
-uint8_t* WebpDecoder::GetDecodedFrame(void) {
-    return (state_ == state_ready ? buf_ : nullptr);
+uint8_t* WebpDecoder::GetDecodedFrame(uint32_t* duration) {
+    uint8_t* frame = nullptr;
+    pthread_mutex_lock(&lock_);
+    if (!frames_.empty()) {
+        FrameSlot& slot = frames_[readIdx_];
+        if (duration) {
+            *duration = slot.duration_;
+        }
+        if (slot.state_ == state_ready) {
+            slot.state_ = state_displaying;
+            stats_.displayedFrames_++;
+            stats_.totalQueueDepth_ += stats_.queueDepth_;
+            stats_.queueDepth_--;
+            waiting_ = false;
+            frame = slot.buf_;
+        } else if (slot.state_ == state_displaying) {
+            frame = slot.buf_;
+        } else if (started_ && !waiting_) {
+            // only count once for every frame we are waiting for
+            stats_.underruns_++;
+            waiting_ = true;
+        }
+    }
+    pthread_mutex_unlock(&lock_);
+    return frame;
 }
 
 /*
  * DecodeFrame():
- *    thread function to decode a picture
+ *    thread function to decode pictures
  *    directly pass through to internal decoding function
  */
 void* DecodeFrame(void * decoder) {
@@ -67,89 +119,333 @@ void* DecodeFrame(void * decoder) {
 }
 
 /*
- * DecodeFrameInternal():
- *    Main decoding function from app side, and executing inside its own thread
+ * LoadFile():
+ *    Map the compressed file into memory if not yet. Assets are kept open
+ *    until decoder is destroyed: AAsset_getBuffer() maps uncompressed
+ *    assets directly, so there is no extra copy of the file data.
  */
-void WebpDecoder::DecodeFrameInternal() {
-    const char * webpFile = files_.front();
-    files_.pop();
-    files_.push(webpFile);
-
-    AAsset* frameFile = AAssetManager_open(assetMgr_, webpFile, AASSET_MODE_BUFFER);
-    assert(frameFile != NULL);
-    int32_t len = AAsset_getLength(frameFile);
-    uint8_t *buf = new uint8_t[len];
-    assert(buf);
-    len = AAsset_read(frameFile, buf, len);
-    assert(len > 0);
-    AAsset_close(frameFile);
+bool WebpDecoder::LoadFile(uint32_t fileIdx) {
+    FileData& file = fileData_[fileIdx];
+    if (file.data_) {
+        return true;
+    }
+    AAsset* asset = AAssetManager_open(assetMgr_, files_[fileIdx],
+                                       AASSET_MODE_BUFFER);
+    assert(asset != NULL);
+    if (!asset) {
+        return false;
+    }
+    file.data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+    file.len_ = AAsset_getLength(asset);
+    file.asset_ = asset;
+    assert(file.data_ && file.len_ > 0);
 
-    WebPDecoderConfig config;
-    if (!WebPInitDecoderConfig(&config)) {
-        assert(0);
+    WebPBitstreamFeatures features;
+    if (file.data_ &&
+        WebPGetFeatures(file.data_, file.len_, &features) == VP8_STATUS_OK &&
+        features.has_animation) {
+        file.anim_ = new WebpAnimation(file.data_, file.len_);
+        if (!file.anim_->IsValid()) {
+            delete file.anim_;
+            file.anim_ = nullptr;
+        }
     }
 
-    VP8StatusCode  status = WebPGetFeatures(buf, len, &config.input);
-    assert(status == VP8_STATUS_OK);
+    pthread_mutex_lock(&lock_);
+    UpdateMemoryUsage(file.len_);
+    pthread_mutex_unlock(&lock_);
+    return (file.data_ != nullptr);
+}
+
+/*
+ * InitDecoderConfig():
+ *    decoding options and output buffer description shared by all decoding
+ *    modes: scaled to window size, written into dst with window's stride
+ */
+bool WebpDecoder::InitDecoderConfig(WebPDecoderConfig* config, uint8_t* dst) {
+    if (!WebPInitDecoderConfig(config)) {
+        assert(0);
+        return false;
+    }
 
     // let's decode it into a buffer ...
-    config.options.bypass_filtering = 1;
-    config.options.no_fancy_upsampling = 1;
-    config.options.flip = 0;
-    config.options.use_scaling = 1;
-    config.options.scaled_width = bufInfo_.width_;
-    config.options.scaled_height = bufInfo_.height_;
+    config->options.bypass_filtering = 1;
+    config->options.no_fancy_upsampling = 1;
+    config->options.flip = 0;
+    config->options.use_scaling = 1;
+    config->options.scaled_width = bufInfo_.width_;
+    config->options.scaled_height = bufInfo_.height_;
 
     // this does not seems to have difference on Nexus 5
-    config.options.use_threads = 1;
+    config->options.use_threads = 1;
     switch (bufInfo_.format_) {
         case SurfaceFormat::SURFACE_FORMAT_RGB_565:
-            config.output.colorspace = MODE_RGB_565;
+            config->output.colorspace = MODE_RGB_565;
             break;
         case SurfaceFormat::SURFACE_FORMAT_RGBA_8888:
         case SurfaceFormat::SURFACE_FORMAT_RGBX_8888:
-            config.output.colorspace = MODE_RGBA;
+            config->output.colorspace = MODE_RGBA;
             break;
         default:
             assert( 0 );
-            delete  [] buf;
-            return;
-    }
-    config.output.width = bufInfo_.width_;
-    config.output.height = bufInfo_.height_;
-    config.output.is_external_memory = 1;
-    config.output.private_memory = reinterpret_cast<uint8_t*>(buf_);
-    config.output.u.RGBA.stride = bufInfo_.stride_ * bytePerPix_;
-    config.output.u.RGBA.rgba  = config.output.private_memory;
-    config.output.u.RGBA.size  = config.output.height *
-                                 config.output.u.RGBA.stride;
-
-    status = WebPDecode(buf, len, &config);
+            return false;
+    }
+    config->output.width = bufInfo_.width_;
+    config->output.height = bufInfo_.height_;
+    config->output.is_external_memory = 1;
+    config->output.private_memory = dst;
+    config->output.u.RGBA.stride = bufInfo_.stride_ * bytePerPix_;
+    config->output.u.RGBA.rgba  = config->output.private_memory;
+    config->output.u.RGBA.size  = config->output.height *
+                                  config->output.u.RGBA.stride;
+    return true;
+}
+
+/*
+ * DecodePicture():
+ *    decode one compressed webp picture into dst, scaled to window size
+ */
+bool WebpDecoder::DecodePicture(const FileData& file, uint8_t* dst) {
+    WebPDecoderConfig config;
+    if (!InitDecoderConfig(&config, dst)) {
+        return false;
+    }
+
+    VP8StatusCode  status = WebPGetFeatures(file.data_, file.len_,
+                                            &config.input);
+    assert(status == VP8_STATUS_OK);
+
+    status = WebPDecode(file.data_, file.len_, &config);
     WebPFreeDecBuffer(&config.output);
-    delete [] buf;
 
-    // only change state when it is decoded OK. Our small decoder engine will be
-    // in decoding state when error happens
     assert(status == VP8_STATUS_OK);
-    if (status == VP8_STATUS_OK) {
-        state_ = state_ready;
+    return (status == VP8_STATUS_OK);
+}
+
+/*
+ * DecodeAnimationFrame():
+ *    composite frame idx of the animation, then scale it to window size into
+ *    dst. *duration receives how long the frame is displayed
+ */
+bool WebpDecoder::DecodeAnimationFrame(WebpAnimation* anim, uint32_t idx,
+                                       uint8_t* dst, uint32_t* duration) {
+    const uint8_t* canvas = anim->GetFrame(idx, duration);
+    if (!canvas) {
+        return false;
+    }
+    // same as browsers: very short frames are played at 100 ms
+    if (*duration <= 10) {
+        *duration = 100;
+    }
+    ScaleCanvas(canvas, anim->Width(), anim->Height(), dst);
+    return true;
+}
+
+/*
+ * ScaleCanvas():
+ *    nearest sampling of RGBA canvas into dst in window size and format,
+ *    transparent pixels are composed over black
+ */
+void WebpDecoder::ScaleCanvas(const uint8_t* canvas, uint32_t width,
+                              uint32_t height, uint8_t* dst) {
+    scaleMap_.resize(bufInfo_.width_);
+    for (int32_t col = 0; col < bufInfo_.width_; col++) {
+        scaleMap_[col] = (col * width / bufInfo_.width_) * 4;
+    }
+    for (int32_t row = 0; row < bufInfo_.height_; row++) {
+        const uint8_t* src = canvas + (row * height / bufInfo_.height_) *
+                                      width * 4;
+        uint8_t* line = dst + row * bufInfo_.stride_ * bytePerPix_;
+        for (int32_t col = 0; col < bufInfo_.width_; col++) {
+            StoreRGBAPixel(src + scaleMap_[col], line + col * bytePerPix_,
+                           bytePerPix_);
+        }
+    }
+}
+
+/*
+ * DecodeFrameInto():
+ *    Incrementally decode the next file into dst: compressed data is read in
+ *    kINCREMENTAL_CHUNK_SIZE chunks and fed to WebPIDecoder as it arrives,
+ *    so decoding starts before the whole file is read and no private frame
+ *    is used. WebPIAppend() still keeps its own copy of the data appended so
+ *    far, so the compressed file ends up in memory during the decode.
+ *    callback is invoked every time more rows of dst are decoded.
+ */
+bool WebpDecoder::DecodeFrameInto(uint8_t* dst, RowsDecodedCallback callback,
+                                  void* ctx) {
+    if (!dst || files_.empty() || started_) {
+        return false;
+    }
+    const char* webpFile = files_[nextFile_];
+    nextFile_ = (nextFile_ + 1) % files_.size();
+
+    AAsset* asset = AAssetManager_open(assetMgr_, webpFile,
+                                       AASSET_MODE_STREAMING);
+    assert(asset != NULL);
+    if (!asset) {
+        return false;
+    }
+    if (chunk_.empty()) {
+        chunk_.resize(kINCREMENTAL_CHUNK_SIZE);
+        UpdateMemoryUsage(chunk_.size());
+    }
+
+    uint64_t startTime = GetTimeInUs(), firstRowTime = 0;
+    WebPDecoderConfig config;
+    WebPIDecoder* idec = nullptr;
+    VP8StatusCode status = VP8_STATUS_NOT_ENOUGH_DATA;
+    int32_t lastRow = 0;
+    int len;
+    while ((len = AAsset_read(asset, chunk_.data(), chunk_.size())) > 0) {
+        if (!idec) {
+            // first chunk carries the headers: use them for scaling setup
+            if (!InitDecoderConfig(&config, dst)) {
+                break;
+            }
+            idec = WebPIDecode(chunk_.data(), len, &config);
+            if (!idec) {
+                status = VP8_STATUS_BITSTREAM_ERROR;
+                break;
+            }
+        }
+        status = WebPIAppend(idec, chunk_.data(), len);
+        if (status != VP8_STATUS_OK && status != VP8_STATUS_SUSPENDED) {
+            break;
+        }
+
+        int lastY = 0;
+        if (WebPIDecGetRGB(idec, &lastY, nullptr, nullptr, nullptr) &&
+            lastY > lastRow) {
+            if (!lastRow)
+                firstRowTime = GetTimeInUs() - startTime;
+            if (callback)
+                callback(ctx, lastRow, lastY);
+            lastRow = lastY;
+        }
+        if (status == VP8_STATUS_OK) {
+            break;
+        }
+    }
+    if (idec) {
+        WebPIDelete(idec);
+        WebPFreeDecBuffer(&config.output);
+    }
+    AAsset_close(asset);
+
+    assert(status == VP8_STATUS_OK);
+    if (status != VP8_STATUS_OK) {
+        return false;
     }
+    uint32_t decodeTime = static_cast<uint32_t>(GetTimeInUs() - startTime);
+    stats_.decodedFrames_++;
+    stats_.displayedFrames_++;
+    stats_.incrementalFrames_++;
+    stats_.totalFirstRowTime_ += firstRowTime;
+    stats_.totalDecodeTime_ += decodeTime;
+    if (decodeTime < stats_.minDecodeTime_)
+        stats_.minDecodeTime_ = decodeTime;
+    if (decodeTime > stats_.maxDecodeTime_)
+        stats_.maxDecodeTime_ = decodeTime;
+    return true;
+}
+
+/*
+ * DecodeFrameInternal():
+ *    Main decoding loop from app side, and executing inside its own thread:
+ *    decode the next file into the next free frame of the ring until
+ *    decoder is destroyed
+ */
+void WebpDecoder::DecodeFrameInternal() {
+    // file and animation frame where the current run of failures started
+    int32_t failedFile = -1;
+    uint32_t failedFrame = 0;
+
+    pthread_mutex_lock(&lock_);
+    while (!stopPending_) {
+        FrameSlot& slot = frames_[writeIdx_];
+        if (slot.state_ != state_idle) {
+            // ring is full, wait for a frame to be displayed
+            pthread_cond_wait(&cond_, &lock_);
+            continue;
+        }
+        slot.state_ = state_decoding;
+        uint32_t fileIdx = nextFile_;
+        pthread_mutex_unlock(&lock_);
+
+        // nextFile_ and animFrame_ are only touched by this thread
+        uint64_t startTime = GetTimeInUs();
+        uint32_t frameIdx = animFrame_;
+        bool decoded = LoadFile(fileIdx);
+        FileData& file = fileData_[fileIdx];
+        uint32_t duration = 0;
+        bool fileDone = true;
+        if (decoded && file.anim_) {
+            decoded = DecodeAnimationFrame(file.anim_, animFrame_, slot.buf_,
+                                           &duration);
+            animTime_ += duration;
+            animFrame_ = (animFrame_ + 1) % file.anim_->FrameCount();
+            if (animFrame_) {
+                fileDone = !decoded;
+            } else {
+                // end of a loop: play it again if the file asks for it
+                uint32_t loops = file.anim_->LoopCount();
+                animLoop_++;
+                fileDone = !decoded || (loops ? animLoop_ >= loops :
+                                        animTime_ >= kINFINITE_LOOP_TIME);
+            }
+        } else if (decoded) {
+            decoded = DecodePicture(file, slot.buf_);
+        }
+        if (fileDone) {
+            nextFile_ = (nextFile_ + 1) % files_.size();
+            animFrame_ = animLoop_ = animTime_ = 0;
+        }
+        uint32_t decodeTime = static_cast<uint32_t>(GetTimeInUs() - startTime);
 
-    delete worker_;
-    worker_ = nullptr;
+        // read ahead the next file while the frame is being displayed
+        LoadFile(nextFile_);
 
-    // if we were asked to release while we are busy decoding (at this point,
-    // this is dangling pointer), we perform the release here to complete the
-    // request.
-    if (stopPending_) {
-        stopPending_ = false;
-        delete  this;
+        pthread_mutex_lock(&lock_);
+        if (!decoded) {
+            // skip the broken file, re-use the same frame
+            slot.state_ = state_idle;
+            if (failedFile < 0) {
+                failedFile = static_cast<int32_t>(fileIdx);
+                failedFrame = frameIdx;
+            }
+            if (nextFile_ == static_cast<uint32_t>(failedFile) &&
+                animFrame_ == failedFrame) {
+                // nothing could be decoded in a whole round of the files:
+                // stop until the decoder is destroyed instead of spinning
+                while (!stopPending_) {
+                    pthread_cond_wait(&cond_, &lock_);
+                }
+            }
+            continue;
+        }
+        failedFile = -1;
+        // GetDecodedFrame() reads the duration under the lock too
+        slot.duration_ = duration;
+        slot.state_ = state_ready;
+        writeIdx_ = (writeIdx_ + 1) % frames_.size();
+        stats_.decodedFrames_++;
+        stats_.totalDecodeTime_ += decodeTime;
+        if (decodeTime < stats_.minDecodeTime_)
+            stats_.minDecodeTime_ = decodeTime;
+        if (decodeTime > stats_.maxDecodeTime_)
+            stats_.maxDecodeTime_ = decodeTime;
+        if (++stats_.queueDepth_ > stats_.maxQueueDepth_)
+            stats_.maxQueueDepth_ = stats_.queueDepth_;
     }
+    pthread_mutex_unlock(&lock_);
 }
 
 /*
  * DecodeFrame(void):
- *     Start to decode a picture into internal frame memory
+ *     Start the decoding thread at the first call; afterwards release the
+ *     frame returned by GetDecodedFrame() back to the ring so the worker
+ *     could decode the next picture into it.
  *     The internal memory layout and size are the same as andriod native
  *     window to save copying when possible.
  *
@@ -157,38 +453,51 @@ void WebpDecoder::DecodeFrameInternal() {
  *     window size.
  */
 bool WebpDecoder::DecodeFrame(void) {
-    if (state_ == state_decoding)
+    if (frames_.empty())
         return false;
-    pthread_t       worker_;
-    pthread_attr_t  attrib;
-    pthread_attr_init( &attrib);
-    pthread_attr_setdetachstate(&attrib, PTHREAD_CREATE_DETACHED);
-    int status = pthread_create(&worker_, &attrib, ::DecodeFrame, this);
-    pthread_attr_destroy(&attrib);
-
-    if (status == 0) {
-        state_ = state_decoding;
+
+    pthread_mutex_lock(&lock_);
+    if (started_) {
+        FrameSlot& slot = frames_[readIdx_];
+        if (slot.state_ == state_displaying) {
+            slot.state_ = state_idle;
+            readIdx_ = (readIdx_ + 1) % frames_.size();
+            pthread_cond_signal(&cond_);
+        }
+        pthread_mutex_unlock(&lock_);
         return true;
     }
+    int status = pthread_create(&worker_, nullptr, ::DecodeFrame, this);
+    started_ = (status == 0);
+    pthread_mutex_unlock(&lock_);
 
     // create thread failed...
-    assert(false);
-    return false;
+    assert(status == 0);
+    return (status == 0);
+}
+
+void WebpDecoder::GetStats(DecoderStats* stats) {
+    pthread_mutex_lock(&lock_);
+    *stats = stats_;
+    pthread_mutex_unlock(&lock_);
 }
 
 /*
  * DestroyDecoder(void):
- *     Self-delete if decoder is idle
- *     Otherwise set up a flag to let decoding thread perform self-delete when
- *     it finishes. Upon returning from the function, the class pointer is invalid
- *     and should not be used
+ *     Ask decoding thread to exit once the current picture is decoded, then
+ *     self-delete. Upon returning from the function, the class pointer is
+ *     invalid and should not be used
  */
 bool WebpDecoder::DestroyDecoder(void) {
-    if (state_ == state_decoding) {
-        stopPending_ = true;
-        return false;
-    }
+    pthread_mutex_lock(&lock_);
+    stopPending_ = true;
+    pthread_cond_signal(&cond_);
+    pthread_mutex_unlock(&lock_);
 
+    if (started_) {
+        pthread_join(worker_, nullptr);
+        started_ = false;
+    }
     delete this;
     return true;
 }
@@ -197,7 +506,15 @@ bool WebpDecoder::DestroyDecoder(void) {
  * private destructor prevent object directly call delete
  */
 WebpDecoder::~WebpDecoder() {
-    if (buf_)  delete [] buf_;
-    buf_ = nullptr;
+    for (auto& slot : frames_) {
+        delete [] slot.buf_;
+    }
+    frames_.clear();
+    for (auto& file : fileData_) {
+        delete file.anim_;
+        if (file.asset_) AAsset_close(file.asset_);
+    }
+    fileData_.clear();
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
 }
-
@@ -15,10 +15,13 @@
  */
 #ifndef __WEBP_DECODE_H__
 #define __WEBP_DECODE_H__
-#include <queue>
+#include <pthread.h>
+#include <vector>
 #include <android/asset_manager.h>
+#include <webp/decode.h>
+#include "webp_anim.h"
 
-enum DecodeState { state_idle, state_decoding, state_ready};
+enum DecodeState { state_idle, state_decoding, state_ready, state_displaying};
 enum class SurfaceFormat : unsigned int {
     SURFACE_FORMAT_RGBA_8888,
     SURFACE_FORMAT_RGBX_8888,
@@ -31,46 +34,156 @@ struct DecodeSurfaceDescriptor {
     SurfaceFormat format_;
 };
 
+/*
+ * StoreRGBAPixel(): write one RGBA pixel into a surface of bytePerPix
+ *                   (RGB_565 or RGBX/RGBA_8888), composed over black
+ */
+static inline void StoreRGBAPixel(const uint8_t* rgba, uint8_t* dst,
+                                  uint32_t bytePerPix) {
+    uint32_t a = rgba[3];
+    uint32_t r = (rgba[0] * a + 127) / 255;
+    uint32_t g = (rgba[1] * a + 127) / 255;
+    uint32_t b = (rgba[2] * a + 127) / 255;
+    if (bytePerPix == 2) {
+        *reinterpret_cast<uint16_t*>(dst) = static_cast<uint16_t>(
+            ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    } else {
+        dst[0] = static_cast<uint8_t>(r);
+        dst[1] = static_cast<uint8_t>(g);
+        dst[2] = static_cast<uint8_t>(b);
+        dst[3] = 0xFF;
+    }
+}
+
+/*
+ * Decoder statistics, all time in micro-seconds
+ *   queue depth: number of decoded frames waiting to be displayed, sampled
+ *                every time a frame is handed out
+ *   underruns:   times a frame is requested but none is decoded yet
+ */
+struct DecoderStats {
+    uint32_t decodedFrames_;
+    uint32_t displayedFrames_;
+    uint32_t underruns_;
+    uint64_t totalDecodeTime_;
+    uint32_t minDecodeTime_, maxDecodeTime_;
+    uint32_t queueDepth_, maxQueueDepth_;
+    uint64_t totalQueueDepth_;
+    // incremental decoding only
+    uint32_t incrementalFrames_;
+    uint64_t totalFirstRowTime_;
+    // bytes held by decoder: frame ring, mapped files and read chunk
+    uint64_t memory_, peakMemory_;
+};
+
+/*
+ * Called during incremental decoding when rows [startRow, endRow) of the
+ * destination are decoded
+ */
+typedef void (*RowsDecodedCallback)(void* ctx, int32_t startRow,
+                                    int32_t endRow);
+
 /*
  * Webp decoder wrapper:
- *     Select a picture to decode in its own thread. The thread is deleted
- *     once a picture is decoded into its internal memory. The next picture
- *     will be decoded when:
- *       - the decoded frame is retrieved
- *       - Another DecodeFrame() is called [this is trigger]
+ *     One persistent worker thread decodes pictures into a ring of
+ *     kDEFAULT_FRAME_RING_SIZE output frames, in file order. The worker keeps
+ *     decoding as long as there is a free frame in the ring, so decoding of
+ *     the next picture overlaps with displaying of the current one.
+ *     Compressed file data is kept mapped (AAsset_getBuffer()) after the
+ *     first read; the file after the one being decoded is read ahead.
+ *     Animated files are played frame by frame through WebpAnimation, each
+ *     frame is handed out with its own display time. An animation is played
+ *     as many times as its loop count says; one looping forever is played
+ *     until kINFINITE_LOOP_TIME has passed, at the end of a loop, then the
+ *     slide-show moves on.
+ *
+ *     Frame flow:
+ *       - GetDecodedFrame() hands out the oldest decoded frame
+ *       - DecodeFrame() returns that frame to the ring [this is trigger]
+ *
+ *     Created with ringSize 0, the decoder has no worker or frame memory:
+ *     DecodeFrameInto() streams the next file in kINCREMENTAL_CHUNK_SIZE
+ *     chunks through WebPIDecoder straight into the caller's buffer, and
+ *     reports rows as they are decoded (WebPIDecoder keeps a copy of the
+ *     compressed data it is given). Animated files are not supported
+ *     in this mode.
+ *
  *    when display format changes, call DestroyDecoder() to release this decoder
  *    and allocate a new deocder object.
  */
 class WebpDecoder {
   public:
+    static const uint32_t kDEFAULT_FRAME_RING_SIZE = 3;
+    static const uint32_t kINCREMENTAL_CHUNK_SIZE = 16 * 1024;
+    static const uint32_t kINFINITE_LOOP_TIME = 10000;  // ms
+
     explicit WebpDecoder(const char** files, uint32_t count,
                          DecodeSurfaceDescriptor* surfDesc,
-                         AAssetManager* assetMgr);
-    // Start decode a picture
+                         AAssetManager* assetMgr,
+                         uint32_t ringSize = kDEFAULT_FRAME_RING_SIZE);
+    // Start decoding, or recycle the frame from GetDecodedFrame()
     bool     DecodeFrame(void);
 
-    // Poll to see if a picture is decoded and ready to be used/displayed
-    uint8_t *GetDecodedFrame(void);
+    // Poll to see if a picture is decoded and ready to be used/displayed,
+    // duration: display time in ms for animation frames, 0 for pictures
+    uint8_t *GetDecodedFrame(uint32_t* duration = nullptr);
+
+    // Decode the next picture incrementally into dst, which has the
+    // geometry of the surface descriptor (e.g. a locked window buffer)
+    bool     DecodeFrameInto(uint8_t* dst, RowsDecodedCallback callback,
+                             void* ctx);
 
     // WebpDecoder internal decoding function, no called from user
     void     DecodeFrameInternal(void);
 
+    // Snapshot of decoding statistics
+    void     GetStats(DecoderStats* stats);
+
     // Release this decoder after usage
     bool     DestroyDecoder(void);
 
   private:
+    struct FrameSlot {
+        uint8_t*    buf_;
+        DecodeState state_;
+        uint32_t    duration_;
+    };
+    struct FileData {
+        AAsset*        asset_;
+        const uint8_t* data_;
+        int32_t        len_;
+        WebpAnimation* anim_;
+    };
+
+    bool     LoadFile(uint32_t fileIdx);
+    bool     InitDecoderConfig(WebPDecoderConfig* config, uint8_t* dst);
+    bool     DecodePicture(const FileData& file, uint8_t* dst);
+    bool     DecodeAnimationFrame(WebpAnimation* anim, uint32_t idx,
+                                  uint8_t* dst, uint32_t* duration);
+    void     ScaleCanvas(const uint8_t* canvas, uint32_t width,
+                         uint32_t height, uint8_t* dst);
+    void     UpdateMemoryUsage(int64_t delta);
+
     DecodeSurfaceDescriptor bufInfo_;
     AAssetManager*          assetMgr_;
-    std::queue<const char*> files_;
-    uint8_t*  buf_;
-    bool      stopPending_;
-    DecodeState state_;
+    std::vector<const char*> files_;
+    std::vector<FileData>    fileData_;
+    std::vector<FrameSlot>   frames_;
+    std::vector<uint8_t>     chunk_;
+    std::vector<uint32_t>    scaleMap_;
+    uint32_t  nextFile_, animFrame_;
+    uint32_t  animLoop_, animTime_;  // loops done, time played (ms)
+    uint32_t  writeIdx_, readIdx_;
+    bool      started_, stopPending_, waiting_;
 
     uint32_t   bytePerPix_;
-    pthread_t* worker_;
+    pthread_t  worker_;
+    pthread_mutex_t lock_;
+    pthread_cond_t  cond_;
+    DecoderStats    stats_;
     /*
      * private destructor prevent object directly call delete
      */
     ~WebpDecoder();
 };
-#endif // __WEBP_DECODE_H__
\ No newline at end of file
+#endif // __WEBP_DECODE_H__
@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <webp/decode.h>
+#include "webp_tile.h"
+
+static uint64_t GetTimeInUs(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+/*
+ * DecodeTiles():
+ *    thread function to decode tiles
+ *    directly pass through to internal decoding function
+ */
+static void* DecodeTiles(void* decoder) {
+    reinterpret_cast<WebpTileDecoder*>(decoder)->DecodeTilesInternal();
+    return nullptr;
+}
+
+WebpTileDecoder::WebpTileDecoder(const DecodeSurfaceDescriptor& surfDesc)
+    : bufInfo_(surfDesc), cacheBytes_(0), exit_(false), generation_(0),
+      viewId_(-1), viewLeft_(0.0f), viewTop_(0.0f), viewScale_(0.0f),
+      viewStartTime_(0), viewComplete_(false) {
+    memset(&stats_, 0, sizeof(stats_));
+    bytePerPix_ = (bufInfo_.format_ == SurfaceFormat::SURFACE_FORMAT_RGB_565)
+                  ? 2 : 4;
+    pthread_mutex_init(&lock_, nullptr);
+    pthread_cond_init(&cond_, nullptr);
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t count = static_cast<uint32_t>(
+        std::min<long>(std::max<long>(cores, 1), kMAX_WORKERS));
+    for (uint32_t i = 0; i < count; i++) {
+        pthread_t worker;
+        if (pthread_create(&worker, nullptr, DecodeTiles, this) == 0) {
+            workers_.push_back(worker);
+        }
+    }
+    assert(!workers_.empty());
+}
+
+WebpTileDecoder::~WebpTileDecoder() {
+    pthread_mutex_lock(&lock_);
+    exit_ = true;
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&lock_);
+    for (auto& worker : workers_) {
+        pthread_join(worker, nullptr);
+    }
+    workers_.clear();
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+}
+
+int32_t WebpTileDecoder::AddImage(const uint8_t* data, size_t len) {
+    Image image { data, len, 0, 0, 0 };
+    if (!WebPGetInfo(data, len, &image.width_, &image.height_)) {
+        return -1;
+    }
+    // coarsest level: the whole picture fits into one tile
+    while ((image.width_ >> image.maxLevel_) > kTILE_SIZE ||
+           (image.height_ >> image.maxLevel_) > kTILE_SIZE) {
+        image.maxLevel_++;
+    }
+    pthread_mutex_lock(&lock_);
+    images_.push_back(image);
+    int32_t id = static_cast<int32_t>(images_.size()) - 1;
+    pthread_mutex_unlock(&lock_);
+    return id;
+}
+
+/*
+ * GetImage(): copy of a registered picture, under lock_ as AddImage() may
+ *             reallocate images_ from another thread
+ */
+bool WebpTileDecoder::GetImage(int32_t id, Image* image) {
+    pthread_mutex_lock(&lock_);
+    bool valid = (id >= 0 && id < static_cast<int32_t>(images_.size()));
+    if (valid) {
+        *image = images_[id];
+    }
+    pthread_mutex_unlock(&lock_);
+    return valid;
+}
+
+bool WebpTileDecoder::GetImageSize(int32_t id, int32_t* width,
+                                   int32_t* height) {
+    Image image;
+    if (!GetImage(id, &image)) {
+        return false;
+    }
+    *width = image.width_;
+    *height = image.height_;
+    return true;
+}
+
+uint64_t WebpTileDecoder::TileKey(int32_t id, int32_t level,
+                                  int32_t tx, int32_t ty) {
+    return (static_cast<uint64_t>(id) << 48) |
+           (static_cast<uint64_t>(level) << 40) |
+           (static_cast<uint64_t>(tx) << 20) | static_cast<uint64_t>(ty);
+}
+
+/*
+ * FindTile(): look up cache and mark the tile as most recently used,
+ *             caller holds lock_
+ */
+std::shared_ptr<WebpTileDecoder::Tile> WebpTileDecoder::FindTile(
+    uint64_t key) {
+    auto it = tileMap_.find(key);
+    if (it == tileMap_.end()) {
+        return nullptr;
+    }
+    tiles_.splice(tiles_.begin(), tiles_, it->second);
+    return *it->second;
+}
+
+/*
+ * DecodeTile():
+ *    decode one tile with cropping, and scaling for levels above 0
+ */
+bool WebpTileDecoder::DecodeTile(uint64_t key, Tile* tile) {
+    int32_t id = static_cast<int32_t>(key >> 48);
+    int32_t level = static_cast<int32_t>((key >> 40) & 0xFF);
+    int32_t tx = static_cast<int32_t>((key >> 20) & 0xFFFFF);
+    int32_t ty = static_cast<int32_t>(key & 0xFFFFF);
+
+    Image image;
+    if (!GetImage(id, &image)) {
+        return false;
+    }
+
+    // tile origin is always even, as libwebp wants for cropping
+    int32_t span = kTILE_SIZE << level;
+    int32_t srcX = tx * span, srcY = ty * span;
+    int32_t cropW = std::min(span, image.width_ - srcX);
+    int32_t cropH = std::min(span, image.height_ - srcY);
+    if (cropW <= 0 || cropH <= 0) {
+        return false;
+    }
+    tile->key_ = key;
+    tile->width_ = std::max(1, (cropW + (1 << level) - 1) >> level);
+    tile->height_ = std::max(1, (cropH + (1 << level) - 1) >> level);
+    tile->pixels_.resize(tile->width_ * tile->height_ * 4);
+
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config)) {
+        return false;
+    }
+    config.options.use_cropping = 1;
+    config.options.crop_left = srcX;
+    config.options.crop_top = srcY;
+    config.options.crop_width = cropW;
+    config.options.crop_height = cropH;
+    if (level) {
+        config.options.use_scaling = 1;
+        config.options.scaled_width = tile->width_;
+        config.options.scaled_height = tile->height_;
+    }
+    // parallelism comes from decoding several tiles at once
+    config.options.use_threads = 0;
+    config.output.colorspace = MODE_RGBA;
+    config.output.width = tile->width_;
+    config.output.height = tile->height_;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = tile->pixels_.data();
+    config.output.u.RGBA.stride = tile->width_ * 4;
+    config.output.u.RGBA.size = tile->pixels_.size();
+
+    VP8StatusCode status = WebPDecode(image.data_, image.len_, &config);
+    WebPFreeDecBuffer(&config.output);
+    return (status == VP8_STATUS_OK);
+}
+
+/*
+ * DecodeTilesInternal():
+ *    worker loop: decode pending tiles into cache, evicting the least
+ *    recently used tiles beyond kCACHE_BUDGET
+ */
+void WebpTileDecoder::DecodeTilesInternal(void) {
+    pthread_mutex_lock(&lock_);
+    while (!exit_) {
+        if (pending_.empty()) {
+            pthread_cond_wait(&cond_, &lock_);
+            continue;
+        }
+        uint64_t key = pending_.front();
+        pending_.pop_front();
+        pthread_mutex_unlock(&lock_);
+
+        uint64_t startTime = GetTimeInUs();
+        std::shared_ptr<Tile> tile(new Tile);
+        bool decoded = DecodeTile(key, tile.get());
+        uint64_t decodeTime = GetTimeInUs() - startTime;
+
+        pthread_mutex_lock(&lock_);
+        queued_.erase(key);
+        if (!decoded) {
+            continue;
+        }
+        tiles_.push_front(tile);
+        tileMap_[key] = tiles_.begin();
+        cacheBytes_ += tile->pixels_.size();
+        while (cacheBytes_ > kCACHE_BUDGET && tiles_.size() > 1) {
+            std::shared_ptr<Tile>& victim = tiles_.back();
+            cacheBytes_ -= victim->pixels_.size();
+            tileMap_.erase(victim->key_);
+            tiles_.pop_back();
+            stats_.evictedTiles_++;
+        }
+        generation_++;
+        stats_.decodedTiles_++;
+        stats_.totalDecodeTime_ += decodeTime;
+    }
+    pthread_mutex_unlock(&lock_);
+}
+
+/*
+ * BlitTile():
+ *    nearest sampling of the part of tile (at level, position tx/ty) that
+ *    falls into the viewport
+ */
+void WebpTileDecoder::BlitTile(const Tile& tile, int32_t level,
+                               int32_t tx, int32_t ty, float left, float top,
+                               float scale, uint8_t* dst) {
+    float span = static_cast<float>(kTILE_SIZE << level);
+    float srcX = tx * span, srcY = ty * span;
+    float unit = static_cast<float>(1 << level);
+
+    int32_t x0 = std::max(0, static_cast<int32_t>(
+        std::floor((srcX - left) * scale)));
+    int32_t x1 = std::min(bufInfo_.width_, static_cast<int32_t>(
+        std::ceil((srcX + tile.width_ * unit - left) * scale)));
+    int32_t y0 = std::max(0, static_cast<int32_t>(
+        std::floor((srcY - top) * scale)));
+    int32_t y1 = std::min(bufInfo_.height_, static_cast<int32_t>(
+        std::ceil((srcY + tile.height_ * unit - top) * scale)));
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    std::vector<int32_t> columns(x1 - x0);
+    for (int32_t x = x0; x < x1; x++) {
+        columns[x - x0] = static_cast<int32_t>(
+            std::floor((left + (x + 0.5f) / scale - srcX) / unit));
+    }
+    for (int32_t y = y0; y < y1; y++) {
+        int32_t row = static_cast<int32_t>(
+            std::floor((top + (y + 0.5f) / scale - srcY) / unit));
+        if (row < 0 || row >= tile.height_) {
+            continue;
+        }
+        const uint8_t* src = &tile.pixels_[row * tile.width_ * 4];
+        uint8_t* line = dst + y * bufInfo_.stride_ * bytePerPix_;
+        for (int32_t x = x0; x < x1; x++) {
+            int32_t col = columns[x - x0];
+            if (col < 0 || col >= tile.width_) {
+                continue;
+            }
+            StoreRGBAPixel(src + col * 4, line + x * bytePerPix_, bytePerPix_);
+        }
+    }
+}
+
+bool WebpTileDecoder::RenderViewport(int32_t id, float left, float top,
+                                     float scale, uint8_t* dst) {
+    Image image;
+    if (scale <= 0.0f || !dst || !GetImage(id, &image)) {
+        return false;
+    }
+
+    // decode at the first level not smaller than what is displayed
+    int32_t level = 0;
+    while (level < image.maxLevel_ && scale * (2 << level) <= 1.0f) {
+        level++;
+    }
+    int32_t span = kTILE_SIZE << level;
+    float right = std::min(static_cast<float>(image.width_),
+                           left + bufInfo_.width_ / scale);
+    float bottom = std::min(static_cast<float>(image.height_),
+                            top + bufInfo_.height_ / scale);
+    int32_t tx0 = static_cast<int32_t>(std::max(0.0f, left)) / span;
+    int32_t ty0 = static_cast<int32_t>(std::max(0.0f, top)) / span;
+    int32_t tx1 = static_cast<int32_t>(std::ceil(right)) / span;
+    int32_t ty1 = static_cast<int32_t>(std::ceil(bottom)) / span;
+    tx1 = std::min(tx1, (image.width_ - 1) / span);
+    ty1 = std::min(ty1, (image.height_ - 1) / span);
+
+    struct DrawItem {
+        std::shared_ptr<Tile> tile_;
+        int32_t level_, tx_, ty_;
+    };
+    std::vector<DrawItem> fallbacks, draws;
+    bool complete = true;
+
+    pthread_mutex_lock(&lock_);
+    if (id != viewId_ || left != viewLeft_ || top != viewTop_ ||
+        scale != viewScale_) {
+        // new viewport: drop requests for tiles no longer visible
+        for (auto key : pending_) {
+            queued_.erase(key);
+        }
+        pending_.clear();
+        viewId_ = id, viewLeft_ = left, viewTop_ = top, viewScale_ = scale;
+        viewStartTime_ = GetTimeInUs();
+        viewComplete_ = false;
+        viewKeys_.clear();
+    }
+    std::unordered_set<uint64_t> fallbackKeys;
+    for (int32_t ty = ty0; ty <= ty1; ty++) {
+        for (int32_t tx = tx0; tx <= tx1; tx++) {
+            uint64_t key = TileKey(id, level, tx, ty);
+            // re-renders of the same viewport are not counted again
+            bool counted = !viewKeys_.insert(key).second;
+            std::shared_ptr<Tile> tile = FindTile(key);
+            if (tile) {
+                if (!counted) {
+                    stats_.hits_++;
+                }
+                draws.push_back(DrawItem {tile, level, tx, ty});
+                continue;
+            }
+            if (!counted) {
+                stats_.misses_++;
+            }
+            complete = false;
+            if (!queued_.count(key)) {
+                queued_.insert(key);
+                pending_.push_back(key);
+            }
+            // show the closest coarser level meanwhile
+            for (int32_t l = level + 1; l <= image.maxLevel_; l++) {
+                int32_t shift = l - level;
+                uint64_t parentKey = TileKey(id, l, tx >> shift, ty >> shift);
+                std::shared_ptr<Tile> parent = FindTile(parentKey);
+                if (parent) {
+                    if (fallbackKeys.insert(parentKey).second) {
+                        fallbacks.push_back(DrawItem {parent, l, tx >> shift,
+                                                      ty >> shift});
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    if (!pending_.empty()) {
+        pthread_cond_broadcast(&cond_);
+    }
+    if (complete && !viewComplete_) {
+        viewComplete_ = true;
+        stats_.viewports_++;
+        stats_.totalViewportTime_ += GetTimeInUs() - viewStartTime_;
+    }
+    pthread_mutex_unlock(&lock_);
+
+    // tiles are held by shared pointers: safe to draw without lock
+    uint8_t* line = dst;
+    for (int32_t y = 0; y < bufInfo_.height_; y++) {
+        memset(line, 0, bufInfo_.width_ * bytePerPix_);
+        line += bufInfo_.stride_ * bytePerPix_;
+    }
+    for (auto& item : fallbacks) {
+        BlitTile(*item.tile_, item.level_, item.tx_, item.ty_,
+                 left, top, scale, dst);
+    }
+    for (auto& item : draws) {
+        BlitTile(*item.tile_, item.level_, item.tx_, item.ty_,
+                 left, top, scale, dst);
+    }
+    return complete;
+}
+
+uint32_t WebpTileDecoder::Generation(void) {
+    pthread_mutex_lock(&lock_);
+    uint32_t generation = generation_;
+    pthread_mutex_unlock(&lock_);
+    return generation;
+}
+
+void WebpTileDecoder::GetStats(TileStats* stats) {
+    pthread_mutex_lock(&lock_);
+    *stats = stats_;
+    stats->cacheBytes_ = cacheBytes_;
+    pthread_mutex_unlock(&lock_);
+}
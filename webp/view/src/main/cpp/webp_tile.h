@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __WEBP_TILE_H__
+#define __WEBP_TILE_H__
+#include <pthread.h>
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "webp_decode.h"
+
+/*
+ * Tile decoding statistics
+ *   hits, misses:  tiles of a viewport found in cache or queued for decoding
+ *                  when the viewport is first rendered; re-rendering it while
+ *                  tiles are pending does not count them again
+ *   viewport time: from the first RenderViewport() of a new viewport until
+ *                  all of its tiles are rendered at the requested level,
+ *                  in micro-seconds
+ */
+struct TileStats {
+    uint32_t hits_, misses_;
+    uint32_t decodedTiles_, evictedTiles_;
+    uint64_t totalDecodeTime_;
+    uint32_t viewports_;
+    uint64_t totalViewportTime_;
+    uint64_t cacheBytes_;
+};
+
+/*
+ * Tiled webp decoder for pictures too large to decode in one go:
+ *     A picture is split into kTILE_SIZE x kTILE_SIZE tiles at every level of
+ *     detail; level n is the picture scaled down by 2^n. Each tile is decoded
+ *     on its own with libwebp cropping + scaling options, so only the visible
+ *     part of the picture is decoded, and only at the resolution needed.
+ *     Tiles are decoded by a pool of worker threads into an LRU cache keyed
+ *     by (file, level, tile), bounded by kCACHE_BUDGET bytes.
+ *     While a tile is not decoded yet, a coarser cached level is shown in its
+ *     place.
+ *     Compressed data is not copied: it must stay valid while the decoder is
+ *     alive.
+ */
+class WebpTileDecoder {
+  public:
+    static const int32_t  kTILE_SIZE = 256;
+    static const uint32_t kCACHE_BUDGET = 64 * 1024 * 1024;
+    static const uint32_t kMAX_WORKERS = 4;
+
+    explicit WebpTileDecoder(const DecodeSurfaceDescriptor& surfDesc);
+    ~WebpTileDecoder();
+
+    // register a picture, return its id or -1 on error
+    int32_t  AddImage(const uint8_t* data, size_t len);
+    bool     GetImageSize(int32_t id, int32_t* width, int32_t* height);
+
+    /*
+     * Render the viewport into dst (surface geometry): picture pixel
+     * (left, top) goes to dst origin, scale is dst pixels per picture
+     * pixel. Missing tiles are queued for decoding; return true if all
+     * tiles were available at the wanted level.
+     */
+    bool     RenderViewport(int32_t id, float left, float top, float scale,
+                            uint8_t* dst);
+
+    // bumped every time a tile is decoded, for callers to re-render
+    uint32_t Generation(void);
+    void     GetStats(TileStats* stats);
+
+    // worker thread function, not called from user
+    void     DecodeTilesInternal(void);
+
+  private:
+    struct Image {
+        const uint8_t* data_;
+        size_t         len_;
+        int32_t        width_, height_;
+        int32_t        maxLevel_;
+    };
+    struct Tile {
+        uint64_t key_;
+        int32_t  width_, height_;
+        std::vector<uint8_t> pixels_;   // RGBA
+    };
+    typedef std::list<std::shared_ptr<Tile>> TileList;
+
+    static uint64_t TileKey(int32_t id, int32_t level, int32_t tx, int32_t ty);
+    bool     GetImage(int32_t id, Image* image);
+    std::shared_ptr<Tile> FindTile(uint64_t key);
+    bool     DecodeTile(uint64_t key, Tile* tile);
+    void     BlitTile(const Tile& tile, int32_t level, int32_t tx, int32_t ty,
+                      float left, float top, float scale, uint8_t* dst);
+
+    DecodeSurfaceDescriptor bufInfo_;
+    uint32_t bytePerPix_;
+    std::vector<Image> images_;
+
+    // cache: most recently used tile at front
+    TileList tiles_;
+    std::unordered_map<uint64_t, TileList::iterator> tileMap_;
+    uint64_t cacheBytes_;
+
+    // decode requests: only tiles of the latest viewport are pending
+    std::deque<uint64_t>         pending_;
+    std::unordered_set<uint64_t> queued_;
+    std::vector<pthread_t>       workers_;
+    pthread_mutex_t lock_;
+    pthread_cond_t  cond_;
+    bool      exit_;
+    uint32_t  generation_;
+
+    // viewport timing
+    int32_t   viewId_;
+    float     viewLeft_, viewTop_, viewScale_;
+    uint64_t  viewStartTime_;
+    bool      viewComplete_;
+    std::unordered_set<uint64_t> viewKeys_;   // tiles counted in stats_
+    TileStats stats_;
+};
+#endif // __WEBP_TILE_H__
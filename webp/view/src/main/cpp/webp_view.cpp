@@ -14,12 +14,15 @@
  * limitations under the License.
  */
 
-#include <cstdio>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <android/native_window.h>
 #include <android_native_app_glue.h>
 #include <android/log.h>
 #include "webp_decode.h"
+#include "webp_tile.h"
 
 #define  LOG_TAG    "libwebp-view"
 #define  LOGI(...)  __android_log_print(ANDROID_LOG_INFO,LOG_TAG,__VA_ARGS__)
@@ -30,6 +33,7 @@
  * webp files that are inside assets folder:
  *    they will be decoded and displayed as slide-show
  *    decoding will happen in its own thread
+ *    animated files are played with their own frame timing
  */
 const char * frames[] = {
         "clips/frame1.webp",
@@ -38,6 +42,22 @@ const char * frames[] = {
 };
 const int kFRAME_COUNT = sizeof(frames) / sizeof(frames[0]);
 const int kFRAME_DISPLAY_TIME = 2;
+/*
+ * Decode incrementally straight into the locked window buffer instead of
+ * through decoder's frame ring: the file is streamed in chunks through
+ * WebPIDecoder, with no frame ring and no copy into the window. The picture
+ * is shown once it is decoded, as the window is only posted on unlock, and
+ * decoding happens on this thread. Animated files need the frame ring.
+ */
+const bool kDECODE_INTO_WINDOW = true;
+// log decoder statistics every so many displayed frames
+const int kSTATS_LOG_INTERVAL = 30;
+/*
+ * Show the first file with the tiled decoder instead of the slide-show:
+ * only visible tiles are decoded, at the resolution needed. Drag to pan,
+ * tap to toggle between fit-to-window and 1:1 zoom.
+ */
+const bool kTILED_VIEW = false;
 
 /*
  * main object handles Android window frame update, and use webp to decode
@@ -48,11 +68,14 @@ class Engine {
     explicit Engine(android_app* app) :
                 app_(app),
                 decoder_(nullptr),
-                animating_(false) {
+                animating_(false),
+                frameDuration_(0),
+                tiles_(nullptr),
+                tiledAsset_(nullptr) {
         memset(&frameStartTime_, 0, sizeof(frameStartTime_));
     }
 
-    ~Engine() {}
+    ~Engine() { ReleaseTiledView(); }
 
     struct android_app* AndroidApp(void) const { return app_; }
     void StartAnimation(bool start) { animating_ = start; }
@@ -67,17 +90,38 @@ class Engine {
     // and current frame has been displayed with requested time
     bool UpdateDisplay(void);
 
+    // pan / zoom for tiled view, return true if the event is consumed
+    bool HandleTouch(AInputEvent* event);
+
   private:
     void UpdateFrameBuffer(ANativeWindow_Buffer* buf, uint8_t* src);
+    void LogDecoderStats(void);
+    bool PrepareTiledView(const DecodeSurfaceDescriptor& descriptor);
+    void ReleaseTiledView(void);
+    bool UpdateTiledView(void);
+    void ClampViewport(void);
     struct android_app* app_;
     WebpDecoder* decoder_;
     bool animating_;
     struct timespec frameStartTime_;
+    uint32_t frameDuration_;  // ms, current frame stays on screen
+
+    // tiled view
+    WebpTileDecoder* tiles_;
+    AAsset* tiledAsset_;
+    int32_t tiledImage_;
+    int32_t imageWidth_, imageHeight_, windowWidth_, windowHeight_;
+    float viewLeft_, viewTop_, viewScale_, fitScale_;
+    uint32_t tileGeneration_;
+    bool viewDirty_;
+    float touchX_, touchY_;
+    bool touchMoved_;
 };
 
 static int32_t ProcessAndroidInput(struct android_app *app, AInputEvent *event) {
     Engine* engine = reinterpret_cast<Engine*>(app->userData);
     if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_MOTION) {
+        engine->HandleTouch(event);
         engine->StartAnimation(true);
         return 1;
     } else if (AInputEvent_getType(event) == AINPUT_EVENT_TYPE_KEY) {
@@ -171,6 +215,7 @@ bool Engine::PrepareDrawing(void) {
     // create decoder
     if (decoder_) {
         decoder_->DestroyDecoder();
+        decoder_ = nullptr;
     }
     ANativeWindow_Buffer buf;
     if (ANativeWindow_lock(app_->window, &buf, NULL) < 0) {
@@ -196,8 +241,14 @@ bool Engine::PrepareDrawing(void) {
     descriptor.height_ = buf.height;
     descriptor.stride_ = buf.stride;
 
+    if (kTILED_VIEW) {
+        return PrepareTiledView(descriptor);
+    }
+
     decoder_ = new WebpDecoder(frames, kFRAME_COUNT, &descriptor,
-                               app_->activity->assetManager);
+                               app_->activity->assetManager,
+                               kDECODE_INTO_WINDOW ? 0 :
+                               WebpDecoder::kDEFAULT_FRAME_RING_SIZE);
     assert(decoder_);
     if (!decoder_) {
         return false;
@@ -209,23 +260,44 @@ bool Engine::PrepareDrawing(void) {
 
 /*
  * Only copy decoded webp picture when:
- *  - current frame has been on for kFrame_DISPLAY_TIME seconds
+ *  - current frame has been on for kFrame_DISPLAY_TIME seconds, or its own
+ *    duration for animation frames
  *  - a new picture is decoded
  * After copying, start decoding the next frame
  */
 bool Engine::UpdateDisplay(void) {
+    if (tiles_) {
+        return UpdateTiledView();
+    }
     if (!app_->window || !decoder_) {
         assert(0);
         return false;
     }
     struct timespec curTime;
     clock_gettime(CLOCK_MONOTONIC, &curTime);
-    if (curTime.tv_sec <
-        (frameStartTime_.tv_sec + (__kernel_time_t )kFRAME_DISPLAY_TIME)) {
+    int64_t elapsed = (curTime.tv_sec - frameStartTime_.tv_sec) * 1000 +
+                      (curTime.tv_nsec - frameStartTime_.tv_nsec) / 1000000;
+    if (elapsed < frameDuration_) {
         // current frame is displayed less than required duration
         return false;
     }
-    uint8_t *frame = decoder_->GetDecodedFrame();
+    if (kDECODE_INTO_WINDOW) {
+        ANativeWindow_Buffer buffer;
+        if (ANativeWindow_lock(app_->window, &buffer, nullptr) < 0) {
+            LOGW("Unable to lock window buffer");
+            return false;
+        }
+        bool decoded = decoder_->DecodeFrameInto(
+            reinterpret_cast<uint8_t*>(buffer.bits), nullptr, nullptr);
+        ANativeWindow_unlockAndPost(app_->window);
+        clock_gettime(CLOCK_MONOTONIC, &frameStartTime_);
+        frameDuration_ = kFRAME_DISPLAY_TIME * 1000;
+        LogDecoderStats();
+        return decoded;
+    }
+
+    uint32_t duration = 0;
+    uint8_t *frame = decoder_->GetDecodedFrame(&duration);
     if (!frame)
         return false;
 
@@ -237,9 +309,187 @@ bool Engine::UpdateDisplay(void) {
     UpdateFrameBuffer(&buffer, frame);
     ANativeWindow_unlockAndPost(app_->window);
     clock_gettime(CLOCK_MONOTONIC, &frameStartTime_);
+    frameDuration_ = duration ? duration : kFRAME_DISPLAY_TIME * 1000;
 
-    // start decoding next frame
+    // return the frame to decoder to decode next one into it
     decoder_->DecodeFrame();
+    LogDecoderStats();
+    return true;
+}
+
+/*
+ * LogDecoderStats(): dump decoder statistics every kSTATS_LOG_INTERVAL frames
+ */
+void Engine::LogDecoderStats(void) {
+    DecoderStats stats;
+    decoder_->GetStats(&stats);
+    if (!stats.decodedFrames_ || stats.displayedFrames_ % kSTATS_LOG_INTERVAL) {
+        return;
+    }
+    LOGI("Decoded %d frames, decode time(us) min %d, avg %d, max %d",
+         stats.decodedFrames_, stats.minDecodeTime_,
+         static_cast<int32_t>(stats.totalDecodeTime_ / stats.decodedFrames_),
+         stats.maxDecodeTime_);
+    if (stats.incrementalFrames_) {
+        LOGI("First row decoded in %d us on average",
+             static_cast<int32_t>(stats.totalFirstRowTime_ /
+                                  stats.incrementalFrames_));
+    } else {
+        LOGI("Queue depth avg %.2f, max %d, underruns %d",
+             static_cast<float>(stats.totalQueueDepth_) /
+             stats.displayedFrames_,
+             stats.maxQueueDepth_, stats.underruns_);
+    }
+    LOGI("Decoder memory %lld bytes, peak %lld bytes",
+         static_cast<long long>(stats.memory_),
+         static_cast<long long>(stats.peakMemory_));
+}
+
+/*
+ * PrepareTiledView():
+ *     map the first file and show it fit to window; tiles are decoded on
+ *     demand by tile decoder's own threads
+ */
+bool Engine::PrepareTiledView(const DecodeSurfaceDescriptor& descriptor) {
+    ReleaseTiledView();
+    tiledAsset_ = AAssetManager_open(app_->activity->assetManager, frames[0],
+                                     AASSET_MODE_BUFFER);
+    if (!tiledAsset_) {
+        LOGE("Unable to open %s for tiled view", frames[0]);
+        return false;
+    }
+    tiles_ = new WebpTileDecoder(descriptor);
+    tiledImage_ = tiles_->AddImage(
+        static_cast<const uint8_t*>(AAsset_getBuffer(tiledAsset_)),
+        AAsset_getLength(tiledAsset_));
+    if (tiledImage_ < 0 ||
+        !tiles_->GetImageSize(tiledImage_, &imageWidth_, &imageHeight_)) {
+        LOGE("%s is not a valid webp file", frames[0]);
+        ReleaseTiledView();
+        return false;
+    }
+    windowWidth_ = descriptor.width_;
+    windowHeight_ = descriptor.height_;
+    fitScale_ = std::min(static_cast<float>(windowWidth_) / imageWidth_,
+                         static_cast<float>(windowHeight_) / imageHeight_);
+    viewScale_ = fitScale_;
+    viewLeft_ = viewTop_ = 0.0f;
+    ClampViewport();
+    tileGeneration_ = 0;
+    viewDirty_ = true;
+    touchMoved_ = false;
+    return true;
+}
+
+void Engine::ReleaseTiledView(void) {
+    delete tiles_;
+    tiles_ = nullptr;
+    if (tiledAsset_) {
+        AAsset_close(tiledAsset_);
+        tiledAsset_ = nullptr;
+    }
+}
+
+/*
+ * ClampViewport(): keep picture inside window, centered when it is smaller
+ */
+void Engine::ClampViewport(void) {
+    float viewWidth = windowWidth_ / viewScale_;
+    float viewHeight = windowHeight_ / viewScale_;
+    if (viewWidth >= imageWidth_) {
+        viewLeft_ = (imageWidth_ - viewWidth) / 2;
+    } else {
+        viewLeft_ = std::min(std::max(viewLeft_, 0.0f),
+                             imageWidth_ - viewWidth);
+    }
+    if (viewHeight >= imageHeight_) {
+        viewTop_ = (imageHeight_ - viewHeight) / 2;
+    } else {
+        viewTop_ = std::min(std::max(viewTop_, 0.0f),
+                            imageHeight_ - viewHeight);
+    }
+}
+
+bool Engine::HandleTouch(AInputEvent* event) {
+    if (!tiles_) {
+        return false;
+    }
+    float x = AMotionEvent_getX(event, 0);
+    float y = AMotionEvent_getY(event, 0);
+    switch (AMotionEvent_getAction(event) & AMOTION_EVENT_ACTION_MASK) {
+        case AMOTION_EVENT_ACTION_DOWN:
+            touchMoved_ = false;
+            break;
+        case AMOTION_EVENT_ACTION_MOVE:
+            if (std::abs(x - touchX_) + std::abs(y - touchY_) > 8.0f ||
+                touchMoved_) {
+                viewLeft_ -= (x - touchX_) / viewScale_;
+                viewTop_ -= (y - touchY_) / viewScale_;
+                touchMoved_ = true;
+                ClampViewport();
+                viewDirty_ = true;
+            } else {
+                // not a drag yet: keep the anchor point
+                return true;
+            }
+            break;
+        case AMOTION_EVENT_ACTION_UP:
+            if (!touchMoved_) {
+                // tap: zoom 1:1 around the tapped point, or back to fit
+                float newScale = (viewScale_ < 1.0f) ? 1.0f : fitScale_;
+                float pointX = viewLeft_ + x / viewScale_;
+                float pointY = viewTop_ + y / viewScale_;
+                viewScale_ = newScale;
+                viewLeft_ = pointX - x / viewScale_;
+                viewTop_ = pointY - y / viewScale_;
+                ClampViewport();
+                viewDirty_ = true;
+            }
+            break;
+        default:
+            break;
+    }
+    touchX_ = x, touchY_ = y;
+    return true;
+}
+
+/*
+ * UpdateTiledView():
+ *     re-render the viewport when it moved, or when more tiles are decoded
+ */
+bool Engine::UpdateTiledView(void) {
+    uint32_t generation = tiles_->Generation();
+    if (!app_->window || (!viewDirty_ && generation == tileGeneration_)) {
+        return false;
+    }
+    ANativeWindow_Buffer buffer;
+    if (ANativeWindow_lock(app_->window, &buffer, nullptr) < 0) {
+        LOGW("Unable to lock window buffer");
+        return false;
+    }
+    bool complete = tiles_->RenderViewport(
+        tiledImage_, viewLeft_, viewTop_, viewScale_,
+        reinterpret_cast<uint8_t*>(buffer.bits));
+    ANativeWindow_unlockAndPost(app_->window);
+    tileGeneration_ = generation;
+
+    if (complete && viewDirty_) {
+        TileStats stats;
+        tiles_->GetStats(&stats);
+        uint32_t lookups = stats.hits_ + stats.misses_;
+        LOGI("Tiles: hit rate %.1f%%, %d decoded (avg %d us), %d evicted, "
+             "cache %lld bytes",
+             lookups ? 100.0f * stats.hits_ / lookups : 0.0f,
+             stats.decodedTiles_,
+             stats.decodedTiles_ ? static_cast<int32_t>(
+                 stats.totalDecodeTime_ / stats.decodedTiles_) : 0,
+             stats.evictedTiles_, static_cast<long long>(stats.cacheBytes_));
+        LOGI("Time to viewport avg %d us over %d viewports",
+             stats.viewports_ ? static_cast<int32_t>(
+                 stats.totalViewportTime_ / stats.viewports_) : 0,
+             stats.viewports_);
+    }
+    viewDirty_ = false;
     return true;
 }
 